@@ -28,6 +28,12 @@ EXAMPLES=(
     "send"
     "receive_poll"
     "receive_interrupt"
+    "selftest"
+    "sniffer"
+    "receive_hybrid"
+    "traffic_gen"
+    "ping"
+    "flash_stress"
 )
 
 echo -e "${BLUE}========================================${NC}"
@@ -2,7 +2,7 @@
  * @file config_twai.h
  * @brief Hardware configuration for ESP32 TWAI (CAN) examples
  * 
- * This configuration is used by all TWAI examples (send, receive_poll, receive_interrupt).
+ * This configuration is used by all TWAI examples (send, receive_poll, receive_interrupt, selftest, sniffer, receive_hybrid, traffic_gen, ping, flash_stress).
  * Adjust GPIO pins and parameters according to your hardware setup.
  * 
  * Hardware requirements:
@@ -0,0 +1,206 @@
+/**
+ * @file main.c
+ * @brief Continuous CAN reception while flash is erased and written
+ *
+ * This example checks CONFIG_CAN_TWAI_IRAM_HOT_PATH on real hardware. A
+ * receiver task drains the bus continuously while the main task erases and
+ * rewrites a scratch flash partition, which disables the flash cache for
+ * tens of milliseconds at a time. At the end the driver's rx_missed_count
+ * (driver RX queue full) and rx_overrun_count (controller FIFO overrun) must
+ * both still be 0; the example reports FAIL and asserts otherwise.
+ *
+ * Traffic comes from the board itself: the controller runs in no-ACK mode
+ * and a sender task keeps the TX queue full of self-received frames with a
+ * sequence number; in this mode the test also fails on gaps in the received
+ * sequence or if fewer frames come back than were sent.
+ * For a load that does not pause with the flash operation, set
+ * SELF_TRAFFIC to 0 and run examples/traffic_gen on a second node.
+ *
+ * Hardware requirements:
+ * - ESP32 with TWAI controller
+ * - CAN transceiver (e.g., SN65HVD230)
+ * - 120-ohm termination resistor (no other node needed with SELF_TRAFFIC)
+ *
+ * Configuration: See examples/config_twai.h, sdkconfig.defaults (IRAM hot
+ * path) and partitions.csv (scratch "storage" partition)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "can_twai.h"
+#include "config_twai.h"
+
+static const char *TAG = "flash_stress";
+
+#define SELF_TRAFFIC     1        /**< 1 = send self-received frames, 0 = external traffic */
+#define TEST_ID          0x5A0    /**< Identifier of the self-received frames */
+#define FLASH_CYCLES     16       /**< Erase/write cycles over the scratch area */
+#define FLASH_AREA_SIZE  (64 * 1024)
+#define WRITE_CHUNK      4096
+#define RX_TASK_PRIO     (configMAX_PRIORITIES - 2)
+#define TX_TASK_PRIO     (tskIDLE_PRIORITY + 2)
+#define TASK_STACK       3072
+
+/** @brief Counters shared between the test tasks */
+static volatile bool stop = false;
+static volatile bool stop_tx = false;
+static volatile bool rx_exited = false;
+static volatile bool tx_exited = false;
+static volatile uint32_t received = 0;
+static volatile uint32_t seq_gaps = 0;
+static volatile uint32_t sent = 0;
+
+static uint8_t chunk[WRITE_CHUNK];
+
+static void rx_task(void *arg)
+{
+    (void)arg;
+    twai_message_t msg;
+    uint32_t expected = 0;
+    bool have_seq = false;
+
+    while (!stop) {
+        if (!can_twai_receive_timeout(&msg, pdMS_TO_TICKS(10))) {
+            continue;
+        }
+        received++;
+        if (msg.identifier != TEST_ID || msg.data_length_code < 4) {
+            continue;
+        }
+        uint32_t seq;
+        memcpy(&seq, msg.data, sizeof(seq));
+        if (have_seq && seq != expected) {
+            seq_gaps++;
+        }
+        expected = seq + 1;
+        have_seq = true;
+    }
+    rx_exited = true;
+    vTaskDelete(NULL);
+}
+
+static void tx_task(void *arg)
+{
+    (void)arg;
+    twai_message_t msg = {0};
+    msg.identifier = TEST_ID;
+    msg.self = 1;
+    msg.data_length_code = 8;
+
+    uint32_t seq = 0;
+    while (!stop_tx) {
+        memcpy(msg.data, &seq, sizeof(seq));
+        if (can_twai_send_timeout(&msg, pdMS_TO_TICKS(10))) {
+            seq++;
+            sent++;
+        }
+    }
+    tx_exited = true;
+    vTaskDelete(NULL);
+}
+
+/** @brief Erase and rewrite the scratch area FLASH_CYCLES times */
+static bool stress_flash(const esp_partition_t *part)
+{
+    size_t area = part->size < FLASH_AREA_SIZE ? part->size : FLASH_AREA_SIZE;
+    for (int cycle = 0; cycle < FLASH_CYCLES; cycle++) {
+        esp_err_t err = esp_partition_erase_range(part, 0, area);
+        for (size_t off = 0; err == ESP_OK && off < area; off += WRITE_CHUNK) {
+            memset(chunk, (uint8_t)(cycle + off / WRITE_CHUNK), sizeof(chunk));
+            err = esp_partition_write(part, off, chunk, sizeof(chunk));
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Flash cycle %d failed: %s", cycle, esp_err_to_name(err));
+            return false;
+        }
+        ESP_LOGI(TAG, "Cycle %2d: erased and wrote %u KB, %lu frames received so far", cycle,
+                 (unsigned)(area / 1024), (unsigned long)received);
+    }
+    return true;
+}
+
+void app_main(void)
+{
+    ESP_LOGI(TAG, "=== example: flash_stress, backend: %s ===", can_backend_get_name());
+#if !CONFIG_CAN_TWAI_IRAM_HOT_PATH
+    ESP_LOGW(TAG, "CONFIG_CAN_TWAI_IRAM_HOT_PATH is off, frames are expected to be lost");
+#endif
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, "storage");
+    if (part == NULL) {
+        ESP_LOGE(TAG, "No \"storage\" partition, use the example's partitions.csv");
+        return;
+    }
+
+    twai_backend_config_t hw = TWAI_HW_CFG;
+#if SELF_TRAFFIC
+    hw.params.mode = TWAI_MODE_NO_ACK;
+#endif
+    if (!can_twai_init(&hw)) {
+        ESP_LOGE(TAG, "Failed to initialize %s backend", can_backend_get_name());
+        return;
+    }
+
+    // Receiver on this core, above the flash-writing main task
+    xTaskCreatePinnedToCore(rx_task, "can_fs_rx", TASK_STACK, NULL, RX_TASK_PRIO, NULL,
+                            xPortGetCoreID());
+#if SELF_TRAFFIC
+    xTaskCreate(tx_task, "can_fs_tx", TASK_STACK, NULL, TX_TASK_PRIO, NULL);
+#else
+    tx_exited = true;
+#endif
+    vTaskDelay(pdMS_TO_TICKS(100));  // let traffic settle before the first erase
+
+    bool flash_ok = stress_flash(part);
+
+    // Stop sending first so the receiver can collect every frame still queued
+    stop_tx = true;
+    while (!tx_exited) {
+        vTaskDelay(1);
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));  // drain what arrived during the last write
+
+    stop = true;
+    while (!rx_exited) {
+        vTaskDelay(1);
+    }
+
+    twai_status_info_t status;
+    if (!can_twai_get_status(&status)) {
+        ESP_LOGE(TAG, "Failed to read driver status");
+        can_twai_deinit();
+        return;
+    }
+    can_twai_deinit();
+
+    ESP_LOGI(TAG, "sent %lu, received %lu, sequence gaps %lu", (unsigned long)sent,
+             (unsigned long)received, (unsigned long)seq_gaps);
+    ESP_LOGI(TAG, "rx_missed_count %lu, rx_overrun_count %lu", (unsigned long)status.rx_missed_count,
+             (unsigned long)status.rx_overrun_count);
+
+    bool passed = flash_ok && received > 0 && status.rx_missed_count == 0 &&
+                  status.rx_overrun_count == 0;
+#if SELF_TRAFFIC
+    // Every frame queued for sending must have come back, in order
+    passed = passed && seq_gaps == 0 && received == sent;
+#endif
+    if (passed) {
+        ESP_LOGI(TAG, "Flash stress PASSED");
+    } else {
+        ESP_LOGE(TAG, "Flash stress FAILED - enable CONFIG_CAN_TWAI_IRAM_HOT_PATH or raise "
+                      "CONFIG_CAN_TWAI_IRAM_MIN_RX_QUEUE_LEN");
+    }
+    assert(status.rx_missed_count == 0);
+    assert(status.rx_overrun_count == 0);
+#if SELF_TRAFFIC
+    assert(seq_gaps == 0 && received == sent);
+#endif
+}
@@ -0,0 +1,147 @@
+/**
+ * @file main.c
+ * @brief Round-trip latency between two nodes (CAN ping)
+ *
+ * Flash one node with PING_INITIATOR 1 and the other with PING_INITIATOR 0.
+ *
+ * The responder echoes probes from an RX hook in a high-priority receive
+ * task. The initiator measures the round trip for two receive paths, each
+ * without and with background load from the traffic generator:
+ * - hook:  echoes are handled in the receive task itself,
+ * - queue: the receive task forwards frames to a lower-priority consumer
+ *          task through a queue, as in examples/receive_interrupt, and the
+ *          consumer hands them to can_twai_ping_process().
+ * The difference between the two is the cost of the queue hand-off and the
+ * consumer's priority; the loaded runs add TX queue and arbitration delays.
+ *
+ * Hardware requirements:
+ * - Two ESP32 boards with TWAI controller and CAN transceiver
+ * - 120-ohm termination at both ends of the bus
+ *
+ * Configuration: See examples/config_twai.h (PING_BITRATE must match its timing)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <inttypes.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "examples_utils.h"
+#include "can_twai.h"
+#include "can_twai_ping.h"
+#include "config_twai.h"
+
+static const char *TAG = "ping";
+
+#define PING_INITIATOR  1         // 1 = initiator, 0 = responder
+#define PING_BITRATE    1000000   // TWAI_TIMING_CONFIG_1MBITS() in config_twai.h
+#define PROBE_ID        0x010     // Probes win arbitration against the background load
+#define ECHO_ID         0x011
+#define PROBE_COUNT     1000
+#define PROBE_INTERVAL  5
+
+#define RX_QUEUE_LENGTH 64
+#define RX_TASK_STACK   4096
+#define RX_TASK_PRIO    12
+#define CONSUMER_PRIO   10
+
+static QueueHandle_t rx_queue;
+
+static void rx_task(void *arg)
+{
+    twai_message_t msg;
+    for (;;) {
+        // Hooks (and a hook-mode ping) run inside can_twai_receive()
+        if (can_twai_receive(&msg)) {
+            (void)xQueueSend(rx_queue, &msg, 0);
+        } else {
+            sleep_ms_min_ticks(1);
+        }
+    }
+}
+
+static void consumer_task(void *arg)
+{
+    twai_message_t msg;
+    for (;;) {
+        if (xQueueReceive(rx_queue, &msg, portMAX_DELAY) == pdTRUE) {
+            can_twai_ping_process(&msg);
+        }
+    }
+}
+
+#if PING_INITIATOR
+static void run(const char *path, can_twai_ping_rx_t rx, const can_twai_gen_config_t *background)
+{
+    const can_twai_ping_config_t pc = {
+        .request_id = PROBE_ID, .reply_id = ECHO_ID, .rx = rx,
+        .count = PROBE_COUNT, .interval_ms = PROBE_INTERVAL, .bucket_us = 25,
+        .background = background,
+    };
+    if (!can_twai_ping_start(&pc)) {
+        return;
+    }
+    can_twai_ping_wait(portMAX_DELAY);
+    can_twai_ping_stop();
+
+    can_twai_ping_stats_t st;
+    can_twai_ping_get_stats(&st);
+    ESP_LOGI(TAG, "%-5s | %3" PRIu32 " %% | %5" PRIu32 "/%" PRIu32 " | %5" PRIu32 " | %5" PRIu32 " | %5" PRIu32 " | %5" PRIu32,
+             path, background ? background->load_permille / 10 : 0, st.received, st.sent,
+             st.rtt_min_us, can_twai_ping_percentile_us(&st, 50),
+             can_twai_ping_percentile_us(&st, 99), st.rtt_max_us);
+    can_twai_ping_log_report();
+}
+#endif
+
+void app_main(void)
+{
+    ESP_LOGI(TAG, "=== example: ping (%s), backend: %s ===",
+             PING_INITIATOR ? "initiator" : "responder", can_backend_get_name());
+
+    if (!can_twai_init(&TWAI_HW_CFG)) {
+        ESP_LOGE(TAG, "Failed to initialize %s backend", can_backend_get_name());
+        return;
+    }
+
+    rx_queue = xQueueCreate(RX_QUEUE_LENGTH, sizeof(twai_message_t));
+    if (rx_queue == NULL ||
+        xTaskCreate(rx_task, "can_rx", RX_TASK_STACK, NULL, RX_TASK_PRIO, NULL) != pdPASS ||
+        xTaskCreate(consumer_task, "can_cons", RX_TASK_STACK, NULL, CONSUMER_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create RX queue or tasks");
+        return;
+    }
+
+#if PING_INITIATOR
+    const can_twai_gen_config_t load = {
+        .bitrate = PING_BITRATE, .load_permille = 500,
+        .id_mode = CAN_TWAI_GEN_IDS_RANDOM, .id_min = 0x300, .id_max = 0x3FF,
+        .payload = CAN_TWAI_GEN_PAYLOAD_RANDOM,
+    };
+    can_twai_gen_config_t heavy = load;
+    heavy.load_permille = 900;
+
+    ESP_LOGI(TAG, "path  | load | echoed    | min   | p50   | p99   | max (us)");
+    run("hook", CAN_TWAI_PING_RX_HOOK, NULL);
+    run("hook", CAN_TWAI_PING_RX_HOOK, &load);
+    run("hook", CAN_TWAI_PING_RX_HOOK, &heavy);
+    run("queue", CAN_TWAI_PING_RX_EXTERNAL, NULL);
+    run("queue", CAN_TWAI_PING_RX_EXTERNAL, &load);
+    run("queue", CAN_TWAI_PING_RX_EXTERNAL, &heavy);
+    ESP_LOGI(TAG, "Done");
+#else
+    const can_twai_ping_responder_config_t rc = { .request_id = PROBE_ID, .reply_id = ECHO_ID };
+    if (!can_twai_ping_responder_init(&rc)) {
+        return;
+    }
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(10000));
+        uint32_t echoed, failed;
+        can_twai_ping_responder_get_counts(&echoed, &failed);
+        ESP_LOGI(TAG, "Echoed %" PRIu32 " probes, %" PRIu32 " refused by TX", echoed, failed);
+    }
+#endif
+}
@@ -0,0 +1,232 @@
+/**
+ * @file main.c
+ * @brief Hybrid interrupt/polling receive benchmark using ESP32 TWAI controller
+ *
+ * This example compares the three receive modes of can_twai_hybrid.h on the
+ * same bursty workload, without a second node: the controller runs in no-ACK
+ * mode and receives its own frames. Each cycle sends a burst of back-to-back
+ * frames followed by a few isolated frames. For each mode it reports:
+ * - CPU load of the receiver core (idle-priority spinner, as in the self-test),
+ * - wakeups and polls per frame,
+ * - TX->RX latency of isolated frames (what polling costs) and of burst
+ *   frames (includes waiting in the TX queue behind the burst).
+ *
+ * Expected picture: interrupt mode has the lowest latency but one wakeup per
+ * frame in bursts, polling mode has the fewest wakeups in bursts but adds up
+ * to one poll interval to isolated frames and keeps polling while idle, and
+ * auto mode gets close to the best of both.
+ *
+ * Hardware requirements:
+ * - ESP32 with TWAI controller
+ * - CAN transceiver (e.g., SN65HVD230)
+ * - 120-ohm termination resistor (no other node needed)
+ *
+ * Configuration: See examples/config_twai.h (mode and RX queue are overridden)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "can_twai.h"
+#include "can_twai_hybrid.h"
+#include "config_twai.h"
+
+static const char *TAG = "receive_hybrid";
+
+// Workload
+#define TEST_ID          0x6A0
+#define CYCLES           20
+#define BURST_FRAMES     100
+#define ISOLATED_FRAMES  5
+#define ISOLATED_GAP_MS  20
+#define ISOLATED_FLAG    0x80000000u   // set in the sequence number of isolated frames
+
+// Receiver
+#define RECEIVER_PRIO    12
+#define RECEIVER_CORE    (portNUM_PROCESSORS - 1)
+#define CALIBRATION_MS   200
+
+/** @brief Latency accumulator */
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t count;
+} latency_t;
+
+static latency_t lat_isolated;
+static latency_t lat_burst;
+static volatile uint32_t received;
+static volatile uint32_t spin_count;
+static volatile bool spin_stop;
+static volatile bool spin_exited;
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void latency_add(latency_t *l, uint32_t us)
+{
+    if (us < l->min) {
+        l->min = us;
+    }
+    if (us > l->max) {
+        l->max = us;
+    }
+    l->sum += us;
+    l->count++;
+}
+
+static void on_frames(const twai_message_t *msgs, size_t count, void *ctx)
+{
+    (void)ctx;
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        if (msgs[i].identifier != TEST_ID || msgs[i].data_length_code != 8) {
+            continue;
+        }
+        uint32_t lat = now - get_le32(&msgs[i].data[4]);
+        latency_add(get_le32(msgs[i].data) & ISOLATED_FLAG ? &lat_isolated : &lat_burst, lat);
+        received++;
+    }
+}
+
+static void spin_task(void *arg)
+{
+    (void)arg;
+    while (!spin_stop) {
+        spin_count++;
+    }
+    spin_exited = true;
+    vTaskDelete(NULL);
+}
+
+/** @brief Run the idle-priority spinner for a while or until stop_spinner() */
+static bool start_spinner(void)
+{
+    spin_stop = false;
+    spin_exited = false;
+    spin_count = 0;
+    return xTaskCreatePinnedToCore(spin_task, "spin", 1536, NULL, tskIDLE_PRIORITY, NULL,
+                                   RECEIVER_CORE) == pdPASS;
+}
+
+static uint32_t stop_spinner(void)
+{
+    spin_stop = true;
+    while (!spin_exited) {
+        vTaskDelay(1);
+    }
+    return spin_count;
+}
+
+static bool send_frame(uint32_t seq)
+{
+    twai_message_t msg = {0};
+    msg.identifier = TEST_ID;
+    msg.self = 1;
+    msg.data_length_code = 8;
+    put_le32(msg.data, seq);
+    put_le32(&msg.data[4], (uint32_t)esp_timer_get_time());
+    return can_twai_send(&msg);
+}
+
+static void run_mode(can_twai_hybrid_mode_t mode, const char *name, uint32_t idle_spins_per_ms)
+{
+    lat_isolated = (latency_t){ .min = UINT32_MAX };
+    lat_burst = (latency_t){ .min = UINT32_MAX };
+    received = 0;
+
+    const can_twai_hybrid_config_t cfg = {
+        .mode     = mode,
+        .handler  = on_frames,
+        .priority = RECEIVER_PRIO,
+        .core     = RECEIVER_CORE,
+    };
+    if (!can_twai_hybrid_start(&cfg)) {
+        ESP_LOGE(TAG, "Failed to start receiver");
+        return;
+    }
+
+    bool spinning = start_spinner();
+    int64_t start = esp_timer_get_time();
+
+    uint32_t sent = 0;
+    for (uint32_t c = 0; c < CYCLES; c++) {
+        for (uint32_t i = 0; i < BURST_FRAMES; i++) {
+            sent += send_frame(sent);
+        }
+        for (uint32_t i = 0; i < ISOLATED_FRAMES; i++) {
+            vTaskDelay(pdMS_TO_TICKS(ISOLATED_GAP_MS));
+            sent += send_frame(sent | ISOLATED_FLAG);
+        }
+    }
+    vTaskDelay(pdMS_TO_TICKS(ISOLATED_GAP_MS));
+
+    int64_t elapsed_ms = (esp_timer_get_time() - start) / 1000;
+    uint32_t spins = spinning ? stop_spinner() : 0;
+    can_twai_hybrid_stats_t st;
+    can_twai_hybrid_get_stats(&st);
+    can_twai_hybrid_stop();
+
+    uint32_t cpu_pct = 0;
+    if (spinning && idle_spins_per_ms > 0 && elapsed_ms > 0) {
+        uint64_t idle = (uint64_t)idle_spins_per_ms * (uint64_t)elapsed_ms;
+        uint32_t idle_pct = (uint32_t)((uint64_t)spins * 100u / idle);
+        cpu_pct = idle_pct >= 100 ? 0 : 100 - idle_pct;
+    }
+    uint32_t frames = received ? received : 1;
+
+    ESP_LOGI(TAG, "%-9s | %4" PRIu32 "/%4" PRIu32 " | %4" PRIu32 " | %6.2f | %6.2f | %5" PRIu32 " | "
+             "%" PRIu32 "/%" PRIu32 "/%" PRIu32 " | %" PRIu32 "/%" PRIu32,
+             name, received, sent, cpu_pct,
+             (double)st.wakeups / frames, (double)st.polls / frames, st.to_poll,
+             lat_isolated.count ? lat_isolated.min : 0,
+             lat_isolated.count ? (uint32_t)(lat_isolated.sum / lat_isolated.count) : 0,
+             lat_isolated.max,
+             lat_burst.count ? (uint32_t)(lat_burst.sum / lat_burst.count) : 0, lat_burst.max);
+}
+
+void app_main(void)
+{
+    ESP_LOGI(TAG, "=== example: receive_hybrid, backend: %s ===", can_backend_get_name());
+
+    // Receive own frames; the RX queue must hold one poll interval of traffic
+    twai_backend_config_t hw = TWAI_HW_CFG;
+    hw.params.mode = TWAI_MODE_NO_ACK;
+    hw.params.rx_queue_len = 64;
+    if (!can_twai_init(&hw)) {
+        ESP_LOGE(TAG, "Failed to initialize %s backend", can_backend_get_name());
+        return;
+    }
+
+    // Spinner rate on an idle receiver core, for the CPU load estimate
+    uint32_t idle_spins_per_ms = 0;
+    if (start_spinner()) {
+        vTaskDelay(pdMS_TO_TICKS(CALIBRATION_MS));
+        idle_spins_per_ms = stop_spinner() / CALIBRATION_MS;
+    }
+
+    ESP_LOGI(TAG, "%d cycles of %d burst + %d isolated frames (%d ms apart)",
+             CYCLES, BURST_FRAMES, ISOLATED_FRAMES, ISOLATED_GAP_MS);
+    ESP_LOGI(TAG, "mode      | recv/sent | cpu%% | wake/f | poll/f | ->poll | isolated lat min/avg/max us | burst lat avg/max us");
+    run_mode(CAN_TWAI_HYBRID_INTERRUPT, "interrupt", idle_spins_per_ms);
+    run_mode(CAN_TWAI_HYBRID_POLL, "poll", idle_spins_per_ms);
+    run_mode(CAN_TWAI_HYBRID_AUTO, "auto", idle_spins_per_ms);
+
+    can_twai_deinit();
+}
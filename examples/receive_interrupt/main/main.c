@@ -9,6 +9,11 @@
  * This pattern prevents message loss during processing by using a queue buffer.
  * The TWAI driver uses interrupts internally, so this example just wraps
  * that with an additional queue for backpressure handling.
+ *
+ * The queue is the RX buffer from can_twai_rxbuf.h: when the consumer
+ * falls behind, it drops the lowest-priority (highest ID) frames first, and
+ * IDs up to FAST_LANE_MAX_ID have a reserved fast lane. Drops are counted
+ * per ID and reported every REPORT_INTERVAL_MS.
  * 
  * Hardware requirements:
  * - ESP32 with TWAI controller
@@ -24,14 +29,17 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "examples_utils.h"
 #include "can_twai.h"
+#include "can_twai_rxbuf.h"
 #include "config_twai.h"
 
 
 // Queue capacity tuned for bursty traffic
 #define RX_QUEUE_LENGTH 64
+#define FAST_LANE_LENGTH 16
+#define FAST_LANE_MAX_ID 0x0FF      // Control traffic: never displaced by diagnostics
+#define REPORT_INTERVAL_MS 10000
 
 // Task configuration
 #define PRODUCER_TASK_STACK 4096
@@ -39,12 +47,10 @@
 #define PRODUCER_TASK_PRIO  12
 #define CONSUMER_TASK_PRIO  10
 
-static QueueHandle_t rx_queue;
-
 static inline void received_to_queue(twai_message_t *msg) {
     // TWAI backend: block on driver receive (driver handles IRQ internally)
     if (can_twai_receive(msg)) {
-        (void)xQueueSend(rx_queue, msg, 0);
+        (void)can_twai_rxbuf_push(msg);   // Counts the frame per ID if dropped
     } else {
         // No frame within adapter timeout; yield briefly
         sleep_ms_min_ticks(1);
@@ -66,7 +72,7 @@ static void can_rx_consumer_task(void *arg)
     const bool print_during_receive = false;
 
     for (;;) {
-        if (xQueueReceive(rx_queue, &message, portMAX_DELAY) == pdTRUE) {
+        if (can_twai_rxbuf_pop(&message, portMAX_DELAY)) {
             process_received_message(&message, print_during_receive);
         }
     }
@@ -91,8 +97,13 @@ void app_main(void)
     }
 
     // Create RX queue
-    rx_queue = xQueueCreate(RX_QUEUE_LENGTH, sizeof(twai_message_t));
-    if (rx_queue == NULL) {
+    const can_twai_rxbuf_config_t rx_queue_cfg = {
+        .capacity = RX_QUEUE_LENGTH,
+        .policy = CAN_TWAI_RXBUF_DROP_LOWEST,
+        .fast_lane_len = FAST_LANE_LENGTH,
+        .fast_lane_id = FAST_LANE_MAX_ID,
+    };
+    if (!can_twai_rxbuf_init(&rx_queue_cfg)) {
         ESP_LOGE(tag, "Failed to create RX queue");
         return;
     }
@@ -104,4 +115,10 @@ void app_main(void)
         ESP_LOGE(tag, "Failed to create tasks (prod=%ld, cons=%ld)", (long)ok1, (long)ok2);
         return;
     }
+
+    // Report queue depth and the frames the consumer lost
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(REPORT_INTERVAL_MS));
+        can_twai_rxbuf_log_report(10);
+    }
 }
@@ -0,0 +1,60 @@
+/**
+ * @file main.c
+ * @brief Single-board CAN self-test example using ESP32 TWAI controller
+ *
+ * This example verifies a board and its transceiver without a second node:
+ * the controller runs in no-ACK mode and receives its own frames. For each
+ * bitrate it reports maximum throughput, bus load, CPU load and TX->RX
+ * latency, which makes it a quick benchmark for the adapter on a new chip.
+ *
+ * Hardware requirements:
+ * - ESP32 with TWAI controller
+ * - CAN transceiver (e.g., SN65HVD230)
+ * - 120-ohm termination resistor (no other node needed)
+ *
+ * Configuration: See examples/config_twai.h (mode and bitrate are overridden)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "esp_log.h"
+#include "can_twai.h"
+#include "can_twai_selftest.h"
+#include "config_twai.h"
+
+static const char *TAG = "selftest";
+
+void app_main(void)
+{
+    ESP_LOGI(TAG, "=== example: selftest, backend: %s ===", can_backend_get_name());
+
+    // Bitrates to test, fastest first
+    static const can_twai_selftest_bitrate_t rates[] = {
+        { .bitrate_kbps = 1000, .timing = TWAI_TIMING_CONFIG_1MBITS() },
+        { .bitrate_kbps = 500,  .timing = TWAI_TIMING_CONFIG_500KBITS() },
+        { .bitrate_kbps = 250,  .timing = TWAI_TIMING_CONFIG_250KBITS() },
+        { .bitrate_kbps = 125,  .timing = TWAI_TIMING_CONFIG_125KBITS() },
+    };
+    const size_t rate_count = sizeof(rates) / sizeof(rates[0]);
+    can_twai_selftest_result_t results[sizeof(rates) / sizeof(rates[0])];
+
+    // Test settings
+    const can_twai_selftest_config_t cfg = {
+        .bitrates          = rates,
+        .bitrate_count     = rate_count,
+        .throughput_frames = 5000,
+        .latency_samples   = 200,
+        .dlc               = 8,
+        .identifier        = 0x7AB,
+    };
+
+    bool passed = can_twai_selftest_run(&TWAI_HW_CFG, &cfg, results);
+    can_twai_selftest_print_report(results, rate_count);
+
+    if (passed) {
+        ESP_LOGI(TAG, "Self-test PASSED");
+    } else {
+        ESP_LOGE(TAG, "Self-test FAILED - check wiring, transceiver and termination");
+    }
+}
@@ -0,0 +1,88 @@
+/**
+ * @file main.c
+ * @brief Bus load sweep with the traffic generator for receiver stress tests
+ *
+ * Steps the bus load from 25 % to 100 % with two profiles and reports the
+ * achieved load of each step:
+ * - mixed: random IDs from a range, DLC mix, random payload,
+ * - bursts: sequential IDs, 8-byte counter payload in bursts of 8 frames
+ *   (a receiver checks the counter for lost frames).
+ *
+ * Connect the receiver under test to the bus; it has to acknowledge the
+ * frames. If the achieved load stays below the requested one, the bus is
+ * shared with other traffic or the configured bitrate does not match.
+ *
+ * Hardware requirements:
+ * - ESP32 with TWAI controller
+ * - CAN transceiver (e.g., SN65HVD230)
+ * - Device under test on the bus, 120-ohm termination at both ends
+ *
+ * Configuration: See examples/config_twai.h (GEN_BITRATE must match its timing)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <inttypes.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "can_twai.h"
+#include "can_twai_gen.h"
+#include "config_twai.h"
+
+static const char *TAG = "traffic_gen";
+
+#define GEN_BITRATE  1000000   // TWAI_TIMING_CONFIG_1MBITS() in config_twai.h
+#define STEP_MS      5000
+
+static const uint32_t loads_permille[] = { 250, 500, 750, 900, 1000 };
+
+static void sweep(const char *name, can_twai_gen_config_t gc)
+{
+    for (size_t i = 0; i < sizeof(loads_permille) / sizeof(loads_permille[0]); i++) {
+        gc.load_permille = loads_permille[i];
+        if (!can_twai_gen_start(&gc)) {
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(STEP_MS));
+        can_twai_gen_stop();
+
+        can_twai_gen_stats_t st;
+        can_twai_gen_get_stats(&st);
+        ESP_LOGI(TAG, "%-7s | %3" PRIu32 ".%" PRIu32 " %% | %3" PRIu32 ".%" PRIu32 " %% | %6" PRIu32 " | %5" PRIu32 "/%" PRIu32,
+                 name, st.requested_permille / 10, st.requested_permille % 10,
+                 st.achieved_permille / 10, st.achieved_permille % 10,
+                 st.frames_per_sec, st.queue_full, st.ticks);
+    }
+}
+
+void app_main(void)
+{
+    ESP_LOGI(TAG, "=== example: traffic_gen, backend: %s ===", can_backend_get_name());
+
+    if (!can_twai_init(&TWAI_HW_CFG)) {
+        ESP_LOGE(TAG, "Failed to initialize %s backend", can_backend_get_name());
+        return;
+    }
+
+    const can_twai_gen_config_t mixed = {
+        .bitrate = GEN_BITRATE,
+        .id_mode = CAN_TWAI_GEN_IDS_RANDOM, .id_min = 0x100, .id_max = 0x3FF,
+        .dlc_weights = { [0] = 1, [2] = 1, [4] = 2, [8] = 6 },
+        .payload = CAN_TWAI_GEN_PAYLOAD_RANDOM,
+    };
+    const can_twai_gen_config_t bursts = {
+        .bitrate = GEN_BITRATE,
+        .id_mode = CAN_TWAI_GEN_IDS_SEQUENTIAL, .id_min = 0x500, .id_max = 0x50F,
+        .burst_frames = 8,
+        .payload = CAN_TWAI_GEN_PAYLOAD_COUNTER,
+    };
+
+    ESP_LOGI(TAG, "%d ms per step at %d bit/s", STEP_MS, GEN_BITRATE);
+    ESP_LOGI(TAG, "profile | requested | achieved | frames/s | TX full/ticks");
+    sweep("mixed", mixed);
+    sweep("bursts", bursts);
+
+    can_twai_deinit();
+}
@@ -112,6 +112,23 @@ bool can_twai_deinit(void);
  */
 bool can_twai_send(const twai_message_t *msg);
 
+/**
+ * @brief Send a CAN message with an explicit timeout
+ * 
+ * Same as can_twai_send() but waits at most @p timeout ticks for space in
+ * the TX queue instead of the configured transmit timeout. Useful for code
+ * on the receive path that must never block (e.g. the auto-responder).
+ * 
+ * @param[in] msg     Pointer to message to transmit
+ * @param[in] timeout Maximum time to wait in ticks (0 = do not block)
+ * 
+ * @return true if message was successfully queued for transmission
+ * @return false if transmission failed or message is invalid
+ * 
+ * @see can_twai_send()
+ */
+bool can_twai_send_timeout(const twai_message_t *msg, TickType_t timeout);
+
 /**
  * @brief Receive a CAN message (non-blocking)
  * 
@@ -132,6 +149,64 @@ bool can_twai_send(const twai_message_t *msg);
  */
 bool can_twai_receive(twai_message_t *msg);
 
+/**
+ * @brief Receive a CAN message with an explicit timeout
+ * 
+ * Same as can_twai_receive() but waits at most @p timeout ticks instead of
+ * the configured receive timeout. Useful for schedulers that must wake up
+ * for their own deadlines (e.g. the coroutine executor).
+ * 
+ * @param[out] msg     Pointer to buffer where received message will be stored
+ * @param[in]  timeout Maximum time to wait in ticks (0 = do not block)
+ * 
+ * @return true if a message was successfully received
+ * @return false if no message was received (timeout or error)
+ * 
+ * @see can_twai_receive()
+ */
+bool can_twai_receive_timeout(twai_message_t *msg, TickType_t timeout);
+
+/**
+ * @brief Send several CAN messages in order
+ * 
+ * Holds the transmit gate once for the whole batch. When no transmit hook
+ * or local delivery is active and the backend supports batches, all
+ * messages are handed over in one call (one sendmmsg() on SocketCAN);
+ * otherwise they are sent one by one like can_twai_send_timeout().
+ * 
+ * @param[in] msgs    Messages to send
+ * @param[in] count   Number of messages
+ * @param[in] timeout Maximum time to wait for transmit queue space, per message
+ * 
+ * @return Number of messages queued; stops at the first failure or invalid DLC
+ */
+size_t can_twai_send_batch(const twai_message_t *msgs, size_t count, TickType_t timeout);
+
+/**
+ * @brief Receive up to @p max CAN messages
+ * 
+ * Waits up to @p timeout for the first message and then takes all messages
+ * already received, without waiting again (one recvmmsg() on SocketCAN).
+ * Receive hooks run for every message; messages consumed by a hook are
+ * removed from @p msgs.
+ * 
+ * @param[out] msgs    Buffer for received messages
+ * @param[in]  max     Capacity of @p msgs
+ * @param[in]  timeout Maximum time to wait for the first message
+ * 
+ * @return Number of messages stored (0 on timeout or if hooks consumed all)
+ */
+size_t can_twai_receive_batch(twai_message_t *msgs, size_t max, TickType_t timeout);
+
+/**
+ * @brief Read controller state, error counters and queue levels
+ * 
+ * @param[out] status Status from the active backend
+ * 
+ * @return true if the status was read
+ */
+bool can_twai_get_status(twai_status_info_t *status);
+
 /**
  * @brief Check TWAI controller status and reset if necessary
  * 
@@ -151,9 +226,11 @@ bool can_twai_receive(twai_message_t *msg);
 void can_twai_reset_if_needed(void);
 
 /**
- * @brief Get human-readable backend name for TWAI adapter
+ * @brief Get human-readable name of the active backend
+ *
+ * @return const char* Static C string with backend name ("TWAI", "SocketCAN")
  *
- * @return const char* Static C string with backend name
+ * @see can_twai_backend.h
  */
 const char *can_backend_get_name(void);
 
@@ -0,0 +1,149 @@
+/**
+ * @file can_twai_auth.h
+ * @brief SecOC-style authenticated CAN frames for the TWAI adapter
+ *
+ * Appends a truncated freshness value and a truncated MAC to the payload
+ * of selected IDs. The MAC covers a 16-bit Data ID, the authentic payload
+ * bytes and the full 64-bit freshness value (a per-ID message counter), so
+ * replayed or modified frames are rejected.
+ *
+ * Frame layout (classic CAN, DLC = data_len + fv_bytes + mac_bytes <= 8):
+ * @code
+ * | data[0 .. data_len-1] | freshness (low fv_bytes, big endian) | MAC (first mac_bytes) |
+ * @endcode
+ * Frames of a transmit ID are sent with DLC = data_len and extended on the
+ * way out; can_twai_send() refuses any other DLC (counted in length_failures).
+ *
+ * Two MAC algorithms are available:
+ * - CAN_TWAI_AUTH_AES_CMAC: AES-128-CMAC (RFC 4493) via mbedTLS, which uses
+ *   the chip's AES accelerator when CONFIG_MBEDTLS_HARDWARE_AES is enabled.
+ * - CAN_TWAI_AUTH_SIPHASH: SipHash-2-4 in software, much cheaper per frame
+ *   on cores without an AES accelerator.
+ *
+ * Key schedules (AES round keys and CMAC subkeys, SipHash key words) are
+ * computed once in can_twai_auth_init().
+ *
+ * Received frames can be verified inline in can_twai_receive() (failed
+ * frames are consumed), or passed through unverified and checked later in
+ * batches with can_twai_auth_verify_batch(), off the receive path.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Key length in bytes (AES-128 and SipHash both use 128-bit keys) */
+#define CAN_TWAI_AUTH_KEY_LEN 16
+
+/** @brief Maximum truncated freshness value length in bytes */
+#define CAN_TWAI_AUTH_MAX_FV_BYTES 4
+
+/**
+ * @brief MAC algorithm
+ */
+typedef enum {
+    CAN_TWAI_AUTH_AES_CMAC = 0,  /**< AES-128-CMAC, hardware accelerated when available */
+    CAN_TWAI_AUTH_SIPHASH,       /**< SipHash-2-4, software */
+} can_twai_auth_alg_t;
+
+/**
+ * @brief Authentication settings for one ID and direction
+ */
+typedef struct {
+    uint32_t            identifier;     /**< CAN identifier */
+    bool                transmit;       /**< true: authenticate on send, false: verify on receive */
+    can_twai_auth_alg_t alg;            /**< MAC algorithm */
+    const uint8_t      *key;            /**< CAN_TWAI_AUTH_KEY_LEN bytes (copied) */
+    uint16_t            data_id;        /**< Data ID included in the MAC */
+    uint8_t             data_len;       /**< Authentic payload bytes */
+    uint8_t             fv_bytes;       /**< Transmitted freshness bytes (1..CAN_TWAI_AUTH_MAX_FV_BYTES) */
+    uint8_t             mac_bytes;      /**< Transmitted MAC bytes (1..8) */
+    uint32_t            accept_window;  /**< RX: max. freshness step accepted (0 = any forward step) */
+    bool                verify_inline;  /**< RX: verify in can_twai_receive(), consume failures */
+} can_twai_auth_config_t;
+
+/**
+ * @brief Per-ID authentication statistics
+ */
+typedef struct {
+    uint32_t authenticated;     /**< TX: frames signed, RX: frames verified OK */
+    uint32_t mac_failures;      /**< RX: MAC mismatch */
+    uint32_t freshness_failures;/**< RX: replayed or out-of-window freshness */
+    uint32_t length_failures;   /**< DLC does not match the configured layout (TX: send refused) */
+} can_twai_auth_stats_t;
+
+/**
+ * @brief Precompute key schedules and attach authentication to TX/RX paths
+ *
+ * @param[in] cfg   Authenticated IDs (copied); an ID may appear once per direction
+ * @param[in] count Number of entries
+ *
+ * @return false on invalid configuration or out of memory
+ */
+bool can_twai_auth_init(const can_twai_auth_config_t *cfg, size_t count);
+
+/**
+ * @brief Detach authentication and wipe all key material
+ */
+void can_twai_auth_deinit(void);
+
+/**
+ * @brief Verify a batch of received frames (receive IDs with verify_inline = false)
+ *
+ * Frames must be passed in reception order, since verification advances
+ * the freshness state. Frames of IDs without an RX entry are reported invalid.
+ *
+ * @param[in]  msgs    Received frames
+ * @param[in]  count   Number of frames
+ * @param[out] results Per-frame result (may be NULL)
+ *
+ * @return Number of frames that verified successfully
+ */
+size_t can_twai_auth_verify_batch(const twai_message_t *msgs, size_t count, bool *results);
+
+/**
+ * @brief Read the full freshness value of an ID (e.g. to persist it in NVS)
+ *
+ * @return false if the ID/direction is not configured
+ */
+bool can_twai_auth_get_freshness(uint32_t identifier, bool transmit, uint64_t *fv);
+
+/**
+ * @brief Restore the full freshness value of an ID (e.g. after reboot)
+ *
+ * @return false if the ID/direction is not configured
+ */
+bool can_twai_auth_set_freshness(uint32_t identifier, bool transmit, uint64_t fv);
+
+/**
+ * @brief Get authentication statistics of one ID
+ *
+ * If an ID is configured for both directions, the receive-side entry is reported.
+ *
+ * @return false if the ID is not configured
+ */
+bool can_twai_auth_get_stats(uint32_t identifier, can_twai_auth_stats_t *out);
+
+/**
+ * @brief Measure MAC throughput of an algorithm on this chip
+ *
+ * Computes @p iterations MACs over a maximal-length message with a
+ * throw-away key and returns the achieved rate.
+ *
+ * @return MACs per second, or 0 on error
+ */
+uint32_t can_twai_auth_benchmark(can_twai_auth_alg_t alg, uint32_t iterations);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @file can_twai_backend.h
+ * @brief Pluggable controller backends behind the can_twai_* API
+ *
+ * The adapter core (hooks, gates, local delivery, recovery policy) talks to
+ * the controller only through a backend table. Two backends are provided:
+ * - can_twai_backend_twai: the ESP-IDF TWAI driver (default on chips),
+ * - can_twai_backend_socketcan: a Linux SocketCAN raw socket, e.g. on a
+ *   vcan interface (default on the ESP-IDF linux target). It receives with
+ *   recvmmsg() and sends batches with sendmmsg(), so one system call moves
+ *   up to 32 frames.
+ *
+ * Frames, configuration and status keep the TWAI types on every backend;
+ * the SocketCAN backend maps them to struct can_frame and socket options.
+ * Modules that read TWAI hardware directly (the ECC decoding of
+ * can_twai_diag) only work on the TWAI backend.
+ *
+ * Typical usage (host build against a vcan interface):
+ * @code
+ * // ip link add dev vcan0 type vcan && ip link set up vcan0
+ * can_twai_socketcan_set_interface("vcan0");
+ * can_twai_set_backend(&can_twai_backend_socketcan);
+ * can_twai_init(&config);
+ *
+ * twai_message_t rx[16];
+ * size_t n = can_twai_receive_batch(rx, 16, pdMS_TO_TICKS(10));
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+#include "can_twai_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Controller backend operations
+ *
+ * All functions except the optional batch functions must be provided.
+ * Error codes follow the TWAI driver: ESP_ERR_TIMEOUT when nothing could be
+ * received or queued in time, ESP_ERR_INVALID_STATE when the controller is
+ * not running.
+ */
+typedef struct {
+    const char *name;  /**< Returned by can_backend_get_name() */
+
+    /** @brief Install and start the controller */
+    esp_err_t (*init)(const twai_backend_config_t *cfg);
+    /** @brief Stop and release the controller */
+    esp_err_t (*deinit)(void);
+    /** @brief Restart a stopped controller */
+    esp_err_t (*start)(void);
+    /** @brief Stop the controller without releasing it */
+    esp_err_t (*stop)(void);
+
+    /** @brief Queue one frame for transmission */
+    esp_err_t (*transmit)(const twai_message_t *msg, TickType_t timeout);
+    /**
+     * @brief Queue several frames, in order (optional)
+     * @return Number of frames queued; stops at the first failure
+     */
+    size_t (*transmit_batch)(const twai_message_t *msgs, size_t count, TickType_t timeout);
+
+    /** @brief Wait for one received frame */
+    esp_err_t (*receive)(twai_message_t *msg, TickType_t timeout);
+    /**
+     * @brief Wait for the first frame, then take all that are ready (optional)
+     * @return Number of frames stored in @p msgs (0 on timeout)
+     */
+    size_t (*receive_batch)(twai_message_t *msgs, size_t max, TickType_t timeout);
+
+    /** @brief Controller state, error counters and queue levels */
+    esp_err_t (*get_status)(twai_status_info_t *status);
+    /** @brief Start bus-off recovery */
+    esp_err_t (*recover)(void);
+
+    /** @brief Wait for alerts (TWAI_ALERT_* bits) */
+    esp_err_t (*read_alerts)(uint32_t *alerts, TickType_t timeout);
+    /** @brief Change the set of alerts reported by read_alerts */
+    esp_err_t (*reconfigure_alerts)(uint32_t alerts_enabled, uint32_t *current_alerts);
+} can_twai_backend_t;
+
+#if !CONFIG_IDF_TARGET_LINUX
+/** @brief ESP-IDF TWAI driver backend */
+extern const can_twai_backend_t can_twai_backend_twai;
+#endif
+
+#if defined(__linux__)
+/** @brief Linux SocketCAN raw socket backend */
+extern const can_twai_backend_t can_twai_backend_socketcan;
+
+/**
+ * @brief Select the network interface used by the SocketCAN backend
+ *
+ * @param[in] ifname Interface name, e.g. "vcan0" (default) or "can0"
+ *
+ * @return false if the name is too long
+ *
+ * @note Call before can_twai_init()
+ */
+bool can_twai_socketcan_set_interface(const char *ifname);
+#endif
+
+/**
+ * @brief Select the backend used by the next can_twai_init()
+ *
+ * @return false if the adapter is initialized or the table is incomplete
+ */
+bool can_twai_set_backend(const can_twai_backend_t *backend);
+
+/**
+ * @brief Backend currently selected
+ */
+const can_twai_backend_t *can_twai_get_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
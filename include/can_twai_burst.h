@@ -0,0 +1,146 @@
+/**
+ * @file can_twai_burst.h
+ * @brief Contiguous TX burst groups for multi-frame transactions
+ *
+ * Some devices expect a group of frames back-to-back, e.g. a multi-frame
+ * setpoint update, and must not see a frame of another sender on this node
+ * in between. Concurrent can_twai_send() callers would interleave them.
+ *
+ * Once initialized, this module puts a gate (a recursive mutex with
+ * priority inheritance) in front of the transmit path. A burst holds the
+ * gate while all its frames are enqueued, so other senders on this node
+ * wait and their frames follow the whole group. Frames of other nodes can
+ * still win arbitration between burst frames; only this node's own traffic
+ * is kept out.
+ *
+ * Starvation is visible in the statistics: how often senders had to wait,
+ * the longest wait and the longest time a burst held the transmit path.
+ * max_frames limits the size of one burst, including frames sent with
+ * can_twai_send() between begin and end; further sends in the same burst
+ * fail. Keep it at or below the driver TX queue length so a burst is
+ * enqueued without waiting for the bus.
+ *
+ * Typical usage:
+ * @code
+ * can_twai_burst_config_t bc = { .max_frames = 8 };
+ * can_twai_burst_init(&bc);   // after can_twai_init()
+ *
+ * twai_message_t frames[3] = { ... };
+ * size_t sent;
+ * if (!can_twai_burst_send(frames, 3, pdMS_TO_TICKS(20), &sent)) { ... }
+ *
+ * // Or build the group while holding the transmit path
+ * if (can_twai_burst_begin(pdMS_TO_TICKS(20))) {
+ *     can_twai_send(&header);
+ *     can_twai_send(&payload);
+ *     can_twai_burst_end();
+ * }
+ * @endcode
+ *
+ * @note Every can_twai_send() takes and releases the gate while the module
+ *       is initialized, which adds a mutex round trip per frame.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Burst configuration
+ */
+typedef struct {
+    size_t max_frames;  /**< Maximum frames per burst (0 = 16) */
+} can_twai_burst_config_t;
+
+/**
+ * @brief Burst and contention statistics
+ */
+typedef struct {
+    uint32_t bursts;         /**< Bursts completed */
+    uint32_t burst_frames;   /**< Frames enqueued within bursts */
+    uint32_t failed;         /**< Bursts that could not enqueue all frames */
+    uint32_t over_budget;    /**< Sends refused because the burst already had max_frames */
+    uint32_t contended;      /**< Gate acquisitions that had to wait (bursts and single sends) */
+    uint32_t timeouts;       /**< Gate acquisitions that timed out */
+    uint32_t wait_max_us;    /**< Longest wait for the gate */
+    uint32_t hold_max_us;    /**< Longest time a burst held the gate */
+    uint32_t hold_avg_us;    /**< Average time a burst held the gate */
+} can_twai_burst_stats_t;
+
+/**
+ * @brief Install the transmit gate
+ *
+ * @return false if already initialized or out of memory
+ *
+ * @note Call after can_twai_init()
+ */
+bool can_twai_burst_init(const can_twai_burst_config_t *cfg);
+
+/**
+ * @brief Remove the transmit gate
+ *
+ * Waits for in-flight sends and for an open burst to end before the gate is
+ * freed. Bursts begun after this is called fail.
+ *
+ * @note Do not call between can_twai_burst_begin() and can_twai_burst_end()
+ */
+void can_twai_burst_deinit(void);
+
+/**
+ * @brief Send a group of frames without frames of other senders in between
+ *
+ * @param[in]  msgs    Frames, sent in array order
+ * @param[in]  count   Number of frames (1..max_frames)
+ * @param[in]  timeout Maximum wait for the gate, for TX queue room for the
+ *                     whole group, and for each frame's TX queue slot
+ * @param[out] sent    Frames enqueued (may be NULL)
+ *
+ * Nothing is sent if the group does not fit the remaining burst budget or
+ * the driver TX queue does not get room for all @p count frames in time.
+ *
+ * @return true if all frames were enqueued. On false, the first @p sent
+ *         frames are already queued and cannot be recalled (0 unless a
+ *         frame failed after the queue check, e.g. on bus-off)
+ */
+bool can_twai_burst_send(const twai_message_t *msgs, size_t count, TickType_t timeout, size_t *sent);
+
+/**
+ * @brief Acquire the transmit path for a burst built with can_twai_send()
+ *
+ * Sends of the calling task go through; other tasks wait. Calls nest.
+ *
+ * @return false if not initialized or the gate was not acquired in time
+ */
+bool can_twai_burst_begin(TickType_t timeout);
+
+/**
+ * @brief Release the transmit path taken by can_twai_burst_begin()
+ *
+ * Ignored (with an error log) if the calling task is not inside a burst.
+ */
+void can_twai_burst_end(void);
+
+/**
+ * @brief Get statistics
+ */
+void can_twai_burst_get_stats(can_twai_burst_stats_t *out);
+
+/**
+ * @brief Clear statistics
+ */
+void can_twai_burst_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,140 @@
+/**
+ * @file can_twai_cantop.h
+ * @brief Live per-ID traffic table ("cantop") with rates and last payloads
+ *
+ * Printing every frame cannot keep up with a busy bus. Instead, this module
+ * keeps one row per identifier seen on the bus: frame count, current rate,
+ * min/max/mean inter-arrival time, last DLC and last payload. The
+ * application prints a sorted snapshot as often as it likes, for example
+ * once per second during commissioning.
+ *
+ * The table is a fixed-capacity open-addressing hash table with linear
+ * probing, allocated once at init. Each frame costs one hash and usually a
+ * single probe. No memory is allocated on the receive path. Rows are never
+ * removed, only reset. Once the table is 7/8 full, frames of new IDs are
+ * counted as overflow so probe chains stay short.
+ *
+ * Frames are taken from can_twai_receive() through an RX hook, or fed
+ * explicitly with can_twai_cantop_update() (e.g. from the sniffer).
+ *
+ * Typical usage:
+ * @code
+ * can_twai_cantop_config_t tc = { .capacity = 256, .hook_receive = true };
+ * can_twai_cantop_init(&tc);   // after can_twai_init()
+ *
+ * for (;;) {
+ *     vTaskDelay(pdMS_TO_TICKS(1000));
+ *     can_twai_cantop_log(20);   // top 20 IDs by rate
+ * }
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Traffic table configuration
+ */
+typedef struct {
+    size_t capacity;      /**< Table slots, rounded up to a power of two (0 = 256) */
+    bool   hook_receive;  /**< Count frames passing can_twai_receive() */
+} can_twai_cantop_config_t;
+
+/**
+ * @brief Snapshot order
+ */
+typedef enum {
+    CAN_TWAI_CANTOP_BY_RATE = 0,  /**< Highest current rate first */
+    CAN_TWAI_CANTOP_BY_ID,        /**< Ascending identifier, standard before extended */
+    CAN_TWAI_CANTOP_BY_COUNT,     /**< Most frames first */
+} can_twai_cantop_sort_t;
+
+/**
+ * @brief One row of the traffic table
+ */
+typedef struct {
+    uint32_t identifier;        /**< CAN identifier */
+    bool     extd;              /**< 29-bit identifier */
+    uint32_t count;             /**< Frames received */
+    float    rate_hz;           /**< Current rate (smoothed, decays when the ID goes silent) */
+    uint32_t min_interval_us;   /**< Shortest inter-arrival time */
+    uint32_t max_interval_us;   /**< Longest inter-arrival time */
+    uint32_t mean_interval_us;  /**< Mean inter-arrival time since the first frame */
+    uint32_t age_us;            /**< Time since the last frame */
+    uint8_t  dlc;               /**< Last DLC */
+    bool     rtr;               /**< Last frame was a remote frame */
+    uint8_t  data[8];           /**< Last payload */
+} can_twai_cantop_entry_t;
+
+/**
+ * @brief Allocate the table and optionally attach it to the receive path
+ *
+ * @return false if already initialized, out of memory or the RX hook table is full
+ */
+bool can_twai_cantop_init(const can_twai_cantop_config_t *cfg);
+
+/**
+ * @brief Detach and free the table
+ */
+void can_twai_cantop_deinit(void);
+
+/**
+ * @brief Account one frame
+ *
+ * @param[in] msg     Received frame
+ * @param[in] time_us Reception time (esp_timer_get_time())
+ */
+void can_twai_cantop_update(const twai_message_t *msg, int64_t time_us);
+
+/**
+ * @brief Copy a sorted snapshot of the table
+ *
+ * Rows are copied a few at a time, each group under a short lock, so the
+ * receive path is never held off for the whole table. Every row is
+ * consistent in itself (count, intervals and payload of the same frame);
+ * rows copied later may include frames that arrived during the copy.
+ *
+ * @param[out] out  Buffer for rows
+ * @param[in]  max  Capacity of @p out
+ * @param[in]  sort Row order
+ *
+ * @return Number of rows copied (the first @p max rows in the chosen order)
+ *
+ * @note Call from one task at a time (uses a shared copy buffer)
+ */
+size_t can_twai_cantop_snapshot(can_twai_cantop_entry_t *out, size_t max, can_twai_cantop_sort_t sort);
+
+/**
+ * @brief Number of distinct IDs in the table
+ */
+size_t can_twai_cantop_id_count(void);
+
+/**
+ * @brief Frames of IDs that did not fit into the table
+ */
+uint32_t can_twai_cantop_overflow(void);
+
+/**
+ * @brief Clear all rows
+ */
+void can_twai_cantop_reset(void);
+
+/**
+ * @brief Log the top @p rows IDs by rate (0 = all)
+ */
+void can_twai_cantop_log(size_t rows);
+
+#ifdef __cplusplus
+}
+#endif
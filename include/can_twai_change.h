@@ -0,0 +1,135 @@
+/**
+ * @file can_twai_change.h
+ * @brief Change detection and deadband notification on the TWAI receive path
+ *
+ * Most cyclic CAN traffic repeats the same payload. This module compares
+ * each received frame of a configured ID against the last frame delivered
+ * to subscribers and notifies them only when something relevant changed:
+ * - any payload bit selected by a per-ID byte mask (two 32-bit XOR/AND ops), or
+ * - a decoded signal that moved by more than its deadband, or
+ * - the DLC.
+ *
+ * Unchanged frames can optionally be kept from the application, so a
+ * consumer task blocked in can_twai_receive() is not woken up for them at
+ * all. Other receive-path modules (liveness, buffers, statistics) still
+ * see every frame.
+ *
+ * Typical usage:
+ * @code
+ * static const can_twai_signal_t rpm = { .start_bit = 16, .length = 16, .deadband = 50 };
+ * static const can_twai_change_config_t watch[] = {
+ *     { .identifier = 0x100, .mask = CAN_TWAI_CHANGE_MASK_BYTES(0x01),  // byte 0: state
+ *       .signals = &rpm, .signal_count = 1,
+ *       .callback = on_engine_change, .suppress_unchanged = true },
+ * };
+ * can_twai_change_init(watch, 1);
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of deadband signals per ID */
+#define CAN_TWAI_CHANGE_MAX_SIGNALS 4
+
+/** @brief Change flag: masked payload bits or DLC changed */
+#define CAN_TWAI_CHANGE_PAYLOAD  (1u << 30)
+/** @brief Change flag: first frame received for this ID */
+#define CAN_TWAI_CHANGE_FIRST    (1u << 31)
+
+/**
+ * @brief Build a 64-bit payload mask from an 8-bit byte selector
+ *
+ * Bit n of @p bytes selects payload byte n entirely.
+ */
+#define CAN_TWAI_CHANGE_MASK_BYTES(bytes) \
+    ((((bytes) & 0x01) ? 0x00000000000000FFull : 0) | (((bytes) & 0x02) ? 0x000000000000FF00ull : 0) | \
+     (((bytes) & 0x04) ? 0x0000000000FF0000ull : 0) | (((bytes) & 0x08) ? 0x00000000FF000000ull : 0) | \
+     (((bytes) & 0x10) ? 0x000000FF00000000ull : 0) | (((bytes) & 0x20) ? 0x0000FF0000000000ull : 0) | \
+     (((bytes) & 0x40) ? 0x00FF000000000000ull : 0) | (((bytes) & 0x80) ? 0xFF00000000000000ull : 0))
+
+/**
+ * @brief Signal monitored with a deadband
+ *
+ * Signals use little-endian (Intel) bit numbering: bit 0 is the LSB of
+ * data[0], bit 63 the MSB of data[7].
+ */
+typedef struct {
+    uint8_t  start_bit;  /**< Position of the signal LSB (0..63) */
+    uint8_t  length;     /**< Signal length in bits (1..32) */
+    bool     is_signed;  /**< Two's complement signal */
+    uint32_t deadband;   /**< Notify when |value - last notified value| > deadband (raw units) */
+} can_twai_signal_t;
+
+/**
+ * @brief Subscriber callback
+ *
+ * Runs in the task that called can_twai_receive(); keep it short.
+ *
+ * @param[in] msg     Received message
+ * @param[in] changed Bit i set if signal i exceeded its deadband, plus
+ *                    CAN_TWAI_CHANGE_PAYLOAD / CAN_TWAI_CHANGE_FIRST
+ * @param[in] ctx     Context pointer from the configuration
+ */
+typedef void (*can_twai_change_cb_t)(const twai_message_t *msg, uint32_t changed, void *ctx);
+
+/**
+ * @brief Change detection settings for one ID
+ */
+typedef struct {
+    uint32_t                 identifier;          /**< CAN identifier */
+    uint64_t                 mask;                /**< Payload bits compared (bit 0 = data[0] LSB) */
+    const can_twai_signal_t *signals;             /**< Deadband signals (may be NULL) */
+    size_t                   signal_count;        /**< Number of signals (max CAN_TWAI_CHANGE_MAX_SIGNALS) */
+    can_twai_change_cb_t     callback;            /**< Called on relevant change (may be NULL) */
+    void                    *ctx;                 /**< Passed to callback */
+    bool                     suppress_unchanged;  /**< Hide unchanged frames from can_twai_receive() */
+} can_twai_change_config_t;
+
+/**
+ * @brief Change detection statistics
+ */
+typedef struct {
+    uint32_t frames_checked;     /**< Frames of monitored IDs */
+    uint32_t frames_changed;     /**< Frames that triggered a notification */
+    uint32_t frames_suppressed;  /**< Unchanged frames hidden from the application */
+} can_twai_change_stats_t;
+
+/**
+ * @brief Attach change detection for a set of IDs to the receive path
+ *
+ * @param[in] entries Per-ID settings (copied)
+ * @param[in] count   Number of entries
+ *
+ * @return false on invalid configuration, duplicate IDs or out of memory
+ */
+bool can_twai_change_init(const can_twai_change_config_t *entries, size_t count);
+
+/**
+ * @brief Detach change detection and free its state
+ */
+void can_twai_change_deinit(void);
+
+/**
+ * @brief Get change detection statistics
+ *
+ * Sums per-ID counters without a lock; the totals may be a few frames
+ * apart from each other while frames are being received. All zero when
+ * change detection is not initialized.
+ */
+void can_twai_change_get_stats(can_twai_change_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
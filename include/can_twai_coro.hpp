@@ -0,0 +1,252 @@
+/**
+ * @file can_twai_coro.hpp
+ * @brief C++20 coroutine layer for the ESP32 TWAI (CAN) adapter
+ *
+ * Lets protocol state machines be written as coroutines instead of
+ * dedicated FreeRTOS tasks. All coroutines run on a single executor task
+ * that owns the adapter's receive path, so a suspended session costs only
+ * its coroutine frame (typically a few hundred bytes) instead of a full
+ * task stack.
+ *
+ * Typical usage:
+ * @code
+ * can_twai::Task ping_session(uint32_t req_id, uint32_t resp_id)
+ * {
+ *     can_twai::Bus bus;
+ *     twai_message_t req = { .identifier = req_id, .data_length_code = 1 };
+ *     for (;;) {
+ *         co_await bus.send(req);
+ *         auto resp = co_await bus.receive(resp_id, 50);  // 50 ms timeout
+ *         if (!resp) {
+ *             // Handle timeout
+ *         }
+ *         co_await can_twai::sleep(100);
+ *     }
+ * }
+ *
+ * can_twai_init(&config);
+ * can_twai::executor_start(can_twai::ExecutorConfig{});
+ * can_twai::spawn(ping_session(0x100, 0x101));
+ * @endcode
+ *
+ * @note Once the executor is started it is the only consumer of
+ *       can_twai_receive(); the application must not call it from other tasks.
+ * @note Awaitables may only be used from coroutines running on the executor.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <utility>
+#include "can_twai.h"
+
+namespace can_twai {
+
+/** @brief Timeout value meaning "wait forever" */
+constexpr uint32_t WAIT_FOREVER = UINT32_MAX;
+
+/**
+ * @brief Executor task configuration
+ */
+struct ExecutorConfig {
+    uint32_t    stack_size      = 4096;          /**< Executor task stack size in bytes */
+    UBaseType_t priority        = 10;            /**< Executor task priority */
+    BaseType_t  core_id         = tskNO_AFFINITY;/**< Core to pin the executor to (tskNO_AFFINITY = any) */
+    uint32_t    spawn_queue_len = 16;            /**< Max. coroutines waiting to be started */
+    uint32_t    max_idle_ms     = 10;            /**< Upper bound of one receive wait (spawn latency) */
+};
+
+/**
+ * @brief Fire-and-forget coroutine started with spawn()
+ *
+ * The coroutine is created suspended and starts running on the executor
+ * once spawned. Its frame is freed automatically when it returns.
+ */
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() noexcept
+        {
+            return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        static Task get_return_object_on_allocation_failure() noexcept { return Task{}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::abort(); }
+    };
+
+    Task() noexcept = default;
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task()
+    {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    /** @brief false if the coroutine frame could not be allocated */
+    bool valid() const noexcept { return static_cast<bool>(handle_); }
+
+    /** @brief Transfer ownership of the coroutine frame to the caller */
+    std::coroutine_handle<> release() noexcept { return std::exchange(handle_, {}); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) noexcept : handle_(h) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+/**
+ * @brief Suspended coroutine bookkeeping (lives inside the coroutine frame)
+ *
+ * Waiters are linked into the executor's intrusive lists, so suspending
+ * never allocates.
+ */
+struct Waiter {
+    Waiter                 *next       = nullptr;  /**< Link in receive or send list */
+    Waiter                 *next_timer = nullptr;  /**< Link in deadline-ordered timer list */
+    std::coroutine_handle<> handle;                /**< Coroutine to resume */
+    int64_t                 deadline_us = -1;      /**< Absolute deadline (esp_timer time), <0 = none */
+    uint32_t                id   = 0;              /**< Receive: identifier to match */
+    uint32_t                mask = 0;              /**< Receive: identifier bits compared */
+    twai_message_t          msg  = {};             /**< Received message / message to send */
+    bool                    ok   = false;          /**< Result delivered to await_resume() */
+};
+
+void wait_receive(Waiter *w, uint32_t timeout_ms);
+void wait_send(Waiter *w);
+void wait_sleep(Waiter *w, uint32_t ms);
+
+} // namespace detail
+
+/**
+ * @brief Awaitable returned by Bus::receive()
+ *
+ * Resumes with the first message whose identifier matches, or with
+ * std::nullopt when the timeout expires.
+ */
+class ReceiveAwaiter {
+public:
+    ReceiveAwaiter(uint32_t id, uint32_t mask, uint32_t timeout_ms) noexcept
+        : timeout_ms_(timeout_ms)
+    {
+        waiter_.id   = id;
+        waiter_.mask = mask;
+    }
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        waiter_.handle = h;
+        detail::wait_receive(&waiter_, timeout_ms_);
+    }
+    std::optional<twai_message_t> await_resume() const noexcept
+    {
+        if (!waiter_.ok) {
+            return std::nullopt;
+        }
+        return waiter_.msg;
+    }
+
+private:
+    detail::Waiter waiter_;
+    uint32_t       timeout_ms_;
+};
+
+/**
+ * @brief Awaitable returned by Bus::send()
+ *
+ * Resumes with the result of can_twai_send() once the executor has
+ * handed the message to the driver.
+ */
+class SendAwaiter {
+public:
+    explicit SendAwaiter(const twai_message_t &msg) noexcept { waiter_.msg = msg; }
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        waiter_.handle = h;
+        detail::wait_send(&waiter_);
+    }
+    bool await_resume() const noexcept { return waiter_.ok; }
+
+private:
+    detail::Waiter waiter_;
+};
+
+/**
+ * @brief Awaitable returned by sleep()
+ */
+class SleepAwaiter {
+public:
+    explicit SleepAwaiter(uint32_t ms) noexcept : ms_(ms) {}
+    bool await_ready() const noexcept { return ms_ == 0; }
+    void await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        waiter_.handle = h;
+        detail::wait_sleep(&waiter_, ms_);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    detail::Waiter waiter_;
+    uint32_t       ms_;
+};
+
+/**
+ * @brief Coroutine view of the TWAI adapter
+ *
+ * Stateless handle; any number of instances may be used concurrently.
+ */
+class Bus {
+public:
+    /** @brief Wait for a message with exactly this identifier */
+    ReceiveAwaiter receive(uint32_t id, uint32_t timeout_ms = WAIT_FOREVER) const noexcept
+    {
+        return ReceiveAwaiter(id, UINT32_MAX, timeout_ms);
+    }
+
+    /** @brief Wait for a message with (identifier & mask) == (id & mask) */
+    ReceiveAwaiter receive_masked(uint32_t id, uint32_t mask,
+                                  uint32_t timeout_ms = WAIT_FOREVER) const noexcept
+    {
+        return ReceiveAwaiter(id, mask, timeout_ms);
+    }
+
+    /** @brief Send a message through can_twai_send() */
+    SendAwaiter send(const twai_message_t &msg) const noexcept { return SendAwaiter(msg); }
+};
+
+/** @brief Suspend the calling coroutine for @p ms milliseconds */
+inline SleepAwaiter sleep(uint32_t ms) noexcept { return SleepAwaiter(ms); }
+
+/**
+ * @brief Start the executor task
+ *
+ * Must be called after can_twai_init(). From then on the executor is the
+ * only consumer of the adapter's receive path.
+ *
+ * @return true if the executor was started (or was already running)
+ */
+bool executor_start(const ExecutorConfig &cfg);
+
+/**
+ * @brief Hand a coroutine to the executor
+ *
+ * Safe to call from any task, including from coroutines on the executor.
+ *
+ * @return false if the executor is not running, the frame allocation
+ *         failed or the spawn queue is full
+ */
+bool spawn(Task &&task);
+
+} // namespace can_twai
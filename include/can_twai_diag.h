@@ -0,0 +1,141 @@
+/**
+ * @file can_twai_diag.h
+ * @brief Bus error classification and fault diagnosis for the TWAI adapter
+ *
+ * Listens to bus error alerts and decodes the controller's error code
+ * capture (ECC) register into bit, stuff, form, CRC and ACK errors, split
+ * by direction (while transmitting or receiving). Counts are kept in a
+ * sliding window of fixed time buckets, so rates reflect the current state
+ * of the bus rather than its whole history. From the error mix in the
+ * window a likely cause is derived:
+ *
+ * | Suspect                       | Typical signature                                          |
+ * |-------------------------------|------------------------------------------------------------|
+ * | CAN_TWAI_SUSPECT_NO_ACK       | ACK errors on own frames, nothing received                 |
+ * | CAN_TWAI_SUSPECT_BITRATE      | stuff/form/bit errors, no frame sent or received OK        |
+ * | CAN_TWAI_SUSPECT_BAD_NODE     | errors almost only while receiving, own frames get through |
+ * | CAN_TWAI_SUSPECT_TERMINATION  | bit/CRC errors in both directions next to good traffic     |
+ *
+ * The ECC register latches one error: the first one after the previous
+ * read. Alerts are polled, so several bus errors (counted by the driver)
+ * may share one read. Only the captured error is classified; the others in
+ * the same batch are counted as CAN_TWAI_ERR_UNKNOWN. ECC is read only when
+ * the driver's bus error counter has advanced, so a stale capture is never
+ * counted, and suspects are derived from the classified errors only.
+ *
+ * @note Requires alerts, i.e. call after can_twai_init(). ECC decoding uses
+ *       the TWAI low-level HAL and can be turned off with
+ *       CONFIG_CAN_TWAI_DIAG_READ_ECC. It is always off on the ESP32, where
+ *       the driver ISR reads and clears ECC for its errata workarounds.
+ *       Without ECC all bus errors are counted as CAN_TWAI_ERR_UNKNOWN and
+ *       no suspect beyond UNKNOWN is given.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of window buckets */
+#define CAN_TWAI_DIAG_MAX_BUCKETS 16
+
+/**
+ * @brief Bus error class
+ */
+typedef enum {
+    CAN_TWAI_ERR_BIT = 0,       /**< Bit monitored differs from bit sent */
+    CAN_TWAI_ERR_STUFF,         /**< More than 5 equal consecutive bits */
+    CAN_TWAI_ERR_FORM,          /**< Fixed-form field violated */
+    CAN_TWAI_ERR_CRC,           /**< CRC mismatch */
+    CAN_TWAI_ERR_ACK,           /**< No dominant ACK for own frame */
+    CAN_TWAI_ERR_OTHER,         /**< Captured, but none of the classes above */
+    CAN_TWAI_ERR_UNKNOWN,       /**< Counted by the driver, no ECC capture for it */
+    CAN_TWAI_ERR_CLASS_COUNT
+} can_twai_err_class_t;
+
+/**
+ * @brief Most likely cause of the errors in the window
+ */
+typedef enum {
+    CAN_TWAI_SUSPECT_NONE = 0,     /**< Fewer errors than min_errors */
+    CAN_TWAI_SUSPECT_NO_ACK,       /**< Node alone on the bus, or other nodes offline / listen-only */
+    CAN_TWAI_SUSPECT_BITRATE,      /**< Bitrate (or sample point) differs from the other nodes */
+    CAN_TWAI_SUSPECT_BAD_NODE,     /**< Another node sends corrupt frames */
+    CAN_TWAI_SUSPECT_TERMINATION,  /**< Signal integrity: termination, wiring, stub length */
+    CAN_TWAI_SUSPECT_UNKNOWN,      /**< Errors present, no clear signature */
+} can_twai_suspect_t;
+
+/**
+ * @brief Diagnosis configuration
+ */
+typedef struct {
+    uint32_t window_ms;   /**< Sliding window length (0 = 10000) */
+    uint32_t buckets;     /**< Buckets in the window (0 = 10, max. CAN_TWAI_DIAG_MAX_BUCKETS) */
+    uint32_t min_errors;  /**< Errors in the window needed for a suspect (0 = 5) */
+} can_twai_diag_config_t;
+
+/**
+ * @brief Diagnosis report
+ */
+typedef struct {
+    uint32_t           total[CAN_TWAI_ERR_CLASS_COUNT];   /**< Errors per class since init */
+    uint32_t           window[CAN_TWAI_ERR_CLASS_COUNT];  /**< Errors per class in the window */
+    uint32_t           window_ms;                         /**< Window length */
+    uint32_t           tx_errors;                         /**< Window: classified errors while transmitting */
+    uint32_t           rx_errors;                         /**< Window: classified errors while receiving */
+    uint32_t           tx_ok_alerts;                      /**< Window: TX_SUCCESS alerts (>0: own frames got through) */
+    uint32_t           rx_ok_alerts;                      /**< Window: RX_DATA alerts (>0: frames received) */
+    uint32_t           error_passive_events;              /**< Since init: transitions to error passive */
+    uint32_t           bus_off_events;                    /**< Since init: transitions to bus-off */
+    uint32_t           tx_error_counter;                  /**< Current TEC */
+    uint32_t           rx_error_counter;                  /**< Current REC */
+    uint32_t           last_ecc;                          /**< Raw ECC register of the last classified error */
+    can_twai_suspect_t suspect;                           /**< Most likely cause */
+} can_twai_diag_report_t;
+
+/**
+ * @brief Start collecting bus error statistics
+ *
+ * @param[in] cfg Configuration (NULL = defaults)
+ *
+ * @return false if already running or alerts cannot be enabled
+ */
+bool can_twai_diag_init(const can_twai_diag_config_t *cfg);
+
+/**
+ * @brief Stop collecting bus error statistics
+ */
+void can_twai_diag_deinit(void);
+
+/**
+ * @brief Get current error statistics and the suspected cause
+ *
+ * @return false if diagnosis is not running
+ */
+bool can_twai_diag_get_report(can_twai_diag_report_t *out);
+
+/**
+ * @brief Log the current report with ESP_LOGI
+ */
+void can_twai_diag_log_report(void);
+
+/**
+ * @brief Short name of an error class
+ */
+const char *can_twai_diag_class_str(can_twai_err_class_t cls);
+
+/**
+ * @brief Human-readable description of a suspect
+ */
+const char *can_twai_diag_suspect_str(can_twai_suspect_t suspect);
+
+#ifdef __cplusplus
+}
+#endif
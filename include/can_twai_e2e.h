@@ -0,0 +1,156 @@
+/**
+ * @file can_twai_e2e.h
+ * @brief End-to-end (E2E) protection profiles for the TWAI adapter
+ *
+ * Adds AUTOSAR-style E2E protection to selected CAN IDs: an alive counter
+ * and a CRC computed over a 16-bit Data ID and the payload. Protected IDs
+ * are handled transparently inside can_twai_send() (counter and CRC are
+ * written into the outgoing frame) and can_twai_receive() (counter and CRC
+ * are checked and the result is recorded per ID).
+ *
+ * Supported profiles (header placed at byte @c offset of the payload):
+ * | Profile                  | CRC                              | Counter           | Layout                            |
+ * |--------------------------|----------------------------------|-------------------|-----------------------------------|
+ * | CAN_TWAI_E2E_PROFILE_1   | CRC8 SAE J1850 (poly 0x1D)       | 4 bit, 0..14      | CRC @ +0, counter low nibble @ +1 |
+ * | CAN_TWAI_E2E_PROFILE_5   | CRC16 CCITT-FALSE (poly 0x1021)  | 8 bit, 0..255     | CRC (LE) @ +0..+1, counter @ +2   |
+ *
+ * Each CRC has a bitwise, a table and a slicing-by-4 engine; the lookup
+ * tables are generated at compile time and are constant data in flash. The
+ * profiles use the slicing-by-4 engine (see tools/e2e for the comparison).
+ *
+ * Typical usage:
+ * @code
+ * static const can_twai_e2e_config_t e2e[] = {
+ *     { .identifier = 0x120, .profile = CAN_TWAI_E2E_PROFILE_1, .transmit = true,
+ *       .data_id = 0x0120 },
+ *     { .identifier = 0x220, .profile = CAN_TWAI_E2E_PROFILE_5, .transmit = false,
+ *       .data_id = 0x0220, .max_delta_counter = 2, .drop_invalid = true },
+ * };
+ * can_twai_e2e_init(e2e, 2);
+ *
+ * can_twai_e2e_stats_t st;
+ * can_twai_e2e_get_stats(0x220, &st);
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief E2E profile
+ */
+typedef enum {
+    CAN_TWAI_E2E_PROFILE_1 = 0,  /**< CRC8 + 4-bit counter */
+    CAN_TWAI_E2E_PROFILE_5,      /**< CRC16 + 8-bit counter */
+} can_twai_e2e_profile_t;
+
+/**
+ * @brief Result of checking one received frame
+ */
+typedef enum {
+    CAN_TWAI_E2E_STATUS_NONE = 0,        /**< Nothing received yet */
+    CAN_TWAI_E2E_STATUS_OK,              /**< CRC valid, counter incremented by 1 */
+    CAN_TWAI_E2E_STATUS_OK_SOME_LOST,    /**< CRC valid, counter gap within max_delta_counter */
+    CAN_TWAI_E2E_STATUS_REPEATED,        /**< CRC valid, counter unchanged */
+    CAN_TWAI_E2E_STATUS_WRONG_SEQUENCE,  /**< CRC valid, counter gap too large */
+    CAN_TWAI_E2E_STATUS_WRONG_CRC,       /**< CRC mismatch */
+    CAN_TWAI_E2E_STATUS_ERROR,           /**< Frame too short for the profile header */
+} can_twai_e2e_status_t;
+
+/**
+ * @brief E2E settings for one protected ID
+ */
+typedef struct {
+    uint32_t               identifier;         /**< CAN identifier */
+    can_twai_e2e_profile_t profile;            /**< Protection profile */
+    bool                   transmit;           /**< true: protect on send, false: check on receive */
+    uint16_t               data_id;            /**< Data ID included in the CRC */
+    uint8_t                offset;             /**< Byte offset of the E2E header in the payload */
+    uint8_t                max_delta_counter;  /**< RX: largest counter step still accepted (0 = 1) */
+    bool                   drop_invalid;       /**< RX: consume frames with WRONG_CRC / WRONG_SEQUENCE / ERROR */
+} can_twai_e2e_config_t;
+
+/**
+ * @brief Per-ID E2E statistics
+ */
+typedef struct {
+    can_twai_e2e_status_t last_status;     /**< Status of the most recent frame */
+    uint8_t               last_counter;    /**< Counter of the most recent frame (sent or received) */
+    uint32_t              frames;          /**< Frames protected (TX) or checked (RX) */
+    uint32_t              ok;              /**< RX: OK or OK_SOME_LOST */
+    uint32_t              lost;            /**< RX: frames missing according to counter gaps */
+    uint32_t              repeated;        /**< RX: REPEATED */
+    uint32_t              wrong_sequence;  /**< RX: WRONG_SEQUENCE */
+    uint32_t              crc_errors;      /**< RX: WRONG_CRC */
+    uint32_t              errors;          /**< RX: ERROR (frame too short) */
+} can_twai_e2e_stats_t;
+
+/**
+ * @brief Attach E2E protection to the transmit and receive paths
+ *
+ * @param[in] cfg   Protected IDs (copied); an ID may appear once per direction
+ * @param[in] count Number of entries
+ *
+ * @return false on invalid configuration or out of memory
+ */
+bool can_twai_e2e_init(const can_twai_e2e_config_t *cfg, size_t count);
+
+/**
+ * @brief Detach E2E protection and free its state
+ */
+void can_twai_e2e_deinit(void);
+
+/**
+ * @brief Get E2E statistics of one ID
+ *
+ * If an ID is configured for both directions, the receive-side entry is reported.
+ *
+ * @return false if the ID is not protected
+ */
+bool can_twai_e2e_get_stats(uint32_t identifier, can_twai_e2e_stats_t *out);
+
+/**
+ * @brief CRC8 SAE J1850 (poly 0x1D, init 0xFF, xorout 0xFF, check 0x4B)
+ *
+ * Uses the engine of the E2E profiles (slicing-by-4).
+ */
+uint8_t can_twai_crc8_sae_j1850(const uint8_t *data, size_t len);
+
+/** @brief CRC8 SAE J1850, bit by bit without tables */
+uint8_t can_twai_crc8_sae_j1850_bitwise(const uint8_t *data, size_t len);
+
+/** @brief CRC8 SAE J1850, one 256-entry table lookup per byte */
+uint8_t can_twai_crc8_sae_j1850_table(const uint8_t *data, size_t len);
+
+/** @brief CRC8 SAE J1850, slicing-by-4 (four tables, four bytes per step) */
+uint8_t can_twai_crc8_sae_j1850_slice4(const uint8_t *data, size_t len);
+
+/**
+ * @brief CRC16 CCITT-FALSE (poly 0x1021, init 0xFFFF, xorout 0, check 0x29B1)
+ *
+ * Uses the engine of the E2E profiles (slicing-by-4).
+ */
+uint16_t can_twai_crc16_ccitt(const uint8_t *data, size_t len);
+
+/** @brief CRC16 CCITT-FALSE, bit by bit without tables */
+uint16_t can_twai_crc16_ccitt_bitwise(const uint8_t *data, size_t len);
+
+/** @brief CRC16 CCITT-FALSE, one 256-entry table lookup per byte */
+uint16_t can_twai_crc16_ccitt_table(const uint8_t *data, size_t len);
+
+/** @brief CRC16 CCITT-FALSE, slicing-by-4 (four tables, four bytes per step) */
+uint16_t can_twai_crc16_ccitt_slice4(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file can_twai_fastpath.h
+ * @brief Low-latency handlers for a small set of critical CAN IDs
+ *
+ * The fast path takes over the driver RX queue with a dispatcher task at the
+ * highest FreeRTOS priority. The driver ISR wakes this task directly, so a
+ * handler for a registered ID (e.g. emergency stop) runs without any further
+ * queue hop or context switch. All other frames are forwarded to an internal
+ * queue that can_twai_receive() reads transparently.
+ *
+ * Cost for the other traffic: every frame that is not handled on the fast
+ * path takes one extra queue hop (driver RX queue -> dispatcher -> forward
+ * queue) before can_twai_receive() sees it. When the application falls
+ * behind and the forward queue is full, the dispatcher drops the frame
+ * rather than stall the fast path. Drops are counted
+ * (can_twai_fastpath_get_forward_drops()) and logged as a warning from the
+ * next can_twai_receive() call, at most once per second; size
+ * forward_queue_len for the longest expected receive gap.
+ *
+ * Handler constraints (the handler runs inside the dispatcher and delays all
+ * further reception until it returns):
+ * - run in a few microseconds, never block or wait (no vTaskDelay, no
+ *   blocking queue/semaphore calls, no can_twai_receive());
+ * - signal other tasks only with non-blocking calls (xTaskNotifyGive,
+ *   xQueueSend with zero timeout, GPIO writes);
+ * - with CONFIG_CAN_TWAI_IRAM_HOT_PATH, mark the handler IRAM_ATTR so it
+ *   keeps its timing during flash operations.
+ *
+ * Typical usage:
+ * @code
+ * static void estop(const twai_message_t *msg, void *ctx)
+ * {
+ *     gpio_set_level(MOTOR_ENABLE_GPIO, 0);
+ * }
+ *
+ * static const can_twai_fastpath_entry_t fast[] = {
+ *     { .identifier = 0x001, .handler = estop },
+ * };
+ * can_twai_fastpath_config_t fp = { .entries = fast, .count = 1 };
+ * can_twai_fastpath_init(&fp);   // after can_twai_init()
+ * @endcode
+ *
+ * Scope: handlers run in the dispatcher task, not in interrupt or alert
+ * callback context, and the module does not measure reaction time from
+ * frame arrival. The legacy TWAI driver offers no user hook inside its ISR
+ * and no RX timestamp, so the dispatcher task is the earliest point where a
+ * frame, or a time stamp for it, is available. The statistics cover only
+ * the part from there to handler return; the ISR-to-task wake-up before it
+ * has to be measured externally (e.g. a GPIO toggled by the handler against
+ * the frame on a logic analyzer).
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of fast-path IDs */
+#define CAN_TWAI_FASTPATH_MAX_IDS 8
+
+/**
+ * @brief Fast-path handler
+ *
+ * @param[in] msg Received frame
+ * @param[in] ctx Context pointer from the entry
+ */
+typedef void (*can_twai_fastpath_handler_t)(const twai_message_t *msg, void *ctx);
+
+/**
+ * @brief One fast-path ID
+ */
+typedef struct {
+    uint32_t                    identifier;  /**< CAN identifier */
+    can_twai_fastpath_handler_t handler;     /**< Handler run from the dispatcher */
+    void                       *ctx;         /**< Handler context */
+    bool                        forward;     /**< Also deliver the frame to can_twai_receive() */
+} can_twai_fastpath_entry_t;
+
+/**
+ * @brief Fast-path configuration
+ */
+typedef struct {
+    const can_twai_fastpath_entry_t *entries;            /**< Fast-path IDs */
+    size_t                           count;              /**< Number of entries (max. CAN_TWAI_FASTPATH_MAX_IDS) */
+    size_t                           forward_queue_len;  /**< Queue for other traffic (0 = 32) */
+    uint32_t                         stack_size;         /**< Dispatcher stack (0 = 3072) */
+    int                              core;               /**< Dispatcher core (tskNO_AFFINITY allowed) */
+} can_twai_fastpath_config_t;
+
+/**
+ * @brief Handler statistics of one fast-path ID
+ *
+ * Times are measured from the moment the dispatcher obtains the frame from
+ * the driver until the handler returns (ID lookup plus handler run time).
+ * They do not include the time from frame arrival to that moment: the
+ * driver ISR's queue send and the switch to the dispatcher task. The legacy
+ * TWAI driver has no ISR hook and no RX timestamp, so that part cannot be
+ * measured here; it is one context switch to the highest-priority task
+ * unless a critical section or a higher-priority ISR delays it.
+ */
+typedef struct {
+    uint32_t calls;           /**< Handler invocations */
+    uint32_t handler_max_us;  /**< Worst case, dispatcher receive to handler return */
+    uint32_t handler_avg_us;  /**< Average, dispatcher receive to handler return */
+} can_twai_fastpath_stats_t;
+
+/**
+ * @brief Start the dispatcher and route can_twai_receive() through it
+ *
+ * @return false on invalid configuration or out of memory
+ *
+ * @note Call after can_twai_init() while no can_twai_receive() is in progress
+ */
+bool can_twai_fastpath_init(const can_twai_fastpath_config_t *cfg);
+
+/**
+ * @brief Stop the dispatcher; can_twai_receive() reads the driver again
+ *
+ * @note Call while no can_twai_receive() is in progress
+ */
+void can_twai_fastpath_deinit(void);
+
+/**
+ * @brief Get handler statistics of one fast-path ID
+ *
+ * @return false if the ID is not registered
+ */
+bool can_twai_fastpath_get_stats(uint32_t identifier, can_twai_fastpath_stats_t *out);
+
+/**
+ * @brief Number of non-fast-path frames dropped because the forward queue was full
+ */
+uint32_t can_twai_fastpath_get_forward_drops(void);
+
+#ifdef __cplusplus
+}
+#endif
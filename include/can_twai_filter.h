@@ -0,0 +1,102 @@
+/**
+ * @file can_twai_filter.h
+ * @brief Runtime-compiled filter expressions on CAN ID and payload
+ *
+ * The acceptance filter of the controller only matches ID/mask pairs. This
+ * module compiles expressions such as
+ * @code
+ * id in 0x100..0x1FF && (data[2] & 0x80)
+ * !ext && dlc >= 4 && (data[1] << 8 | data[0]) > 1000
+ * @endcode
+ * into a compact stack bytecode. The bytecode has no jumps, so evaluating a
+ * frame takes exactly one pass over at most CAN_TWAI_FILTER_MAX_INSNS
+ * instructions: the cost is fixed per filter and known after compilation.
+ *
+ * Language (all values are unsigned 32-bit, non-zero is true):
+ * - operands: decimal/hex numbers, id, dlc, ext, rtr, data[0..7]
+ *   (bytes beyond the DLC read as 0)
+ * - operators by increasing precedence: `||` `or`, `&&` `and`, `!` `not`,
+ *   comparisons `== != < <= > >=` and the inclusive range `x in lo..hi`,
+ *   `|`, `^`, `&`, `<< >>`, parentheses
+ *
+ * The code is plain C without ESP-IDF dependencies so the same compiler and
+ * evaluator can be benchmarked on a host (see tools/filter/).
+ *
+ * Typical usage:
+ * @code
+ * char err[64];
+ * can_twai_filter_t *f = can_twai_filter_compile("id in 0x100..0x1FF && data[2] & 0x80",
+ *                                                err, sizeof(err));
+ * if (f == NULL) { ESP_LOGE(TAG, "filter: %s", err); }
+ *
+ * can_twai_filter_frame_t fr = { .identifier = msg.identifier, .dlc = msg.data_length_code,
+ *                                .extd = msg.extd, .rtr = msg.rtr, .data = msg.data };
+ * if (can_twai_filter_match(f, &fr)) { ... }
+ * can_twai_filter_free(f);
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of bytecode instructions per filter */
+#define CAN_TWAI_FILTER_MAX_INSNS 64
+
+/** @brief Maximum evaluation stack depth */
+#define CAN_TWAI_FILTER_MAX_STACK 16
+
+/** @brief Compiled filter (opaque) */
+typedef struct can_twai_filter can_twai_filter_t;
+
+/**
+ * @brief Frame fields visible to filters
+ */
+typedef struct {
+    uint32_t       identifier;  /**< CAN identifier */
+    uint8_t        dlc;         /**< Data length code */
+    bool           extd;        /**< 29-bit identifier */
+    bool           rtr;         /**< Remote frame */
+    const uint8_t *data;        /**< Payload (at least dlc bytes, may be NULL if dlc is 0) */
+} can_twai_filter_frame_t;
+
+/**
+ * @brief Compile a filter expression
+ *
+ * @param[in]  expr    Expression text
+ * @param[out] err     Error message with column on failure (may be NULL)
+ * @param[in]  err_len Size of @p err
+ *
+ * @return Compiled filter, or NULL on syntax error, too long program or out of memory
+ */
+can_twai_filter_t *can_twai_filter_compile(const char *expr, char *err, size_t err_len);
+
+/**
+ * @brief Free a compiled filter (NULL allowed)
+ */
+void can_twai_filter_free(can_twai_filter_t *filter);
+
+/**
+ * @brief Evaluate a filter on one frame
+ *
+ * @return true if the frame matches; a NULL filter matches everything
+ */
+bool can_twai_filter_match(const can_twai_filter_t *filter, const can_twai_filter_frame_t *frame);
+
+/**
+ * @brief Number of instructions executed per evaluation
+ */
+size_t can_twai_filter_length(const can_twai_filter_t *filter);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,142 @@
+/**
+ * @file can_twai_gen.h
+ * @brief Bus load traffic generator for receiver stress tests
+ *
+ * Generates frames at a configurable share of the bus capacity, up to full
+ * saturation (about 7000 8-byte frames per second at 1 Mbit/s). The profile
+ * sets the target load, the ID distribution, the DLC mix, bursts and the
+ * payload content.
+ *
+ * A periodic esp_timer wakes a generator task, which refills a bit budget
+ * from the elapsed time and sends frames while the budget covers them. The
+ * length of every frame is computed exactly, with its actual stuff bits, so
+ * the achieved load is what the frames occupy on the bus. With bursts, the
+ * budget is saved up until a whole burst fits, which is then queued in one
+ * can_twai_send_batch() call.
+ *
+ * When the bus cannot carry the requested load (lost arbitration against
+ * other nodes, a too-high target), the TX queue fills up; those refusals
+ * are counted, and the achieved load stays below the requested one.
+ *
+ * Typical usage:
+ * @code
+ * can_twai_gen_config_t gc = {
+ *     .bitrate = 1000000, .load_permille = 800,
+ *     .id_mode = CAN_TWAI_GEN_IDS_RANDOM, .id_min = 0x100, .id_max = 0x1FF,
+ *     .dlc_weights = { [0] = 1, [2] = 2, [8] = 7 },   // 10 % DLC 0, 20 % DLC 2, 70 % DLC 8
+ *     .burst_frames = 4, .payload = CAN_TWAI_GEN_PAYLOAD_COUNTER,
+ * };
+ * can_twai_gen_start(&gc);   // after can_twai_init()
+ * vTaskDelay(pdMS_TO_TICKS(10000));
+ * can_twai_gen_stop();
+ * can_twai_gen_log_report();
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief How identifiers are chosen
+ */
+typedef enum {
+    CAN_TWAI_GEN_IDS_FIXED,       /**< Always id_min (or ids[0]) */
+    CAN_TWAI_GEN_IDS_SEQUENTIAL,  /**< id_min..id_max (or ids[]) in order, wrapping */
+    CAN_TWAI_GEN_IDS_RANDOM,      /**< Uniform over id_min..id_max (or ids[]) */
+} can_twai_gen_ids_t;
+
+/**
+ * @brief Payload content
+ */
+typedef enum {
+    CAN_TWAI_GEN_PAYLOAD_COUNTER,    /**< Running frame counter, little endian */
+    CAN_TWAI_GEN_PAYLOAD_RANDOM,     /**< Pseudo-random bytes */
+    CAN_TWAI_GEN_PAYLOAD_TIMESTAMP,  /**< esp_timer_get_time() when built, little endian */
+} can_twai_gen_payload_t;
+
+/**
+ * @brief Generator profile
+ */
+typedef struct {
+    uint32_t               bitrate;         /**< Bus bit rate, basis of the load */
+    uint32_t               load_permille;   /**< Target bus load (1..1000) */
+    can_twai_gen_ids_t     id_mode;         /**< Identifier distribution */
+    uint32_t               id_min;          /**< Lowest identifier */
+    uint32_t               id_max;          /**< Highest identifier */
+    const uint32_t        *ids;             /**< Identifier list used instead of the range (may be NULL) */
+    size_t                 id_count;        /**< Entries in ids */
+    bool                   extd;            /**< 29-bit identifiers */
+    uint8_t                dlc_weights[TWAI_FRAME_MAX_DLC + 1]; /**< Relative weight of DLC 0..8 (all 0 = DLC 8) */
+    uint16_t               burst_frames;    /**< Frames queued back-to-back (0 = 1, at most 32) */
+    can_twai_gen_payload_t payload;         /**< Payload content */
+    uint32_t               period_us;       /**< Timer period (0 = 1000) */
+    uint32_t               seed;            /**< Random seed (0 = fixed default), for repeatable runs */
+    uint32_t               task_priority;   /**< Generator task priority (0 = configMAX_PRIORITIES - 2) */
+} can_twai_gen_config_t;
+
+/**
+ * @brief Requested and achieved load
+ */
+typedef struct {
+    uint32_t requested_permille;  /**< Target load */
+    uint32_t achieved_permille;   /**< Bus time of queued frames over elapsed time */
+    uint32_t frames_per_sec;      /**< Queued frames per second */
+    uint64_t frames;              /**< Frames queued */
+    uint64_t bits;                /**< Bus bits of queued frames, incl. stuffing and IFS */
+    uint32_t bursts;              /**< Bursts queued */
+    uint32_t queue_full;          /**< Timer ticks on which the TX path refused a frame */
+    uint32_t ticks;               /**< Timer ticks handled */
+    uint32_t missed_ticks;        /**< Ticks merged because the task was late */
+    int64_t  elapsed_us;          /**< Time since start */
+} can_twai_gen_stats_t;
+
+/**
+ * @brief Validate the profile and start generating
+ *
+ * @return false on an invalid profile, if already running, or if the task
+ *         or timer cannot be created
+ */
+bool can_twai_gen_start(const can_twai_gen_config_t *cfg);
+
+/**
+ * @brief Stop generating; statistics stay readable
+ */
+void can_twai_gen_stop(void);
+
+/**
+ * @brief Change the target load while running
+ */
+void can_twai_gen_set_load(uint32_t load_permille);
+
+/**
+ * @brief Get requested vs. achieved load
+ */
+void can_twai_gen_get_stats(can_twai_gen_stats_t *out);
+
+/**
+ * @brief Log requested vs. achieved load
+ */
+void can_twai_gen_log_report(void);
+
+/**
+ * @brief Exact length of a data or remote frame on the bus
+ *
+ * Includes stuff bits (computed from the actual ID, DLC, data and CRC),
+ * the fixed-form trailer and the 3-bit intermission.
+ */
+uint32_t can_twai_gen_frame_bits(const twai_message_t *msg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file can_twai_group.h
+ * @brief Consistent multi-message snapshot groups for the TWAI adapter
+ *
+ * A snapshot group is a set of CAN IDs that together form one value, e.g.
+ * a 3-frame IMU packet. The receive path collects the members of a cycle
+ * and publishes them only when all of them have arrived, so readers never
+ * see frames from different cycles mixed together.
+ *
+ * Frames are assigned to a cycle either by a rolling counter carried in the
+ * payload (CAN_TWAI_GROUP_MATCH_COUNTER) or by arriving within a time window
+ * (CAN_TWAI_GROUP_MATCH_WINDOW). Completed cycles are published through
+ * four buffers; readers pin the published buffer, copy it and release it
+ * in a fixed number of steps, without locks or retries (wait-free).
+ *
+ * Typical usage:
+ * @code
+ * static const uint32_t imu_ids[] = { 0x300, 0x301, 0x302 };
+ * can_twai_group_config_t cfg = {
+ *     .ids = imu_ids, .count = 3,
+ *     .match = CAN_TWAI_GROUP_MATCH_COUNTER,
+ *     .counter_byte = 7, .counter_mask = 0x0F,
+ * };
+ * can_twai_group_t *imu = can_twai_group_create(&cfg);
+ *
+ * can_twai_group_snapshot_t snap;
+ * if (can_twai_group_read(imu, &snap)) {
+ *     // snap.msgs[0..2] all belong to the same cycle
+ * }
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of messages in one snapshot group */
+#define CAN_TWAI_GROUP_MAX_MEMBERS 8
+
+/**
+ * @brief How frames are assigned to a cycle
+ */
+typedef enum {
+    CAN_TWAI_GROUP_MATCH_COUNTER = 0,  /**< Same rolling counter value in payload */
+    CAN_TWAI_GROUP_MATCH_WINDOW,       /**< All members within a time window */
+} can_twai_group_match_t;
+
+/**
+ * @brief Snapshot group configuration
+ */
+typedef struct {
+    const uint32_t        *ids;           /**< Member identifiers (snapshot order, no duplicates) */
+    size_t                 count;         /**< Number of members (1..CAN_TWAI_GROUP_MAX_MEMBERS) */
+    can_twai_group_match_t match;         /**< Cycle matching method */
+    uint8_t                counter_byte;  /**< COUNTER: payload byte holding the counter */
+    uint8_t                counter_mask;  /**< COUNTER: counter bits within that byte */
+    uint32_t               window_us;     /**< WINDOW: max. time from first to last member */
+} can_twai_group_config_t;
+
+/**
+ * @brief One complete cycle of a snapshot group
+ */
+typedef struct {
+    twai_message_t msgs[CAN_TWAI_GROUP_MAX_MEMBERS];  /**< Members in configuration order */
+    size_t         count;         /**< Number of valid entries in msgs */
+    int64_t        timestamp_us;  /**< Reception time of the completing member */
+    uint32_t       cycle;         /**< Number of cycles published so far (1 = first) */
+} can_twai_group_snapshot_t;
+
+/**
+ * @brief Snapshot group statistics
+ */
+typedef struct {
+    uint32_t completed;   /**< Cycles published */
+    uint32_t incomplete;  /**< Cycles discarded because a member was missing */
+    uint32_t skipped;     /**< Complete cycles not published because slow readers held all spare buffers */
+} can_twai_group_stats_t;
+
+/** @brief Opaque snapshot group handle */
+typedef struct can_twai_group can_twai_group_t;
+
+/**
+ * @brief Create a snapshot group and attach it to the receive path
+ *
+ * @return Group handle, or NULL on invalid configuration (including a
+ *         member ID listed twice) or out of memory
+ */
+can_twai_group_t *can_twai_group_create(const can_twai_group_config_t *cfg);
+
+/**
+ * @brief Detach a snapshot group from the receive path and free it
+ *
+ * @note No reader may be inside can_twai_group_read() for this group
+ */
+void can_twai_group_destroy(can_twai_group_t *group);
+
+/**
+ * @brief Copy the latest complete cycle
+ *
+ * Wait-free: two atomic increments around one copy, no lock and no retry,
+ * and the receive path never waits for it either. While a reader copies,
+ * the writer publishes into the other three buffers; only if readers still
+ * hold all of those does it skip the cycle (counted in skipped).
+ *
+ * @return true if at least one cycle has been completed
+ */
+bool can_twai_group_read(const can_twai_group_t *group, can_twai_group_snapshot_t *out);
+
+/**
+ * @brief Get group statistics
+ */
+void can_twai_group_get_stats(const can_twai_group_t *group, can_twai_group_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
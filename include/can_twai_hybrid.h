@@ -0,0 +1,150 @@
+/**
+ * @file can_twai_hybrid.h
+ * @brief Hybrid interrupt/polling receive with automatic switchover
+ *
+ * Blocking in can_twai_receive() wakes the receiving task from the driver
+ * ISR for every frame: one context switch per frame at high load. Polling
+ * with a sleep (examples/receive_poll) avoids that, but wastes CPU when the
+ * bus is idle and adds up to one poll interval of latency.
+ *
+ * The hybrid receiver switches between both, similar to Linux NAPI:
+ * - interrupt mode: the task blocks on the driver queue and is woken by the
+ *   ISR. Each wake drains everything already queued;
+ * - after enter_frames frames in a row have arrived closer than enter_gap_us,
+ *   it switches to polling mode: it sleeps poll_interval ticks, then drains
+ *   the queue in one batch. The ISR still fills the queue but wakes nobody,
+ *   so a burst costs one context switch per poll instead of one per frame;
+ * - after idle_polls polls in a row found no frame, it goes back to
+ *   interrupt mode.
+ *
+ * Frames are delivered in batches to a handler running in the receiver task.
+ * The statistics show wakeups and polls per frame, the time spent in the
+ * handler loop and the time spent in polling mode, so the thresholds can be
+ * tuned for the real traffic (see examples/receive_hybrid/).
+ *
+ * Sizing: in polling mode the driver RX queue must hold one poll interval of
+ * traffic, e.g. 21 frames per ms at 1 Mbit/s with 0-byte frames.
+ *
+ * Typical usage:
+ * @code
+ * static void on_frames(const twai_message_t *msgs, size_t count, void *ctx)
+ * {
+ *     for (size_t i = 0; i < count; i++) { handle(&msgs[i]); }
+ * }
+ *
+ * can_twai_hybrid_config_t hc = { .handler = on_frames, .priority = 12 };
+ * can_twai_hybrid_start(&hc);   // after can_twai_init()
+ * @endcode
+ *
+ * @note The receiver task is the only caller of can_twai_receive() while it
+ *       runs. RX hooks (and the fast path) keep working. Frames consumed by
+ *       a hook are not delivered, but still count as traffic for the
+ *       switchover.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Receive mode
+ */
+typedef enum {
+    CAN_TWAI_HYBRID_AUTO = 0,   /**< Switch between interrupt and polling mode */
+    CAN_TWAI_HYBRID_INTERRUPT,  /**< Always block on the driver queue */
+    CAN_TWAI_HYBRID_POLL,       /**< Always poll every poll_interval */
+} can_twai_hybrid_mode_t;
+
+/**
+ * @brief Batch handler
+ *
+ * @param[in] msgs  Received frames, in reception order
+ * @param[in] count Number of frames (>= 1)
+ * @param[in] ctx   Context pointer from the configuration
+ */
+typedef void (*can_twai_hybrid_handler_t)(const twai_message_t *msgs, size_t count, void *ctx);
+
+/**
+ * @brief Switchover thresholds
+ */
+typedef struct {
+    uint32_t   enter_frames;   /**< Closely spaced frames that switch to polling (0 = 4, 1 = on first frame) */
+    uint32_t   enter_gap_us;   /**< Maximum spacing counted as a burst (0 = 2 poll intervals) */
+    uint32_t   idle_polls;     /**< Empty polls that switch back to interrupt mode (0 = 2) */
+    TickType_t poll_interval;  /**< Sleep between polls in ticks (0 = 1) */
+} can_twai_hybrid_thresholds_t;
+
+/**
+ * @brief Hybrid receiver configuration
+ */
+typedef struct {
+    can_twai_hybrid_mode_t       mode;        /**< Receive mode */
+    can_twai_hybrid_thresholds_t thresholds;  /**< Switchover thresholds */
+    can_twai_hybrid_handler_t    handler;     /**< Batch handler (required) */
+    void                        *ctx;         /**< Handler context */
+    size_t                       batch_max;   /**< Maximum frames per handler call (0 = 32) */
+    uint32_t                     stack_size;  /**< Receiver task stack (0 = 3072) */
+    UBaseType_t                  priority;    /**< Receiver task priority */
+    int                          core;        /**< Receiver task core (tskNO_AFFINITY allowed) */
+} can_twai_hybrid_config_t;
+
+/**
+ * @brief Receiver statistics
+ */
+typedef struct {
+    uint32_t frames;         /**< Frames delivered */
+    uint32_t batches;        /**< Handler calls */
+    uint32_t max_batch;      /**< Largest number of frames drained at once */
+    uint32_t wakeups;        /**< Interrupt-mode wakeups by a received frame */
+    uint32_t polls;          /**< Polls in polling mode */
+    uint32_t empty_polls;    /**< Polls that found no frame */
+    uint32_t to_poll;        /**< Switches to polling mode */
+    uint32_t to_interrupt;   /**< Switches back to interrupt mode */
+    uint64_t busy_us;        /**< Time spent draining and in the handler */
+    uint64_t poll_mode_us;   /**< Time spent in polling mode */
+    bool     polling;        /**< Currently in polling mode */
+} can_twai_hybrid_stats_t;
+
+/**
+ * @brief Start the receiver task
+ *
+ * @return false if already running, the configuration is invalid or the task cannot be created
+ */
+bool can_twai_hybrid_start(const can_twai_hybrid_config_t *cfg);
+
+/**
+ * @brief Stop the receiver task (waits up to one receive timeout)
+ */
+void can_twai_hybrid_stop(void);
+
+/**
+ * @brief Change the switchover thresholds while running
+ *
+ * Zero fields take their defaults. Takes effect at the next wake or poll.
+ */
+void can_twai_hybrid_set_thresholds(const can_twai_hybrid_thresholds_t *thresholds);
+
+/**
+ * @brief Get receiver statistics
+ */
+void can_twai_hybrid_get_stats(can_twai_hybrid_stats_t *out);
+
+/**
+ * @brief Clear receiver statistics
+ */
+void can_twai_hybrid_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
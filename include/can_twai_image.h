@@ -0,0 +1,92 @@
+/**
+ * @file can_twai_image.h
+ * @brief Process image of received CAN messages for the TWAI adapter
+ *
+ * The process image keeps the latest payload of each configured CAN ID in
+ * a fixed slot. The adapter's receive path updates the slots; any number of
+ * tasks can read a consistent snapshot at any time without queues or
+ * mutexes. Each slot is protected by a sequence lock (seqlock): the writer
+ * never waits, readers retry only if they raced with an update of the same
+ * slot.
+ *
+ * Typical usage:
+ * @code
+ * static const uint32_t ids[] = { 0x100, 0x101, 0x200 };
+ * can_twai_image_config_t img = { .ids = ids, .count = 3 };
+ * can_twai_image_init(&img);
+ *
+ * // Any task, any time:
+ * can_twai_image_sample_t s;
+ * if (can_twai_image_read(0x100, &s) && s.age_us < 50000) {
+ *     // s.msg.data holds a consistent copy not older than 50 ms
+ * }
+ * @endcode
+ *
+ * @note Slots are updated from within can_twai_receive(), so some task must
+ *       keep receiving (e.g. a producer task or the coroutine executor).
+ * @note Identifiers are matched without regard to the extended-frame flag.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Process image configuration
+ */
+typedef struct {
+    const uint32_t *ids;    /**< Identifiers to track (copied, order irrelevant) */
+    size_t          count;  /**< Number of identifiers */
+} can_twai_image_config_t;
+
+/**
+ * @brief Consistent snapshot of one process image slot
+ */
+typedef struct {
+    twai_message_t msg;           /**< Latest received message */
+    int64_t        timestamp_us;  /**< Reception time (esp_timer_get_time()) */
+    int64_t        age_us;        /**< Time since reception when the snapshot was taken */
+    uint32_t       rx_count;      /**< Number of messages received for this ID */
+} can_twai_image_sample_t;
+
+/**
+ * @brief Create the process image and attach it to the receive path
+ *
+ * @param[in] cfg Identifiers to track
+ *
+ * @return true on success
+ * @return false on invalid configuration, duplicate IDs or out of memory
+ */
+bool can_twai_image_init(const can_twai_image_config_t *cfg);
+
+/**
+ * @brief Detach the process image from the receive path and free it
+ *
+ * @note No reader may be inside can_twai_image_read() when this is called
+ */
+void can_twai_image_deinit(void);
+
+/**
+ * @brief Read a consistent snapshot of one slot (lock-free)
+ *
+ * @param[in]  identifier CAN identifier to read
+ * @param[out] out        Snapshot of the slot
+ *
+ * @return true if the ID is tracked and has been received at least once
+ * @return false otherwise (@p out is left untouched)
+ */
+bool can_twai_image_read(uint32_t identifier, can_twai_image_sample_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,118 @@
+/**
+ * @file can_twai_liveness.h
+ * @brief Timer-wheel based liveness monitor for cyclic CAN messages
+ *
+ * Detects when an expected cyclic message stops arriving. Every monitored
+ * ID owns one timer in a two-level hierarchical timer wheel; each arrival
+ * re-arms it in O(1) from the receive path, and a periodic tick expires
+ * overdue timers. The cost per received frame and per tick is independent
+ * of the number of monitored IDs.
+ *
+ * When a timer expires, the ID's status bit is set and the callback is
+ * called with alive = false. The next arrival clears the bit and calls the
+ * callback with alive = true.
+ *
+ * Typical usage:
+ * @code
+ * static const can_twai_liveness_entry_t expected[] = {
+ *     { .identifier = 0x100, .timeout_ms = 30 },   // 10 ms cycle, 3 missed
+ *     { .identifier = 0x200, .timeout_ms = 300 },  // 100 ms cycle
+ * };
+ * can_twai_liveness_config_t cfg = {
+ *     .entries = expected, .count = 2, .tick_ms = 5,
+ *     .callback = on_liveness, .ctx = NULL,
+ * };
+ * can_twai_liveness_init(&cfg);
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of monitored IDs */
+#define CAN_TWAI_LIVENESS_MAX_ENTRIES 1024
+
+/** @brief Longest supported timeout, in ticks */
+#define CAN_TWAI_LIVENESS_MAX_TICKS (256u * 63u)
+
+/**
+ * @brief One monitored ID
+ */
+typedef struct {
+    uint32_t identifier;  /**< CAN identifier */
+    uint32_t timeout_ms;  /**< Max. allowed gap between two frames */
+} can_twai_liveness_entry_t;
+
+/**
+ * @brief Liveness change callback
+ *
+ * Called from the esp_timer task when an ID times out (alive = false) and
+ * from the receiving task when it reappears (alive = true).
+ */
+typedef void (*can_twai_liveness_cb_t)(uint32_t identifier, bool alive, void *ctx);
+
+/**
+ * @brief Liveness monitor configuration
+ */
+typedef struct {
+    const can_twai_liveness_entry_t *entries;   /**< Monitored IDs (copied) */
+    size_t                           count;     /**< Number of entries */
+    uint32_t                         tick_ms;   /**< Wheel resolution; timeouts round up to it */
+    can_twai_liveness_cb_t           callback;  /**< Liveness change callback (may be NULL) */
+    void                            *ctx;       /**< Passed to callback */
+} can_twai_liveness_config_t;
+
+/**
+ * @brief Start monitoring
+ *
+ * All timers are armed immediately, so IDs that never appear are reported
+ * as well.
+ *
+ * @return false on invalid configuration (timeout longer than
+ *         CAN_TWAI_LIVENESS_MAX_TICKS ticks, duplicate IDs), or out of memory
+ */
+bool can_twai_liveness_init(const can_twai_liveness_config_t *cfg);
+
+/**
+ * @brief Stop monitoring and free all state
+ */
+void can_twai_liveness_deinit(void);
+
+/**
+ * @brief Check whether a monitored ID is currently alive
+ *
+ * @return false if the ID timed out or is not monitored
+ */
+bool can_twai_liveness_is_alive(uint32_t identifier);
+
+/**
+ * @brief Copy the timeout status bitmap
+ *
+ * Bit (i % 32) of word (i / 32) is set while entry i (configuration order)
+ * is timed out.
+ *
+ * @param[out] bits  Destination
+ * @param[in]  words Capacity of @p bits in 32-bit words
+ *
+ * @return Number of words written
+ */
+size_t can_twai_liveness_get_status(uint32_t *bits, size_t words);
+
+/**
+ * @brief Number of IDs currently timed out
+ */
+uint32_t can_twai_liveness_missing_count(void);
+
+#ifdef __cplusplus
+}
+#endif
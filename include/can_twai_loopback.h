@@ -0,0 +1,129 @@
+/**
+ * @file can_twai_loopback.h
+ * @brief Local delivery of transmitted frames to subscribers in the same node
+ *
+ * Components on one ESP32 that talk to each other over CAN IDs normally only
+ * see each other's frames if they come back from the bus. With loopback
+ * enabled, every frame passed to can_twai_send() whose ID has subscribers
+ * is handed to their callbacks directly from the sending task:
+ * - zero-copy: callbacks get a pointer to the frame being sent;
+ * - in order: deliveries are serialized, so all subscribers see the frames
+ *   of all senders in the same order;
+ * - independent of the bus: no arbitration, no bus-off, no timing.
+ *
+ * A frame still goes to the bus as well unless one of its subscriptions is
+ * marked local_only. Frames received from the bus are not looped back.
+ *
+ * Typical usage:
+ * @code
+ * static void on_setpoint(const twai_message_t *msg, void *ctx)
+ * {
+ *     xQueueSend(motor_queue, msg->data, 0);   // copy what is needed, do not block
+ * }
+ *
+ * can_twai_loopback_config_t lc = { .max_subscriptions = 8 };
+ * can_twai_loopback_init(&lc);   // after can_twai_init()
+ *
+ * can_twai_loopback_sub_t sub = { .identifier = 0x210, .callback = on_setpoint, .local_only = true };
+ * can_twai_loopback_subscribe(&sub);
+ * @endcode
+ *
+ * @note Callbacks run in the sending task with the delivery lock held and
+ *       should return quickly. They may call can_twai_send() and
+ *       subscribe/unsubscribe (also themselves) without disturbing the
+ *       delivery in progress, but must not call can_twai_loopback_deinit().
+ * @note Do not combine with msg.self = 1 for the same frames, otherwise
+ *       the frame is delivered once locally and once from the bus.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Local subscriber callback
+ *
+ * @param[in] msg Frame as sent (after TX hooks); valid only during the call
+ * @param[in] ctx Context pointer from the subscription
+ */
+typedef void (*can_twai_loopback_cb_t)(const twai_message_t *msg, void *ctx);
+
+/**
+ * @brief One local subscription
+ */
+typedef struct {
+    uint32_t               identifier;  /**< CAN identifier */
+    can_twai_loopback_cb_t callback;    /**< Called for every frame sent with this ID */
+    void                  *ctx;         /**< Callback context */
+    bool                   local_only;  /**< Keep frames of this ID off the bus */
+} can_twai_loopback_sub_t;
+
+/**
+ * @brief Loopback configuration
+ */
+typedef struct {
+    size_t max_subscriptions;  /**< Subscription table size (0 = 16) */
+} can_twai_loopback_config_t;
+
+/**
+ * @brief Loopback statistics
+ */
+typedef struct {
+    uint32_t frames_looped;  /**< Sent frames delivered to at least one subscriber */
+    uint32_t frames_local;   /**< Frames kept off the bus */
+    uint32_t deliveries;     /**< Callback invocations */
+} can_twai_loopback_stats_t;
+
+/**
+ * @brief Enable local delivery of sent frames
+ *
+ * @return false if already enabled or out of memory
+ *
+ * @note Call after can_twai_init()
+ */
+bool can_twai_loopback_init(const can_twai_loopback_config_t *cfg);
+
+/**
+ * @brief Disable local delivery and drop all subscriptions
+ *
+ * Waits for sends that are delivering locally to finish before freeing the
+ * table, so it is safe to call while other tasks keep sending.
+ *
+ * @note Do not call from a subscriber callback
+ */
+void can_twai_loopback_deinit(void);
+
+/**
+ * @brief Add a subscription (copied)
+ *
+ * Subscribers of the same ID are called in subscription order.
+ *
+ * @return false if loopback is not enabled, the table is full or the callback is NULL
+ */
+bool can_twai_loopback_subscribe(const can_twai_loopback_sub_t *sub);
+
+/**
+ * @brief Remove a subscription
+ *
+ * When this returns the callback is not running and will not be called again.
+ */
+void can_twai_loopback_unsubscribe(uint32_t identifier, can_twai_loopback_cb_t callback, void *ctx);
+
+/**
+ * @brief Get loopback statistics
+ */
+void can_twai_loopback_get_stats(can_twai_loopback_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,196 @@
+/**
+ * @file can_twai_ping.h
+ * @brief Round-trip latency probe between two nodes (CAN ping)
+ *
+ * The initiator sends numbered, timestamped probes; the responder on the
+ * other node echoes each one with its own ID; the initiator records the
+ * round-trip time (RTT) in a histogram. Probes and echoes are 8-byte
+ * frames:
+ *
+ * | bytes | content                                                   |
+ * |-------|-----------------------------------------------------------|
+ * | 0..1  | sequence number (little endian)                           |
+ * | 2..5  | initiator send time, low 32 bits of esp_timer (us)        |
+ * | 6..7  | responder turnaround in us, 0 in probes (saturates 65535) |
+ *
+ * Where the frames are handled decides what the RTT contains:
+ * - CAN_TWAI_PING_RX_HOOK: in an RX hook, i.e. when the frame passes
+ *   can_twai_receive() in whatever task receives;
+ * - CAN_TWAI_PING_RX_EXTERNAL: nothing is installed; the application
+ *   passes frames to can_twai_ping_process(), e.g. from the consumer of a
+ *   producer/consumer queue, or lists can_twai_ping_fastpath_handler() for
+ *   the ID in its fast-path table (the fastest receive path).
+ * Comparing the paths on both nodes shows what queues, task priorities and
+ * hand-offs cost.
+ *
+ * The initiator can run the traffic generator during the test, so the
+ * probes compete with background load for the TX queue and the bus.
+ *
+ * Typical usage:
+ * @code
+ * // Responder node
+ * can_twai_ping_responder_config_t rc = { .request_id = 0x7E0, .reply_id = 0x7E8 };
+ * can_twai_ping_responder_init(&rc);
+ *
+ * // Initiator node
+ * can_twai_gen_config_t bg = { .bitrate = 1000000, .load_permille = 500,
+ *                              .id_min = 0x300, .id_max = 0x3FF,
+ *                              .id_mode = CAN_TWAI_GEN_IDS_RANDOM };
+ * can_twai_ping_config_t pc = { .request_id = 0x7E0, .reply_id = 0x7E8,
+ *                               .count = 1000, .interval_ms = 5, .background = &bg };
+ * can_twai_ping_start(&pc);
+ * can_twai_ping_wait(portMAX_DELAY);
+ * can_twai_ping_log_report();
+ * @endcode
+ *
+ * @note Some task must keep calling can_twai_receive() on both nodes for
+ *       CAN_TWAI_PING_RX_HOOK. Give the probe IDs a higher priority (lower
+ *       value) than the background traffic to measure the best case, or a
+ *       lower one to see arbitration delays.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+#include "can_twai_gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Number of RTT histogram buckets (the last one is open-ended) */
+#define CAN_TWAI_PING_HIST_BUCKETS 32
+
+/**
+ * @brief Where probe and echo frames are handled
+ */
+typedef enum {
+    CAN_TWAI_PING_RX_HOOK = 0,  /**< RX hook, installed by the module */
+    CAN_TWAI_PING_RX_EXTERNAL,  /**< Application calls can_twai_ping_process() or uses the fast path */
+} can_twai_ping_rx_t;
+
+/**
+ * @brief Responder configuration
+ */
+typedef struct {
+    uint32_t           request_id;  /**< ID of probes to echo */
+    uint32_t           reply_id;    /**< ID of echoes */
+    bool               extd;        /**< 29-bit identifiers */
+    can_twai_ping_rx_t rx;          /**< Where probes are handled */
+} can_twai_ping_responder_config_t;
+
+/**
+ * @brief Initiator configuration
+ */
+typedef struct {
+    uint32_t                     request_id;   /**< ID of probes */
+    uint32_t                     reply_id;     /**< ID of echoes */
+    bool                         extd;         /**< 29-bit identifiers */
+    can_twai_ping_rx_t           rx;           /**< Where echoes are handled */
+    uint32_t                     count;        /**< Probes to send (0 = until stopped) */
+    uint32_t                     interval_ms;  /**< Time between probes (0 = 10) */
+    uint32_t                     timeout_ms;   /**< Echo later than this counts as lost (0 = 100, < 256 intervals) */
+    uint32_t                     bucket_us;    /**< Histogram bucket width (0 = 50) */
+    const can_twai_gen_config_t *background;   /**< Generator profile run during the test (may be NULL) */
+    uint32_t                     priority;     /**< Sender task priority (0 = configMAX_PRIORITIES - 3) */
+} can_twai_ping_config_t;
+
+/**
+ * @brief Initiator results
+ */
+typedef struct {
+    uint32_t sent;              /**< Probes queued */
+    uint32_t send_failed;       /**< Probes the TX path refused */
+    uint32_t received;          /**< Echoes within the timeout */
+    uint32_t lost;              /**< Probes without echo within the timeout */
+    uint32_t late;              /**< Echoes after the timeout */
+    uint32_t unexpected;        /**< Duplicate or unknown echoes */
+    uint32_t rtt_min_us;        /**< Shortest round trip */
+    uint32_t rtt_avg_us;        /**< Average round trip */
+    uint32_t rtt_max_us;        /**< Longest round trip */
+    uint32_t turnaround_avg_us; /**< Average time the responder held a probe */
+    uint32_t turnaround_max_us; /**< Longest time the responder held a probe */
+    uint32_t bucket_us;         /**< Histogram bucket width */
+    uint32_t hist[CAN_TWAI_PING_HIST_BUCKETS];  /**< RTT histogram: bucket i covers [i, i+1) * bucket_us */
+} can_twai_ping_stats_t;
+
+/**
+ * @brief Start echoing probes
+ *
+ * @return false on invalid configuration, if already running or if the
+ *         RX hook table is full
+ */
+bool can_twai_ping_responder_init(const can_twai_ping_responder_config_t *cfg);
+
+/**
+ * @brief Stop echoing probes
+ */
+void can_twai_ping_responder_deinit(void);
+
+/**
+ * @brief Echoes sent and echoes the TX path refused
+ */
+void can_twai_ping_responder_get_counts(uint32_t *echoed, uint32_t *failed);
+
+/**
+ * @brief Start sending probes (and the background load, if configured)
+ *
+ * @return false on invalid configuration, if already running, or if the
+ *         task, hook or generator cannot be started
+ */
+bool can_twai_ping_start(const can_twai_ping_config_t *cfg);
+
+/**
+ * @brief Wait until all probes are sent and answered or timed out
+ *
+ * @return false on timeout (or if the probe count is unlimited)
+ */
+bool can_twai_ping_wait(TickType_t timeout);
+
+/**
+ * @brief Stop sending probes and the background load; results stay readable
+ */
+void can_twai_ping_stop(void);
+
+/**
+ * @brief Get the initiator results
+ */
+void can_twai_ping_get_stats(can_twai_ping_stats_t *out);
+
+/**
+ * @brief RTT percentile estimate from the histogram
+ *
+ * @return Upper limit of the bucket holding the percentile (capped at rtt_max_us)
+ */
+uint32_t can_twai_ping_percentile_us(const can_twai_ping_stats_t *stats, uint32_t percent);
+
+/**
+ * @brief Log the results with a text histogram
+ */
+void can_twai_ping_log_report(void);
+
+/**
+ * @brief Handle a frame on the external receive path
+ *
+ * Echoes probes (responder) and records echoes (initiator). Call it for
+ * every received frame, or only for the probe and echo IDs.
+ *
+ * @return true if the frame was a probe or echo of this node
+ */
+bool can_twai_ping_process(const twai_message_t *msg);
+
+/**
+ * @brief can_twai_ping_process() as a fast-path handler (can_twai_fastpath.h)
+ */
+void can_twai_ping_fastpath_handler(const twai_message_t *msg, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
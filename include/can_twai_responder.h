@@ -0,0 +1,135 @@
+/**
+ * @file can_twai_responder.h
+ * @brief Automatic answers to remote frames and request frames
+ *
+ * Many slave nodes answer an RTR frame, or a fixed request frame, with a
+ * static payload or with the latest value of some quantity. The responder
+ * keeps a table of request ID -> response template and answers matching
+ * frames directly from the adapter's receive path. No application code runs
+ * and no extra task switch is needed.
+ *
+ * The payload of a response is either
+ * - static: the template data, or
+ * - live: a buffer inside the responder that the producer refreshes with
+ *   can_twai_responder_set_data(). The copy is taken under a lock, so a
+ *   response never mixes an old value with a new one.
+ *
+ * Responses are queued with can_twai_send_timeout(..., 0) and pass through
+ * the TX hooks like any other frame (E2E, authentication, TX statistics).
+ * A full TX queue counts as a failed response; the request is not retried.
+ *
+ * Typical usage:
+ * @code
+ * static const can_twai_responder_entry_t answers[] = {
+ *     { .request_id = 0x700, .match = CAN_TWAI_RESPONDER_RTR,               // identification
+ *       .response = { .identifier = 0x700, .data_length_code = 4,
+ *                     .data = { 'N', 'O', 'D', '1' } } },
+ *     { .request_id = 0x601, .match = CAN_TWAI_RESPONDER_DATA, .live = true, // latest temperature
+ *       .response = { .identifier = 0x581, .data_length_code = 2 }, .consume = true },
+ * };
+ * can_twai_responder_config_t rc = { .entries = answers, .count = 2 };
+ * can_twai_responder_init(&rc);   // after can_twai_init()
+ *
+ * uint8_t t[2] = { temp & 0xFF, temp >> 8 };
+ * can_twai_responder_set_data(0x601, t, 2);   // from the measuring task
+ * @endcode
+ *
+ * @note Requests are answered when the frame passes can_twai_receive(), so
+ *       some task must keep receiving. The measured latency starts when the
+ *       adapter obtains the request and ends when the response is queued.
+ *       Use can_twai_txstats.h on the response ID for the time on the wire.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Which request frames trigger a response
+ */
+typedef enum {
+    CAN_TWAI_RESPONDER_RTR = 0,  /**< Remote frames only */
+    CAN_TWAI_RESPONDER_DATA,     /**< Data frames only */
+    CAN_TWAI_RESPONDER_ANY,      /**< Remote and data frames */
+} can_twai_responder_match_t;
+
+/**
+ * @brief One request ID with its response
+ */
+typedef struct {
+    uint32_t                   request_id;  /**< Identifier of the request frame */
+    can_twai_responder_match_t match;       /**< Accepted request frame type */
+    twai_message_t             response;    /**< Response template (ID, flags, DLC, static data) */
+    bool                       live;        /**< Payload from the live buffer (initially the template data) */
+    bool                       consume;     /**< Do not pass answered requests to can_twai_receive() */
+} can_twai_responder_entry_t;
+
+/**
+ * @brief Responder configuration
+ */
+typedef struct {
+    const can_twai_responder_entry_t *entries;  /**< Response table (copied) */
+    size_t                            count;    /**< Number of entries */
+} can_twai_responder_config_t;
+
+/**
+ * @brief Statistics of one request ID
+ */
+typedef struct {
+    uint32_t requests;        /**< Matching requests received */
+    uint32_t responses;       /**< Responses queued for transmission */
+    uint32_t failed;          /**< Responses the driver did not accept */
+    uint32_t latency_max_us;  /**< Worst request-to-response latency */
+    uint32_t latency_avg_us;  /**< Average request-to-response latency */
+} can_twai_responder_stats_t;
+
+/**
+ * @brief Attach the response table to the receive path
+ *
+ * @return false on invalid configuration, duplicate request IDs or out of memory
+ *
+ * @note Call after can_twai_init() while no can_twai_receive() is in progress
+ */
+bool can_twai_responder_init(const can_twai_responder_config_t *cfg);
+
+/**
+ * @brief Detach the responder and free its table
+ */
+void can_twai_responder_deinit(void);
+
+/**
+ * @brief Update the live payload of a request ID
+ *
+ * @param[in] request_id Identifier of the request frame
+ * @param[in] data       New payload
+ * @param[in] len        Payload length 0..8, becomes the response DLC
+ *
+ * @return false if the ID is unknown, not live, or @p len is invalid
+ */
+bool can_twai_responder_set_data(uint32_t request_id, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Get statistics of one request ID
+ *
+ * @return false if the ID is not in the table
+ */
+bool can_twai_responder_get_stats(uint32_t request_id, can_twai_responder_stats_t *out);
+
+/**
+ * @brief Clear the statistics of all request IDs
+ */
+void can_twai_responder_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file can_twai_rxbuf.h
+ * @brief RX buffer with priority-aware overflow policies
+ *
+ * A plain FreeRTOS queue between a receive task and a slower consumer
+ * (examples/receive_interrupt) drops whatever frame arrives while it is
+ * full, control traffic as well as diagnostics. This buffer decides what
+ * to lose:
+ * - CAN_TWAI_RXBUF_DROP_NEWEST: keep the queued frames, drop the new one;
+ * - CAN_TWAI_RXBUF_DROP_OLDEST: drop the oldest queued frame;
+ * - CAN_TWAI_RXBUF_DROP_LOWEST: drop the frame with the lowest bus priority
+ *   (the one that would lose arbitration, i.e. the highest ID), which may
+ *   be the new frame itself.
+ *
+ * Frames that win arbitration against a configured limit ID go to a
+ * separate fast lane, which the consumer always empties first. Each lane
+ * applies the policy on its own, so however much diagnostic traffic
+ * arrives, it never takes fast lane space, and the frames of one ID stay
+ * in order. Every dropped frame is counted in the totals, and per ID for
+ * as many IDs as the drop table holds.
+ *
+ * Typical usage:
+ * @code
+ * can_twai_rxbuf_config_t bc = {
+ *     .capacity = 64, .policy = CAN_TWAI_RXBUF_DROP_LOWEST,
+ *     .fast_lane_len = 16, .fast_lane_id = 0x0FF,   // IDs 0x000..0x0FF
+ * };
+ * can_twai_rxbuf_init(&bc);   // after can_twai_init()
+ *
+ * // Receive task
+ * if (can_twai_receive(&msg)) { can_twai_rxbuf_push(&msg); }
+ *
+ * // Consumer task
+ * if (can_twai_rxbuf_pop(&msg, portMAX_DELAY)) { handle(&msg); }
+ * @endcode
+ *
+ * @note With DROP_LOWEST each lane keeps a priority heap next to the
+ *       frames, so push, pop and eviction cost O(log capacity) under the
+ *       spinlock and about 24 extra bytes per frame.
+ * @note Per-ID drop accounting is incomplete by design: the drop table has
+ *       room for 7/8 of drop_table_len IDs and never forgets one. Drops of
+ *       further IDs only increase untracked_ids; can_twai_rxbuf_get_drops()
+ *       returns 0 for them and can_twai_rxbuf_drop_snapshot() omits them.
+ *       Size drop_table_len for the number of IDs on the bus.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What to drop when a lane is full
+ */
+typedef enum {
+    CAN_TWAI_RXBUF_DROP_NEWEST = 0,  /**< Drop the arriving frame */
+    CAN_TWAI_RXBUF_DROP_OLDEST,      /**< Drop the oldest queued frame */
+    CAN_TWAI_RXBUF_DROP_LOWEST,      /**< Drop the lowest-priority (highest ID) frame */
+} can_twai_rxbuf_policy_t;
+
+/**
+ * @brief Buffer configuration
+ */
+typedef struct {
+    size_t                  capacity;       /**< Main lane frames (0 = 64) */
+    can_twai_rxbuf_policy_t policy;         /**< Overflow policy of both lanes */
+    size_t                  fast_lane_len;  /**< Fast lane frames (0 = no fast lane) */
+    uint32_t                fast_lane_id;   /**< Frames winning arbitration against this ID, or equal to it, use the fast lane */
+    bool                    fast_lane_extd; /**< fast_lane_id is a 29-bit identifier */
+    size_t                  drop_table_len; /**< Drop table size; 7/8 of it get separate drop counts (0 = 64) */
+} can_twai_rxbuf_config_t;
+
+/**
+ * @brief Buffer statistics
+ */
+typedef struct {
+    uint32_t pushed;          /**< Frames offered */
+    uint32_t popped;          /**< Frames delivered */
+    uint32_t fast;            /**< Frames stored in the fast lane */
+    uint32_t dropped;         /**< Frames lost, all causes */
+    uint32_t dropped_newest;  /**< Arriving frames dropped */
+    uint32_t dropped_oldest;  /**< Oldest queued frames dropped */
+    uint32_t evicted;         /**< Queued lower-priority frames dropped for a higher-priority one */
+    uint32_t untracked_ids;   /**< Drops of IDs that did not fit into the drop table */
+    uint32_t depth;           /**< Frames queued now, both lanes */
+    uint32_t high_water;      /**< Most frames queued in the main lane */
+    uint32_t fast_high_water; /**< Most frames queued in the fast lane */
+} can_twai_rxbuf_stats_t;
+
+/**
+ * @brief Drops of one identifier
+ */
+typedef struct {
+    uint32_t identifier;  /**< CAN identifier */
+    bool     extd;        /**< 29-bit identifier */
+    uint32_t drops;       /**< Frames lost */
+} can_twai_rxbuf_drop_entry_t;
+
+/**
+ * @brief Allocate the buffer
+ *
+ * @return false if already initialized, on an invalid configuration or out of memory
+ */
+bool can_twai_rxbuf_init(const can_twai_rxbuf_config_t *cfg);
+
+/**
+ * @brief Free the buffer; queued frames are discarded
+ *
+ * @note No task may be blocked in can_twai_rxbuf_pop() any more.
+ */
+void can_twai_rxbuf_deinit(void);
+
+/**
+ * @brief Queue a received frame, applying the overflow policy
+ *
+ * @return false if the frame itself was dropped (a frame evicted in its
+ *         place is counted, but not reported here)
+ */
+bool can_twai_rxbuf_push(const twai_message_t *msg);
+
+/**
+ * @brief Take the next frame, fast lane first
+ *
+ * @param[out] msg     Frame
+ * @param[in]  timeout Maximum wait in ticks
+ *
+ * @return false on timeout
+ */
+bool can_twai_rxbuf_pop(twai_message_t *msg, TickType_t timeout);
+
+/**
+ * @brief Get buffer statistics
+ */
+void can_twai_rxbuf_get_stats(can_twai_rxbuf_stats_t *out);
+
+/**
+ * @brief Frames of one identifier lost so far
+ */
+uint32_t can_twai_rxbuf_get_drops(uint32_t identifier, bool extd);
+
+/**
+ * @brief Copy the per-ID drop counts, most drops first
+ *
+ * @return Number of entries copied
+ */
+size_t can_twai_rxbuf_drop_snapshot(can_twai_rxbuf_drop_entry_t *out, size_t max);
+
+/**
+ * @brief Clear statistics and drop counts (queued frames stay)
+ */
+void can_twai_rxbuf_reset_stats(void);
+
+/**
+ * @brief Log statistics and the IDs with the most drops (0 rows = all)
+ */
+void can_twai_rxbuf_log_report(size_t rows);
+
+#ifdef __cplusplus
+}
+#endif
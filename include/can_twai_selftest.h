@@ -0,0 +1,107 @@
+/**
+ * @file can_twai_selftest.h
+ * @brief Single-board self-test and throughput measurement for the TWAI adapter
+ *
+ * Runs the controller in TWAI_MODE_NO_ACK and transmits frames with the
+ * self-reception flag, so the node receives its own traffic without a
+ * second node on the bus (a transceiver is still required). For every
+ * requested bitrate it measures:
+ * - maximum throughput (frames per second with the TX queue kept full),
+ * - CPU load of the core running the test during that phase,
+ * - TX->RX latency (one frame in flight at a time).
+ *
+ * Typical usage:
+ * @code
+ * static const can_twai_selftest_bitrate_t rates[] = {
+ *     { .bitrate_kbps = 1000, .timing = TWAI_TIMING_CONFIG_1MBITS() },
+ *     { .bitrate_kbps = 500,  .timing = TWAI_TIMING_CONFIG_500KBITS() },
+ * };
+ * can_twai_selftest_result_t results[2];
+ * can_twai_selftest_config_t st = {
+ *     .bitrates = rates, .bitrate_count = 2,
+ *     .throughput_frames = 5000, .latency_samples = 200, .dlc = 8,
+ * };
+ * if (can_twai_selftest_run(&TWAI_HW_CFG, &st, results)) {
+ *     can_twai_selftest_print_report(results, 2);
+ * }
+ * @endcode
+ *
+ * @note The adapter must not be initialized when the self-test starts; it
+ *       is initialized per bitrate and left deinitialized afterwards.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+#include "can_twai_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One bitrate to test
+ */
+typedef struct {
+    uint32_t             bitrate_kbps;  /**< Bitrate label for the report */
+    twai_timing_config_t timing;        /**< Bit timing (use TWAI_TIMING_CONFIG_* macros) */
+} can_twai_selftest_bitrate_t;
+
+/**
+ * @brief Self-test configuration
+ */
+typedef struct {
+    const can_twai_selftest_bitrate_t *bitrates;           /**< Bitrates to test */
+    size_t                             bitrate_count;      /**< Number of bitrates */
+    uint32_t                           throughput_frames;  /**< Frames sent in the throughput phase */
+    uint32_t                           latency_samples;    /**< Frames sent in the latency phase */
+    uint8_t                            dlc;                /**< Payload length (8 recommended, min. 8 for timestamps) */
+    uint32_t                           identifier;         /**< Identifier used for test frames */
+} can_twai_selftest_config_t;
+
+/**
+ * @brief Result for one bitrate
+ */
+typedef struct {
+    uint32_t bitrate_kbps;     /**< Tested bitrate */
+    bool     passed;           /**< All frames sent and received back intact */
+    uint32_t frames_sent;      /**< Throughput phase: frames sent */
+    uint32_t frames_received;  /**< Throughput phase: frames received back */
+    uint32_t frames_lost;      /**< Both phases: frames sent but never received back */
+    uint32_t send_failed;      /**< Both phases: frames can_twai_send() did not accept */
+    uint32_t frames_corrupt;   /**< Both phases: frames received out of order or modified */
+    uint32_t frames_per_sec;   /**< Throughput phase: achieved receive rate */
+    uint32_t bus_load_pct;     /**< Throughput phase: estimated bus load (worst-case stuffing) */
+    uint32_t cpu_load_pct;     /**< Throughput phase: load of the test core */
+    uint32_t latency_min_us;   /**< Latency phase: minimum TX->RX latency */
+    uint32_t latency_avg_us;   /**< Latency phase: average TX->RX latency */
+    uint32_t latency_max_us;   /**< Latency phase: maximum TX->RX latency */
+} can_twai_selftest_result_t;
+
+/**
+ * @brief Run the self-test for all configured bitrates
+ *
+ * @param[in]  base    Hardware configuration (mode and timing are overridden)
+ * @param[in]  cfg     Self-test configuration
+ * @param[out] results One result per bitrate (cfg->bitrate_count entries)
+ *
+ * @return true if every bitrate passed
+ */
+bool can_twai_selftest_run(const twai_backend_config_t *base,
+                           const can_twai_selftest_config_t *cfg,
+                           can_twai_selftest_result_t *results);
+
+/**
+ * @brief Log a table with the self-test results
+ */
+void can_twai_selftest_print_report(const can_twai_selftest_result_t *results, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
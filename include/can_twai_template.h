@@ -0,0 +1,106 @@
+/**
+ * @file can_twai_template.h
+ * @brief Precompiled TX message templates
+ *
+ * Application code usually rebuilds a complete twai_message_t (flags,
+ * identifier, DLC) before every can_twai_send(), and the adapter checks
+ * the DLC again each time. A template is built and validated once at
+ * startup; a send only copies the payload bytes into it and hands it to the
+ * transmit path without further checks. When no TX hook, local delivery or
+ * burst gate is active, that path calls the driver directly.
+ *
+ * The per-send saving can be measured on the host with
+ * `make template-bench` (tools/template/).
+ *
+ * Typical usage:
+ * @code
+ * static can_twai_template_t speed_tpl;
+ * const can_twai_template_config_t tc = { .identifier = 0x123, .dlc = 4 };
+ * can_twai_template_init(&speed_tpl, &tc);   // once at startup
+ *
+ * for (;;) {
+ *     uint8_t d[4] = { ... };
+ *     can_twai_template_send(&speed_tpl, d);  // copies 4 bytes, sends
+ * }
+ *
+ * // Or write the payload in place
+ * uint8_t *p = can_twai_template_payload(&speed_tpl);
+ * p[0] = ...;
+ * can_twai_template_send(&speed_tpl, NULL);
+ * @endcode
+ *
+ * @note A template is not thread-safe; use one template per sending task.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Template definition
+ */
+typedef struct {
+    uint32_t       identifier;   /**< CAN identifier */
+    uint8_t        dlc;          /**< Data length code (0..8) */
+    bool           extd;         /**< 29-bit identifier */
+    bool           rtr;          /**< Remote frame (no payload is copied) */
+    bool           single_shot;  /**< Do not retransmit on error or lost arbitration */
+    bool           self_rx;      /**< Also receive the frame (self-reception) */
+    const uint8_t *data;         /**< Initial payload (dlc bytes, may be NULL) */
+} can_twai_template_config_t;
+
+/**
+ * @brief Prebuilt, validated frame
+ */
+typedef struct {
+    twai_message_t msg;    /**< Frame handed to the driver */
+    bool           valid;  /**< Passed validation in can_twai_template_init() */
+} can_twai_template_t;
+
+/**
+ * @brief Build and validate a template
+ *
+ * @param[out] tpl Template to fill
+ * @param[in]  cfg Template definition
+ *
+ * @return false if the identifier does not fit its format or the DLC is above 8
+ */
+bool can_twai_template_init(can_twai_template_t *tpl, const can_twai_template_config_t *cfg);
+
+/**
+ * @brief Payload buffer of a template, for writing in place
+ */
+static inline uint8_t *can_twai_template_payload(can_twai_template_t *tpl)
+{
+    return tpl->msg.data;
+}
+
+/**
+ * @brief Patch the payload and send with the configured transmit timeout
+ *
+ * @param[in] tpl  Template from can_twai_template_init()
+ * @param[in] data New payload (DLC bytes), or NULL to send the current one
+ *
+ * @return true if the frame was queued
+ */
+bool can_twai_template_send(can_twai_template_t *tpl, const uint8_t *data);
+
+/**
+ * @brief Patch the payload and send with a specific timeout
+ */
+bool can_twai_template_send_timeout(can_twai_template_t *tpl, const uint8_t *data, TickType_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
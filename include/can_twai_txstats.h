@@ -0,0 +1,125 @@
+/**
+ * @file can_twai_txstats.h
+ * @brief Per-ID transmit latency and arbitration-loss statistics
+ *
+ * Measures, for selected IDs, the time from can_twai_send() handing a frame
+ * to the driver until its transmission completes (TX queue wait +
+ * arbitration + transmission), and how many times the frame lost
+ * arbitration on the way. Results are kept in fixed-size histograms per ID,
+ * so memory does not grow with the number of frames.
+ *
+ * Latency histogram buckets (CAN_TWAI_TXSTATS_LAT_BUCKETS):
+ * @code
+ * bucket 0: < 64 us,  bucket i: [64 << (i-1), 64 << i) us,  last: >= 64 << (N-2) us
+ * @endcode
+ * Arbitration histogram buckets: 0, 1, 2, ... losses per frame, the last
+ * bucket collecting CAN_TWAI_TXSTATS_ARB_BUCKETS-1 or more.
+ *
+ * How it works: every sent frame is recorded in a FIFO with its enqueue
+ * time. TX_SUCCESS / TX_FAILED / ARB_LOST alerts are matched against the
+ * driver's pending-TX count, and the oldest frames are completed in order.
+ *
+ * Approximations:
+ * - the driver does not report which frame lost arbitration; all losses
+ *   seen at one alert are charged to the oldest frame still queued,
+ * - all frames completed at one alert share that alert's timestamp, so
+ *   back-to-back frames whose completions are reported together get the
+ *   latency of the last one's completion.
+ *
+ * @note Completion times have the resolution of the adapter's alert task
+ *       (typically tens of microseconds). With several tasks sending
+ *       concurrently the FIFO order may differ from the driver's for frames
+ *       queued at the same instant.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Number of latency histogram buckets */
+#define CAN_TWAI_TXSTATS_LAT_BUCKETS 12
+
+/** @brief Number of arbitration-loss histogram buckets */
+#define CAN_TWAI_TXSTATS_ARB_BUCKETS 5
+
+/**
+ * @brief Statistics configuration
+ */
+typedef struct {
+    const uint32_t *ids;            /**< Identifiers to instrument */
+    size_t          count;          /**< Number of identifiers */
+    size_t          max_in_flight;  /**< FIFO capacity, >= TX queue length + senders (0 = 64) */
+} can_twai_txstats_config_t;
+
+/**
+ * @brief Transmit statistics of one ID
+ */
+typedef struct {
+    uint32_t frames;                                  /**< Frames completed successfully */
+    uint32_t failed;                                  /**< Frames failed (TX_FAILED, bus-off) */
+    uint32_t arb_lost;                                /**< Arbitration losses in total */
+    uint32_t lat_min_us;                              /**< Minimum latency */
+    uint32_t lat_avg_us;                              /**< Average latency */
+    uint32_t lat_max_us;                              /**< Maximum latency */
+    uint32_t lat_hist[CAN_TWAI_TXSTATS_LAT_BUCKETS];  /**< Latency histogram */
+    uint32_t arb_hist[CAN_TWAI_TXSTATS_ARB_BUCKETS];  /**< Losses-per-frame histogram */
+} can_twai_txstats_t;
+
+/**
+ * @brief Start collecting transmit statistics
+ *
+ * @return false on invalid configuration, out of memory or if alerts cannot be enabled
+ *
+ * @note Call after can_twai_init() while no can_twai_send() is in progress
+ */
+bool can_twai_txstats_init(const can_twai_txstats_config_t *cfg);
+
+/**
+ * @brief Stop collecting and free all statistics
+ */
+void can_twai_txstats_deinit(void);
+
+/**
+ * @brief Get statistics of one ID
+ *
+ * @return false if the ID is not instrumented
+ */
+bool can_twai_txstats_get(uint32_t identifier, can_twai_txstats_t *out);
+
+/**
+ * @brief Clear the statistics of all IDs
+ */
+void can_twai_txstats_reset(void);
+
+/**
+ * @brief Upper limit of a latency bucket in microseconds (UINT32_MAX for the last)
+ */
+uint32_t can_twai_txstats_bucket_limit_us(size_t bucket);
+
+/**
+ * @brief Latency percentile estimate from the histogram
+ *
+ * @param[in] stats   Statistics of one ID
+ * @param[in] percent Percentile (1..100)
+ *
+ * @return Upper limit of the bucket holding the percentile (capped at lat_max_us)
+ */
+uint32_t can_twai_txstats_percentile_us(const can_twai_txstats_t *stats, uint32_t percent);
+
+/**
+ * @brief Log a table with frames, failures, arbitration losses and latencies of all IDs
+ */
+void can_twai_txstats_log(void);
+
+#ifdef __cplusplus
+}
+#endif
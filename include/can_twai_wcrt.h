@@ -0,0 +1,118 @@
+/**
+ * @file can_twai_wcrt.h
+ * @brief Worst-case response time analysis for a CAN message set
+ *
+ * Implements the revised CAN schedulability analysis (Davis, Burns, Bril,
+ * Lukkien, "Controller Area Network (CAN) schedulability analysis: Refuted,
+ * revisited and revised", Real-Time Systems 35, 2007) with worst-case bit
+ * stuffing, and Audsley's optimal priority assignment, which is optimal for
+ * this analysis.
+ *
+ * The analysis code is plain C without ESP-IDF dependencies, so it runs on
+ * the target as well as on a development host (see tools/wcrt/).
+ *
+ * Typical usage:
+ * @code
+ * static const can_twai_wcrt_msg_t set[] = {
+ *     { .identifier = 0x100, .dlc = 8, .period_us = 10000, .jitter_us = 500 },
+ *     { .identifier = 0x200, .dlc = 4, .period_us = 20000, .deadline_us = 5000 },
+ * };
+ * can_twai_wcrt_result_t res[2];
+ * bool ok = can_twai_wcrt_analyze(set, 2, 500000, res);
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One periodic (or sporadic) message of the set
+ */
+typedef struct {
+    uint32_t identifier;   /**< CAN identifier (priority: lower wins) */
+    bool     extended;     /**< 29-bit identifier */
+    uint8_t  dlc;          /**< Payload length 0..8 */
+    uint32_t period_us;    /**< Period or minimum inter-arrival time */
+    uint32_t jitter_us;    /**< Queuing jitter */
+    uint32_t deadline_us;  /**< Relative deadline (0 = period) */
+} can_twai_wcrt_msg_t;
+
+/**
+ * @brief Analysis result of one message
+ */
+typedef struct {
+    uint32_t transmit_us;  /**< Worst-case transmission time C (incl. stuffing) */
+    uint32_t blocking_us;  /**< Blocking by lower-priority frames B */
+    uint32_t wcrt_us;      /**< Worst-case response time R (UINT32_MAX if unbounded) */
+    uint32_t instances;    /**< Instances examined in the busy period Q */
+    bool     schedulable;  /**< R <= deadline */
+} can_twai_wcrt_result_t;
+
+/**
+ * @brief Worst-case frame length in bits (incl. stuffing, EOF and intermission)
+ */
+uint32_t can_twai_wcrt_frame_bits(uint8_t dlc, bool extended);
+
+/**
+ * @brief Bitrate from timing parameters
+ *
+ * @param[in] quanta_hz Time quantum frequency (quanta_resolution_hz), or 0 to derive it
+ * @param[in] src_hz    Controller source clock, used when quanta_hz is 0
+ * @param[in] brp       Baud rate prescaler, used when quanta_hz is 0
+ * @param[in] tseg_1    Time segment 1 in quanta
+ * @param[in] tseg_2    Time segment 2 in quanta
+ *
+ * @return Bitrate in bit/s, 0 on invalid parameters
+ */
+uint32_t can_twai_wcrt_bitrate(uint32_t quanta_hz, uint32_t src_hz, uint32_t brp,
+                               uint32_t tseg_1, uint32_t tseg_2);
+
+/**
+ * @brief Bus utilization of the set in per mille (worst-case stuffing)
+ */
+uint32_t can_twai_wcrt_utilization_permille(const can_twai_wcrt_msg_t *msgs, size_t count,
+                                            uint32_t bitrate);
+
+/**
+ * @brief Compute worst-case response times with the priorities given by the IDs
+ *
+ * @param[in]  msgs    Message set (any order)
+ * @param[in]  count   Number of messages
+ * @param[in]  bitrate Bus bitrate in bit/s
+ * @param[out] results One result per message, same order as @p msgs
+ *
+ * @return true if every message meets its deadline; false otherwise or on
+ *         invalid input (duplicate IDs, DLC > 8, zero period or bitrate)
+ */
+bool can_twai_wcrt_analyze(const can_twai_wcrt_msg_t *msgs, size_t count, uint32_t bitrate,
+                           can_twai_wcrt_result_t *results);
+
+/**
+ * @brief Find a priority order that makes the set schedulable
+ *
+ * Uses Audsley's algorithm: it assigns the lowest priority first, each time
+ * to a message that meets its deadline with all unassigned messages above it.
+ *
+ * @param[in]  msgs    Message set
+ * @param[in]  count   Number of messages
+ * @param[in]  bitrate Bus bitrate in bit/s
+ * @param[out] order   Message indices from highest to lowest priority
+ *
+ * @return false if no priority order makes the set schedulable
+ */
+bool can_twai_wcrt_assign_priorities(const can_twai_wcrt_msg_t *msgs, size_t count,
+                                     uint32_t bitrate, size_t *order);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+/**
+ * @file gpio.h
+ * @brief GPIO number type for the ESP-IDF linux target
+ *
+ * Only needed because the wiring part of twai_backend_config_t names GPIOs;
+ * the SocketCAN backend ignores it.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0,
+} gpio_num_t;
+
+#ifdef __cplusplus
+}
+#endif
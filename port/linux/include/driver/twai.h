@@ -0,0 +1,128 @@
+/**
+ * @file twai.h
+ * @brief TWAI driver types for the ESP-IDF linux target
+ *
+ * The linux target has no TWAI driver, but the adapter API is expressed in
+ * its types. This header provides the subset used by the adapter with the
+ * same names, layouts and values, so code written against the TWAI backend
+ * compiles unchanged against the SocketCAN backend.
+ *
+ * Bit timing is configured on the network interface, so the timing macros
+ * only record the nominal bit rate.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TWAI_FRAME_MAX_DLC          8
+#define TWAI_STD_ID_MASK            0x7FF
+#define TWAI_EXTD_ID_MASK           0x1FFFFFFF
+#define TWAI_IO_UNUSED              GPIO_NUM_NC
+
+#define TWAI_MSG_FLAG_NONE          0x00
+#define TWAI_MSG_FLAG_EXTD          0x01
+#define TWAI_MSG_FLAG_RTR           0x02
+#define TWAI_MSG_FLAG_SS            0x04
+#define TWAI_MSG_FLAG_SELF          0x08
+#define TWAI_MSG_FLAG_DLC_NON_COMP  0x10
+
+#define TWAI_ALERT_TX_IDLE              0x00000001
+#define TWAI_ALERT_TX_SUCCESS           0x00000002
+#define TWAI_ALERT_RX_DATA              0x00000004
+#define TWAI_ALERT_BELOW_ERR_WARN       0x00000008
+#define TWAI_ALERT_ERR_ACTIVE           0x00000010
+#define TWAI_ALERT_RECOVERY_IN_PROGRESS 0x00000020
+#define TWAI_ALERT_BUS_RECOVERED        0x00000040
+#define TWAI_ALERT_ARB_LOST             0x00000080
+#define TWAI_ALERT_ABOVE_ERR_WARN       0x00000100
+#define TWAI_ALERT_BUS_ERROR            0x00000200
+#define TWAI_ALERT_TX_FAILED            0x00000400
+#define TWAI_ALERT_RX_QUEUE_FULL        0x00000800
+#define TWAI_ALERT_ERR_PASS             0x00001000
+#define TWAI_ALERT_BUS_OFF              0x00002000
+#define TWAI_ALERT_RX_FIFO_OVERRUN      0x00004000
+#define TWAI_ALERT_TX_RETRIED           0x00008000
+#define TWAI_ALERT_PERIPH_RESET         0x00010000
+#define TWAI_ALERT_ALL                  0x0001FFFF
+#define TWAI_ALERT_NONE                 0x00000000
+#define TWAI_ALERT_AND_LOG              0x00020000
+
+typedef enum {
+    TWAI_MODE_NORMAL,
+    TWAI_MODE_NO_ACK,
+    TWAI_MODE_LISTEN_ONLY,
+} twai_mode_t;
+
+typedef enum {
+    TWAI_STATE_STOPPED,
+    TWAI_STATE_RUNNING,
+    TWAI_STATE_BUS_OFF,
+    TWAI_STATE_RECOVERING,
+} twai_state_t;
+
+typedef struct {
+    union {
+        struct {
+            uint32_t extd: 1;
+            uint32_t rtr: 1;
+            uint32_t ss: 1;
+            uint32_t self: 1;
+            uint32_t dlc_non_comp: 1;
+            uint32_t reserved: 27;
+        };
+        uint32_t flags;
+    };
+    uint32_t identifier;
+    uint8_t data_length_code;
+    uint8_t data[TWAI_FRAME_MAX_DLC];
+} twai_message_t;
+
+typedef struct {
+    uint32_t bitrate;  /**< Nominal bit rate, informational only */
+} twai_timing_config_t;
+
+#define TWAI_TIMING_CONFIG_25KBITS()  { .bitrate = 25000 }
+#define TWAI_TIMING_CONFIG_50KBITS()  { .bitrate = 50000 }
+#define TWAI_TIMING_CONFIG_100KBITS() { .bitrate = 100000 }
+#define TWAI_TIMING_CONFIG_125KBITS() { .bitrate = 125000 }
+#define TWAI_TIMING_CONFIG_250KBITS() { .bitrate = 250000 }
+#define TWAI_TIMING_CONFIG_500KBITS() { .bitrate = 500000 }
+#define TWAI_TIMING_CONFIG_800KBITS() { .bitrate = 800000 }
+#define TWAI_TIMING_CONFIG_1MBITS()   { .bitrate = 1000000 }
+
+typedef struct {
+    uint32_t acceptance_code;
+    uint32_t acceptance_mask;
+    bool single_filter;
+} twai_filter_config_t;
+
+#define TWAI_FILTER_CONFIG_ACCEPT_ALL() { .acceptance_code = 0, .acceptance_mask = 0xFFFFFFFF, .single_filter = true }
+
+typedef struct {
+    twai_state_t state;
+    uint32_t msgs_to_tx;
+    uint32_t msgs_to_rx;
+    uint32_t tx_error_counter;
+    uint32_t rx_error_counter;
+    uint32_t tx_failed_count;
+    uint32_t rx_missed_count;
+    uint32_t rx_overrun_count;
+    uint32_t arb_lost_count;
+    uint32_t bus_error_count;
+} twai_status_info_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,12 +11,16 @@
  */
 
 #include "can_twai.h"
+#include "can_twai_priv.h"
+#include "can_twai_backend.h"
 #include <stdio.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/twai.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
+#include <stdatomic.h>
 #include <inttypes.h>  // for PRIu32, PRIu8, etc.
 
 /** @brief Logging tag for this module */
@@ -25,50 +29,114 @@ static const char* TAG = "can_backend_twai";
 /** @brief Stored configuration for timeout and recovery operations */
 static twai_backend_config_t twai_config;
 
+/** @brief Controller backend (see can_twai_backend.h) */
+#if CONFIG_IDF_TARGET_LINUX
+static const can_twai_backend_t *backend = &can_twai_backend_socketcan;
+#else
+static const can_twai_backend_t *backend = &can_twai_backend_twai;
+#endif
+static bool initialized = false;
+
+/** @brief Registered receive-path hook */
+typedef struct {
+    can_twai_rx_hook_t fn;
+    void              *ctx;
+} rx_hook_entry_t;
+
+/** @brief Registered transmit-path hook */
+typedef struct {
+    can_twai_tx_hook_t fn;
+    void              *ctx;
+} tx_hook_entry_t;
+
+/** @brief Registered transmit-result hook */
+typedef struct {
+    can_twai_tx_done_hook_t fn;
+    void                   *ctx;
+} tx_done_hook_entry_t;
+
+/** @brief Everything the receive path calls into, in registration order */
+typedef struct {
+    rx_hook_entry_t       hooks[CAN_TWAI_MAX_RX_HOOKS];
+    int                   count;
+    can_twai_rx_deliver_t deliver;  /**< Runs after all hooks passed (NULL = deliver all) */
+} rx_path_t;
+
+/** @brief Everything the transmit path calls into, in registration order */
+typedef struct {
+    tx_hook_entry_t      hooks[CAN_TWAI_MAX_TX_HOOKS];
+    int                  count;
+    tx_done_hook_entry_t done_hooks[CAN_TWAI_MAX_TX_DONE_HOOKS];
+    int                  done_count;
+    can_twai_tx_local_t  local;  /**< Local delivery of sent frames (NULL = bus only) */
+    can_twai_tx_gate_t   gate;   /**< Transmit path serialization (NULL = none) */
+} tx_path_t;
+
+/**
+ * @brief Lets a writer wait until no reader uses the previous configuration
+ *
+ * Readers enter the current epoch and use the path copy of its parity. A
+ * writer fills the other copy, flips the epoch and waits until the readers
+ * of the old epoch have left; only then may the old copy (and whatever its
+ * hooks point to) be reused or freed. Readers never wait for writers.
+ */
+typedef struct {
+    atomic_uint epoch;
+    atomic_int  inside[2];
+} path_guard_t;
+
+static rx_path_t rx_paths[2];
+static path_guard_t rx_guard;
+
+static tx_path_t tx_paths[2];
+static path_guard_t tx_guard;
+
+/** @brief Serializes writers of both paths */
+static portMUX_TYPE path_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool path_updating = false;
+
+/** @brief Sequence number of the last send that ran hooks */
+static atomic_uint tx_seq;
+
+/** @brief Registered alert hook */
+typedef struct {
+    uint32_t              mask;
+    can_twai_alert_hook_t fn;
+    void                 *ctx;
+} alert_hook_entry_t;
+
+#define ALERT_TASK_STACK 3072
+#define ALERT_TASK_PRIO  (configMAX_PRIORITIES - 3)
+#define ALERT_POLL_TICKS pdMS_TO_TICKS(50)
+
+/** @brief Alert hooks and the task that reads alerts for them */
+static alert_hook_entry_t alert_hooks[CAN_TWAI_MAX_ALERT_HOOKS];
+static volatile int alert_hook_count = 0;
+static portMUX_TYPE alert_hook_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool alert_task_stop = false;
+static volatile bool alert_task_running = false;
+static volatile bool alert_dispatching = false;
+
+/** @brief Frame source used instead of the driver (NULL = backend receive) */
+static volatile can_twai_rx_source_t rx_source = NULL;
+
 bool can_twai_init(const twai_backend_config_t *cfg)  
 {
-    ESP_LOGD(TAG, "Initializing TWAI driver with:");
+    ESP_LOGD(TAG, "Initializing %s backend with:", backend->name);
     ESP_LOGD(TAG, "  TX GPIO: %d", (int)cfg->wiring.tx_gpio);
     ESP_LOGD(TAG, "  RX GPIO: %d", (int)cfg->wiring.rx_gpio);
     ESP_LOGD(TAG, "  Mode: %s", cfg->params.mode == TWAI_MODE_NORMAL ? "Normal" :
                                  cfg->params.mode == TWAI_MODE_NO_ACK ? "No Ack" : "Listen Only");
 
-    // Build general config from split config
-    twai_general_config_t g = {
-        .controller_id  = cfg->params.controller_id,
-        .mode           = cfg->params.mode,
-        .tx_io          = cfg->wiring.tx_gpio,
-        .rx_io          = cfg->wiring.rx_gpio,
-        .clkout_io      = cfg->wiring.clkout_io,
-        .bus_off_io     = cfg->wiring.bus_off_io,
-        .tx_queue_len   = cfg->params.tx_queue_len,
-        .rx_queue_len   = cfg->params.rx_queue_len,
-        .alerts_enabled = cfg->params.alerts_enabled,
-        .clkout_divider = cfg->params.clkout_divider,
-        .intr_flags     = cfg->params.intr_flags,
-        .general_flags  = {0},
-    };
-
-    // Install TWAI driver with provided configuration
-    esp_err_t err = twai_driver_install(&g, 
-                                      &cfg->tf.timing, 
-                                      &cfg->tf.filter);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to install TWAI driver: %s", esp_err_to_name(err));
-        return false;
-    }
-
-    // Start TWAI driver
-    err = twai_start();
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start TWAI: %s", esp_err_to_name(err));
-        twai_driver_uninstall();
+    // Install and start the controller
+    if (backend->init(cfg) != ESP_OK) {
         return false;
     }
    
     twai_config = *cfg;
+    initialized = true;
 
-    ESP_LOGI(TAG, "TWAI started successfully (rx_timeout=%ldms, tx_timeout=%ldms)", 
+    ESP_LOGI(TAG, "%s started successfully (rx_timeout=%ldms, tx_timeout=%ldms)", backend->name,
              pdTICKS_TO_MS(twai_config.timeouts.receive_timeout), 
              pdTICKS_TO_MS(twai_config.timeouts.transmit_timeout));
 
@@ -78,35 +146,246 @@ bool can_twai_init(const twai_backend_config_t *cfg)
 
 bool can_twai_deinit() 
 {
-     // Stop TWAI driver
-    esp_err_t err = twai_stop();
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to stop TWAI: %s", esp_err_to_name(err));
+    // Stop and release the controller
+    if (backend->deinit() != ESP_OK) {
         return false;
     }
+    initialized = false;
+    return true;
+}
 
-    // Uninstall TWAI driver
-    err = twai_driver_uninstall();
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to uninstall TWAI driver: %s", esp_err_to_name(err));
+bool can_twai_set_backend(const can_twai_backend_t *b)
+{
+    if (initialized) {
+        ESP_LOGE(TAG, "Backend cannot change while initialized");
         return false;
     }
-
+    if (b == NULL || b->init == NULL || b->deinit == NULL || b->start == NULL || b->stop == NULL ||
+        b->transmit == NULL || b->receive == NULL || b->get_status == NULL || b->recover == NULL ||
+        b->read_alerts == NULL || b->reconfigure_alerts == NULL) {
+        ESP_LOGE(TAG, "Incomplete backend");
+        return false;
+    }
+    backend = b;
     return true;
 }
 
-bool can_twai_send(const twai_message_t *msg)
+const can_twai_backend_t *can_twai_get_backend(void)
 {
-    // Validate message length
-    if (msg->data_length_code > TWAI_FRAME_MAX_DLC) {
-        ESP_LOGE(TAG, "Invalid message length: %d", msg->data_length_code);
-        return false;
+    return backend;
+}
+
+CAN_TWAI_HOT_ATTR esp_err_t can_twai_backend_receive(twai_message_t *msg, TickType_t timeout)
+{
+    return backend->receive(msg, timeout);
+}
+
+esp_err_t can_twai_backend_status(twai_status_info_t *status)
+{
+    return backend->get_status(status);
+}
+
+bool can_twai_get_status(twai_status_info_t *status)
+{
+    return status != NULL && backend->get_status(status) == ESP_OK;
+}
+
+// --------------------------------------------------------------------------------------
+// Path configuration updates
+// --------------------------------------------------------------------------------------
+/** @brief Enter the current epoch; returns the index of the path copy to use */
+static CAN_TWAI_HOT_ATTR unsigned guard_enter(path_guard_t *g)
+{
+    for (;;) {
+        unsigned e = atomic_load(&g->epoch) & 1u;
+        atomic_fetch_add(&g->inside[e], 1);
+        if ((atomic_load(&g->epoch) & 1u) == e) {
+            return e;
+        }
+        atomic_fetch_sub(&g->inside[e], 1);  // a writer flipped meanwhile, retry
+    }
+}
+
+static CAN_TWAI_HOT_ATTR void guard_exit(path_guard_t *g, unsigned e)
+{
+    atomic_fetch_sub(&g->inside[e], 1);
+}
+
+/** @brief Start a path update: returns the inactive copy, already equal to the active one */
+static void *path_update_begin(path_guard_t *g, void *paths, size_t size)
+{
+    for (;;) {
+        portENTER_CRITICAL(&path_lock);
+        bool busy = path_updating;
+        path_updating = true;
+        portEXIT_CRITICAL(&path_lock);
+        if (!busy) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    unsigned cur = atomic_load(&g->epoch) & 1u;
+    uint8_t *base = (uint8_t *)paths;
+    memcpy(base + (cur ^ 1u) * size, base + cur * size, size);
+    return base + (cur ^ 1u) * size;
+}
+
+/** @brief Publish the updated copy and wait until the old one is no longer in use */
+static void path_update_end(path_guard_t *g)
+{
+    unsigned old = atomic_fetch_add(&g->epoch, 1) & 1u;
+    while (atomic_load(&g->inside[old]) != 0) {
+        vTaskDelay(1);
     }
+    portENTER_CRITICAL(&path_lock);
+    path_updating = false;
+    portEXIT_CRITICAL(&path_lock);
+}
 
+// --------------------------------------------------------------------------------------
+// Transmit-path hooks
+// --------------------------------------------------------------------------------------
+bool can_twai_register_tx_hook(can_twai_tx_hook_t hook, void *ctx)
+{
+    tx_path_t *p = path_update_begin(&tx_guard, tx_paths, sizeof(tx_path_t));
+    bool ok = p->count < CAN_TWAI_MAX_TX_HOOKS;
+    if (ok) {
+        p->hooks[p->count].fn  = hook;
+        p->hooks[p->count].ctx = ctx;
+        p->count++;
+    }
+    path_update_end(&tx_guard);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "TX hook table full (%d entries)", CAN_TWAI_MAX_TX_HOOKS);
+    }
+    return ok;
+}
+
+void can_twai_unregister_tx_hook(can_twai_tx_hook_t hook, void *ctx)
+{
+    tx_path_t *p = path_update_begin(&tx_guard, tx_paths, sizeof(tx_path_t));
+    for (int i = 0; i < p->count; i++) {
+        if (p->hooks[i].fn == hook && p->hooks[i].ctx == ctx) {
+            for (int j = i + 1; j < p->count; j++) {
+                p->hooks[j - 1] = p->hooks[j];
+            }
+            p->count--;
+            break;
+        }
+    }
+    path_update_end(&tx_guard);
+}
+
+bool can_twai_register_tx_done_hook(can_twai_tx_done_hook_t hook, void *ctx)
+{
+    tx_path_t *p = path_update_begin(&tx_guard, tx_paths, sizeof(tx_path_t));
+    bool ok = p->done_count < CAN_TWAI_MAX_TX_DONE_HOOKS;
+    if (ok) {
+        p->done_hooks[p->done_count].fn  = hook;
+        p->done_hooks[p->done_count].ctx = ctx;
+        p->done_count++;
+    }
+    path_update_end(&tx_guard);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "TX-done hook table full (%d entries)", CAN_TWAI_MAX_TX_DONE_HOOKS);
+    }
+    return ok;
+}
+
+void can_twai_unregister_tx_done_hook(can_twai_tx_done_hook_t hook, void *ctx)
+{
+    tx_path_t *p = path_update_begin(&tx_guard, tx_paths, sizeof(tx_path_t));
+    for (int i = 0; i < p->done_count; i++) {
+        if (p->done_hooks[i].fn == hook && p->done_hooks[i].ctx == ctx) {
+            for (int j = i + 1; j < p->done_count; j++) {
+                p->done_hooks[j - 1] = p->done_hooks[j];
+            }
+            p->done_count--;
+            break;
+        }
+    }
+    path_update_end(&tx_guard);
+}
+
+/** @brief Report the outcome of a send to all transmit-result hooks */
+static CAN_TWAI_HOT_ATTR void run_tx_done_hooks(const tx_path_t *p, const twai_message_t *msg, uint32_t seq,
+                                                bool queued)
+{
+    for (int i = 0; i < p->done_count; i++) {
+        p->done_hooks[i].fn(msg, seq, queued, p->done_hooks[i].ctx);
+    }
+}
+
+/** @brief Pass an outgoing message through all hooks; false if one aborted it */
+static CAN_TWAI_HOT_ATTR bool run_tx_hooks(const tx_path_t *p, twai_message_t *msg, uint32_t seq)
+{
+    for (int i = 0; i < p->count; i++) {
+        if (!p->hooks[i].fn(msg, seq, p->hooks[i].ctx)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_send(const twai_message_t *msg)
+{
     // Transmit message with configured timeout
-    esp_err_t err = twai_transmit(msg, twai_config.timeouts.transmit_timeout);
+    return can_twai_send_timeout(msg, twai_config.timeouts.transmit_timeout);
+}
+
+/** @brief Path with nothing configured */
+static const tx_path_t tx_path_none;
+
+/**
+ * @brief Racy peek whether the transmit path has nothing configured
+ *
+ * Nothing is called through the peeked copy, so a concurrent update can at
+ * worst let a frame pass without a hook that is being registered just now.
+ */
+static CAN_TWAI_HOT_ATTR bool tx_path_empty(void)
+{
+    const tx_path_t *p = &tx_paths[atomic_load_explicit(&tx_guard.epoch, memory_order_relaxed) & 1u];
+    return p->count == 0 && p->done_count == 0 && p->local == NULL && p->gate == NULL;
+}
+
+static CAN_TWAI_HOT_ATTR bool send_frame(const tx_path_t *p, const twai_message_t *msg, TickType_t timeout)
+{
+    // Number this send so hooks can match their TX and TX-done calls
+    uint32_t seq = 0;
+    if (p->count > 0 || p->done_count > 0) {
+        seq = atomic_fetch_add_explicit(&tx_seq, 1, memory_order_relaxed) + 1;
+    }
+
+    // Let transmit hooks work on a private copy
+    twai_message_t hooked;
+    if (p->count > 0) {
+        hooked = *msg;
+        if (!run_tx_hooks(p, &hooked, seq)) {
+            run_tx_done_hooks(p, &hooked, seq, false);
+            return false;
+        }
+        msg = &hooked;
+    }
+
+    // Deliver to local subscribers, possibly instead of the bus
+    if (p->local != NULL && !p->local(msg)) {
+        run_tx_done_hooks(p, msg, seq, false);
+        ESP_LOGD(TAG, "Message delivered locally: ID=0x%lX", msg->identifier);
+        return true;
+    }
+
+    // Transmit message with caller-provided timeout
+    esp_err_t err = backend->transmit(msg, timeout);
+    run_tx_done_hooks(p, msg, seq, err == ESP_OK);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send message: %s", esp_err_to_name(err));
+        // A full queue is the expected answer to a non-blocking attempt
+        if (err == ESP_ERR_TIMEOUT && timeout == 0) {
+            ESP_LOGD(TAG, "Transmit queue full: ID=0x%lX", msg->identifier);
+        } else {
+            ESP_LOGE(TAG, "Failed to send message: %s", esp_err_to_name(err));
+        }
         can_twai_reset_if_needed();
         return false;
     }
@@ -114,23 +393,212 @@ bool can_twai_send(const twai_message_t *msg)
     return true;
 }
 
+CAN_TWAI_HOT_ATTR bool can_twai_send_timeout(const twai_message_t *msg, TickType_t timeout)
+{
+    // Validate message length
+    if (msg->data_length_code > TWAI_FRAME_MAX_DLC) {
+        ESP_LOGE(TAG, "Invalid message length: %d", msg->data_length_code);
+        return false;
+    }
+    return can_twai_send_validated(msg, timeout);
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_send_validated(const twai_message_t *msg, TickType_t timeout)
+{
+    // Without gate, hooks and local delivery this goes straight to the driver
+    if (tx_path_empty()) {
+        return send_frame(&tx_path_none, msg, timeout);
+    }
+
+    // The path copy stays valid (and its modules alive) until guard_exit()
+    unsigned e = guard_enter(&tx_guard);
+    const tx_path_t *p = &tx_paths[e];
+
+    // Wait while another task holds the transmit path for a burst
+    bool ok = false;
+    if (p->gate != NULL && !p->gate(true, timeout)) {
+        ESP_LOGW(TAG, "Transmit path busy: ID=0x%lX", msg->identifier);
+    } else {
+        ok = send_frame(p, msg, timeout);
+        if (p->gate != NULL) {
+            p->gate(false, 0);
+        }
+    }
+    guard_exit(&tx_guard, e);
+    return ok;
+}
+
+CAN_TWAI_HOT_ATTR size_t can_twai_send_batch(const twai_message_t *msgs, size_t count, TickType_t timeout)
+{
+    // Validate message lengths; the batch ends before the first invalid one
+    size_t valid = 0;
+    while (valid < count && msgs[valid].data_length_code <= TWAI_FRAME_MAX_DLC) {
+        valid++;
+    }
+    if (valid < count) {
+        ESP_LOGE(TAG, "Invalid message length: %d", msgs[valid].data_length_code);
+    }
+    if (valid == 0) {
+        return 0;
+    }
+
+    // Hold the transmit path once for the whole batch
+    unsigned e = guard_enter(&tx_guard);
+    const tx_path_t *p = &tx_paths[e];
+    if (p->gate != NULL && !p->gate(true, timeout)) {
+        ESP_LOGW(TAG, "Transmit path busy: ID=0x%lX", msgs[0].identifier);
+        guard_exit(&tx_guard, e);
+        return 0;
+    }
+
+    size_t sent = 0;
+    if (backend->transmit_batch != NULL && p->count == 0 && p->done_count == 0 && p->local == NULL) {
+        // Nothing to run per frame: hand the whole batch to the backend
+        sent = backend->transmit_batch(msgs, valid, timeout);
+        if (sent < valid) {
+            if (timeout == 0) {
+                ESP_LOGD(TAG, "Batch stopped after %u of %u messages", (unsigned)sent, (unsigned)valid);
+            } else {
+                ESP_LOGE(TAG, "Batch stopped after %u of %u messages", (unsigned)sent, (unsigned)valid);
+            }
+            can_twai_reset_if_needed();
+        }
+    } else {
+        while (sent < valid && send_frame(p, &msgs[sent], timeout)) {
+            sent++;
+        }
+    }
+
+    if (p->gate != NULL) {
+        p->gate(false, 0);
+    }
+    guard_exit(&tx_guard, e);
+    return sent;
+}
+
+TickType_t can_twai_get_transmit_timeout(void)
+{
+    return twai_config.timeouts.transmit_timeout;
+}
+
+int can_twai_get_tx_queue_len(void)
+{
+    return twai_config.params.tx_queue_len;
+}
+
+void can_twai_set_tx_local(can_twai_tx_local_t local)
+{
+    tx_path_t *p = path_update_begin(&tx_guard, tx_paths, sizeof(tx_path_t));
+    p->local = local;
+    path_update_end(&tx_guard);
+}
+
+void can_twai_set_tx_gate(can_twai_tx_gate_t gate)
+{
+    tx_path_t *p = path_update_begin(&tx_guard, tx_paths, sizeof(tx_path_t));
+    p->gate = gate;
+    path_update_end(&tx_guard);
+}
+
 void can_twai_reset_if_needed(void) {
     twai_status_info_t status;
-    if (twai_get_status_info(&status) == ESP_OK) {
+    if (backend->get_status(&status) == ESP_OK) {
         if (status.state == TWAI_STATE_BUS_OFF) {
             ESP_LOGW(TAG, "Bus-off detected, initiating recovery...");
-            twai_initiate_recovery();
+            backend->recover();
             vTaskDelay(twai_config.timeouts.bus_off_timeout);  // wait for recovery
         } else if (status.state != TWAI_STATE_RUNNING) {
             ESP_LOGW(TAG, "Controller not running (state=%d), restarting...", (int)status.state);
-            twai_stop();
+            backend->stop();
             vTaskDelay(twai_config.timeouts.bus_not_running_timeout);
-            twai_start();
+            backend->start();
         }
     }
 } // can_twai_reset_if_needed
 
-bool can_twai_receive(twai_message_t *msg)
+// --------------------------------------------------------------------------------------
+// Receive-path hooks
+// --------------------------------------------------------------------------------------
+bool can_twai_register_rx_hook(can_twai_rx_hook_t hook, void *ctx)
+{
+    rx_path_t *p = path_update_begin(&rx_guard, rx_paths, sizeof(rx_path_t));
+    bool ok = p->count < CAN_TWAI_MAX_RX_HOOKS;
+    if (ok) {
+        p->hooks[p->count].fn  = hook;
+        p->hooks[p->count].ctx = ctx;
+        p->count++;
+    }
+    path_update_end(&rx_guard);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "RX hook table full (%d entries)", CAN_TWAI_MAX_RX_HOOKS);
+    }
+    return ok;
+}
+
+void can_twai_unregister_rx_hook(can_twai_rx_hook_t hook, void *ctx)
+{
+    rx_path_t *p = path_update_begin(&rx_guard, rx_paths, sizeof(rx_path_t));
+    for (int i = 0; i < p->count; i++) {
+        if (p->hooks[i].fn == hook && p->hooks[i].ctx == ctx) {
+            for (int j = i + 1; j < p->count; j++) {
+                p->hooks[j - 1] = p->hooks[j];
+            }
+            p->count--;
+            break;
+        }
+    }
+    path_update_end(&rx_guard);
+}
+
+void can_twai_sync_rx_hooks(void)
+{
+    path_update_begin(&rx_guard, rx_paths, sizeof(rx_path_t));
+    path_update_end(&rx_guard);
+}
+
+void can_twai_set_rx_deliver(can_twai_rx_deliver_t deliver)
+{
+    rx_path_t *p = path_update_begin(&rx_guard, rx_paths, sizeof(rx_path_t));
+    p->deliver = deliver;
+    path_update_end(&rx_guard);
+}
+
+/** @brief Pass a received message through all hooks; false if it is not delivered */
+static CAN_TWAI_HOT_ATTR bool run_rx_hooks(twai_message_t *msg)
+{
+    // Racy peek: a hook registered just now may miss this frame
+    const rx_path_t *peek = &rx_paths[atomic_load_explicit(&rx_guard.epoch, memory_order_relaxed) & 1u];
+    if (peek->count == 0 && peek->deliver == NULL) {
+        return true;
+    }
+
+    unsigned e = guard_enter(&rx_guard);
+    const rx_path_t *p = &rx_paths[e];
+    int64_t now_us = esp_timer_get_time();
+    bool pass = true;
+    for (int i = 0; i < p->count && pass; i++) {
+        pass = p->hooks[i].fn(msg, now_us, p->hooks[i].ctx);
+    }
+    if (pass && p->deliver != NULL) {
+        pass = p->deliver(msg);
+    }
+    guard_exit(&rx_guard, e);
+    return pass;
+}
+
+void can_twai_set_rx_source(can_twai_rx_source_t source)
+{
+    rx_source = source;
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_receive(twai_message_t *msg)
+{
+    // Receive message with configured timeout
+    return can_twai_receive_timeout(msg, twai_config.timeouts.receive_timeout);
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_receive_timeout(twai_message_t *msg, TickType_t timeout)
 {
     // Validate input buffer
     if (msg == NULL) {
@@ -138,14 +606,15 @@ bool can_twai_receive(twai_message_t *msg)
         return false;
     }
 
-    // Receive message with configured timeout
-    esp_err_t err = twai_receive(msg, twai_config.timeouts.receive_timeout);
+    // Receive message with caller-provided timeout
+    can_twai_rx_source_t source = rx_source;
+    esp_err_t err = source != NULL ? source(msg, timeout) : backend->receive(msg, timeout);
     
     if (err == ESP_OK) {
         // Validate received message
         if (msg->data_length_code <= TWAI_FRAME_MAX_DLC) {
             ESP_LOGD(TAG, "Received ID=0x%lX LEN=%d", msg->identifier, msg->data_length_code);
-            return true;
+            return run_rx_hooks(msg);
         } else {
             ESP_LOGW(TAG, "Received message with invalid DLC: %d", msg->data_length_code);
             return false;
@@ -160,12 +629,185 @@ bool can_twai_receive(twai_message_t *msg)
     return false;
 }
 
+CAN_TWAI_HOT_ATTR size_t can_twai_receive_batch(twai_message_t *msgs, size_t max, TickType_t timeout)
+{
+    return can_twai_receive_batch_counted(msgs, max, timeout, NULL);
+}
+
+CAN_TWAI_HOT_ATTR size_t can_twai_receive_batch_counted(twai_message_t *msgs, size_t max, TickType_t timeout,
+                                                        size_t *taken)
+{
+    if (taken != NULL) {
+        *taken = 0;
+    }
+    if (msgs == NULL || max == 0) {
+        ESP_LOGE(TAG, "Invalid input buffer");
+        return 0;
+    }
+
+    size_t n = 0;
+    can_twai_rx_source_t source = rx_source;
+    if (source == NULL && backend->receive_batch != NULL) {
+        n = backend->receive_batch(msgs, max, timeout);
+    } else {
+        // Wait for the first message, then take what is already queued
+        esp_err_t err = ESP_OK;
+        while (n < max) {
+            TickType_t wait = n == 0 ? timeout : 0;
+            err = source != NULL ? source(&msgs[n], wait) : backend->receive(&msgs[n], wait);
+            if (err != ESP_OK) {
+                break;
+            }
+            n++;
+        }
+        if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+            ESP_LOGE(TAG, "Error receiving message: %s (error code: %d)",
+                     esp_err_to_name(err), err);
+            can_twai_reset_if_needed();
+        }
+    }
+
+    if (taken != NULL) {
+        *taken = n;
+    }
+
+    // Validate and run hooks, dropping consumed messages in place
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (msgs[i].data_length_code > TWAI_FRAME_MAX_DLC) {
+            ESP_LOGW(TAG, "Received message with invalid DLC: %d", msgs[i].data_length_code);
+            continue;
+        }
+        if (!run_rx_hooks(&msgs[i])) {
+            continue;
+        }
+        if (kept != i) {
+            msgs[kept] = msgs[i];
+        }
+        kept++;
+    }
+    return kept;
+}
+
+// --------------------------------------------------------------------------------------
+// Alert hooks
+// --------------------------------------------------------------------------------------
+/** @brief Alerts requested by the application plus all registered hooks */
+static uint32_t alert_mask(void)
+{
+    uint32_t mask = twai_config.params.alerts_enabled;
+    for (int i = 0; i < alert_hook_count; i++) {
+        mask |= alert_hooks[i].mask;
+    }
+    return mask;
+}
+
+static void alert_task(void *arg)
+{
+    while (!alert_task_stop) {
+        uint32_t alerts = 0;
+        esp_err_t err = backend->read_alerts(&alerts, ALERT_POLL_TICKS);
+        if (err == ESP_ERR_TIMEOUT) {
+            continue;
+        }
+        if (err != ESP_OK) {
+            vTaskDelay(ALERT_POLL_TICKS);  // driver stopped or uninstalled
+            continue;
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        portENTER_CRITICAL(&alert_hook_lock);
+        alert_hook_entry_t hooks[CAN_TWAI_MAX_ALERT_HOOKS];
+        int count = alert_hook_count;
+        memcpy(hooks, alert_hooks, sizeof(alert_hook_entry_t) * count);
+        alert_dispatching = true;
+        portEXIT_CRITICAL(&alert_hook_lock);
+
+        for (int i = 0; i < count; i++) {
+            if (alerts & hooks[i].mask) {
+                hooks[i].fn(alerts, now_us, hooks[i].ctx);
+            }
+        }
+        alert_dispatching = false;
+    }
+    alert_task_running = false;
+    vTaskDelete(NULL);
+}
+
+bool can_twai_register_alert_hook(uint32_t alerts, can_twai_alert_hook_t hook, void *ctx)
+{
+    bool ok = false;
+    portENTER_CRITICAL(&alert_hook_lock);
+    if (alert_hook_count < CAN_TWAI_MAX_ALERT_HOOKS) {
+        alert_hooks[alert_hook_count].mask = alerts;
+        alert_hooks[alert_hook_count].fn   = hook;
+        alert_hooks[alert_hook_count].ctx  = ctx;
+        alert_hook_count++;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&alert_hook_lock);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Alert hook table full (%d entries)", CAN_TWAI_MAX_ALERT_HOOKS);
+        return false;
+    }
+
+    esp_err_t err = backend->reconfigure_alerts(alert_mask(), NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable alerts: %s", esp_err_to_name(err));
+        can_twai_unregister_alert_hook(hook, ctx);
+        return false;
+    }
+
+    if (!alert_task_running) {
+        alert_task_stop = false;
+        alert_task_running = true;
+        if (xTaskCreate(alert_task, "can_alerts", ALERT_TASK_STACK, NULL,
+                        ALERT_TASK_PRIO, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create alert task");
+            alert_task_running = false;
+            can_twai_unregister_alert_hook(hook, ctx);
+            return false;
+        }
+    }
+    return true;
+}
+
+void can_twai_unregister_alert_hook(can_twai_alert_hook_t hook, void *ctx)
+{
+    portENTER_CRITICAL(&alert_hook_lock);
+    for (int i = 0; i < alert_hook_count; i++) {
+        if (alert_hooks[i].fn == hook && alert_hooks[i].ctx == ctx) {
+            for (int j = i + 1; j < alert_hook_count; j++) {
+                alert_hooks[j - 1] = alert_hooks[j];
+            }
+            alert_hook_count--;
+            break;
+        }
+    }
+    int remaining = alert_hook_count;
+    portEXIT_CRITICAL(&alert_hook_lock);
+
+    // The removed hook may still be running from a copy of the table
+    while (alert_dispatching) {
+        vTaskDelay(1);
+    }
+
+    backend->reconfigure_alerts(alert_mask(), NULL);
+    if (remaining == 0 && alert_task_running) {
+        alert_task_stop = true;
+        while (alert_task_running) {
+            vTaskDelay(1);
+        }
+    }
+}
+
 // --------------------------------------------------------------------------------------
 // Backend identification
 // --------------------------------------------------------------------------------------
 const char *can_backend_get_name(void)
 {
-    return "TWAI";
+    return backend->name;
 }
 
 
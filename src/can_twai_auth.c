@@ -0,0 +1,571 @@
+/**
+ * @file can_twai_auth.c
+ * @brief Truncated AES-CMAC / SipHash authentication with freshness counters
+ *
+ * Each configured ID/direction keeps its own precomputed key material:
+ * an mbedTLS AES context with expanded round keys plus the CMAC subkeys
+ * K1/K2, or the two SipHash key words. MAC input is
+ * Data ID (2 bytes, BE) | authentic payload | freshness value (8 bytes, BE).
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_auth.h"
+#include "can_twai_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "mbedtls/aes.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_auth";
+
+/** @brief Longest MAC input: Data ID + full payload + freshness value */
+#define MAC_INPUT_MAX (2 + TWAI_FRAME_MAX_DLC + 8)
+
+/** @brief Runtime state of one authenticated ID/direction */
+typedef struct {
+    can_twai_auth_config_t cfg;
+    can_twai_auth_stats_t  stats;
+    uint64_t               fv;        /**< TX: last sent, RX: last accepted freshness value */
+    union {
+        struct {
+            mbedtls_aes_context aes;  /**< Expanded AES-128 key */
+            uint8_t             k1[16];
+            uint8_t             k2[16];
+        } cmac;
+        struct {
+            uint64_t k0;
+            uint64_t k1;
+        } sip;
+    } key;
+} auth_entry_t;
+
+/** @brief Entries for each direction, sorted by identifier */
+static auth_entry_t *tx_tab = NULL;
+static size_t tx_count = 0;
+static auth_entry_t *rx_tab = NULL;
+static size_t rx_count = 0;
+
+/** @brief Guards freshness values and statistics */
+static portMUX_TYPE auth_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// --------------------------------------------------------------------------------------
+// AES-CMAC (RFC 4493)
+// --------------------------------------------------------------------------------------
+
+static void cmac_double(const uint8_t in[16], uint8_t out[16])
+{
+    uint8_t carry = in[0] >> 7;
+    for (int i = 0; i < 15; i++) {
+        out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+    }
+    out[15] = (uint8_t)((in[15] << 1) ^ (carry ? 0x87 : 0x00));
+}
+
+static bool cmac_setup(auth_entry_t *e, const uint8_t *key)
+{
+    mbedtls_aes_init(&e->key.cmac.aes);
+    if (mbedtls_aes_setkey_enc(&e->key.cmac.aes, key, 128) != 0) {
+        return false;
+    }
+    uint8_t zero[16] = {0};
+    uint8_t l[16];
+    if (mbedtls_aes_crypt_ecb(&e->key.cmac.aes, MBEDTLS_AES_ENCRYPT, zero, l) != 0) {
+        return false;
+    }
+    cmac_double(l, e->key.cmac.k1);
+    cmac_double(e->key.cmac.k1, e->key.cmac.k2);
+    memset(l, 0, sizeof(l));
+    return true;
+}
+
+static void cmac_compute(const auth_entry_t *e, const uint8_t *msg, size_t len, uint8_t mac[16])
+{
+    mbedtls_aes_context *aes = (mbedtls_aes_context *)&e->key.cmac.aes;
+    uint8_t x[16] = {0};
+    size_t blocks = (len + 15) / 16;
+    if (blocks == 0) {
+        blocks = 1;
+    }
+
+    for (size_t b = 0; b < blocks - 1; b++) {
+        for (int i = 0; i < 16; i++) {
+            x[i] ^= msg[b * 16 + i];
+        }
+        mbedtls_aes_crypt_ecb(aes, MBEDTLS_AES_ENCRYPT, x, x);
+    }
+
+    // Last block: complete -> XOR K1, partial -> pad 10..0 and XOR K2
+    size_t last = len - (blocks - 1) * 16;
+    const uint8_t *tail = msg + (blocks - 1) * 16;
+    if (len > 0 && last == 16) {
+        for (int i = 0; i < 16; i++) {
+            x[i] ^= tail[i] ^ e->key.cmac.k1[i];
+        }
+    } else {
+        for (size_t i = 0; i < 16; i++) {
+            uint8_t m = (i < last) ? tail[i] : (i == last ? 0x80 : 0x00);
+            x[i] ^= m ^ e->key.cmac.k2[i];
+        }
+    }
+    mbedtls_aes_crypt_ecb(aes, MBEDTLS_AES_ENCRYPT, x, mac);
+}
+
+// --------------------------------------------------------------------------------------
+// SipHash-2-4
+// --------------------------------------------------------------------------------------
+
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(v0, v1, v2, v3)                                            \
+    do {                                                                    \
+        v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32);       \
+        v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2;                            \
+        v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0;                            \
+        v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32);       \
+    } while (0)
+
+static uint64_t load_le64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void siphash_setup(auth_entry_t *e, const uint8_t *key)
+{
+    e->key.sip.k0 = load_le64(key);
+    e->key.sip.k1 = load_le64(key + 8);
+}
+
+static void siphash_compute(const auth_entry_t *e, const uint8_t *msg, size_t len, uint8_t mac[8])
+{
+    uint64_t v0 = 0x736f6d6570736575ull ^ e->key.sip.k0;
+    uint64_t v1 = 0x646f72616e646f6dull ^ e->key.sip.k1;
+    uint64_t v2 = 0x6c7967656e657261ull ^ e->key.sip.k0;
+    uint64_t v3 = 0x7465646279746573ull ^ e->key.sip.k1;
+
+    size_t full = len & ~(size_t)7;
+    for (size_t i = 0; i < full; i += 8) {
+        uint64_t m = load_le64(msg + i);
+        v3 ^= m;
+        SIPROUND(v0, v1, v2, v3);
+        SIPROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    uint64_t b = (uint64_t)len << 56;
+    for (size_t i = 0; i < (len & 7); i++) {
+        b |= (uint64_t)msg[full + i] << (8 * i);
+    }
+    v3 ^= b;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+
+    uint64_t h = v0 ^ v1 ^ v2 ^ v3;
+    for (int i = 0; i < 8; i++) {
+        mac[i] = (uint8_t)(h >> (8 * i));
+    }
+}
+
+// --------------------------------------------------------------------------------------
+// Frame handling
+// --------------------------------------------------------------------------------------
+
+/** @brief Compute the full MAC of a frame for a given freshness value */
+static void compute_mac(const auth_entry_t *e, const uint8_t *data, uint64_t fv, uint8_t mac[16])
+{
+    uint8_t input[MAC_INPUT_MAX];
+    size_t n = 0;
+    input[n++] = (uint8_t)(e->cfg.data_id >> 8);
+    input[n++] = (uint8_t)e->cfg.data_id;
+    memcpy(&input[n], data, e->cfg.data_len);
+    n += e->cfg.data_len;
+    for (int i = 7; i >= 0; i--) {
+        input[n++] = (uint8_t)(fv >> (8 * i));
+    }
+
+    if (e->cfg.alg == CAN_TWAI_AUTH_AES_CMAC) {
+        cmac_compute(e, input, n, mac);
+    } else {
+        siphash_compute(e, input, n, mac);
+    }
+}
+
+static int cmp_cfg_ptr(const void *a, const void *b)
+{
+    uint32_t x = (*(const can_twai_auth_config_t *const *)a)->identifier;
+    uint32_t y = (*(const can_twai_auth_config_t *const *)b)->identifier;
+    return (x > y) - (x < y);
+}
+
+static auth_entry_t *find_entry(auth_entry_t *tab, size_t count, uint32_t identifier)
+{
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t key = tab[mid].cfg.identifier;
+        if (key == identifier) {
+            return &tab[mid];
+        }
+        if (key < identifier) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static bool verify_frame(auth_entry_t *e, const twai_message_t *msg)
+{
+    const can_twai_auth_config_t *c = &e->cfg;
+    if (msg->data_length_code != c->data_len + c->fv_bytes + c->mac_bytes) {
+        portENTER_CRITICAL(&auth_lock);
+        e->stats.length_failures++;
+        portEXIT_CRITICAL(&auth_lock);
+        return false;
+    }
+
+    // Rebuild the full freshness value from its transmitted low bytes
+    uint64_t trunc = 0;
+    for (uint8_t i = 0; i < c->fv_bytes; i++) {
+        trunc = (trunc << 8) | msg->data[c->data_len + i];
+    }
+    const uint64_t mask = (1ull << (8 * c->fv_bytes)) - 1;
+
+    portENTER_CRITICAL(&auth_lock);
+    uint64_t last = e->fv;
+    portEXIT_CRITICAL(&auth_lock);
+
+    uint64_t fv = (last & ~mask) | trunc;
+    if (fv <= last) {
+        fv += mask + 1;
+    }
+
+    uint8_t mac[16];
+    compute_mac(e, msg->data, fv, mac);
+    const uint8_t *rx_mac = &msg->data[c->data_len + c->fv_bytes];
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < c->mac_bytes; i++) {
+        diff |= mac[i] ^ rx_mac[i];  // constant time
+    }
+
+    bool ok = false;
+    portENTER_CRITICAL(&auth_lock);
+    if (diff != 0) {
+        e->stats.mac_failures++;
+    } else if (fv <= e->fv || (c->accept_window != 0 && fv - e->fv > c->accept_window)) {
+        e->stats.freshness_failures++;
+    } else {
+        e->fv = fv;
+        e->stats.authenticated++;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&auth_lock);
+    return ok;
+}
+
+static bool auth_tx_hook(twai_message_t *msg, uint32_t seq, void *ctx)
+{
+    (void)seq;
+    (void)ctx;
+    auth_entry_t *e = find_entry(tx_tab, tx_count, msg->identifier);
+    if (e == NULL) {
+        return true;
+    }
+    const can_twai_auth_config_t *c = &e->cfg;
+
+    // The MAC covers exactly data_len bytes; anything else would be sent with a bogus layout
+    if (msg->data_length_code != c->data_len) {
+        portENTER_CRITICAL(&auth_lock);
+        e->stats.length_failures++;
+        portEXIT_CRITICAL(&auth_lock);
+        ESP_LOGW(TAG, "ID 0x%lX: DLC %u, expected %u authentic bytes, not sent",
+                 (unsigned long)msg->identifier, msg->data_length_code, c->data_len);
+        return false;
+    }
+
+    portENTER_CRITICAL(&auth_lock);
+    uint64_t fv = ++e->fv;
+    e->stats.authenticated++;
+    portEXIT_CRITICAL(&auth_lock);
+
+    uint8_t mac[16];
+    compute_mac(e, msg->data, fv, mac);
+
+    uint8_t pos = c->data_len;
+    for (int i = c->fv_bytes - 1; i >= 0; i--) {
+        msg->data[pos++] = (uint8_t)(fv >> (8 * i));
+    }
+    memcpy(&msg->data[pos], mac, c->mac_bytes);
+    msg->data_length_code = (uint8_t)(pos + c->mac_bytes);
+    return true;
+}
+
+static bool auth_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    (void)rx_time_us;
+    (void)ctx;
+    auth_entry_t *e = find_entry(rx_tab, rx_count, msg->identifier);
+    if (e == NULL || !e->cfg.verify_inline) {
+        return true;
+    }
+    if (!verify_frame(e, msg)) {
+        ESP_LOGD(TAG, "ID 0x%lX: authentication failed", (unsigned long)msg->identifier);
+        return false;
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------------------
+// Public API
+// --------------------------------------------------------------------------------------
+
+static bool setup_key(auth_entry_t *e, const uint8_t *key)
+{
+    if (e->cfg.alg == CAN_TWAI_AUTH_AES_CMAC) {
+        return cmac_setup(e, key);
+    }
+    siphash_setup(e, key);
+    return true;
+}
+
+static void wipe_table(auth_entry_t *tab, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (tab[i].cfg.alg == CAN_TWAI_AUTH_AES_CMAC) {
+            mbedtls_aes_free(&tab[i].key.cmac.aes);
+        }
+        memset(&tab[i].key, 0, sizeof(tab[i].key));
+    }
+    free(tab);
+}
+
+static bool build_table(const can_twai_auth_config_t *cfg, size_t count, bool transmit,
+                        auth_entry_t **tab_out, size_t *count_out)
+{
+    *tab_out = NULL;
+    *count_out = 0;
+
+    // Sort configuration pointers first: AES contexts are set up in place and never moved
+    const can_twai_auth_config_t **order = malloc(count * sizeof(*order));
+    if (order == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        return false;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (cfg[i].transmit == transmit) {
+            order[n++] = &cfg[i];
+        }
+    }
+    if (n == 0) {
+        free(order);
+        return true;
+    }
+    qsort(order, n, sizeof(*order), cmp_cfg_ptr);
+    for (size_t i = 1; i < n; i++) {
+        if (order[i]->identifier == order[i - 1]->identifier) {
+            ESP_LOGE(TAG, "Duplicate %s ID 0x%lX", transmit ? "TX" : "RX",
+                     (unsigned long)order[i]->identifier);
+            free(order);
+            return false;
+        }
+    }
+
+    auth_entry_t *tab = calloc(n, sizeof(auth_entry_t));
+    if (tab == NULL) {
+        ESP_LOGE(TAG, "Out of memory for %u entries", (unsigned)n);
+        free(order);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        tab[i].cfg = *order[i];
+        tab[i].cfg.key = NULL;  // key material lives only in the schedule
+        if (!setup_key(&tab[i], order[i]->key)) {
+            ESP_LOGE(TAG, "ID 0x%lX: key setup failed", (unsigned long)order[i]->identifier);
+            wipe_table(tab, i + 1);
+            free(order);
+            return false;
+        }
+    }
+    free(order);
+
+    *tab_out = tab;
+    *count_out = n;
+    return true;
+}
+
+bool can_twai_auth_init(const can_twai_auth_config_t *cfg, size_t count)
+{
+    if (cfg == NULL || count == 0) {
+        ESP_LOGE(TAG, "Invalid authentication configuration");
+        return false;
+    }
+    if (tx_tab != NULL || rx_tab != NULL) {
+        ESP_LOGE(TAG, "Authentication already initialized");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const can_twai_auth_config_t *c = &cfg[i];
+        if (c->key == NULL ||
+            (c->alg != CAN_TWAI_AUTH_AES_CMAC && c->alg != CAN_TWAI_AUTH_SIPHASH) ||
+            c->fv_bytes == 0 || c->fv_bytes > CAN_TWAI_AUTH_MAX_FV_BYTES ||
+            c->mac_bytes == 0 || c->mac_bytes > 8 ||
+            c->data_len + c->fv_bytes + c->mac_bytes > TWAI_FRAME_MAX_DLC) {
+            ESP_LOGE(TAG, "ID 0x%lX: invalid key, algorithm or frame layout", (unsigned long)c->identifier);
+            return false;
+        }
+    }
+
+    if (!build_table(cfg, count, true, &tx_tab, &tx_count) ||
+        !build_table(cfg, count, false, &rx_tab, &rx_count)) {
+        can_twai_auth_deinit();
+        return false;
+    }
+
+    if ((tx_count > 0 && !can_twai_register_tx_hook(auth_tx_hook, NULL)) ||
+        (rx_count > 0 && !can_twai_register_rx_hook(auth_rx_hook, NULL))) {
+        can_twai_auth_deinit();
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Authentication active (%u TX, %u RX IDs)", (unsigned)tx_count, (unsigned)rx_count);
+    return true;
+}
+
+void can_twai_auth_deinit(void)
+{
+    can_twai_unregister_tx_hook(auth_tx_hook, NULL);
+    can_twai_unregister_rx_hook(auth_rx_hook, NULL);
+    if (tx_tab != NULL) {
+        wipe_table(tx_tab, tx_count);
+    }
+    if (rx_tab != NULL) {
+        wipe_table(rx_tab, rx_count);
+    }
+    tx_tab = rx_tab = NULL;
+    tx_count = rx_count = 0;
+}
+
+size_t can_twai_auth_verify_batch(const twai_message_t *msgs, size_t count, bool *results)
+{
+    if (msgs == NULL) {
+        return 0;
+    }
+
+    size_t valid = 0;
+    auth_entry_t *e = NULL;
+    for (size_t i = 0; i < count; i++) {
+        // Consecutive frames of the same ID reuse the lookup
+        if (e == NULL || e->cfg.identifier != msgs[i].identifier) {
+            e = find_entry(rx_tab, rx_count, msgs[i].identifier);
+        }
+        bool ok = (e != NULL) && verify_frame(e, &msgs[i]);
+        if (results != NULL) {
+            results[i] = ok;
+        }
+        valid += ok;
+    }
+    return valid;
+}
+
+bool can_twai_auth_get_freshness(uint32_t identifier, bool transmit, uint64_t *fv)
+{
+    auth_entry_t *e = transmit ? find_entry(tx_tab, tx_count, identifier)
+                               : find_entry(rx_tab, rx_count, identifier);
+    if (e == NULL || fv == NULL) {
+        return false;
+    }
+    portENTER_CRITICAL(&auth_lock);
+    *fv = e->fv;
+    portEXIT_CRITICAL(&auth_lock);
+    return true;
+}
+
+bool can_twai_auth_set_freshness(uint32_t identifier, bool transmit, uint64_t fv)
+{
+    auth_entry_t *e = transmit ? find_entry(tx_tab, tx_count, identifier)
+                               : find_entry(rx_tab, rx_count, identifier);
+    if (e == NULL) {
+        return false;
+    }
+    portENTER_CRITICAL(&auth_lock);
+    e->fv = fv;
+    portEXIT_CRITICAL(&auth_lock);
+    return true;
+}
+
+bool can_twai_auth_get_stats(uint32_t identifier, can_twai_auth_stats_t *out)
+{
+    if (out == NULL) {
+        return false;
+    }
+    auth_entry_t *e = find_entry(rx_tab, rx_count, identifier);
+    if (e == NULL) {
+        e = find_entry(tx_tab, tx_count, identifier);
+    }
+    if (e == NULL) {
+        return false;
+    }
+    portENTER_CRITICAL(&auth_lock);
+    *out = e->stats;
+    portEXIT_CRITICAL(&auth_lock);
+    return true;
+}
+
+uint32_t can_twai_auth_benchmark(can_twai_auth_alg_t alg, uint32_t iterations)
+{
+    if (iterations == 0) {
+        return 0;
+    }
+
+    auth_entry_t *e = calloc(1, sizeof(auth_entry_t));
+    if (e == NULL) {
+        return 0;
+    }
+    static const uint8_t key[CAN_TWAI_AUTH_KEY_LEN] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+    };
+    e->cfg.alg = alg;
+    e->cfg.data_len = TWAI_FRAME_MAX_DLC;
+    if (!setup_key(e, key)) {
+        free(e);
+        return 0;
+    }
+
+    uint8_t data[TWAI_FRAME_MAX_DLC] = {0};
+    uint8_t mac[16];
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < iterations; i++) {
+        data[0] = (uint8_t)i;
+        compute_mac(e, data, i, mac);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    if (alg == CAN_TWAI_AUTH_AES_CMAC) {
+        mbedtls_aes_free(&e->key.cmac.aes);
+    }
+    free(e);
+
+    uint32_t rate = elapsed > 0 ? (uint32_t)((uint64_t)iterations * 1000000ull / (uint64_t)elapsed) : 0;
+    ESP_LOGI(TAG, "%s: %lu MACs/s (%lu iterations)", alg == CAN_TWAI_AUTH_AES_CMAC ? "AES-CMAC" : "SipHash-2-4",
+             (unsigned long)rate, (unsigned long)iterations);
+    return rate;
+}
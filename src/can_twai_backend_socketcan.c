@@ -0,0 +1,579 @@
+/**
+ * @file can_twai_backend_socketcan.c
+ * @brief Linux SocketCAN backend with batched socket I/O
+ *
+ * One CAN_RAW socket bound to the configured interface. Received frames are
+ * fetched with recvmmsg() into a buffer of RX_BATCH frames; single receives
+ * are served from that buffer, so a burst costs one system call instead of
+ * one per frame. can_twai_send_batch() maps to sendmmsg().
+ *
+ * The socket is never blocked on: waits are done in one-tick steps with
+ * vTaskDelay(), because a task blocked in a system call would stall the
+ * FreeRTOS POSIX port scheduler. Receive and transmit latency is therefore
+ * up to one tick.
+ *
+ * Mapping to the TWAI model:
+ * - bit timing is a property of the interface (ip link ... bitrate), the
+ *   timing configuration is ignored,
+ * - a single acceptance filter becomes one CAN_RAW_FILTER entry per frame
+ *   format; dual filter mode accepts all frames,
+ * - NO_ACK mode enables CAN_RAW_RECV_OWN_MSGS, so every sent frame is also
+ *   received (self-test), LISTEN_ONLY mode rejects transmission,
+ * - status and alerts come from error frames (CAN_RAW_ERR_FILTER) and the
+ *   socket drop counter (SO_RXQ_OVFL). They are collected while frames are
+ *   being received, so some task must receive for them to advance.
+ *
+ * The receive buffer is not locked: use one receiving task, as with the
+ * other receive consumers of the adapter.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#if defined(__linux__)
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // recvmmsg(), sendmmsg()
+#endif
+
+#include "can_twai_backend.h"
+#include "can_twai_priv.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_backend_socketcan";
+
+#define RX_BATCH         32  /**< Frames per recvmmsg() */
+#define TX_BATCH         32  /**< Frames per sendmmsg() */
+#define DEFAULT_IFNAME   "vcan0"
+
+/** @brief Error classes turned into status and alerts */
+#define ERR_CLASSES (CAN_ERR_TX_TIMEOUT | CAN_ERR_LOSTARB | CAN_ERR_CRTL | CAN_ERR_PROT | \
+                     CAN_ERR_TRX | CAN_ERR_ACK | CAN_ERR_BUSOFF | CAN_ERR_BUSERROR | CAN_ERR_RESTARTED)
+
+/** @brief Backend state */
+typedef struct {
+    int                fd;
+    char               ifname[IFNAMSIZ];
+    twai_mode_t        mode;
+    bool               running;
+
+    // Receive buffer, filled by recvmmsg()
+    struct can_frame   rx_raw[RX_BATCH];
+    struct iovec       rx_iov[RX_BATCH];
+    struct mmsghdr     rx_hdr[RX_BATCH];
+    union {
+        char           buf[CMSG_SPACE(sizeof(uint32_t))];
+        struct cmsghdr align;
+    }                  rx_ctrl[RX_BATCH];
+    twai_message_t     rx_msgs[RX_BATCH];
+    size_t             rx_head;
+    size_t             rx_count;
+
+    // Status and alerts
+    twai_status_info_t st;
+    uint32_t           alerts_enabled;
+    uint32_t           alerts_pending;
+} socketcan_t;
+
+static socketcan_t sc = { .fd = -1, .ifname = DEFAULT_IFNAME };
+static portMUX_TYPE sc_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool can_twai_socketcan_set_interface(const char *ifname)
+{
+    if (ifname == NULL || strlen(ifname) >= sizeof(sc.ifname)) {
+        ESP_LOGE(TAG, "Invalid interface name");
+        return false;
+    }
+    strcpy(sc.ifname, ifname);
+    return true;
+}
+
+/** @brief Raise alerts; caller holds sc_lock */
+static void raise_alerts(uint32_t alerts)
+{
+    sc.alerts_pending |= alerts & sc.alerts_enabled;
+}
+
+static void to_can_frame(const twai_message_t *msg, struct can_frame *f)
+{
+    memset(f, 0, sizeof(*f));
+    f->can_id = msg->extd ? (msg->identifier & CAN_EFF_MASK) | CAN_EFF_FLAG
+                          : msg->identifier & CAN_SFF_MASK;
+    if (msg->rtr) {
+        f->can_id |= CAN_RTR_FLAG;
+    }
+    f->can_dlc = msg->data_length_code;
+    if (!msg->rtr) {
+        memcpy(f->data, msg->data, msg->data_length_code);
+    }
+}
+
+static void from_can_frame(const struct can_frame *f, twai_message_t *msg)
+{
+    memset(msg, 0, sizeof(*msg));
+    msg->extd = (f->can_id & CAN_EFF_FLAG) != 0;
+    msg->rtr = (f->can_id & CAN_RTR_FLAG) != 0;
+    msg->identifier = f->can_id & (msg->extd ? CAN_EFF_MASK : CAN_SFF_MASK);
+    msg->data_length_code = f->can_dlc;
+    if (!msg->rtr) {
+        memcpy(msg->data, f->data, f->can_dlc <= CAN_MAX_DLEN ? f->can_dlc : CAN_MAX_DLEN);
+    }
+}
+
+/** @brief Translate an error frame into status counters and alerts */
+static void handle_error_frame(const struct can_frame *f)
+{
+    canid_t cls = f->can_id & CAN_ERR_MASK;
+    uint32_t alerts = 0;
+
+    portENTER_CRITICAL(&sc_lock);
+    if (cls & CAN_ERR_TX_TIMEOUT) {
+        sc.st.tx_failed_count++;
+        alerts |= TWAI_ALERT_TX_FAILED;
+    }
+    if (cls & CAN_ERR_LOSTARB) {
+        sc.st.arb_lost_count++;
+        alerts |= TWAI_ALERT_ARB_LOST;
+    }
+    if (cls & (CAN_ERR_PROT | CAN_ERR_BUSERROR | CAN_ERR_ACK | CAN_ERR_TRX)) {
+        sc.st.bus_error_count++;
+        alerts |= TWAI_ALERT_BUS_ERROR;
+    }
+    if (cls & CAN_ERR_CRTL) {
+        uint8_t ctrl = f->data[1];
+        if (ctrl & (CAN_ERR_CRTL_RX_OVERFLOW | CAN_ERR_CRTL_TX_OVERFLOW)) {
+            sc.st.rx_overrun_count += (ctrl & CAN_ERR_CRTL_RX_OVERFLOW) != 0;
+            alerts |= TWAI_ALERT_RX_FIFO_OVERRUN;
+        }
+        if (ctrl & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) {
+            alerts |= TWAI_ALERT_ABOVE_ERR_WARN;
+        }
+        if (ctrl & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) {
+            alerts |= TWAI_ALERT_ERR_PASS;
+        }
+#ifdef CAN_ERR_CRTL_ACTIVE
+        if (ctrl & CAN_ERR_CRTL_ACTIVE) {
+            alerts |= TWAI_ALERT_ERR_ACTIVE;
+        }
+#endif
+    }
+#ifdef CAN_ERR_CNT
+    if (cls & CAN_ERR_CNT) {
+        sc.st.tx_error_counter = f->data[6];
+        sc.st.rx_error_counter = f->data[7];
+    }
+#endif
+    if (cls & CAN_ERR_BUSOFF) {
+        sc.st.state = TWAI_STATE_BUS_OFF;
+        alerts |= TWAI_ALERT_BUS_OFF;
+    }
+    if (cls & CAN_ERR_RESTARTED) {
+        sc.st.state = sc.running ? TWAI_STATE_RUNNING : TWAI_STATE_STOPPED;
+        alerts |= TWAI_ALERT_BUS_RECOVERED;
+    }
+    raise_alerts(alerts);
+    portEXIT_CRITICAL(&sc_lock);
+}
+
+/** @brief Update the missed-frame counter from the socket drop count */
+static void handle_drop_count(struct msghdr *hdr)
+{
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(hdr); c != NULL; c = CMSG_NXTHDR(hdr, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SO_RXQ_OVFL) {
+            continue;
+        }
+        uint32_t dropped;
+        memcpy(&dropped, CMSG_DATA(c), sizeof(dropped));
+        portENTER_CRITICAL(&sc_lock);
+        if (dropped != sc.st.rx_missed_count) {
+            sc.st.rx_missed_count = dropped;  // cumulative since the socket was opened
+            raise_alerts(TWAI_ALERT_RX_QUEUE_FULL);
+        }
+        portEXIT_CRITICAL(&sc_lock);
+    }
+}
+
+/**
+ * @brief Refill the receive buffer with one recvmmsg()
+ *
+ * @return ESP_OK if data frames are buffered, ESP_ERR_TIMEOUT if none
+ *         arrived in time
+ */
+static esp_err_t fill_rx(TickType_t timeout)
+{
+    sc.rx_head = sc.rx_count = 0;
+    TickType_t start = xTaskGetTickCount();
+
+    for (;;) {
+        for (int i = 0; i < RX_BATCH; i++) {
+            sc.rx_hdr[i].msg_hdr.msg_controllen = sizeof(sc.rx_ctrl[i].buf);
+        }
+        int got = recvmmsg(sc.fd, sc.rx_hdr, RX_BATCH, MSG_DONTWAIT, NULL);
+        if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            ESP_LOGE(TAG, "recvmmsg failed: %s", strerror(errno));
+            return ESP_FAIL;
+        }
+
+        for (int i = 0; i < got; i++) {
+            handle_drop_count(&sc.rx_hdr[i].msg_hdr);
+            const struct can_frame *f = &sc.rx_raw[i];
+            if (sc.rx_hdr[i].msg_len < CAN_MTU) {
+                continue;  // CAN FD or truncated frame
+            }
+            if (f->can_id & CAN_ERR_FLAG) {
+                handle_error_frame(f);
+                continue;
+            }
+            from_can_frame(f, &sc.rx_msgs[sc.rx_count++]);
+        }
+        if (sc.rx_count > 0) {
+            return ESP_OK;
+        }
+
+        // Nothing yet (or only error frames): wait a tick unless out of time
+        if (got > 0) {
+            continue;
+        }
+        if (xTaskGetTickCount() - start >= timeout) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+    }
+}
+
+static esp_err_t socketcan_receive(twai_message_t *msg, TickType_t timeout)
+{
+    if (!sc.running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sc.rx_head == sc.rx_count) {
+        esp_err_t err = fill_rx(timeout);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    *msg = sc.rx_msgs[sc.rx_head++];
+    return ESP_OK;
+}
+
+static size_t socketcan_receive_batch(twai_message_t *msgs, size_t max, TickType_t timeout)
+{
+    if (!sc.running) {
+        return 0;
+    }
+    size_t n = 0;
+    while (n < max) {
+        // Only the first refill may wait
+        if (sc.rx_head == sc.rx_count && fill_rx(n == 0 ? timeout : 0) != ESP_OK) {
+            break;
+        }
+        size_t take = sc.rx_count - sc.rx_head;
+        if (take > max - n) {
+            take = max - n;
+        }
+        memcpy(&msgs[n], &sc.rx_msgs[sc.rx_head], take * sizeof(twai_message_t));
+        sc.rx_head += take;
+        n += take;
+    }
+    return n;
+}
+
+/** @brief Wait one tick for socket buffer space; false when out of time */
+static bool wait_tx_space(TickType_t start, TickType_t timeout)
+{
+    if (xTaskGetTickCount() - start >= timeout) {
+        return false;
+    }
+    vTaskDelay(1);
+    return true;
+}
+
+static bool tx_would_block(void)
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == EINTR;
+}
+
+static esp_err_t tx_state_check(void)
+{
+    if (!sc.running || sc.st.state == TWAI_STATE_BUS_OFF) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sc.mode == TWAI_MODE_LISTEN_ONLY) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t socketcan_transmit(const twai_message_t *msg, TickType_t timeout)
+{
+    esp_err_t err = tx_state_check();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    struct can_frame f;
+    to_can_frame(msg, &f);
+    TickType_t start = xTaskGetTickCount();
+    while (send(sc.fd, &f, sizeof(f), MSG_DONTWAIT) != sizeof(f)) {
+        if (!tx_would_block()) {
+            ESP_LOGE(TAG, "send failed: %s", strerror(errno));
+            return ESP_FAIL;
+        }
+        if (!wait_tx_space(start, timeout)) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    return ESP_OK;
+}
+
+static size_t socketcan_transmit_batch(const twai_message_t *msgs, size_t count, TickType_t timeout)
+{
+    if (tx_state_check() != ESP_OK) {
+        return 0;
+    }
+
+    struct can_frame frames[TX_BATCH];
+    struct iovec iov[TX_BATCH];
+    struct mmsghdr hdr[TX_BATCH];
+    size_t sent = 0;
+    TickType_t start = xTaskGetTickCount();
+
+    while (sent < count) {
+        size_t chunk = count - sent < TX_BATCH ? count - sent : TX_BATCH;
+        for (size_t i = 0; i < chunk; i++) {
+            to_can_frame(&msgs[sent + i], &frames[i]);
+            iov[i].iov_base = &frames[i];
+            iov[i].iov_len = sizeof(frames[i]);
+            memset(&hdr[i], 0, sizeof(hdr[i]));
+            hdr[i].msg_hdr.msg_iov = &iov[i];
+            hdr[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int done = sendmmsg(sc.fd, hdr, (unsigned)chunk, MSG_DONTWAIT);
+        if (done > 0) {
+            sent += (size_t)done;
+            start = xTaskGetTickCount();  // the timeout applies per frame
+            continue;
+        }
+        if (done < 0 && !tx_would_block()) {
+            ESP_LOGE(TAG, "sendmmsg failed: %s", strerror(errno));
+            break;
+        }
+        if (!wait_tx_space(start, timeout)) {
+            break;
+        }
+    }
+    return sent;
+}
+
+/** @brief Map the TWAI acceptance filter to CAN_RAW_FILTER */
+static void apply_filter(const twai_filter_config_t *flt)
+{
+    if (flt->acceptance_mask == 0xFFFFFFFFu) {
+        return;  // accept all, the socket default
+    }
+    if (!flt->single_filter) {
+        ESP_LOGW(TAG, "Dual filter mode is not mapped, accepting all frames");
+        return;
+    }
+
+    // TWAI mask bits set = don't care; identifiers are left-aligned
+    uint32_t code = flt->acceptance_code;
+    uint32_t care = ~flt->acceptance_mask;
+    struct can_filter f[2] = {
+        {
+            .can_id   = (code >> 21) & CAN_SFF_MASK,
+            .can_mask = ((care >> 21) & CAN_SFF_MASK) | CAN_EFF_FLAG,
+        },
+        {
+            .can_id   = ((code >> 3) & CAN_EFF_MASK) | CAN_EFF_FLAG,
+            .can_mask = ((care >> 3) & CAN_EFF_MASK) | CAN_EFF_FLAG,
+        },
+    };
+    if (setsockopt(sc.fd, SOL_CAN_RAW, CAN_RAW_FILTER, f, sizeof(f)) != 0) {
+        ESP_LOGW(TAG, "Failed to set filter: %s", strerror(errno));
+    }
+}
+
+static esp_err_t socketcan_init(const twai_backend_config_t *cfg)
+{
+    if (sc.fd >= 0) {
+        ESP_LOGE(TAG, "Backend already initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to open CAN socket: %s", strerror(errno));
+        return ESP_FAIL;
+    }
+
+    unsigned ifindex = if_nametoindex(sc.ifname);
+    if (ifindex == 0) {
+        ESP_LOGE(TAG, "Interface %s not found", sc.ifname);
+        close(fd);
+        return ESP_ERR_NOT_FOUND;
+    }
+    struct sockaddr_can addr = { .can_family = AF_CAN, .can_ifindex = (int)ifindex };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "Failed to bind to %s: %s", sc.ifname, strerror(errno));
+        close(fd);
+        return ESP_FAIL;
+    }
+
+    int on = 1;
+    can_err_mask_t err_mask = ERR_CLASSES;
+    setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+    setsockopt(fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask));
+    if (cfg->params.mode == TWAI_MODE_NO_ACK) {
+        setsockopt(fd, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &on, sizeof(on));
+    }
+    if (cfg->params.rx_queue_len > 0) {
+        // Socket buffers are accounted per skb; reserve generously per frame
+        int rcvbuf = cfg->params.rx_queue_len * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    char ifname[IFNAMSIZ];
+    strcpy(ifname, sc.ifname);
+    memset(&sc, 0, sizeof(sc));
+    strcpy(sc.ifname, ifname);
+    sc.fd = fd;
+    sc.mode = cfg->params.mode;
+    for (int i = 0; i < RX_BATCH; i++) {
+        sc.rx_iov[i].iov_base = &sc.rx_raw[i];
+        sc.rx_iov[i].iov_len = sizeof(sc.rx_raw[i]);
+        sc.rx_hdr[i].msg_hdr.msg_iov = &sc.rx_iov[i];
+        sc.rx_hdr[i].msg_hdr.msg_iovlen = 1;
+        sc.rx_hdr[i].msg_hdr.msg_control = sc.rx_ctrl[i].buf;
+    }
+    apply_filter(&cfg->tf.filter);
+
+    sc.alerts_enabled = cfg->params.alerts_enabled;
+    sc.st.state = TWAI_STATE_RUNNING;
+    sc.running = true;
+    ESP_LOGI(TAG, "Bound to %s (bit timing is set on the interface)", sc.ifname);
+    return ESP_OK;
+}
+
+static esp_err_t socketcan_deinit(void)
+{
+    if (sc.fd < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    close(sc.fd);
+    sc.fd = -1;
+    sc.running = false;
+    sc.st.state = TWAI_STATE_STOPPED;
+    return ESP_OK;
+}
+
+static esp_err_t socketcan_start(void)
+{
+    if (sc.fd < 0 || sc.running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sc.running = true;
+    sc.st.state = TWAI_STATE_RUNNING;
+    return ESP_OK;
+}
+
+static esp_err_t socketcan_stop(void)
+{
+    if (!sc.running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sc.running = false;
+    sc.st.state = TWAI_STATE_STOPPED;
+    sc.rx_head = sc.rx_count = 0;
+    return ESP_OK;
+}
+
+static esp_err_t socketcan_get_status(twai_status_info_t *status)
+{
+    if (sc.fd < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&sc_lock);
+    *status = sc.st;
+    portEXIT_CRITICAL(&sc_lock);
+    // Only frames already fetched from the socket are known
+    status->msgs_to_rx = (uint32_t)(sc.rx_count - sc.rx_head);
+    return ESP_OK;
+}
+
+static esp_err_t socketcan_recover(void)
+{
+    if (sc.st.state != TWAI_STATE_BUS_OFF) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // The kernel restarts the controller (restart-ms or "ip link ... restart")
+    // and reports it with CAN_ERR_RESTARTED
+    portENTER_CRITICAL(&sc_lock);
+    sc.st.state = TWAI_STATE_RECOVERING;
+    raise_alerts(TWAI_ALERT_RECOVERY_IN_PROGRESS);
+    portEXIT_CRITICAL(&sc_lock);
+    return ESP_OK;
+}
+
+static esp_err_t socketcan_read_alerts(uint32_t *alerts, TickType_t timeout)
+{
+    if (sc.fd < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        portENTER_CRITICAL(&sc_lock);
+        *alerts = sc.alerts_pending;
+        sc.alerts_pending = 0;
+        portEXIT_CRITICAL(&sc_lock);
+        if (*alerts != 0) {
+            return ESP_OK;
+        }
+        if (xTaskGetTickCount() - start >= timeout) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+    }
+}
+
+static esp_err_t socketcan_reconfigure_alerts(uint32_t alerts_enabled, uint32_t *current_alerts)
+{
+    portENTER_CRITICAL(&sc_lock);
+    if (current_alerts != NULL) {
+        *current_alerts = sc.alerts_pending;
+    }
+    sc.alerts_enabled = alerts_enabled;
+    sc.alerts_pending &= alerts_enabled;
+    portEXIT_CRITICAL(&sc_lock);
+    return ESP_OK;
+}
+
+const can_twai_backend_t can_twai_backend_socketcan = {
+    .name               = "SocketCAN",
+    .init               = socketcan_init,
+    .deinit             = socketcan_deinit,
+    .start              = socketcan_start,
+    .stop               = socketcan_stop,
+    .transmit           = socketcan_transmit,
+    .transmit_batch     = socketcan_transmit_batch,
+    .receive            = socketcan_receive,
+    .receive_batch      = socketcan_receive_batch,
+    .get_status         = socketcan_get_status,
+    .recover            = socketcan_recover,
+    .read_alerts        = socketcan_read_alerts,
+    .reconfigure_alerts = socketcan_reconfigure_alerts,
+};
+
+#endif // __linux__
@@ -0,0 +1,106 @@
+/**
+ * @file can_twai_backend_twai.c
+ * @brief ESP-IDF TWAI driver backend
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_backend.h"
+#include "can_twai_priv.h"
+#include "esp_log.h"
+#include "esp_intr_alloc.h"
+#include "driver/twai.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_backend_twai";
+
+static esp_err_t twai_backend_init(const twai_backend_config_t *cfg)
+{
+    // Build general config from split config
+    twai_general_config_t g = {
+        .controller_id  = cfg->params.controller_id,
+        .mode           = cfg->params.mode,
+        .tx_io          = cfg->wiring.tx_gpio,
+        .rx_io          = cfg->wiring.rx_gpio,
+        .clkout_io      = cfg->wiring.clkout_io,
+        .bus_off_io     = cfg->wiring.bus_off_io,
+        .tx_queue_len   = cfg->params.tx_queue_len,
+        .rx_queue_len   = cfg->params.rx_queue_len,
+        .alerts_enabled = cfg->params.alerts_enabled,
+        .clkout_divider = cfg->params.clkout_divider,
+        .intr_flags     = cfg->params.intr_flags,
+        .general_flags  = {0},
+    };
+
+#if CONFIG_CAN_TWAI_IRAM_HOT_PATH
+    // Keep the driver ISR serviceable while the flash cache is disabled and
+    // give the RX queue enough depth to bridge a flash erase/write
+    g.intr_flags |= ESP_INTR_FLAG_IRAM;
+    if (g.rx_queue_len < CONFIG_CAN_TWAI_IRAM_MIN_RX_QUEUE_LEN) {
+        ESP_LOGD(TAG, "  RX queue raised from %lu to %d", (unsigned long)g.rx_queue_len,
+                 CONFIG_CAN_TWAI_IRAM_MIN_RX_QUEUE_LEN);
+        g.rx_queue_len = CONFIG_CAN_TWAI_IRAM_MIN_RX_QUEUE_LEN;
+    }
+#endif
+
+    // Install TWAI driver with provided configuration
+    esp_err_t err = twai_driver_install(&g, &cfg->tf.timing, &cfg->tf.filter);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install TWAI driver: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Start TWAI driver
+    err = twai_start();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start TWAI: %s", esp_err_to_name(err));
+        twai_driver_uninstall();
+    }
+    return err;
+}
+
+static esp_err_t twai_backend_deinit(void)
+{
+    esp_err_t err = twai_stop();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to stop TWAI: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = twai_driver_uninstall();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to uninstall TWAI driver: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static CAN_TWAI_HOT_ATTR esp_err_t twai_backend_transmit(const twai_message_t *msg, TickType_t timeout)
+{
+    return twai_transmit(msg, timeout);
+}
+
+static CAN_TWAI_HOT_ATTR esp_err_t twai_backend_receive(twai_message_t *msg, TickType_t timeout)
+{
+    return twai_receive(msg, timeout);
+}
+
+/** @brief Driver functions used as they are; batches fall back to single frames */
+const can_twai_backend_t can_twai_backend_twai = {
+    .name               = "TWAI",
+    .init               = twai_backend_init,
+    .deinit             = twai_backend_deinit,
+    .start              = twai_start,
+    .stop               = twai_stop,
+    .transmit           = twai_backend_transmit,
+    .transmit_batch     = NULL,
+    .receive            = twai_backend_receive,
+    .receive_batch      = NULL,
+    .get_status         = twai_get_status_info,
+    .recover            = twai_initiate_recovery,
+    .read_alerts        = twai_read_alerts,
+    .reconfigure_alerts = twai_reconfigure_alerts,
+};
+
+#endif // !CONFIG_IDF_TARGET_LINUX
@@ -0,0 +1,256 @@
+/**
+ * @file can_twai_burst.c
+ * @brief Contiguous TX burst groups
+ *
+ * The gate is a recursive mutex installed with can_twai_set_tx_gate(). A
+ * burst takes it once more around the whole group, so the frames of the
+ * group pass their own can_twai_send() gate immediately while every other
+ * task waits. Only the holder changes the nesting depth, so a task that
+ * just acquired the gate always sees depth 0 unless it is the holder. The
+ * gate also counts the holder's frames and refuses those beyond max_frames,
+ * whether they come from can_twai_burst_send() or from can_twai_send()
+ * between begin and end.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_burst.h"
+#include "can_twai.h"
+#include "can_twai_priv.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_burst";
+
+#define DEFAULT_MAX_FRAMES 16
+
+/** @brief Module state */
+typedef struct {
+    SemaphoreHandle_t      gate;
+    TaskHandle_t           holder;       /**< Task inside a burst, NULL if none */
+    size_t                 max_frames;
+    uint32_t               depth;        /**< Burst nesting of the holder */
+    uint32_t               frames;       /**< Frames sent in the current burst */
+    int64_t                hold_since_us;
+    uint64_t               hold_sum_us;
+    can_twai_burst_stats_t st;
+    bool                   running;
+} burst_t;
+
+static burst_t bu;
+static portMUX_TYPE bu_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/** @brief Acquire the gate, accounting contention */
+static bool take_gate(TickType_t timeout)
+{
+    if (xSemaphoreTakeRecursive(bu.gate, 0) == pdTRUE) {
+        return true;
+    }
+
+    int64_t start = esp_timer_get_time();
+    bool ok = timeout > 0 && xSemaphoreTakeRecursive(bu.gate, timeout) == pdTRUE;
+    int64_t waited = esp_timer_get_time() - start;
+
+    portENTER_CRITICAL(&bu_lock);
+    bu.st.contended++;
+    bu.st.timeouts += !ok;
+    if (waited > bu.st.wait_max_us) {
+        bu.st.wait_max_us = (uint32_t)waited;
+    }
+    portEXIT_CRITICAL(&bu_lock);
+    return ok;
+}
+
+static CAN_TWAI_HOT_ATTR bool burst_gate(bool enter, TickType_t timeout)
+{
+    if (!enter) {
+        xSemaphoreGiveRecursive(bu.gate);
+        return true;
+    }
+    if (!take_gate(timeout)) {
+        return false;
+    }
+    if (bu.depth > 0) {
+        // Only the holder gets here with depth > 0
+        if (bu.frames >= bu.max_frames) {
+            xSemaphoreGiveRecursive(bu.gate);
+            portENTER_CRITICAL(&bu_lock);
+            bu.st.over_budget++;
+            portEXIT_CRITICAL(&bu_lock);
+            return false;
+        }
+        bu.frames++;
+    }
+    return true;
+}
+
+/** @brief Wait until the driver TX queue has room for @p count frames (gate held) */
+static bool wait_tx_room(size_t count, TickType_t timeout)
+{
+    int len = can_twai_get_tx_queue_len();
+    if (len <= 0) {
+        return true;  // backend without a TX queue
+    }
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        twai_status_info_t status;
+        if (!can_twai_get_status(&status)) {
+            return false;
+        }
+        if (status.msgs_to_tx <= (uint32_t)len && (uint32_t)len - status.msgs_to_tx >= count) {
+            return true;
+        }
+        if (xTaskGetTickCount() - start >= timeout) {
+            ESP_LOGW(TAG, "TX queue has %lu of %d slots free, burst of %u not started",
+                     (unsigned long)(len - (int)status.msgs_to_tx), len, (unsigned)count);
+            return false;
+        }
+        vTaskDelay(1);
+    }
+}
+
+bool can_twai_burst_init(const can_twai_burst_config_t *cfg)
+{
+    if (bu.running) {
+        ESP_LOGE(TAG, "Burst groups already initialized");
+        return false;
+    }
+
+    memset(&bu, 0, sizeof(bu));
+    bu.max_frames = cfg != NULL && cfg->max_frames ? cfg->max_frames : DEFAULT_MAX_FRAMES;
+    bu.gate = xSemaphoreCreateRecursiveMutex();
+    if (bu.gate == NULL) {
+        ESP_LOGE(TAG, "Failed to create transmit gate");
+        return false;
+    }
+    bu.running = true;
+    can_twai_set_tx_gate(burst_gate);
+    return true;
+}
+
+void can_twai_burst_deinit(void)
+{
+    if (!bu.running) {
+        return;
+    }
+    if (bu.holder == xTaskGetCurrentTaskHandle()) {
+        ESP_LOGE(TAG, "Deinit inside a burst, call can_twai_burst_end() first");
+        return;
+    }
+    // No new bursts; the gate hook is gone once in-flight sends have passed it
+    bu.running = false;
+    can_twai_set_tx_gate(NULL);
+    // Wait for a burst that is still open
+    xSemaphoreTakeRecursive(bu.gate, portMAX_DELAY);
+    xSemaphoreGiveRecursive(bu.gate);
+
+    if (bu.st.contended > 0) {
+        ESP_LOGI(TAG, "Senders waited %lu times, longest %lu us; longest burst hold %lu us",
+                 (unsigned long)bu.st.contended, (unsigned long)bu.st.wait_max_us,
+                 (unsigned long)bu.st.hold_max_us);
+    }
+    vSemaphoreDelete(bu.gate);
+    memset(&bu, 0, sizeof(bu));
+}
+
+bool can_twai_burst_begin(TickType_t timeout)
+{
+    if (!bu.running) {
+        ESP_LOGE(TAG, "Burst groups not initialized");
+        return false;
+    }
+    if (!take_gate(timeout)) {
+        ESP_LOGW(TAG, "Transmit path busy, burst not started");
+        return false;
+    }
+    if (bu.depth++ == 0) {
+        bu.holder = xTaskGetCurrentTaskHandle();
+        bu.frames = 0;
+        bu.hold_since_us = esp_timer_get_time();
+    }
+    return true;
+}
+
+void can_twai_burst_end(void)
+{
+    if (bu.depth == 0 || bu.holder != xTaskGetCurrentTaskHandle()) {
+        ESP_LOGE(TAG, "can_twai_burst_end() without a matching begin in this task");
+        return;
+    }
+    if (--bu.depth == 0) {
+        bu.holder = NULL;
+        int64_t held = esp_timer_get_time() - bu.hold_since_us;
+        portENTER_CRITICAL(&bu_lock);
+        bu.st.bursts++;
+        bu.st.burst_frames += bu.frames;
+        bu.hold_sum_us += held;
+        if (held > bu.st.hold_max_us) {
+            bu.st.hold_max_us = (uint32_t)held;
+        }
+        portEXIT_CRITICAL(&bu_lock);
+    }
+    xSemaphoreGiveRecursive(bu.gate);
+}
+
+bool can_twai_burst_send(const twai_message_t *msgs, size_t count, TickType_t timeout, size_t *sent)
+{
+    size_t n = 0;
+    if (sent != NULL) {
+        *sent = 0;
+    }
+    if (msgs == NULL || count == 0 || count > bu.max_frames) {
+        ESP_LOGE(TAG, "Invalid burst of %u frames (max %u)", (unsigned)count, (unsigned)bu.max_frames);
+        return false;
+    }
+    if (!can_twai_burst_begin(timeout)) {
+        return false;
+    }
+    // Nothing is sent unless the whole group fits; other senders are held off meanwhile
+    if (bu.frames + count > bu.max_frames || !wait_tx_room(count, timeout)) {
+        portENTER_CRITICAL(&bu_lock);
+        bu.st.failed++;
+        portEXIT_CRITICAL(&bu_lock);
+        can_twai_burst_end();
+        return false;
+    }
+    while (n < count && can_twai_send_timeout(&msgs[n], timeout)) {
+        n++;
+    }
+    if (n < count) {
+        portENTER_CRITICAL(&bu_lock);
+        bu.st.failed++;
+        portEXIT_CRITICAL(&bu_lock);
+        ESP_LOGW(TAG, "Burst incomplete: %u of %u frames queued", (unsigned)n, (unsigned)count);
+    }
+    can_twai_burst_end();
+
+    if (sent != NULL) {
+        *sent = n;
+    }
+    return n == count;
+}
+
+void can_twai_burst_get_stats(can_twai_burst_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&bu_lock);
+    *out = bu.st;
+    out->hold_avg_us = bu.st.bursts ? (uint32_t)(bu.hold_sum_us / bu.st.bursts) : 0;
+    portEXIT_CRITICAL(&bu_lock);
+}
+
+void can_twai_burst_reset_stats(void)
+{
+    portENTER_CRITICAL(&bu_lock);
+    memset(&bu.st, 0, sizeof(bu.st));
+    bu.hold_sum_us = 0;
+    portEXIT_CRITICAL(&bu_lock);
+}
@@ -0,0 +1,366 @@
+/**
+ * @file can_twai_cantop.c
+ * @brief Live per-ID traffic table ("cantop")
+ *
+ * Slots are keyed by (identifier + 1) with bit 31 marking extended IDs, so
+ * key 0 means an empty slot and ID 0 stays valid. The slot index is a
+ * multiplicative hash of the key; collisions probe linearly. Because the
+ * load is capped at 7/8 and rows are never deleted, a lookup always ends at
+ * the matching or at an empty slot.
+ *
+ * The inter-arrival time is smoothed with an exponential moving average
+ * (weight 1/8, kept in 1/16 us). The reported rate uses the time since the
+ * last frame instead once that is longer, so a silent ID decays towards 0.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_cantop.h"
+#include "can_twai_priv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_cantop";
+
+#define DEFAULT_CAPACITY 256
+#define KEY_EXTD         0x80000000u
+#define EWMA_SHIFT       3      /**< Smoothing weight 1/8 */
+#define EWMA_FRAC        4      /**< EWMA kept in 1/16 us */
+#define SNAPSHOT_CHUNK   8      /**< Slots copied per critical section */
+
+/** @brief One table slot */
+typedef struct {
+    uint32_t key;           /**< (identifier + 1) | KEY_EXTD, 0 = empty */
+    uint32_t count;
+    int64_t  first_us;
+    int64_t  last_us;
+    uint32_t min_iv_us;
+    uint32_t max_iv_us;
+    uint32_t ewma_iv;       /**< Smoothed interval in 1/16 us */
+    uint8_t  dlc;
+    uint8_t  rtr;
+    uint8_t  data[8];
+} slot_t;
+
+/** @brief Module state */
+typedef struct {
+    slot_t  *slots;
+    slot_t  *scratch;       /**< Snapshot copy of slots */
+    uint32_t mask;          /**< Capacity - 1 */
+    uint32_t shift;         /**< 32 - log2(capacity) */
+    uint32_t used;
+    uint32_t limit;         /**< Maximum number of used slots (7/8 load) */
+    uint32_t overflow;
+    bool     hooked;
+    bool     running;
+} cantop_t;
+
+static cantop_t top;
+static portMUX_TYPE top_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t slot_index(uint32_t key)
+{
+    return (key * 0x9E3779B1u) >> top.shift;
+}
+
+void CAN_TWAI_HOT_ATTR can_twai_cantop_update(const twai_message_t *msg, int64_t time_us)
+{
+    uint32_t key = (msg->identifier + 1) | (msg->extd ? KEY_EXTD : 0);
+    uint8_t dlc = msg->data_length_code > 8 ? 8 : msg->data_length_code;
+
+    portENTER_CRITICAL(&top_lock);
+    if (!top.running) {
+        portEXIT_CRITICAL(&top_lock);
+        return;
+    }
+
+    uint32_t i = slot_index(key);
+    while (top.slots[i].key != key && top.slots[i].key != 0) {
+        i = (i + 1) & top.mask;
+    }
+    slot_t *s = &top.slots[i];
+
+    if (s->key == 0) {
+        if (top.used >= top.limit) {
+            top.overflow++;
+            portEXIT_CRITICAL(&top_lock);
+            return;
+        }
+        top.used++;
+        s->key = key;
+        s->first_us = time_us;
+        s->min_iv_us = UINT32_MAX;
+    } else {
+        int64_t d = time_us - s->last_us;
+        uint32_t iv = d <= 0 ? 0 : d >= UINT32_MAX >> EWMA_FRAC ? UINT32_MAX >> EWMA_FRAC : (uint32_t)d;
+        if (iv < s->min_iv_us) {
+            s->min_iv_us = iv;
+        }
+        if (iv > s->max_iv_us) {
+            s->max_iv_us = iv;
+        }
+        if (s->count == 1) {
+            s->ewma_iv = iv << EWMA_FRAC;
+        } else {
+            s->ewma_iv = s->ewma_iv - (s->ewma_iv >> EWMA_SHIFT) + ((iv << EWMA_FRAC) >> EWMA_SHIFT);
+        }
+    }
+    s->count++;
+    s->last_us = time_us;
+    s->dlc = dlc;
+    s->rtr = msg->rtr;
+    if (!msg->rtr) {
+        memcpy(s->data, msg->data, dlc);
+    }
+    portEXIT_CRITICAL(&top_lock);
+}
+
+static bool CAN_TWAI_HOT_ATTR cantop_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    (void)ctx;
+    can_twai_cantop_update(msg, rx_time_us);
+    return true;
+}
+
+static void fill_entry(can_twai_cantop_entry_t *e, const slot_t *s, int64_t now_us)
+{
+    memset(e, 0, sizeof(*e));
+    e->extd = (s->key & KEY_EXTD) != 0;
+    e->identifier = (s->key & ~KEY_EXTD) - 1;
+    e->count = s->count;
+    e->dlc = s->dlc;
+    e->rtr = s->rtr;
+    memcpy(e->data, s->data, sizeof(e->data));
+
+    int64_t age = now_us - s->last_us;
+    e->age_us = age <= 0 ? 0 : age >= UINT32_MAX ? UINT32_MAX : (uint32_t)age;
+    if (s->count < 2) {
+        return;
+    }
+    e->min_interval_us = s->min_iv_us;
+    e->max_interval_us = s->max_iv_us;
+    e->mean_interval_us = (uint32_t)((s->last_us - s->first_us) / (s->count - 1));
+
+    float iv = (float)s->ewma_iv / (1 << EWMA_FRAC);
+    if ((float)e->age_us > iv) {
+        iv = (float)e->age_us;
+    }
+    e->rate_hz = iv > 0.0f ? 1e6f / iv : 0.0f;
+}
+
+static int cmp_id(const can_twai_cantop_entry_t *x, const can_twai_cantop_entry_t *y)
+{
+    if (x->extd != y->extd) {
+        return x->extd - y->extd;
+    }
+    return (x->identifier > y->identifier) - (x->identifier < y->identifier);
+}
+
+static int cmp_by_id(const void *a, const void *b)
+{
+    return cmp_id(a, b);
+}
+
+static int cmp_by_rate(const void *a, const void *b)
+{
+    const can_twai_cantop_entry_t *x = a;
+    const can_twai_cantop_entry_t *y = b;
+    if (x->rate_hz != y->rate_hz) {
+        return x->rate_hz < y->rate_hz ? 1 : -1;
+    }
+    return cmp_id(x, y);
+}
+
+static int cmp_by_count(const void *a, const void *b)
+{
+    const can_twai_cantop_entry_t *x = a;
+    const can_twai_cantop_entry_t *y = b;
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    return cmp_id(x, y);
+}
+
+bool can_twai_cantop_init(const can_twai_cantop_config_t *cfg)
+{
+    if (top.running) {
+        ESP_LOGE(TAG, "Traffic table already running");
+        return false;
+    }
+
+    size_t want = cfg != NULL && cfg->capacity ? cfg->capacity : DEFAULT_CAPACITY;
+    uint32_t bits = 3;
+    while (((size_t)1 << bits) < want && bits < 16) {
+        bits++;
+    }
+    size_t capacity = (size_t)1 << bits;
+
+    memset(&top, 0, sizeof(top));
+    top.slots = can_twai_hot_calloc(capacity, sizeof(slot_t));
+    top.scratch = calloc(capacity, sizeof(slot_t));
+    if (top.slots == NULL || top.scratch == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        goto fail;
+    }
+    top.mask = capacity - 1;
+    top.shift = 32 - bits;
+    top.limit = capacity - capacity / 8;
+
+    if (cfg != NULL && cfg->hook_receive) {
+        if (!can_twai_register_rx_hook(cantop_rx_hook, NULL)) {
+            goto fail;
+        }
+        top.hooked = true;
+    }
+
+    portENTER_CRITICAL(&top_lock);
+    top.running = true;
+    portEXIT_CRITICAL(&top_lock);
+    ESP_LOGI(TAG, "Traffic table: %u slots, up to %lu IDs", (unsigned)capacity, (unsigned long)top.limit);
+    return true;
+
+fail:
+    free(top.slots);
+    free(top.scratch);
+    memset(&top, 0, sizeof(top));
+    return false;
+}
+
+void can_twai_cantop_deinit(void)
+{
+    if (!top.running) {
+        return;
+    }
+    if (top.hooked) {
+        can_twai_unregister_rx_hook(cantop_rx_hook, NULL);
+    }
+    portENTER_CRITICAL(&top_lock);
+    top.running = false;
+    portEXIT_CRITICAL(&top_lock);
+
+    if (top.overflow > 0) {
+        ESP_LOGW(TAG, "%lu frames of IDs beyond table capacity", (unsigned long)top.overflow);
+    }
+    free(top.slots);
+    free(top.scratch);
+    memset(&top, 0, sizeof(top));
+}
+
+size_t can_twai_cantop_snapshot(can_twai_cantop_entry_t *out, size_t max, can_twai_cantop_sort_t sort)
+{
+    if (!top.running || out == NULL || max == 0) {
+        return 0;
+    }
+
+    // Copy a few slots per lock so the RX hook waits for at most one chunk;
+    // convert and sort outside of it
+    for (uint32_t i = 0; i <= top.mask; i += SNAPSHOT_CHUNK) {
+        portENTER_CRITICAL(&top_lock);
+        memcpy(&top.scratch[i], &top.slots[i], SNAPSHOT_CHUNK * sizeof(slot_t));
+        portEXIT_CRITICAL(&top_lock);
+    }
+    int64_t now = esp_timer_get_time();
+
+    size_t n = 0;
+    for (uint32_t i = 0; i <= top.mask; i++) {
+        if (top.scratch[i].key != 0) {
+            n++;
+        }
+    }
+    can_twai_cantop_entry_t *rows = out;
+    if (n > max) {
+        rows = malloc(n * sizeof(*rows));
+        if (rows == NULL) {
+            ESP_LOGE(TAG, "Out of memory");
+            return 0;
+        }
+    }
+    size_t k = 0;
+    for (uint32_t i = 0; i <= top.mask; i++) {
+        if (top.scratch[i].key != 0) {
+            fill_entry(&rows[k++], &top.scratch[i], now);
+        }
+    }
+
+    int (*cmp)(const void *, const void *) = sort == CAN_TWAI_CANTOP_BY_ID    ? cmp_by_id
+                                            : sort == CAN_TWAI_CANTOP_BY_COUNT ? cmp_by_count
+                                                                               : cmp_by_rate;
+    qsort(rows, n, sizeof(*rows), cmp);
+    if (rows != out) {
+        memcpy(out, rows, max * sizeof(*rows));
+        free(rows);
+        n = max;
+    }
+    return n;
+}
+
+size_t can_twai_cantop_id_count(void)
+{
+    portENTER_CRITICAL(&top_lock);
+    size_t n = top.used;
+    portEXIT_CRITICAL(&top_lock);
+    return n;
+}
+
+uint32_t can_twai_cantop_overflow(void)
+{
+    portENTER_CRITICAL(&top_lock);
+    uint32_t n = top.overflow;
+    portEXIT_CRITICAL(&top_lock);
+    return n;
+}
+
+void can_twai_cantop_reset(void)
+{
+    portENTER_CRITICAL(&top_lock);
+    if (top.running) {
+        memset(top.slots, 0, (top.mask + 1) * sizeof(slot_t));
+        top.used = 0;
+        top.overflow = 0;
+    }
+    portEXIT_CRITICAL(&top_lock);
+}
+
+void can_twai_cantop_log(size_t rows)
+{
+    if (!top.running) {
+        ESP_LOGW(TAG, "Traffic table not running");
+        return;
+    }
+
+    size_t max = rows ? rows : top.limit;
+    can_twai_cantop_entry_t *tab = malloc(max * sizeof(*tab));
+    if (tab == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        return;
+    }
+    size_t n = can_twai_cantop_snapshot(tab, max, CAN_TWAI_CANTOP_BY_RATE);
+
+    ESP_LOGI(TAG, "      ID |  frames |    rate Hz | iv min/mean/max us | age ms | dlc | data");
+    for (size_t i = 0; i < n; i++) {
+        const can_twai_cantop_entry_t *e = &tab[i];
+        char data[3 * 8 + 1] = "";
+        if (e->rtr) {
+            strcpy(data, "RTR");
+        } else {
+            for (int b = 0; b < e->dlc; b++) {
+                snprintf(&data[3 * b], sizeof(data) - 3 * b, "%02X ", e->data[b]);
+            }
+        }
+        ESP_LOGI(TAG, "%8lX%c| %7lu | %10.1f | %lu/%lu/%lu | %6lu | %3u | %s",
+                 (unsigned long)e->identifier, e->extd ? 'x' : ' ', (unsigned long)e->count,
+                 (double)e->rate_hz, (unsigned long)e->min_interval_us, (unsigned long)e->mean_interval_us,
+                 (unsigned long)e->max_interval_us, (unsigned long)(e->age_us / 1000), e->dlc, data);
+    }
+    uint32_t overflow = can_twai_cantop_overflow();
+    if (overflow > 0) {
+        ESP_LOGW(TAG, "%lu frames of IDs beyond table capacity", (unsigned long)overflow);
+    }
+    free(tab);
+}
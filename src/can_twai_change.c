@@ -0,0 +1,252 @@
+/**
+ * @file can_twai_change.c
+ * @brief Per-ID payload change detection with signal deadbands
+ *
+ * The payload is held as two 32-bit words (bytes beyond DLC are zero), so
+ * the mask comparison costs two XOR/AND pairs per frame. Deadband signals
+ * are compared against the value last delivered to subscribers.
+ *
+ * Suppression only hides the frame from the application: the hook always
+ * passes it on, so hooks registered later still see every frame, and the
+ * delivery filter that runs after all hooks drops it from
+ * can_twai_receive().
+ *
+ * Statistics are per-entry counters written only by the receive path (the
+ * entry state already assumes one receiving task per ID), so a frame never
+ * takes a lock; can_twai_change_get_stats() sums them with relaxed loads.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_change.h"
+#include "can_twai_priv.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_change";
+
+/** @brief Runtime state of one monitored ID */
+typedef struct {
+    can_twai_change_config_t cfg;
+    can_twai_signal_t        signals[CAN_TWAI_CHANGE_MAX_SIGNALS];
+    uint32_t                 mask[2];                                  /**< cfg.mask split in words */
+    uint32_t                 last[2];                                  /**< Last notified payload */
+    int64_t                  last_signal[CAN_TWAI_CHANGE_MAX_SIGNALS]; /**< Last notified signal values */
+    uint8_t                  last_dlc;
+    bool                     seen;
+    bool                     hide;        /**< Last frame unchanged and suppressed */
+    _Atomic uint32_t         checked;     /**< Frames of this ID */
+    _Atomic uint32_t         changed;     /**< Frames that triggered a notification */
+    _Atomic uint32_t         suppressed;  /**< Unchanged frames kept from the application */
+} change_entry_t;
+
+/** @brief Entries sorted by identifier */
+static change_entry_t *entries_tab = NULL;
+static size_t entry_count = 0;
+
+
+static int cmp_entry(const void *a, const void *b)
+{
+    uint32_t x = ((const change_entry_t *)a)->cfg.identifier;
+    uint32_t y = ((const change_entry_t *)b)->cfg.identifier;
+    return (x > y) - (x < y);
+}
+
+static CAN_TWAI_HOT_ATTR change_entry_t *find_entry(uint32_t identifier)
+{
+    size_t lo = 0;
+    size_t hi = entry_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t key = entries_tab[mid].cfg.identifier;
+        if (key == identifier) {
+            return &entries_tab[mid];
+        }
+        if (key < identifier) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+/** @brief Increment a counter that only the receive path writes */
+static inline void bump(_Atomic uint32_t *counter)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+/** @brief Raw signal value; sign-extended only for signed signals, so unsigned 32-bit values stay positive */
+static CAN_TWAI_HOT_ATTR int64_t extract_signal(const uint32_t words[2], const can_twai_signal_t *sig)
+{
+    uint64_t raw = ((uint64_t)words[1] << 32) | words[0];
+    uint64_t value = (raw >> sig->start_bit) & ((1ull << sig->length) - 1u);
+    if (sig->is_signed && (value & (1ull << (sig->length - 1)))) {
+        value |= ~((1ull << sig->length) - 1u);  // sign-extend
+    }
+    return (int64_t)value;
+}
+
+static CAN_TWAI_HOT_ATTR bool change_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    (void)rx_time_us;
+    (void)ctx;
+    change_entry_t *e = find_entry(msg->identifier);
+    if (e == NULL) {
+        return true;
+    }
+
+    // Payload as two little-endian words (native on ESP32), zero beyond DLC
+    uint32_t words[2] = {0, 0};
+    memcpy(words, msg->data, msg->data_length_code);
+
+    uint32_t changed = 0;
+    if (!e->seen) {
+        changed = CAN_TWAI_CHANGE_FIRST;
+    } else if ((((words[0] ^ e->last[0]) & e->mask[0]) | ((words[1] ^ e->last[1]) & e->mask[1])) != 0 ||
+               msg->data_length_code != e->last_dlc) {
+        changed = CAN_TWAI_CHANGE_PAYLOAD;
+    }
+
+    int64_t values[CAN_TWAI_CHANGE_MAX_SIGNALS];
+    for (size_t i = 0; i < e->cfg.signal_count; i++) {
+        values[i] = extract_signal(words, &e->signals[i]);
+        int64_t diff = values[i] - e->last_signal[i];
+        if (diff < 0) {
+            diff = -diff;
+        }
+        if (diff > (int64_t)e->signals[i].deadband) {
+            changed |= 1u << i;
+        }
+    }
+
+    bump(&e->checked);
+    e->hide = changed == 0 && e->cfg.suppress_unchanged;
+    if (changed == 0) {
+        if (e->hide) {
+            bump(&e->suppressed);
+        }
+        return true;
+    }
+
+    // Relevant change: this frame becomes the new reference
+    e->last[0] = words[0];
+    e->last[1] = words[1];
+    e->last_dlc = msg->data_length_code;
+    for (size_t i = 0; i < e->cfg.signal_count; i++) {
+        e->last_signal[i] = values[i];
+    }
+    e->seen = true;
+    bump(&e->changed);
+
+    if (e->cfg.callback != NULL) {
+        e->cfg.callback(msg, changed, e->cfg.ctx);
+    }
+    return true;
+}
+
+/** @brief Keep suppressed frames from the application once all hooks have seen them */
+static CAN_TWAI_HOT_ATTR bool change_deliver(const twai_message_t *msg)
+{
+    const change_entry_t *e = find_entry(msg->identifier);
+    return e == NULL || !e->hide;
+}
+
+bool can_twai_change_init(const can_twai_change_config_t *entries, size_t count)
+{
+    if (entries == NULL || count == 0) {
+        ESP_LOGE(TAG, "Invalid change detection configuration");
+        return false;
+    }
+    if (entries_tab != NULL) {
+        ESP_LOGE(TAG, "Change detection already initialized");
+        return false;
+    }
+
+    change_entry_t *tab = can_twai_hot_calloc(count, sizeof(change_entry_t));
+    if (tab == NULL) {
+        ESP_LOGE(TAG, "Out of memory for %u entries", (unsigned)count);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const can_twai_change_config_t *c = &entries[i];
+        if (c->signal_count > CAN_TWAI_CHANGE_MAX_SIGNALS || (c->signal_count > 0 && c->signals == NULL)) {
+            ESP_LOGE(TAG, "ID 0x%lX: invalid signal list", (unsigned long)c->identifier);
+            free(tab);
+            return false;
+        }
+        for (size_t s = 0; s < c->signal_count; s++) {
+            const can_twai_signal_t *sig = &c->signals[s];
+            if (sig->length == 0 || sig->length > 32 || sig->start_bit + sig->length > 64) {
+                ESP_LOGE(TAG, "ID 0x%lX: invalid signal %u", (unsigned long)c->identifier, (unsigned)s);
+                free(tab);
+                return false;
+            }
+            tab[i].signals[s] = *sig;
+        }
+        tab[i].cfg = *c;
+        tab[i].mask[0] = (uint32_t)c->mask;
+        tab[i].mask[1] = (uint32_t)(c->mask >> 32);
+    }
+
+    qsort(tab, count, sizeof(change_entry_t), cmp_entry);
+    for (size_t i = 1; i < count; i++) {
+        if (tab[i].cfg.identifier == tab[i - 1].cfg.identifier) {
+            ESP_LOGE(TAG, "Duplicate ID 0x%lX", (unsigned long)tab[i].cfg.identifier);
+            free(tab);
+            return false;
+        }
+    }
+    // qsort moved the entries: re-point signal lists at their own storage
+    for (size_t i = 0; i < count; i++) {
+        tab[i].cfg.signals = tab[i].signals;
+    }
+
+    entries_tab = tab;
+    entry_count = count;
+
+    if (!can_twai_register_rx_hook(change_rx_hook, NULL)) {
+        free(entries_tab);
+        entries_tab = NULL;
+        entry_count = 0;
+        return false;
+    }
+    can_twai_set_rx_deliver(change_deliver);
+
+    ESP_LOGI(TAG, "Change detection active for %u IDs", (unsigned)count);
+    return true;
+}
+
+void can_twai_change_deinit(void)
+{
+    if (entries_tab == NULL) {
+        return;
+    }
+    can_twai_set_rx_deliver(NULL);
+    can_twai_unregister_rx_hook(change_rx_hook, NULL);
+    free(entries_tab);
+    entries_tab = NULL;
+    entry_count = 0;
+}
+
+void can_twai_change_get_stats(can_twai_change_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < entry_count; i++) {
+        change_entry_t *e = &entries_tab[i];
+        out->frames_checked += atomic_load_explicit(&e->checked, memory_order_relaxed);
+        out->frames_changed += atomic_load_explicit(&e->changed, memory_order_relaxed);
+        out->frames_suppressed += atomic_load_explicit(&e->suppressed, memory_order_relaxed);
+    }
+}
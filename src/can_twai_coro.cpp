@@ -0,0 +1,259 @@
+/**
+ * @file can_twai_coro.cpp
+ * @brief Executor for the TWAI coroutine layer
+ *
+ * A single FreeRTOS task receives messages through can_twai_receive_timeout(),
+ * resumes coroutines waiting for them, performs queued sends and expires
+ * timers. All waiter lists are touched only by the executor task, so no
+ * locking is needed apart from the spawn queue.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_coro.hpp"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+namespace can_twai {
+
+namespace {
+
+/** @brief Logging tag for this module */
+const char *TAG = "can_twai_coro";
+
+/** @brief Executor state (owned by the executor task) */
+struct ExecutorState {
+    TaskHandle_t    task        = nullptr;
+    QueueHandle_t   spawn_queue = nullptr;
+    ExecutorConfig  cfg;
+    detail::Waiter *rx_head     = nullptr;  /**< Coroutines waiting for a message */
+    detail::Waiter *tx_head     = nullptr;  /**< Coroutines waiting to send (FIFO) */
+    detail::Waiter *tx_tail     = nullptr;
+    detail::Waiter *timer_head  = nullptr;  /**< Waiters with a deadline, earliest first */
+};
+
+ExecutorState s;
+
+void unlink_rx(detail::Waiter *w)
+{
+    for (detail::Waiter **pp = &s.rx_head; *pp; pp = &(*pp)->next) {
+        if (*pp == w) {
+            *pp = w->next;
+            w->next = nullptr;
+            return;
+        }
+    }
+}
+
+void unlink_timer(detail::Waiter *w)
+{
+    if (w->deadline_us < 0) {
+        return;
+    }
+    for (detail::Waiter **pp = &s.timer_head; *pp; pp = &(*pp)->next_timer) {
+        if (*pp == w) {
+            *pp = w->next_timer;
+            w->next_timer = nullptr;
+            return;
+        }
+    }
+}
+
+void insert_timer(detail::Waiter *w, uint32_t ms)
+{
+    w->deadline_us = esp_timer_get_time() + (int64_t)ms * 1000;
+    detail::Waiter **pp = &s.timer_head;
+    while (*pp && (*pp)->deadline_us <= w->deadline_us) {
+        pp = &(*pp)->next_timer;
+    }
+    w->next_timer = *pp;
+    *pp = w;
+}
+
+/** @brief Resume every waiter on a locally detached list */
+void resume_all(detail::Waiter *ready)
+{
+    while (ready) {
+        detail::Waiter *w = ready;
+        ready = w->next;
+        w->next = nullptr;
+        w->handle.resume();  // may free the frame holding *w
+    }
+}
+
+void dispatch_message(const twai_message_t &msg)
+{
+    detail::Waiter *ready = nullptr;
+    detail::Waiter **tail = &ready;
+
+    // Detach all matching waiters first: resumed coroutines may re-register
+    detail::Waiter **pp = &s.rx_head;
+    while (*pp) {
+        detail::Waiter *w = *pp;
+        if ((msg.identifier & w->mask) == (w->id & w->mask)) {
+            *pp = w->next;
+            w->next = nullptr;
+            unlink_timer(w);
+            w->msg = msg;
+            w->ok = true;
+            *tail = w;
+            tail = &w->next;
+        } else {
+            pp = &w->next;
+        }
+    }
+    resume_all(ready);
+}
+
+void run_sends()
+{
+    detail::Waiter *ready = s.tx_head;
+    s.tx_head = s.tx_tail = nullptr;
+
+    for (detail::Waiter *w = ready; w; w = w->next) {
+        w->ok = can_twai_send(&w->msg);
+    }
+    resume_all(ready);
+}
+
+void expire_timers(int64_t now_us)
+{
+    detail::Waiter *ready = nullptr;
+    detail::Waiter **tail = &ready;
+
+    while (s.timer_head && s.timer_head->deadline_us <= now_us) {
+        detail::Waiter *w = s.timer_head;
+        s.timer_head = w->next_timer;
+        w->next_timer = nullptr;
+        unlink_rx(w);  // no-op for sleepers
+        w->ok = false;
+        *tail = w;
+        tail = &w->next;
+    }
+    resume_all(ready);
+}
+
+/** @brief Ticks the executor may block in receive without missing work */
+TickType_t next_wait_ticks()
+{
+    if (s.tx_head || uxQueueMessagesWaiting(s.spawn_queue) > 0) {
+        return 0;
+    }
+    int64_t wait_us = (int64_t)s.cfg.max_idle_ms * 1000;
+    if (s.timer_head) {
+        int64_t until = s.timer_head->deadline_us - esp_timer_get_time();
+        if (until < wait_us) {
+            wait_us = until > 0 ? until : 0;
+        }
+    }
+    // Round up so that a sleeper is never woken before its deadline
+    const int64_t tick_us = (int64_t)portTICK_PERIOD_MS * 1000;
+    return (TickType_t)((wait_us + tick_us - 1) / tick_us);
+}
+
+void executor_task(void *arg)
+{
+    (void)arg;
+    twai_message_t msg;
+
+    for (;;) {
+        void *addr;
+        while (xQueueReceive(s.spawn_queue, &addr, 0) == pdTRUE) {
+            std::coroutine_handle<>::from_address(addr).resume();
+        }
+
+        run_sends();
+
+        if (can_twai_receive_timeout(&msg, next_wait_ticks())) {
+            dispatch_message(msg);
+        }
+
+        expire_timers(esp_timer_get_time());
+    }
+}
+
+} // namespace
+
+namespace detail {
+
+void wait_receive(Waiter *w, uint32_t timeout_ms)
+{
+    w->next = s.rx_head;
+    s.rx_head = w;
+    if (timeout_ms != WAIT_FOREVER) {
+        insert_timer(w, timeout_ms);
+    }
+}
+
+void wait_send(Waiter *w)
+{
+    w->next = nullptr;
+    if (s.tx_tail) {
+        s.tx_tail->next = w;
+    } else {
+        s.tx_head = w;
+    }
+    s.tx_tail = w;
+}
+
+void wait_sleep(Waiter *w, uint32_t ms)
+{
+    insert_timer(w, ms);
+}
+
+} // namespace detail
+
+bool executor_start(const ExecutorConfig &cfg)
+{
+    if (s.task != nullptr) {
+        return true;
+    }
+
+    s.cfg = cfg;
+    s.spawn_queue = xQueueCreate(cfg.spawn_queue_len, sizeof(void *));
+    if (s.spawn_queue == nullptr) {
+        ESP_LOGE(TAG, "Failed to create spawn queue");
+        return false;
+    }
+
+    BaseType_t ok = xTaskCreatePinnedToCore(executor_task, "can_coro", cfg.stack_size,
+                                            nullptr, cfg.priority, &s.task, cfg.core_id);
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create executor task");
+        vQueueDelete(s.spawn_queue);
+        s.spawn_queue = nullptr;
+        s.task = nullptr;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Coroutine executor started (prio=%u, max_idle=%lums)",
+             (unsigned)cfg.priority, (unsigned long)cfg.max_idle_ms);
+    return true;
+}
+
+bool spawn(Task &&task)
+{
+    if (!task.valid()) {
+        ESP_LOGE(TAG, "Coroutine frame allocation failed");
+        return false;
+    }
+    if (s.spawn_queue == nullptr) {
+        ESP_LOGE(TAG, "Executor not running");
+        return false;
+    }
+
+    std::coroutine_handle<> h = task.release();
+    void *addr = h.address();
+    if (xQueueSend(s.spawn_queue, &addr, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Spawn queue full");
+        h.destroy();
+        return false;
+    }
+    return true;
+}
+
+} // namespace can_twai
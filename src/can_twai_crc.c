@@ -0,0 +1,175 @@
+/**
+ * @file can_twai_crc.c
+ * @brief CRC8 SAE J1850 and CRC16 CCITT-FALSE engines used by the E2E profiles
+ *
+ * Three engines per CRC: bitwise (no tables), table (one lookup per byte)
+ * and slicing-by-4 (four lookups per four bytes). All lookup tables are
+ * generated by the preprocessor: a CRC over GF(2) is linear, so every table
+ * entry is the XOR of eight basis values, and the basis values are enum
+ * constants computed with the bitwise step. Nothing is computed at run time
+ * and the tables are constant data in flash.
+ *
+ * Plain C without ESP-IDF dependencies, so it also builds on the host
+ * (see tools/e2e).
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_e2e.h"
+
+// --------------------------------------------------------------------------------------
+// Compile-time table generation
+// --------------------------------------------------------------------------------------
+
+/** @brief One MSB-first shift of the CRC8 register, polynomial 0x1D */
+#define CRC8_STEP(c)   ((((c) << 1) ^ (((c) & 0x80) ? 0x1D : 0)) & 0xFF)
+/** @brief One MSB-first shift of the CRC16 register, polynomial 0x1021 */
+#define CRC16_STEP(c)  ((((c) << 1) ^ (((c) & 0x8000) ? 0x1021 : 0)) & 0xFFFF)
+
+#define CRC8_STEP8(c)  CRC8_STEP(CRC8_STEP(CRC8_STEP(CRC8_STEP(CRC8_STEP(CRC8_STEP(CRC8_STEP(CRC8_STEP(c))))))))
+#define CRC16_STEP8(c) CRC16_STEP(CRC16_STEP(CRC16_STEP(CRC16_STEP(CRC16_STEP(CRC16_STEP(CRC16_STEP(CRC16_STEP(c))))))))
+
+/**
+ * @brief Basis values of table @p k: input bit b followed by k zero bytes
+ *
+ * Table k of the slicing engine holds the register after one byte and k
+ * zero bytes; each row is derived from the previous one by eight more steps.
+ */
+#define CRC_BASIS(crc, k, step8, in)                                                        \
+    crc##_B##k##_0 = step8(in(0)), crc##_B##k##_1 = step8(in(1)),                           \
+    crc##_B##k##_2 = step8(in(2)), crc##_B##k##_3 = step8(in(3)),                           \
+    crc##_B##k##_4 = step8(in(4)), crc##_B##k##_5 = step8(in(5)),                           \
+    crc##_B##k##_6 = step8(in(6)), crc##_B##k##_7 = step8(in(7))
+
+#define CRC8_IN0(b)  (1 << (b))
+#define CRC8_IN1(b)  CRC8_B0_##b
+#define CRC8_IN2(b)  CRC8_B1_##b
+#define CRC8_IN3(b)  CRC8_B2_##b
+#define CRC16_IN0(b) (1 << ((b) + 8))
+#define CRC16_IN1(b) CRC16_B0_##b
+#define CRC16_IN2(b) CRC16_B1_##b
+#define CRC16_IN3(b) CRC16_B2_##b
+
+enum {
+    CRC_BASIS(CRC8, 0, CRC8_STEP8, CRC8_IN0),
+    CRC_BASIS(CRC8, 1, CRC8_STEP8, CRC8_IN1),
+    CRC_BASIS(CRC8, 2, CRC8_STEP8, CRC8_IN2),
+    CRC_BASIS(CRC8, 3, CRC8_STEP8, CRC8_IN3),
+    CRC_BASIS(CRC16, 0, CRC16_STEP8, CRC16_IN0),
+    CRC_BASIS(CRC16, 1, CRC16_STEP8, CRC16_IN1),
+    CRC_BASIS(CRC16, 2, CRC16_STEP8, CRC16_IN2),
+    CRC_BASIS(CRC16, 3, CRC16_STEP8, CRC16_IN3),
+};
+
+/** @brief Entry @p i of table @p k as the XOR of the basis values of its set bits */
+#define CRC_ENTRY(crc, k, i)                                                                \
+    ((((i) & 0x01) ? crc##_B##k##_0 : 0) ^ (((i) & 0x02) ? crc##_B##k##_1 : 0) ^            \
+     (((i) & 0x04) ? crc##_B##k##_2 : 0) ^ (((i) & 0x08) ? crc##_B##k##_3 : 0) ^            \
+     (((i) & 0x10) ? crc##_B##k##_4 : 0) ^ (((i) & 0x20) ? crc##_B##k##_5 : 0) ^            \
+     (((i) & 0x40) ? crc##_B##k##_6 : 0) ^ (((i) & 0x80) ? crc##_B##k##_7 : 0))
+
+#define CRC_R4(crc, k, n)   CRC_ENTRY(crc, k, n), CRC_ENTRY(crc, k, n + 1),                 \
+                            CRC_ENTRY(crc, k, n + 2), CRC_ENTRY(crc, k, n + 3)
+#define CRC_R16(crc, k, n)  CRC_R4(crc, k, n), CRC_R4(crc, k, n + 4),                       \
+                            CRC_R4(crc, k, n + 8), CRC_R4(crc, k, n + 12)
+#define CRC_R64(crc, k, n)  CRC_R16(crc, k, n), CRC_R16(crc, k, n + 16),                    \
+                            CRC_R16(crc, k, n + 32), CRC_R16(crc, k, n + 48)
+#define CRC_TABLE(crc, k)   { CRC_R64(crc, k, 0), CRC_R64(crc, k, 64),                      \
+                              CRC_R64(crc, k, 128), CRC_R64(crc, k, 192) }
+
+/** @brief CRC8 SAE J1850 tables; [0] is the plain byte table */
+static const uint8_t crc8_tab[4][256] = {
+    CRC_TABLE(CRC8, 0), CRC_TABLE(CRC8, 1), CRC_TABLE(CRC8, 2), CRC_TABLE(CRC8, 3),
+};
+
+/** @brief CRC16 CCITT tables; [0] is the plain byte table */
+static const uint16_t crc16_tab[4][256] = {
+    CRC_TABLE(CRC16, 0), CRC_TABLE(CRC16, 1), CRC_TABLE(CRC16, 2), CRC_TABLE(CRC16, 3),
+};
+
+// --------------------------------------------------------------------------------------
+// CRC8 SAE J1850
+// --------------------------------------------------------------------------------------
+
+uint8_t can_twai_crc8_sae_j1850_bitwise(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (uint8_t)CRC8_STEP(crc);
+        }
+    }
+    return crc ^ 0xFF;
+}
+
+uint8_t can_twai_crc8_sae_j1850_table(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = crc8_tab[0][crc ^ data[i]];
+    }
+    return crc ^ 0xFF;
+}
+
+uint8_t can_twai_crc8_sae_j1850_slice4(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    for (; len >= 4; data += 4, len -= 4) {
+        crc = crc8_tab[3][crc ^ data[0]] ^ crc8_tab[2][data[1]] ^
+              crc8_tab[1][data[2]] ^ crc8_tab[0][data[3]];
+    }
+    while (len--) {
+        crc = crc8_tab[0][crc ^ *data++];
+    }
+    return crc ^ 0xFF;
+}
+
+uint8_t can_twai_crc8_sae_j1850(const uint8_t *data, size_t len)
+{
+    return can_twai_crc8_sae_j1850_slice4(data, len);
+}
+
+// --------------------------------------------------------------------------------------
+// CRC16 CCITT-FALSE
+// --------------------------------------------------------------------------------------
+
+uint16_t can_twai_crc16_ccitt_bitwise(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int b = 0; b < 8; b++) {
+            crc = (uint16_t)CRC16_STEP(crc);
+        }
+    }
+    return crc;
+}
+
+uint16_t can_twai_crc16_ccitt_table(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)((crc << 8) ^ crc16_tab[0][(uint8_t)((crc >> 8) ^ data[i])]);
+    }
+    return crc;
+}
+
+uint16_t can_twai_crc16_ccitt_slice4(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (; len >= 4; data += 4, len -= 4) {
+        crc = crc16_tab[3][(uint8_t)((crc >> 8) ^ data[0])] ^ crc16_tab[2][(uint8_t)(crc ^ data[1])] ^
+              crc16_tab[1][data[2]] ^ crc16_tab[0][data[3]];
+    }
+    while (len--) {
+        crc = (uint16_t)((crc << 8) ^ crc16_tab[0][(uint8_t)((crc >> 8) ^ *data++)]);
+    }
+    return crc;
+}
+
+uint16_t can_twai_crc16_ccitt(const uint8_t *data, size_t len)
+{
+    return can_twai_crc16_ccitt_slice4(data, len);
+}
@@ -0,0 +1,366 @@
+/**
+ * @file can_twai_diag.c
+ * @brief Bus error classification from alerts and the error code capture register
+ *
+ * ECC register layout (SJA1000 compatible):
+ * @code
+ * | 7..6 error type | 5 direction (1 = RX) | 4..0 frame segment |
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_diag.h"
+#include "can_twai_priv.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+/*
+ * On the ESP32 the driver ISR reads and clears ECC itself for its errata
+ * workarounds, so reading it here would steal captures from the driver (and
+ * the driver from us). There bus errors are counted without classification.
+ */
+#if CONFIG_CAN_TWAI_DIAG_READ_ECC && !CONFIG_IDF_TARGET_ESP32
+#define DIAG_USE_ECC 1
+#include "hal/twai_ll.h"
+#else
+#define DIAG_USE_ECC 0
+#endif
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_diag";
+
+#define DEFAULT_WINDOW_MS  10000
+#define DEFAULT_BUCKETS    10
+#define DEFAULT_MIN_ERRORS 5
+
+#define DIAG_ALERTS (TWAI_ALERT_BUS_ERROR | TWAI_ALERT_TX_SUCCESS | TWAI_ALERT_RX_DATA | \
+                     TWAI_ALERT_ERR_PASS | TWAI_ALERT_BUS_OFF)
+
+#define ECC_TYPE(ecc)   (((ecc) >> 6) & 0x3u)
+#define ECC_IS_RX(ecc)  (((ecc) >> 5) & 0x1u)
+#define ECC_SEG(ecc)    ((ecc) & 0x1Fu)
+
+#define ECC_TYPE_BIT    0u
+#define ECC_TYPE_FORM   1u
+#define ECC_TYPE_STUFF  2u
+#define ECC_TYPE_OTHER  3u
+
+/** @brief Segment codes the controller can capture (SOF .. overload flag); 0 is never captured */
+#define SEG_VALID_MASK  0x1FCEFFFCu
+
+#define SEG_CRC_SEQ     0x08u
+#define SEG_CRC_DELIM   0x18u
+#define SEG_ACK_SLOT    0x19u
+#define SEG_ACK_DELIM   0x1Bu
+
+/** @brief Counters of one time bucket */
+typedef struct {
+    uint32_t cls[CAN_TWAI_ERR_CLASS_COUNT];
+    uint32_t tx_errors;
+    uint32_t rx_errors;
+    uint32_t tx_ok;
+    uint32_t rx_ok;
+} bucket_t;
+
+/** @brief Diagnosis state */
+typedef struct {
+    bucket_t buckets[CAN_TWAI_DIAG_MAX_BUCKETS];
+    uint32_t bucket_count;
+    int64_t  bucket_us;
+    uint32_t current;
+    int64_t  current_start_us;
+    uint32_t window_ms;
+    uint32_t min_errors;
+
+    uint32_t total[CAN_TWAI_ERR_CLASS_COUNT];
+    uint32_t error_passive_events;
+    uint32_t bus_off_events;
+    uint32_t last_bus_error_count;
+    uint32_t last_ecc;
+    bool     running;
+} diag_t;
+
+static diag_t dg;
+static portMUX_TYPE dg_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Read the captured bus error (0xFFFFFFFF if unavailable)
+ *
+ * The controller latches the first error after the previous read and holds
+ * it until the next read, so call this only when the driver counted at
+ * least one new bus error; otherwise the value is stale.
+ */
+static uint32_t read_ecc(void)
+{
+#if DIAG_USE_ECC
+#ifdef TWAI_LL_GET_HW
+    return twai_ll_get_and_clear_ecc(TWAI_LL_GET_HW(0));
+#else
+    return twai_ll_get_and_clear_ecc(&TWAI);
+#endif
+#else
+    return UINT32_MAX;
+#endif
+}
+
+/** @brief True if @p ecc holds a real capture (not unavailable, cleared or garbage) */
+static bool ecc_valid(uint32_t ecc)
+{
+    return ecc != UINT32_MAX && (SEG_VALID_MASK & (1u << ECC_SEG(ecc))) != 0;
+}
+
+static can_twai_err_class_t classify(uint32_t ecc)
+{
+    uint32_t seg = ECC_SEG(ecc);
+    if (seg == SEG_ACK_SLOT && !ECC_IS_RX(ecc)) {
+        return CAN_TWAI_ERR_ACK;
+    }
+    switch (ECC_TYPE(ecc)) {
+    case ECC_TYPE_BIT:
+        return CAN_TWAI_ERR_BIT;
+    case ECC_TYPE_STUFF:
+        return CAN_TWAI_ERR_STUFF;
+    case ECC_TYPE_FORM:
+        return CAN_TWAI_ERR_FORM;
+    default:
+        if (seg == SEG_CRC_SEQ || seg == SEG_CRC_DELIM || (seg == SEG_ACK_DELIM && ECC_IS_RX(ecc))) {
+            return CAN_TWAI_ERR_CRC;
+        }
+        return CAN_TWAI_ERR_OTHER;
+    }
+}
+
+/** @brief Rotate the window so that the current bucket contains @p now_us */
+static void advance(int64_t now_us)
+{
+    int64_t elapsed = (now_us - dg.current_start_us) / dg.bucket_us;
+    if (elapsed <= 0) {
+        return;
+    }
+    if (elapsed >= dg.bucket_count) {
+        memset(dg.buckets, 0, sizeof(dg.buckets));
+    } else {
+        for (int64_t i = 0; i < elapsed; i++) {
+            dg.current = (dg.current + 1) % dg.bucket_count;
+            memset(&dg.buckets[dg.current], 0, sizeof(bucket_t));
+        }
+    }
+    dg.current_start_us += elapsed * dg.bucket_us;
+}
+
+static void diag_alert_hook(uint32_t alerts, int64_t time_us, void *ctx)
+{
+    uint32_t bus_errors = 0;
+    uint32_t ecc = UINT32_MAX;
+    if (alerts & TWAI_ALERT_BUS_ERROR) {
+        twai_status_info_t status;
+        if (can_twai_backend_status(&status) == ESP_OK) {
+            bus_errors = status.bus_error_count - dg.last_bus_error_count;
+            dg.last_bus_error_count = status.bus_error_count;
+            // The counter proves a new capture is latched; without it ECC may be stale
+            if (bus_errors > 0) {
+                ecc = read_ecc();
+            }
+        } else {
+            bus_errors = 1;
+        }
+    }
+
+    portENTER_CRITICAL(&dg_lock);
+    advance(time_us);
+    bucket_t *b = &dg.buckets[dg.current];
+    if (bus_errors > 0) {
+        // One capture describes one error; the rest of the batch stays unknown
+        uint32_t unknown = bus_errors;
+        if (ecc_valid(ecc)) {
+            can_twai_err_class_t cls = classify(ecc);
+            b->cls[cls]++;
+            dg.total[cls]++;
+            dg.last_ecc = ecc;
+            if (ECC_IS_RX(ecc)) {
+                b->rx_errors++;
+            } else {
+                b->tx_errors++;
+            }
+            unknown--;
+        }
+        b->cls[CAN_TWAI_ERR_UNKNOWN] += unknown;
+        dg.total[CAN_TWAI_ERR_UNKNOWN] += unknown;
+    }
+    if (alerts & TWAI_ALERT_TX_SUCCESS) {
+        b->tx_ok++;
+    }
+    if (alerts & TWAI_ALERT_RX_DATA) {
+        b->rx_ok++;
+    }
+    if (alerts & TWAI_ALERT_ERR_PASS) {
+        dg.error_passive_events++;
+    }
+    if (alerts & TWAI_ALERT_BUS_OFF) {
+        dg.bus_off_events++;
+    }
+    portEXIT_CRITICAL(&dg_lock);
+}
+
+static can_twai_suspect_t suspect_from(const can_twai_diag_report_t *r)
+{
+    const uint32_t *w = r->window;
+    uint32_t all = 0;
+    for (int i = 0; i < CAN_TWAI_ERR_CLASS_COUNT; i++) {
+        all += w[i];
+    }
+    if (all < dg.min_errors) {
+        return CAN_TWAI_SUSPECT_NONE;
+    }
+
+    // Signatures are judged on the classified sample only
+    uint32_t errors = all - w[CAN_TWAI_ERR_UNKNOWN];
+    if (errors == 0 || w[CAN_TWAI_ERR_OTHER] == errors) {
+        return CAN_TWAI_SUSPECT_UNKNOWN;
+    }
+
+    if (w[CAN_TWAI_ERR_ACK] * 2 >= errors && r->rx_ok_alerts == 0) {
+        return CAN_TWAI_SUSPECT_NO_ACK;
+    }
+    uint32_t framing = w[CAN_TWAI_ERR_STUFF] + w[CAN_TWAI_ERR_FORM] + w[CAN_TWAI_ERR_BIT];
+    if (r->tx_ok_alerts == 0 && r->rx_ok_alerts == 0 && framing * 10 >= errors * 7) {
+        return CAN_TWAI_SUSPECT_BITRATE;
+    }
+    if (r->rx_errors * 10 >= errors * 8 && r->tx_ok_alerts > 0) {
+        return CAN_TWAI_SUSPECT_BAD_NODE;
+    }
+    if ((w[CAN_TWAI_ERR_BIT] + w[CAN_TWAI_ERR_CRC]) * 2 >= errors &&
+        r->tx_errors > 0 && r->rx_errors > 0) {
+        return CAN_TWAI_SUSPECT_TERMINATION;
+    }
+    return CAN_TWAI_SUSPECT_UNKNOWN;
+}
+
+bool can_twai_diag_init(const can_twai_diag_config_t *cfg)
+{
+    if (dg.running) {
+        ESP_LOGE(TAG, "Diagnosis already running");
+        return false;
+    }
+
+    can_twai_diag_config_t c = cfg ? *cfg : (can_twai_diag_config_t){0};
+    memset(&dg, 0, sizeof(dg));
+    dg.window_ms = c.window_ms ? c.window_ms : DEFAULT_WINDOW_MS;
+    dg.bucket_count = c.buckets ? c.buckets : DEFAULT_BUCKETS;
+    if (dg.bucket_count > CAN_TWAI_DIAG_MAX_BUCKETS) {
+        ESP_LOGE(TAG, "Too many buckets (max %d)", CAN_TWAI_DIAG_MAX_BUCKETS);
+        return false;
+    }
+    dg.bucket_us = (int64_t)dg.window_ms * 1000 / dg.bucket_count;
+    dg.min_errors = c.min_errors ? c.min_errors : DEFAULT_MIN_ERRORS;
+    dg.current_start_us = esp_timer_get_time();
+
+    twai_status_info_t status;
+    if (can_twai_backend_status(&status) == ESP_OK) {
+        dg.last_bus_error_count = status.bus_error_count;
+    }
+
+    if (!can_twai_register_alert_hook(DIAG_ALERTS, diag_alert_hook, NULL)) {
+        return false;
+    }
+    dg.running = true;
+    return true;
+}
+
+void can_twai_diag_deinit(void)
+{
+    if (!dg.running) {
+        return;
+    }
+    can_twai_unregister_alert_hook(diag_alert_hook, NULL);
+    dg.running = false;
+}
+
+bool can_twai_diag_get_report(can_twai_diag_report_t *out)
+{
+    if (!dg.running || out == NULL) {
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+
+    portENTER_CRITICAL(&dg_lock);
+    advance(esp_timer_get_time());
+    for (uint32_t i = 0; i < dg.bucket_count; i++) {
+        const bucket_t *b = &dg.buckets[i];
+        for (int c = 0; c < CAN_TWAI_ERR_CLASS_COUNT; c++) {
+            out->window[c] += b->cls[c];
+        }
+        out->tx_errors += b->tx_errors;
+        out->rx_errors += b->rx_errors;
+        out->tx_ok_alerts += b->tx_ok;
+        out->rx_ok_alerts += b->rx_ok;
+    }
+    memcpy(out->total, dg.total, sizeof(out->total));
+    out->window_ms = dg.window_ms;
+    out->error_passive_events = dg.error_passive_events;
+    out->bus_off_events = dg.bus_off_events;
+    out->last_ecc = dg.last_ecc;
+    portEXIT_CRITICAL(&dg_lock);
+
+    twai_status_info_t status;
+    if (can_twai_backend_status(&status) == ESP_OK) {
+        out->tx_error_counter = status.tx_error_counter;
+        out->rx_error_counter = status.rx_error_counter;
+    }
+    out->suspect = suspect_from(out);
+    return true;
+}
+
+void can_twai_diag_log_report(void)
+{
+    can_twai_diag_report_t r;
+    if (!can_twai_diag_get_report(&r)) {
+        ESP_LOGW(TAG, "Diagnosis not running");
+        return;
+    }
+
+    ESP_LOGI(TAG, "Bus errors in last %lu ms (total since start):", (unsigned long)r.window_ms);
+    for (int c = 0; c < CAN_TWAI_ERR_CLASS_COUNT; c++) {
+        ESP_LOGI(TAG, "  %-7s %6lu (%lu)", can_twai_diag_class_str((can_twai_err_class_t)c),
+                 (unsigned long)r.window[c], (unsigned long)r.total[c]);
+    }
+    ESP_LOGI(TAG, "  TX/RX errors %lu/%lu, TEC/REC %lu/%lu, error passive %lu, bus-off %lu",
+             (unsigned long)r.tx_errors, (unsigned long)r.rx_errors,
+             (unsigned long)r.tx_error_counter, (unsigned long)r.rx_error_counter,
+             (unsigned long)r.error_passive_events, (unsigned long)r.bus_off_events);
+    ESP_LOGI(TAG, "  Suspect: %s", can_twai_diag_suspect_str(r.suspect));
+}
+
+const char *can_twai_diag_class_str(can_twai_err_class_t cls)
+{
+    switch (cls) {
+    case CAN_TWAI_ERR_BIT:   return "bit";
+    case CAN_TWAI_ERR_STUFF: return "stuff";
+    case CAN_TWAI_ERR_FORM:  return "form";
+    case CAN_TWAI_ERR_CRC:   return "crc";
+    case CAN_TWAI_ERR_ACK:   return "ack";
+    case CAN_TWAI_ERR_OTHER: return "other";
+    default:                 return "unknown";
+    }
+}
+
+const char *can_twai_diag_suspect_str(can_twai_suspect_t suspect)
+{
+    switch (suspect) {
+    case CAN_TWAI_SUSPECT_NONE:
+        return "none (bus healthy)";
+    case CAN_TWAI_SUSPECT_NO_ACK:
+        return "no acknowledge - node alone on bus, other nodes offline or listen-only";
+    case CAN_TWAI_SUSPECT_BITRATE:
+        return "bitrate mismatch - check timing against the other nodes";
+    case CAN_TWAI_SUSPECT_BAD_NODE:
+        return "single bad node - errors only in frames of another node";
+    case CAN_TWAI_SUSPECT_TERMINATION:
+        return "signal integrity - check termination (2x 120 ohm), wiring and stubs";
+    default:
+        return "unknown";
+    }
+}
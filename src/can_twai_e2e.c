@@ -0,0 +1,362 @@
+/**
+ * @file can_twai_e2e.c
+ * @brief E2E protect/check on the TWAI transmit and receive paths
+ *
+ * Protected IDs are kept in two tables sorted by identifier, one for each
+ * direction, and located by binary search from the TX and RX hooks.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_e2e.h"
+#include "can_twai_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_e2e";
+
+// --------------------------------------------------------------------------------------
+// Profiles
+// --------------------------------------------------------------------------------------
+
+/** @brief Runtime state of one protected ID */
+typedef struct {
+    can_twai_e2e_config_t cfg;
+    can_twai_e2e_stats_t  stats;
+    uint8_t               counter;      /**< TX: next counter, RX: last accepted counter */
+    bool                  have_counter; /**< RX: a valid frame has been received */
+} e2e_entry_t;
+
+/** @brief Entries for each direction, sorted by identifier */
+static e2e_entry_t *tx_tab = NULL;
+static size_t tx_count = 0;
+static e2e_entry_t *rx_tab = NULL;
+static size_t rx_count = 0;
+
+/** @brief Guards statistics against concurrent readers */
+static portMUX_TYPE e2e_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/** @brief Header length of a profile (CRC + counter) */
+static inline uint8_t header_len(can_twai_e2e_profile_t profile)
+{
+    return profile == CAN_TWAI_E2E_PROFILE_1 ? 2 : 3;
+}
+
+/** @brief Counter modulus of a profile */
+static inline uint16_t counter_modulus(can_twai_e2e_profile_t profile)
+{
+    return profile == CAN_TWAI_E2E_PROFILE_1 ? 15 : 256;
+}
+
+/** @brief CRC of a frame: Data ID and payload without the CRC bytes, gathered for the CRC engine */
+static uint16_t compute_crc(const e2e_entry_t *e, const twai_message_t *msg)
+{
+    const uint8_t off = e->cfg.offset;
+    const uint8_t id_lo = (uint8_t)e->cfg.data_id;
+    const uint8_t id_hi = (uint8_t)(e->cfg.data_id >> 8);
+    uint8_t buf[TWAI_FRAME_MAX_DLC + 2];
+    size_t n = 0;
+
+    if (e->cfg.profile == CAN_TWAI_E2E_PROFILE_1) {
+        buf[n++] = id_lo;
+        buf[n++] = id_hi;
+        for (uint8_t i = 0; i < msg->data_length_code; i++) {
+            if (i != off) {
+                buf[n++] = msg->data[i];
+            }
+        }
+        return can_twai_crc8_sae_j1850(buf, n);
+    }
+
+    for (uint8_t i = 0; i < msg->data_length_code; i++) {
+        if (i != off && i != off + 1) {
+            buf[n++] = msg->data[i];
+        }
+    }
+    buf[n++] = id_lo;
+    buf[n++] = id_hi;
+    return can_twai_crc16_ccitt(buf, n);
+}
+
+static uint8_t read_counter(const e2e_entry_t *e, const twai_message_t *msg)
+{
+    if (e->cfg.profile == CAN_TWAI_E2E_PROFILE_1) {
+        return msg->data[e->cfg.offset + 1] & 0x0F;
+    }
+    return msg->data[e->cfg.offset + 2];
+}
+
+static void write_header(const e2e_entry_t *e, twai_message_t *msg, uint8_t counter)
+{
+    const uint8_t off = e->cfg.offset;
+    if (e->cfg.profile == CAN_TWAI_E2E_PROFILE_1) {
+        msg->data[off + 1] = (uint8_t)((msg->data[off + 1] & 0xF0) | counter);
+        msg->data[off] = (uint8_t)compute_crc(e, msg);
+    } else {
+        msg->data[off + 2] = counter;
+        uint16_t crc = compute_crc(e, msg);
+        msg->data[off] = (uint8_t)crc;
+        msg->data[off + 1] = (uint8_t)(crc >> 8);
+    }
+}
+
+static uint16_t read_crc(const e2e_entry_t *e, const twai_message_t *msg)
+{
+    const uint8_t off = e->cfg.offset;
+    if (e->cfg.profile == CAN_TWAI_E2E_PROFILE_1) {
+        return msg->data[off];
+    }
+    return (uint16_t)(msg->data[off] | (msg->data[off + 1] << 8));
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+    uint32_t x = ((const e2e_entry_t *)a)->cfg.identifier;
+    uint32_t y = ((const e2e_entry_t *)b)->cfg.identifier;
+    return (x > y) - (x < y);
+}
+
+static e2e_entry_t *find_entry(e2e_entry_t *tab, size_t count, uint32_t identifier)
+{
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t key = tab[mid].cfg.identifier;
+        if (key == identifier) {
+            return &tab[mid];
+        }
+        if (key < identifier) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static can_twai_e2e_status_t check_frame(e2e_entry_t *e, const twai_message_t *msg, uint32_t *lost)
+{
+    *lost = 0;
+    if (msg->data_length_code < e->cfg.offset + header_len(e->cfg.profile)) {
+        return CAN_TWAI_E2E_STATUS_ERROR;
+    }
+    if (read_crc(e, msg) != compute_crc(e, msg)) {
+        return CAN_TWAI_E2E_STATUS_WRONG_CRC;
+    }
+
+    const uint16_t mod = counter_modulus(e->cfg.profile);
+    uint8_t counter = read_counter(e, msg);
+    if (counter >= mod) {
+        return CAN_TWAI_E2E_STATUS_ERROR;
+    }
+
+    can_twai_e2e_status_t status;
+    if (!e->have_counter) {
+        status = CAN_TWAI_E2E_STATUS_OK;
+    } else {
+        uint16_t delta = (uint16_t)((counter + mod - e->counter) % mod);
+        uint8_t max_delta = e->cfg.max_delta_counter ? e->cfg.max_delta_counter : 1;
+        if (delta == 0) {
+            status = CAN_TWAI_E2E_STATUS_REPEATED;
+        } else if (delta == 1) {
+            status = CAN_TWAI_E2E_STATUS_OK;
+        } else if (delta <= max_delta) {
+            status = CAN_TWAI_E2E_STATUS_OK_SOME_LOST;
+            *lost = delta - 1u;
+        } else {
+            status = CAN_TWAI_E2E_STATUS_WRONG_SEQUENCE;
+        }
+    }
+
+    // Resynchronize on every frame with a valid CRC
+    e->counter = counter;
+    e->have_counter = true;
+    return status;
+}
+
+static bool e2e_tx_hook(twai_message_t *msg, uint32_t seq, void *ctx)
+{
+    (void)seq;
+    (void)ctx;
+    e2e_entry_t *e = find_entry(tx_tab, tx_count, msg->identifier);
+    if (e == NULL) {
+        return true;
+    }
+    if (msg->data_length_code < e->cfg.offset + header_len(e->cfg.profile)) {
+        ESP_LOGE(TAG, "ID 0x%lX: DLC %u too short for E2E header", (unsigned long)msg->identifier,
+                 msg->data_length_code);
+        return false;
+    }
+
+    portENTER_CRITICAL(&e2e_lock);
+    uint8_t counter = e->counter;
+    e->counter = (uint8_t)((counter + 1u) % counter_modulus(e->cfg.profile));
+    e->stats.frames++;
+    e->stats.last_counter = counter;
+    e->stats.last_status = CAN_TWAI_E2E_STATUS_OK;
+    portEXIT_CRITICAL(&e2e_lock);
+
+    write_header(e, msg, counter);
+    return true;
+}
+
+static bool e2e_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    (void)rx_time_us;
+    (void)ctx;
+    e2e_entry_t *e = find_entry(rx_tab, rx_count, msg->identifier);
+    if (e == NULL) {
+        return true;
+    }
+
+    uint32_t lost;
+    can_twai_e2e_status_t status = check_frame(e, msg, &lost);
+
+    portENTER_CRITICAL(&e2e_lock);
+    can_twai_e2e_stats_t *st = &e->stats;
+    st->frames++;
+    st->last_status = status;
+    st->last_counter = e->counter;
+    switch (status) {
+    case CAN_TWAI_E2E_STATUS_OK:
+        st->ok++;
+        break;
+    case CAN_TWAI_E2E_STATUS_OK_SOME_LOST:
+        st->ok++;
+        st->lost += lost;
+        break;
+    case CAN_TWAI_E2E_STATUS_REPEATED:
+        st->repeated++;
+        break;
+    case CAN_TWAI_E2E_STATUS_WRONG_SEQUENCE:
+        st->wrong_sequence++;
+        break;
+    case CAN_TWAI_E2E_STATUS_WRONG_CRC:
+        st->crc_errors++;
+        break;
+    default:
+        st->errors++;
+        break;
+    }
+    portEXIT_CRITICAL(&e2e_lock);
+
+    if (status == CAN_TWAI_E2E_STATUS_WRONG_CRC ||
+        status == CAN_TWAI_E2E_STATUS_WRONG_SEQUENCE ||
+        status == CAN_TWAI_E2E_STATUS_ERROR) {
+        ESP_LOGD(TAG, "ID 0x%lX: E2E check failed (status=%d)", (unsigned long)msg->identifier, (int)status);
+        return !e->cfg.drop_invalid;
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------------------
+// Public API
+// --------------------------------------------------------------------------------------
+
+static bool build_table(const can_twai_e2e_config_t *cfg, size_t count, bool transmit,
+                        e2e_entry_t **tab_out, size_t *count_out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (cfg[i].transmit == transmit) {
+            n++;
+        }
+    }
+    *tab_out = NULL;
+    *count_out = 0;
+    if (n == 0) {
+        return true;
+    }
+
+    e2e_entry_t *tab = calloc(n, sizeof(e2e_entry_t));
+    if (tab == NULL) {
+        ESP_LOGE(TAG, "Out of memory for %u entries", (unsigned)n);
+        return false;
+    }
+    size_t k = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (cfg[i].transmit == transmit) {
+            tab[k++].cfg = cfg[i];
+        }
+    }
+    qsort(tab, n, sizeof(e2e_entry_t), cmp_entry);
+    for (size_t i = 1; i < n; i++) {
+        if (tab[i].cfg.identifier == tab[i - 1].cfg.identifier) {
+            ESP_LOGE(TAG, "Duplicate %s ID 0x%lX", transmit ? "TX" : "RX",
+                     (unsigned long)tab[i].cfg.identifier);
+            free(tab);
+            return false;
+        }
+    }
+
+    *tab_out = tab;
+    *count_out = n;
+    return true;
+}
+
+bool can_twai_e2e_init(const can_twai_e2e_config_t *cfg, size_t count)
+{
+    if (cfg == NULL || count == 0) {
+        ESP_LOGE(TAG, "Invalid E2E configuration");
+        return false;
+    }
+    if (tx_tab != NULL || rx_tab != NULL) {
+        ESP_LOGE(TAG, "E2E already initialized");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if ((cfg[i].profile != CAN_TWAI_E2E_PROFILE_1 && cfg[i].profile != CAN_TWAI_E2E_PROFILE_5) ||
+            cfg[i].offset + header_len(cfg[i].profile) > TWAI_FRAME_MAX_DLC) {
+            ESP_LOGE(TAG, "ID 0x%lX: invalid profile or header offset", (unsigned long)cfg[i].identifier);
+            return false;
+        }
+    }
+
+    if (!build_table(cfg, count, true, &tx_tab, &tx_count) ||
+        !build_table(cfg, count, false, &rx_tab, &rx_count)) {
+        can_twai_e2e_deinit();
+        return false;
+    }
+
+    if ((tx_count > 0 && !can_twai_register_tx_hook(e2e_tx_hook, NULL)) ||
+        (rx_count > 0 && !can_twai_register_rx_hook(e2e_rx_hook, NULL))) {
+        can_twai_e2e_deinit();
+        return false;
+    }
+
+    ESP_LOGI(TAG, "E2E protection active (%u TX, %u RX IDs)", (unsigned)tx_count, (unsigned)rx_count);
+    return true;
+}
+
+void can_twai_e2e_deinit(void)
+{
+    can_twai_unregister_tx_hook(e2e_tx_hook, NULL);
+    can_twai_unregister_rx_hook(e2e_rx_hook, NULL);
+    free(tx_tab);
+    free(rx_tab);
+    tx_tab = rx_tab = NULL;
+    tx_count = rx_count = 0;
+}
+
+bool can_twai_e2e_get_stats(uint32_t identifier, can_twai_e2e_stats_t *out)
+{
+    if (out == NULL) {
+        return false;
+    }
+    e2e_entry_t *e = find_entry(rx_tab, rx_count, identifier);
+    if (e == NULL) {
+        e = find_entry(tx_tab, tx_count, identifier);
+    }
+    if (e == NULL) {
+        return false;
+    }
+    portENTER_CRITICAL(&e2e_lock);
+    *out = e->stats;
+    portEXIT_CRITICAL(&e2e_lock);
+    return true;
+}
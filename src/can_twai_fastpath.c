@@ -0,0 +1,223 @@
+/**
+ * @file can_twai_fastpath.c
+ * @brief Highest-priority dispatcher for low-latency CAN IDs
+ *
+ * The dispatcher is the only reader of the driver RX queue. Fast-path IDs
+ * are handled inline; everything else is copied into the forward queue,
+ * which can_twai_receive_timeout() reads through the RX source override.
+ * Driver errors are handed over to the next receive call so the adapter's
+ * error recovery still runs in the application's receiving task.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_fastpath.h"
+#include "can_twai_priv.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_fastpath";
+
+#define DEFAULT_FORWARD_LEN 32
+#define DEFAULT_STACK_SIZE  3072
+#define POLL_TICKS          pdMS_TO_TICKS(10)
+#define DROP_REPORT_US      1000000
+
+/** @brief One fast-path ID with its statistics */
+typedef struct {
+    can_twai_fastpath_entry_t cfg;
+    uint32_t                  calls;
+    uint32_t                  handler_max_us;
+    uint64_t                  handler_sum_us;
+} fast_entry_t;
+
+/** @brief Dispatcher state */
+typedef struct {
+    fast_entry_t       entries[CAN_TWAI_FASTPATH_MAX_IDS];
+    size_t             count;
+    QueueHandle_t      forward;
+    volatile esp_err_t pending_error;
+    volatile uint32_t  drops;
+    uint32_t           reported_drops;  /**< Drops already logged */
+    int64_t            reported_us;     /**< Time of the last drop report */
+    volatile bool      stop;
+    volatile bool      exited;
+    bool               running;
+} fastpath_t;
+
+static fastpath_t fp;
+static portMUX_TYPE fp_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static CAN_TWAI_HOT_ATTR fast_entry_t *find_entry(uint32_t identifier)
+{
+    for (size_t i = 0; i < fp.count; i++) {
+        if (fp.entries[i].cfg.identifier == identifier) {
+            return &fp.entries[i];
+        }
+    }
+    return NULL;
+}
+
+static CAN_TWAI_HOT_ATTR void dispatcher_task(void *arg)
+{
+    twai_message_t msg;
+
+    while (!fp.stop) {
+        esp_err_t err = can_twai_backend_receive(&msg, POLL_TICKS);
+        if (err != ESP_OK) {
+            if (err != ESP_ERR_TIMEOUT) {
+                // Leave recovery to the application's receive call
+                fp.pending_error = err;
+                vTaskDelay(POLL_TICKS);
+            }
+            continue;
+        }
+
+        int64_t t0 = esp_timer_get_time();
+        fast_entry_t *e = find_entry(msg.identifier);
+        if (e != NULL) {
+            e->cfg.handler(&msg, e->cfg.ctx);
+            uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+            portENTER_CRITICAL(&fp_lock);
+            e->calls++;
+            e->handler_sum_us += dt;
+            if (dt > e->handler_max_us) {
+                e->handler_max_us = dt;
+            }
+            portEXIT_CRITICAL(&fp_lock);
+
+            if (!e->cfg.forward) {
+                continue;
+            }
+        }
+
+        if (xQueueSend(fp.forward, &msg, 0) != pdTRUE) {
+            fp.drops++;
+        }
+    }
+
+    fp.exited = true;
+    vTaskDelete(NULL);
+}
+
+/** @brief Log forward-queue drops from the receiving task, at most once per second */
+static void report_drops(void)
+{
+    uint32_t drops = fp.drops;
+    int64_t now = esp_timer_get_time();
+    if (drops != fp.reported_drops && now - fp.reported_us >= DROP_REPORT_US) {
+        ESP_LOGW(TAG, "Forward queue full: %lu frames dropped (%lu total)",
+                 (unsigned long)(drops - fp.reported_drops), (unsigned long)drops);
+        fp.reported_drops = drops;
+        fp.reported_us = now;
+    }
+}
+
+/** @brief RX source for can_twai_receive_timeout(): forwarded frames and errors */
+static CAN_TWAI_HOT_ATTR esp_err_t forward_source(twai_message_t *msg, TickType_t timeout)
+{
+    if (fp.drops != fp.reported_drops) {
+        report_drops();
+    }
+    esp_err_t err = fp.pending_error;
+    if (err != ESP_OK) {
+        fp.pending_error = ESP_OK;
+        return err;
+    }
+    return xQueueReceive(fp.forward, msg, timeout) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+bool can_twai_fastpath_init(const can_twai_fastpath_config_t *cfg)
+{
+    if (fp.running) {
+        ESP_LOGE(TAG, "Fast path already running");
+        return false;
+    }
+    if (cfg == NULL || cfg->entries == NULL || cfg->count == 0 ||
+        cfg->count > CAN_TWAI_FASTPATH_MAX_IDS) {
+        ESP_LOGE(TAG, "Invalid configuration (1..%d IDs)", CAN_TWAI_FASTPATH_MAX_IDS);
+        return false;
+    }
+
+    memset(&fp, 0, sizeof(fp));
+    for (size_t i = 0; i < cfg->count; i++) {
+        if (cfg->entries[i].handler == NULL || find_entry(cfg->entries[i].identifier) != NULL) {
+            ESP_LOGE(TAG, "Missing handler or duplicate ID 0x%lX", cfg->entries[i].identifier);
+            return false;
+        }
+        fp.entries[i].cfg = cfg->entries[i];
+        fp.count = i + 1;
+    }
+
+    size_t queue_len = cfg->forward_queue_len ? cfg->forward_queue_len : DEFAULT_FORWARD_LEN;
+    fp.forward = xQueueCreate(queue_len, sizeof(twai_message_t));
+    if (fp.forward == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        return false;
+    }
+    fp.pending_error = ESP_OK;
+
+    can_twai_set_rx_source(forward_source);
+    uint32_t stack = cfg->stack_size ? cfg->stack_size : DEFAULT_STACK_SIZE;
+    if (xTaskCreatePinnedToCore(dispatcher_task, "can_fastpath", stack, NULL,
+                                configMAX_PRIORITIES - 1, NULL, cfg->core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create dispatcher task");
+        can_twai_set_rx_source(NULL);
+        vQueueDelete(fp.forward);
+        fp.forward = NULL;
+        return false;
+    }
+
+    fp.running = true;
+    ESP_LOGI(TAG, "Fast path started for %u IDs", (unsigned)fp.count);
+    return true;
+}
+
+void can_twai_fastpath_deinit(void)
+{
+    if (!fp.running) {
+        return;
+    }
+
+    can_twai_set_rx_source(NULL);
+    fp.stop = true;
+    while (!fp.exited) {
+        vTaskDelay(1);
+    }
+
+    if (fp.drops != 0) {
+        ESP_LOGW(TAG, "%lu frames dropped on full forward queue", (unsigned long)fp.drops);
+    }
+
+    // Frames still waiting for forwarding are lost with the queue
+    vQueueDelete(fp.forward);
+    fp.forward = NULL;
+    fp.running = false;
+}
+
+bool can_twai_fastpath_get_stats(uint32_t identifier, can_twai_fastpath_stats_t *out)
+{
+    fast_entry_t *e = fp.running ? find_entry(identifier) : NULL;
+    if (e == NULL || out == NULL) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&fp_lock);
+    out->calls = e->calls;
+    out->handler_max_us = e->handler_max_us;
+    out->handler_avg_us = e->calls ? (uint32_t)(e->handler_sum_us / e->calls) : 0;
+    portEXIT_CRITICAL(&fp_lock);
+    return true;
+}
+
+uint32_t can_twai_fastpath_get_forward_drops(void)
+{
+    return fp.drops;
+}
@@ -0,0 +1,405 @@
+/**
+ * @file can_twai_filter.c
+ * @brief Recursive-descent compiler and jump-free stack evaluator for filters
+ *
+ * The parser emits postfix code directly while it descends. It tracks the
+ * stack depth of the emitted code, so an evaluation can never over- or
+ * underflow and needs no checks at run time.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_filter.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "can_twai_priv.h"
+#else
+#define CAN_TWAI_HOT_ATTR
+#endif
+
+/** @brief Maximum nesting of parentheses and unary '!' (bounds parser recursion) */
+#define MAX_NESTING 32
+
+/** @brief Bytecode operations */
+typedef enum {
+    OP_CONST = 0,  /**< push arg */
+    OP_ID,         /**< push identifier */
+    OP_DLC,        /**< push DLC */
+    OP_EXT,        /**< push extended flag */
+    OP_RTR,        /**< push RTR flag */
+    OP_BYTE,       /**< push data[arg] (0 beyond DLC) */
+    OP_BAND,       /**< a & b */
+    OP_BOR,        /**< a | b */
+    OP_BXOR,       /**< a ^ b */
+    OP_SHL,        /**< a << b */
+    OP_SHR,        /**< a >> b */
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_IN,         /**< lo <= x <= hi, pops x lo hi */
+    OP_NOT,        /**< !a */
+    OP_LAND,       /**< a && b */
+    OP_LOR,        /**< a || b */
+} op_t;
+
+/** @brief One instruction */
+typedef struct {
+    uint8_t  op;
+    uint32_t arg;
+} insn_t;
+
+struct can_twai_filter {
+    size_t len;
+    insn_t code[];
+};
+
+/** @brief Parser state */
+typedef struct {
+    const char *src;
+    const char *pos;
+    insn_t      code[CAN_TWAI_FILTER_MAX_INSNS];
+    size_t      len;
+    int         depth;
+    int         nesting;
+    char       *err;
+    size_t      err_len;
+    bool        failed;
+} parser_t;
+
+static void fail(parser_t *p, const char *fmt, ...)
+{
+    if (p->failed) {
+        return;
+    }
+    p->failed = true;
+    if (p->err != NULL && p->err_len > 0) {
+        int n = snprintf(p->err, p->err_len, "col %d: ", (int)(p->pos - p->src) + 1);
+        if (n >= 0 && (size_t)n < p->err_len) {
+            va_list ap;
+            va_start(ap, fmt);
+            vsnprintf(p->err + n, p->err_len - n, fmt, ap);
+            va_end(ap);
+        }
+    }
+}
+
+/** @brief Emit an instruction with stack effect @p delta */
+static void emit(parser_t *p, op_t op, uint32_t arg, int delta)
+{
+    if (p->failed) {
+        return;
+    }
+    if (p->len >= CAN_TWAI_FILTER_MAX_INSNS) {
+        fail(p, "expression too long (max %d instructions)", CAN_TWAI_FILTER_MAX_INSNS);
+        return;
+    }
+    p->depth += delta;
+    if (p->depth > CAN_TWAI_FILTER_MAX_STACK) {
+        fail(p, "expression nested too deeply");
+        return;
+    }
+    p->code[p->len++] = (insn_t){ .op = (uint8_t)op, .arg = arg };
+}
+
+static void skip_space(parser_t *p)
+{
+    while (isspace((unsigned char)*p->pos)) {
+        p->pos++;
+    }
+}
+
+/** @brief Consume operator @p tok if it is next (and not the start of a longer one) */
+static bool accept(parser_t *p, const char *tok)
+{
+    skip_space(p);
+    size_t n = strlen(tok);
+    if (strncmp(p->pos, tok, n) != 0) {
+        return false;
+    }
+    // Keep "|" from matching "||", "<" from matching "<=" or "<<", ...
+    char next = p->pos[n];
+    if (n == 1 && ((strchr("&|<>", tok[0]) != NULL && next == tok[0]) ||
+                   (strchr("<>!", tok[0]) != NULL && next == '='))) {
+        return false;
+    }
+    p->pos += n;
+    return true;
+}
+
+/** @brief Consume keyword @p kw if it is the next whole word */
+static bool accept_word(parser_t *p, const char *kw)
+{
+    skip_space(p);
+    size_t n = strlen(kw);
+    if (strncmp(p->pos, kw, n) != 0 || isalnum((unsigned char)p->pos[n]) || p->pos[n] == '_') {
+        return false;
+    }
+    p->pos += n;
+    return true;
+}
+
+static void expect(parser_t *p, const char *tok)
+{
+    if (!accept(p, tok)) {
+        fail(p, "expected '%s'", tok);
+    }
+}
+
+static bool parse_number(parser_t *p, uint32_t *out)
+{
+    skip_space(p);
+    if (!isdigit((unsigned char)*p->pos)) {
+        return false;
+    }
+    char *end;
+    unsigned long long v = strtoull(p->pos, &end, 0);
+    if (v > UINT32_MAX || isalnum((unsigned char)*end)) {
+        fail(p, "invalid number");
+        return false;
+    }
+    p->pos = end;
+    *out = (uint32_t)v;
+    return true;
+}
+
+static void parse_or(parser_t *p);
+
+static void parse_primary(parser_t *p)
+{
+    uint32_t v;
+    if (p->failed) {
+        return;
+    }
+    if (parse_number(p, &v)) {
+        emit(p, OP_CONST, v, 1);
+    } else if (accept_word(p, "id")) {
+        emit(p, OP_ID, 0, 1);
+    } else if (accept_word(p, "dlc")) {
+        emit(p, OP_DLC, 0, 1);
+    } else if (accept_word(p, "ext")) {
+        emit(p, OP_EXT, 0, 1);
+    } else if (accept_word(p, "rtr")) {
+        emit(p, OP_RTR, 0, 1);
+    } else if (accept_word(p, "data")) {
+        expect(p, "[");
+        if (!p->failed && (!parse_number(p, &v) || v > 7)) {
+            fail(p, "expected byte index 0..7");
+        }
+        expect(p, "]");
+        emit(p, OP_BYTE, v, 1);
+    } else if (accept(p, "(")) {
+        if (++p->nesting > MAX_NESTING) {
+            fail(p, "parentheses nested too deeply");
+            return;
+        }
+        parse_or(p);
+        expect(p, ")");
+        p->nesting--;
+    } else {
+        fail(p, *p->pos ? "unexpected '%c'" : "unexpected end of expression", *p->pos);
+    }
+}
+
+static void parse_shift(parser_t *p)
+{
+    parse_primary(p);
+    for (;;) {
+        if (accept(p, "<<")) {
+            parse_primary(p);
+            emit(p, OP_SHL, 0, -1);
+        } else if (accept(p, ">>")) {
+            parse_primary(p);
+            emit(p, OP_SHR, 0, -1);
+        } else {
+            return;
+        }
+    }
+}
+
+static void parse_band(parser_t *p)
+{
+    parse_shift(p);
+    while (accept(p, "&")) {
+        parse_shift(p);
+        emit(p, OP_BAND, 0, -1);
+    }
+}
+
+static void parse_bxor(parser_t *p)
+{
+    parse_band(p);
+    while (accept(p, "^")) {
+        parse_band(p);
+        emit(p, OP_BXOR, 0, -1);
+    }
+}
+
+static void parse_bor(parser_t *p)
+{
+    parse_bxor(p);
+    while (accept(p, "|")) {
+        parse_bxor(p);
+        emit(p, OP_BOR, 0, -1);
+    }
+}
+
+static void parse_rel(parser_t *p)
+{
+    static const struct {
+        const char *tok;
+        op_t        op;
+    } rel[] = {
+        { "==", OP_EQ }, { "!=", OP_NE }, { "<=", OP_LE }, { ">=", OP_GE }, { "<", OP_LT }, { ">", OP_GT },
+    };
+
+    parse_bor(p);
+    if (accept_word(p, "in")) {
+        parse_bor(p);
+        expect(p, "..");
+        parse_bor(p);
+        emit(p, OP_IN, 0, -2);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(rel) / sizeof(rel[0]); i++) {
+        if (accept(p, rel[i].tok)) {
+            parse_bor(p);
+            emit(p, rel[i].op, 0, -1);
+            return;
+        }
+    }
+}
+
+static void parse_not(parser_t *p)
+{
+    if (accept(p, "!") || accept_word(p, "not")) {
+        if (++p->nesting > MAX_NESTING) {
+            fail(p, "'!' nested too deeply");
+            return;
+        }
+        parse_not(p);
+        emit(p, OP_NOT, 0, 0);
+        p->nesting--;
+    } else {
+        parse_rel(p);
+    }
+}
+
+static void parse_and(parser_t *p)
+{
+    parse_not(p);
+    while (accept(p, "&&") || accept_word(p, "and")) {
+        parse_not(p);
+        emit(p, OP_LAND, 0, -1);
+    }
+}
+
+static void parse_or(parser_t *p)
+{
+    parse_and(p);
+    while (accept(p, "||") || accept_word(p, "or")) {
+        parse_and(p);
+        emit(p, OP_LOR, 0, -1);
+    }
+}
+
+can_twai_filter_t *can_twai_filter_compile(const char *expr, char *err, size_t err_len)
+{
+    if (err != NULL && err_len > 0) {
+        err[0] = '\0';
+    }
+    if (expr == NULL) {
+        return NULL;
+    }
+
+    parser_t *p = calloc(1, sizeof(parser_t));
+    if (p == NULL) {
+        return NULL;
+    }
+    p->src = expr;
+    p->pos = expr;
+    p->err = err;
+    p->err_len = err_len;
+
+    parse_or(p);
+    skip_space(p);
+    if (!p->failed && *p->pos != '\0') {
+        fail(p, "unexpected '%c'", *p->pos);
+    }
+
+    can_twai_filter_t *f = NULL;
+    if (!p->failed) {
+        f = malloc(sizeof(can_twai_filter_t) + p->len * sizeof(insn_t));
+        if (f != NULL) {
+            f->len = p->len;
+            memcpy(f->code, p->code, p->len * sizeof(insn_t));
+        } else if (err != NULL && err_len > 0) {
+            snprintf(err, err_len, "out of memory");
+        }
+    }
+    free(p);
+    return f;
+}
+
+void can_twai_filter_free(can_twai_filter_t *filter)
+{
+    free(filter);
+}
+
+size_t can_twai_filter_length(const can_twai_filter_t *filter)
+{
+    return filter != NULL ? filter->len : 0;
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_filter_match(const can_twai_filter_t *filter,
+                                             const can_twai_filter_frame_t *frame)
+{
+    if (filter == NULL) {
+        return true;
+    }
+
+    uint32_t st[CAN_TWAI_FILTER_MAX_STACK];
+    int sp = 0;  // the compiler guarantees 0 <= sp <= MAX_STACK
+    uint8_t dlc = frame->dlc > 8 ? 8 : frame->dlc;
+
+    for (size_t i = 0; i < filter->len; i++) {
+        const insn_t *in = &filter->code[i];
+        uint32_t b;
+        switch (in->op) {
+        case OP_CONST: st[sp++] = in->arg;                                        break;
+        case OP_ID:    st[sp++] = frame->identifier;                              break;
+        case OP_DLC:   st[sp++] = frame->dlc;                                     break;
+        case OP_EXT:   st[sp++] = frame->extd;                                    break;
+        case OP_RTR:   st[sp++] = frame->rtr;                                     break;
+        case OP_BYTE:  st[sp++] = in->arg < dlc ? frame->data[in->arg] : 0;       break;
+        case OP_BAND:  b = st[--sp]; st[sp - 1] &= b;                             break;
+        case OP_BOR:   b = st[--sp]; st[sp - 1] |= b;                             break;
+        case OP_BXOR:  b = st[--sp]; st[sp - 1] ^= b;                             break;
+        case OP_SHL:   b = st[--sp]; st[sp - 1] = b < 32 ? st[sp - 1] << b : 0;   break;
+        case OP_SHR:   b = st[--sp]; st[sp - 1] = b < 32 ? st[sp - 1] >> b : 0;   break;
+        case OP_EQ:    b = st[--sp]; st[sp - 1] = st[sp - 1] == b;                break;
+        case OP_NE:    b = st[--sp]; st[sp - 1] = st[sp - 1] != b;                break;
+        case OP_LT:    b = st[--sp]; st[sp - 1] = st[sp - 1] < b;                 break;
+        case OP_LE:    b = st[--sp]; st[sp - 1] = st[sp - 1] <= b;                break;
+        case OP_GT:    b = st[--sp]; st[sp - 1] = st[sp - 1] > b;                 break;
+        case OP_GE:    b = st[--sp]; st[sp - 1] = st[sp - 1] >= b;                break;
+        case OP_IN:
+            sp -= 2;
+            st[sp - 1] = st[sp - 1] >= st[sp] && st[sp - 1] <= st[sp + 1];
+            break;
+        case OP_NOT:   st[sp - 1] = !st[sp - 1];                                  break;
+        case OP_LAND:  b = st[--sp]; st[sp - 1] = st[sp - 1] && b;                break;
+        case OP_LOR:   b = st[--sp]; st[sp - 1] = st[sp - 1] || b;                break;
+        default:                                                                  break;
+        }
+    }
+    return sp > 0 && st[sp - 1] != 0;
+}
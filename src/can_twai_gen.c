@@ -0,0 +1,440 @@
+/**
+ * @file can_twai_gen.c
+ * @brief Bus load traffic generator
+ *
+ * The bit budget is kept in nanobits: a timer period of dt microseconds at
+ * bitrate b and load l per mille earns dt * b * l nanobits, and a frame of
+ * n bits costs n * 10^9. The budget is capped at two periods (plus one
+ * burst), so a stall of the task or a full TX queue is not made up for by
+ * a flood afterwards.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_gen.h"
+#include "can_twai.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_gen";
+
+#define MAX_BURST          32
+#define DEFAULT_PERIOD_US  1000
+#define DEFAULT_SEED       0x2545F491u
+#define TASK_STACK         4096
+#define NANOBITS           1000000000ull
+
+#define STD_ID_MAX 0x7FFu
+#define EXT_ID_MAX 0x1FFFFFFFu
+
+/** @brief CRC delimiter, ACK slot and delimiter, EOF, intermission */
+#define TRAILER_BITS (1 + 2 + 7 + 3)
+
+/** @brief Generator state */
+typedef struct {
+    can_twai_gen_config_t  cfg;
+    uint32_t               dlc_cdf[TWAI_FRAME_MAX_DLC + 1];  /**< Cumulative DLC weights */
+    uint32_t               dlc_total;
+    uint32_t               next_id;      /**< Sequential mode position */
+    uint32_t               counter;      /**< Counter payload */
+    uint32_t               rng;          /**< xorshift32 state */
+    volatile uint32_t      load_permille;
+    TaskHandle_t           task;
+    esp_timer_handle_t     timer;
+    int64_t                start_us;
+    int64_t                stop_us;
+    can_twai_gen_stats_t   st;
+    volatile bool          stop;
+    volatile bool          exited;
+    bool                   running;
+} gen_t;
+
+static gen_t gen;
+static portMUX_TYPE gen_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t next_random(void)
+{
+    uint32_t x = gen.rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gen.rng = x;
+    return x;
+}
+
+// --------------------------------------------------------------------------------------
+// Exact frame length
+// --------------------------------------------------------------------------------------
+/** @brief Bits from SOF to the end of the CRC, before stuffing */
+typedef struct {
+    uint8_t bit[128];
+    uint32_t len;
+} bitstream_t;
+
+static void put_bits(bitstream_t *bs, uint32_t value, uint32_t count)
+{
+    while (count-- > 0) {
+        bs->bit[bs->len++] = (value >> count) & 1u;
+    }
+}
+
+uint32_t can_twai_gen_frame_bits(const twai_message_t *msg)
+{
+    bitstream_t bs = { .len = 0 };
+    uint8_t dlc = msg->data_length_code;
+    uint32_t data_bytes = msg->rtr ? 0 : (dlc > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : dlc);
+
+    put_bits(&bs, 0, 1);                              // SOF
+    if (msg->extd) {
+        put_bits(&bs, msg->identifier >> 18, 11);     // base ID
+        put_bits(&bs, 1, 1);                          // SRR
+        put_bits(&bs, 1, 1);                          // IDE
+        put_bits(&bs, msg->identifier, 18);           // extended ID
+        put_bits(&bs, msg->rtr, 1);                   // RTR
+        put_bits(&bs, 0, 2);                          // r1, r0
+    } else {
+        put_bits(&bs, msg->identifier, 11);
+        put_bits(&bs, msg->rtr, 1);                   // RTR
+        put_bits(&bs, 0, 2);                          // IDE, r0
+    }
+    put_bits(&bs, dlc, 4);
+    for (uint32_t i = 0; i < data_bytes; i++) {
+        put_bits(&bs, msg->data[i], 8);
+    }
+
+    // CRC-15 (x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1)
+    uint32_t crc = 0;
+    for (uint32_t i = 0; i < bs.len; i++) {
+        uint32_t nxt = bs.bit[i] ^ ((crc >> 14) & 1u);
+        crc = (crc << 1) & 0x7FFFu;
+        if (nxt) {
+            crc ^= 0x4599u;
+        }
+    }
+    put_bits(&bs, crc, 15);
+
+    // A stuff bit follows every run of five equal bits and starts the next run
+    uint32_t stuff = 0;
+    uint32_t run = 1;
+    uint8_t last = bs.bit[0];
+    for (uint32_t i = 1; i < bs.len; i++) {
+        if (bs.bit[i] == last) {
+            if (++run == 5) {
+                stuff++;
+                last = !last;
+                run = 1;
+            }
+        } else {
+            last = bs.bit[i];
+            run = 1;
+        }
+    }
+    return bs.len + stuff + TRAILER_BITS;
+}
+
+// --------------------------------------------------------------------------------------
+// Frame construction
+// --------------------------------------------------------------------------------------
+static uint32_t pick_id(void)
+{
+    const can_twai_gen_config_t *c = &gen.cfg;
+    uint32_t span = c->ids != NULL ? (uint32_t)c->id_count : c->id_max - c->id_min + 1;
+    uint32_t k;
+    switch (c->id_mode) {
+    case CAN_TWAI_GEN_IDS_SEQUENTIAL:
+        k = gen.next_id;
+        gen.next_id = k + 1 == span ? 0 : k + 1;
+        break;
+    case CAN_TWAI_GEN_IDS_RANDOM:
+        k = span ? next_random() % span : 0;
+        break;
+    default:
+        k = 0;
+        break;
+    }
+    return c->ids != NULL ? c->ids[k] : c->id_min + k;
+}
+
+static uint8_t pick_dlc(void)
+{
+    if (gen.dlc_total == 0) {
+        return TWAI_FRAME_MAX_DLC;
+    }
+    uint32_t r = next_random() % gen.dlc_total;
+    uint8_t dlc = 0;
+    while (r >= gen.dlc_cdf[dlc]) {
+        dlc++;
+    }
+    return dlc;
+}
+
+static void put_le(uint8_t *p, uint64_t v, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static void build_frame(twai_message_t *msg)
+{
+    memset(msg, 0, sizeof(*msg));
+    msg->extd = gen.cfg.extd;
+    msg->identifier = pick_id();
+    msg->data_length_code = pick_dlc();
+
+    switch (gen.cfg.payload) {
+    case CAN_TWAI_GEN_PAYLOAD_RANDOM:
+        for (uint8_t i = 0; i < msg->data_length_code; i += 4) {
+            uint8_t n = msg->data_length_code - i < 4 ? msg->data_length_code - i : 4;
+            put_le(&msg->data[i], next_random(), n);
+        }
+        break;
+    case CAN_TWAI_GEN_PAYLOAD_TIMESTAMP:
+        put_le(msg->data, (uint64_t)esp_timer_get_time(), msg->data_length_code);
+        break;
+    default:
+        put_le(msg->data, gen.counter, msg->data_length_code < 4 ? msg->data_length_code : 4);
+        break;
+    }
+    gen.counter++;
+}
+
+// --------------------------------------------------------------------------------------
+// Generator task
+// --------------------------------------------------------------------------------------
+static void timer_tick(void *arg)
+{
+    xTaskNotifyGive(gen.task);
+}
+
+static void gen_task(void *arg)
+{
+    const uint32_t burst = gen.cfg.burst_frames;
+    twai_message_t frames[MAX_BURST];
+    uint32_t bits[MAX_BURST];
+    size_t first = 0;
+    size_t pending = 0;
+    uint64_t pending_cost = 0;
+    uint64_t budget = 0;
+    int64_t last_us = esp_timer_get_time();
+
+    while (!gen.stop) {
+        uint32_t ticks = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        if (ticks == 0 || gen.stop) {
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        uint64_t rate = (uint64_t)gen.cfg.bitrate * gen.load_permille;  // nanobits per us
+        budget += (uint64_t)(now - last_us) * rate;
+        last_us = now;
+
+        bool refused = false;
+        uint32_t sent_frames = 0;
+        uint64_t sent_bits = 0;
+        uint32_t bursts = 0;
+        for (;;) {
+            if (pending == 0) {
+                first = 0;
+                pending_cost = 0;
+                for (uint32_t i = 0; i < burst; i++) {
+                    build_frame(&frames[i]);
+                    bits[i] = can_twai_gen_frame_bits(&frames[i]);
+                    pending_cost += bits[i];
+                }
+                pending = burst;
+            }
+            if (budget < pending_cost * NANOBITS) {
+                break;
+            }
+
+            size_t sent = burst == 1 ? can_twai_send_timeout(&frames[first], 0)
+                                     : can_twai_send_batch(&frames[first], pending, 0);
+            for (size_t i = 0; i < sent; i++) {
+                pending_cost -= bits[first + i];
+                sent_bits += bits[first + i];
+                budget -= (uint64_t)bits[first + i] * NANOBITS;
+            }
+            sent_frames += sent;
+            first += sent;
+            pending -= sent;
+            if (pending > 0) {
+                refused = true;  // rest of the burst follows once there is room
+                break;
+            }
+            bursts += burst > 1;
+        }
+
+        // Do not save up for more than two periods plus the frames waiting
+        uint64_t cap = 2 * (uint64_t)gen.cfg.period_us * rate + pending_cost * NANOBITS;
+        if (budget > cap) {
+            budget = cap;
+        }
+
+        portENTER_CRITICAL(&gen_lock);
+        gen.st.ticks++;
+        gen.st.missed_ticks += ticks - 1;
+        gen.st.frames += sent_frames;
+        gen.st.bits += sent_bits;
+        gen.st.bursts += bursts;
+        gen.st.queue_full += refused;
+        portEXIT_CRITICAL(&gen_lock);
+    }
+    gen.exited = true;
+    vTaskDelete(NULL);
+}
+
+// --------------------------------------------------------------------------------------
+// Control
+// --------------------------------------------------------------------------------------
+static bool validate(const can_twai_gen_config_t *cfg)
+{
+    uint32_t id_limit = cfg->extd ? EXT_ID_MAX : STD_ID_MAX;
+    if (cfg->bitrate == 0 || cfg->load_permille == 0 || cfg->load_permille > 1000) {
+        ESP_LOGE(TAG, "Invalid bitrate %lu or load %lu permille", (unsigned long)cfg->bitrate,
+                 (unsigned long)cfg->load_permille);
+        return false;
+    }
+    if (cfg->id_mode > CAN_TWAI_GEN_IDS_RANDOM || cfg->payload > CAN_TWAI_GEN_PAYLOAD_TIMESTAMP) {
+        ESP_LOGE(TAG, "Invalid ID mode or payload type");
+        return false;
+    }
+    if (cfg->ids != NULL) {
+        if (cfg->id_count == 0) {
+            ESP_LOGE(TAG, "Empty ID list");
+            return false;
+        }
+        for (size_t i = 0; i < cfg->id_count; i++) {
+            if (cfg->ids[i] > id_limit) {
+                ESP_LOGE(TAG, "ID 0x%lX out of range", (unsigned long)cfg->ids[i]);
+                return false;
+            }
+        }
+    } else if (cfg->id_min > cfg->id_max || cfg->id_max > id_limit) {
+        ESP_LOGE(TAG, "Invalid ID range 0x%lX..0x%lX", (unsigned long)cfg->id_min,
+                 (unsigned long)cfg->id_max);
+        return false;
+    }
+    if (cfg->burst_frames > MAX_BURST) {
+        ESP_LOGE(TAG, "Burst of %u frames exceeds %d", cfg->burst_frames, MAX_BURST);
+        return false;
+    }
+    return true;
+}
+
+bool can_twai_gen_start(const can_twai_gen_config_t *cfg)
+{
+    if (gen.running) {
+        ESP_LOGE(TAG, "Generator already running");
+        return false;
+    }
+    if (cfg == NULL || !validate(cfg)) {
+        return false;
+    }
+
+    memset(&gen, 0, sizeof(gen));
+    gen.cfg = *cfg;
+    gen.cfg.burst_frames = cfg->burst_frames ? cfg->burst_frames : 1;
+    gen.cfg.period_us = cfg->period_us ? cfg->period_us : DEFAULT_PERIOD_US;
+    gen.rng = cfg->seed ? cfg->seed : DEFAULT_SEED;
+    gen.load_permille = cfg->load_permille;
+    for (int d = 0; d <= TWAI_FRAME_MAX_DLC; d++) {
+        gen.dlc_total += cfg->dlc_weights[d];
+        gen.dlc_cdf[d] = gen.dlc_total;
+    }
+
+    UBaseType_t prio = cfg->task_priority ? cfg->task_priority : configMAX_PRIORITIES - 2;
+    if (xTaskCreate(gen_task, "can_gen", TASK_STACK, NULL, prio, &gen.task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create generator task");
+        return false;
+    }
+
+    const esp_timer_create_args_t args = {
+        .callback = timer_tick,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "can_gen",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&args, &gen.timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer");
+        gen.stop = true;
+        while (!gen.exited) {
+            vTaskDelay(1);
+        }
+        return false;
+    }
+    gen.start_us = esp_timer_get_time();
+    gen.running = true;
+    esp_timer_start_periodic(gen.timer, gen.cfg.period_us);
+
+    ESP_LOGI(TAG, "Generating %lu.%lu %% load at %lu bit/s, bursts of %u, period %lu us",
+             (unsigned long)(cfg->load_permille / 10), (unsigned long)(cfg->load_permille % 10),
+             (unsigned long)cfg->bitrate, gen.cfg.burst_frames, (unsigned long)gen.cfg.period_us);
+    return true;
+}
+
+void can_twai_gen_stop(void)
+{
+    if (!gen.running) {
+        return;
+    }
+    esp_timer_stop(gen.timer);
+    esp_timer_delete(gen.timer);
+    gen.stop = true;
+    xTaskNotifyGive(gen.task);
+    while (!gen.exited) {
+        vTaskDelay(1);
+    }
+    gen.stop_us = esp_timer_get_time();
+    gen.running = false;
+}
+
+void can_twai_gen_set_load(uint32_t load_permille)
+{
+    if (load_permille == 0 || load_permille > 1000) {
+        ESP_LOGE(TAG, "Invalid load %lu permille", (unsigned long)load_permille);
+        return;
+    }
+    gen.load_permille = load_permille;
+}
+
+void can_twai_gen_get_stats(can_twai_gen_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    int64_t end = gen.running ? esp_timer_get_time() : gen.stop_us;
+    portENTER_CRITICAL(&gen_lock);
+    *out = gen.st;
+    portEXIT_CRITICAL(&gen_lock);
+
+    out->requested_permille = gen.load_permille;
+    out->elapsed_us = gen.start_us ? end - gen.start_us : 0;
+    if (out->elapsed_us > 0 && gen.cfg.bitrate > 0) {
+        out->achieved_permille = (uint32_t)(out->bits * 1000000000ull /
+                                            ((uint64_t)out->elapsed_us * gen.cfg.bitrate));
+        out->frames_per_sec = (uint32_t)(out->frames * 1000000ull / (uint64_t)out->elapsed_us);
+    }
+}
+
+void can_twai_gen_log_report(void)
+{
+    can_twai_gen_stats_t st;
+    can_twai_gen_get_stats(&st);
+    ESP_LOGI(TAG, "Load requested %lu.%lu %%, achieved %lu.%lu %% (%lu frames/s, %llu frames in %lld ms)",
+             (unsigned long)(st.requested_permille / 10), (unsigned long)(st.requested_permille % 10),
+             (unsigned long)(st.achieved_permille / 10), (unsigned long)(st.achieved_permille % 10),
+             (unsigned long)st.frames_per_sec, (unsigned long long)st.frames,
+             (long long)(st.elapsed_us / 1000));
+    if (st.queue_full > 0 || st.missed_ticks > 0) {
+        ESP_LOGW(TAG, "TX path full on %lu of %lu ticks, %lu ticks late",
+                 (unsigned long)st.queue_full, (unsigned long)st.ticks,
+                 (unsigned long)st.missed_ticks);
+    }
+}
@@ -0,0 +1,269 @@
+/**
+ * @file can_twai_group.c
+ * @brief Multi-message snapshot groups with wait-free reads
+ *
+ * All groups share one receive-path hook, which walks the group list
+ * without a lock; each group has its own spinlock for assembling cycles,
+ * so receivers of different groups never contend. A group is unlinked
+ * first and freed only after can_twai_sync_rx_hooks() has waited out the
+ * dispatches that might still see it.
+ *
+ * Completed cycles are published through four buffers. The word "front"
+ * holds the published buffer index in its low two bits and, above them, the
+ * number of readers that pinned it since it was published. A reader pins
+ * with one fetch_add (which also tells it the index), copies and releases
+ * with one fetch_add on the buffer's release counter: a fixed number of
+ * steps, no retry. On publication the writer swaps the index in and adds
+ * the swapped-out pin count to that buffer's acquire count; it only writes
+ * a spare buffer whose release count has caught up with that. With three
+ * spares, a cycle is only skipped if slow readers still hold all of them.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_group.h"
+#include "can_twai_priv.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_group";
+
+#define GROUP_BUFFERS 4
+#define FRONT_INDEX   3u            /**< Published buffer bits of front */
+#define FRONT_PIN     4u            /**< One reader pin in front */
+#define PIN_MASK      0x3FFFFFFFu   /**< Pins are counted modulo 2^30 */
+
+/** @brief One publication buffer */
+typedef struct {
+    can_twai_group_snapshot_t snap;
+    _Atomic uint32_t          released;  /**< Readers done with this buffer */
+    uint32_t                  acquired;  /**< Readers that pinned it (writer only) */
+} group_buffer_t;
+
+struct can_twai_group {
+    can_twai_group_t *_Atomic next;     /**< Link in the module's group list */
+    portMUX_TYPE            lock;       /**< Serializes receivers of this group */
+    can_twai_group_config_t cfg;        /**< Copy of configuration (ids points to members) */
+    uint32_t                members[CAN_TWAI_GROUP_MAX_MEMBERS];
+
+    // Cycle being assembled (receive path only)
+    twai_message_t          pending[CAN_TWAI_GROUP_MAX_MEMBERS];
+    uint32_t                pending_bits;   /**< Members received in this cycle */
+    uint8_t                 pending_ctr;    /**< COUNTER: counter of this cycle */
+    int64_t                 pending_start;  /**< WINDOW: reception time of first member */
+
+    // Published cycles
+    group_buffer_t          buf[GROUP_BUFFERS];
+    _Atomic uint32_t        front;          /**< Published index | pins since * FRONT_PIN */
+
+    can_twai_group_stats_t  stats;
+};
+
+/** @brief All groups attached to the receive path */
+static can_twai_group_t *_Atomic groups = NULL;
+
+/** @brief Serializes changes of the group list (not its traversal) */
+static portMUX_TYPE list_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/** @brief Publish the pending cycle (group lock held) */
+static CAN_TWAI_HOT_ATTR void publish(can_twai_group_t *g, int64_t rx_time_us)
+{
+    // Only the writer changes the index bits, so they are stable here
+    uint32_t cur = atomic_load_explicit(&g->front, memory_order_relaxed) & FRONT_INDEX;
+    group_buffer_t *b = NULL;
+    uint32_t back = 0;
+    for (uint32_t i = 0; i < GROUP_BUFFERS && b == NULL; i++) {
+        uint32_t released = atomic_load_explicit(&g->buf[i].released, memory_order_acquire);
+        if (i != cur && ((released - g->buf[i].acquired) & PIN_MASK) == 0) {
+            b = &g->buf[i];
+            back = i;
+        }
+    }
+    if (b == NULL) {
+        g->stats.skipped++;  // readers still copy every spare buffer
+        return;
+    }
+
+    memcpy(b->snap.msgs, g->pending, g->cfg.count * sizeof(twai_message_t));
+    b->snap.count = g->cfg.count;
+    b->snap.timestamp_us = rx_time_us;
+    b->snap.cycle = ++g->stats.completed;
+
+    uint32_t old = atomic_exchange_explicit(&g->front, back, memory_order_acq_rel);
+    g->buf[old & FRONT_INDEX].acquired += old / FRONT_PIN;
+}
+
+static CAN_TWAI_HOT_ATTR void start_cycle(can_twai_group_t *g, uint8_t ctr, int64_t rx_time_us)
+{
+    if (g->pending_bits != 0) {
+        g->stats.incomplete++;
+    }
+    g->pending_bits = 0;
+    g->pending_ctr = ctr;
+    g->pending_start = rx_time_us;
+}
+
+static CAN_TWAI_HOT_ATTR void group_add(can_twai_group_t *g, int idx, const twai_message_t *msg, int64_t rx_time_us)
+{
+    uint32_t bit = 1u << idx;
+    uint8_t ctr = 0;
+
+    if (g->cfg.match == CAN_TWAI_GROUP_MATCH_COUNTER) {
+        if (msg->data_length_code <= g->cfg.counter_byte) {
+            return;  // frame too short to carry the counter
+        }
+        ctr = msg->data[g->cfg.counter_byte] & g->cfg.counter_mask;
+        if (g->pending_bits == 0 || ctr != g->pending_ctr) {
+            start_cycle(g, ctr, rx_time_us);
+        }
+    } else {
+        if (g->pending_bits == 0 ||
+            (g->pending_bits & bit) != 0 ||
+            rx_time_us - g->pending_start > (int64_t)g->cfg.window_us) {
+            start_cycle(g, 0, rx_time_us);
+        }
+    }
+
+    g->pending[idx] = *msg;
+    g->pending_bits |= bit;
+
+    if (g->pending_bits == (1u << g->cfg.count) - 1u) {
+        publish(g, rx_time_us);
+        g->pending_bits = 0;
+    }
+}
+
+static CAN_TWAI_HOT_ATTR bool group_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    (void)ctx;
+    for (can_twai_group_t *g = atomic_load_explicit(&groups, memory_order_acquire); g != NULL;
+         g = atomic_load_explicit(&g->next, memory_order_acquire)) {
+        for (size_t i = 0; i < g->cfg.count; i++) {
+            if (g->members[i] == msg->identifier) {
+                portENTER_CRITICAL(&g->lock);
+                group_add(g, (int)i, msg, rx_time_us);
+                portEXIT_CRITICAL(&g->lock);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+can_twai_group_t *can_twai_group_create(const can_twai_group_config_t *cfg)
+{
+    if (cfg == NULL || cfg->ids == NULL || cfg->count == 0 ||
+        cfg->count > CAN_TWAI_GROUP_MAX_MEMBERS) {
+        ESP_LOGE(TAG, "Invalid group configuration");
+        return NULL;
+    }
+    if (cfg->match == CAN_TWAI_GROUP_MATCH_COUNTER &&
+        (cfg->counter_byte >= TWAI_FRAME_MAX_DLC || cfg->counter_mask == 0)) {
+        ESP_LOGE(TAG, "Invalid counter position (byte=%u, mask=0x%02X)",
+                 cfg->counter_byte, cfg->counter_mask);
+        return NULL;
+    }
+
+    for (size_t i = 1; i < cfg->count; i++) {
+        for (size_t k = 0; k < i; k++) {
+            if (cfg->ids[i] == cfg->ids[k]) {
+                ESP_LOGE(TAG, "Duplicate member ID 0x%lX", (unsigned long)cfg->ids[i]);
+                return NULL;
+            }
+        }
+    }
+
+    can_twai_group_t *g = can_twai_hot_calloc(1, sizeof(can_twai_group_t));
+    if (g == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        return NULL;
+    }
+    g->cfg = *cfg;
+    memcpy(g->members, cfg->ids, cfg->count * sizeof(uint32_t));
+    g->cfg.ids = g->members;
+    static const portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    g->lock = unlocked;
+    for (size_t i = 0; i < GROUP_BUFFERS; i++) {
+        atomic_init(&g->buf[i].released, 0);
+    }
+    atomic_init(&g->front, 0);  // buffer 0, cycle 0: nothing published
+
+    portENTER_CRITICAL(&list_lock);
+    can_twai_group_t *head = atomic_load_explicit(&groups, memory_order_relaxed);
+    bool first = (head == NULL);
+    atomic_init(&g->next, head);
+    atomic_store_explicit(&groups, g, memory_order_release);
+    portEXIT_CRITICAL(&list_lock);
+
+    if (first && !can_twai_register_rx_hook(group_rx_hook, NULL)) {
+        portENTER_CRITICAL(&list_lock);
+        atomic_store_explicit(&groups, NULL, memory_order_relaxed);
+        portEXIT_CRITICAL(&list_lock);
+        free(g);
+        return NULL;
+    }
+
+    ESP_LOGI(TAG, "Snapshot group created (%u members, %s matching)", (unsigned)cfg->count,
+             cfg->match == CAN_TWAI_GROUP_MATCH_COUNTER ? "counter" : "window");
+    return g;
+}
+
+void can_twai_group_destroy(can_twai_group_t *group)
+{
+    if (group == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&list_lock);
+    for (can_twai_group_t *_Atomic *pp = &groups; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == group) {
+            atomic_store_explicit(pp, atomic_load_explicit(&group->next, memory_order_relaxed),
+                                  memory_order_release);
+            break;
+        }
+    }
+    bool last = (atomic_load_explicit(&groups, memory_order_relaxed) == NULL);
+    portEXIT_CRITICAL(&list_lock);
+
+    // Both wait for dispatches that may still walk through this group
+    if (last) {
+        can_twai_unregister_rx_hook(group_rx_hook, NULL);
+    } else {
+        can_twai_sync_rx_hooks();
+    }
+    free(group);
+}
+
+bool can_twai_group_read(const can_twai_group_t *group, can_twai_group_snapshot_t *out)
+{
+    if (group == NULL || out == NULL) {
+        return false;
+    }
+
+    can_twai_group_t *g = (can_twai_group_t *)group;
+    // Pin the published buffer; the writer leaves it alone until released
+    uint32_t f = atomic_fetch_add_explicit(&g->front, FRONT_PIN, memory_order_acquire) & FRONT_INDEX;
+    group_buffer_t *b = &g->buf[f];
+    bool ok = b->snap.cycle != 0;  // nothing published yet
+    if (ok) {
+        *out = b->snap;
+    }
+    atomic_fetch_add_explicit(&b->released, 1, memory_order_release);
+    return ok;
+}
+
+void can_twai_group_get_stats(const can_twai_group_t *group, can_twai_group_stats_t *out)
+{
+    if (group == NULL || out == NULL) {
+        return;
+    }
+    can_twai_group_t *g = (can_twai_group_t *)group;
+    portENTER_CRITICAL(&g->lock);
+    *out = g->stats;
+    portEXIT_CRITICAL(&g->lock);
+}
@@ -0,0 +1,271 @@
+/**
+ * @file can_twai_hybrid.c
+ * @brief Hybrid interrupt/polling receive with automatic switchover
+ *
+ * The receiver task has two states. In interrupt mode it blocks for the
+ * first frame, takes everything queued behind it and counts frames whose
+ * spacing is below enter_gap_us; reaching enter_frames switches to polling
+ * mode. In polling mode it sleeps poll_interval ticks and drains the queue
+ * without blocking; idle_polls empty polls in a row switch back. A full
+ * batch is delivered and draining continues, so a long burst never waits
+ * for the next poll.
+ *
+ * "Empty" means no frame was taken from the queue. Frames consumed by RX
+ * hooks or dropped for an invalid DLC still count as traffic, so they
+ * neither end a drain early nor make a poll look idle.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_hybrid.h"
+#include "can_twai.h"
+#include "can_twai_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_hybrid";
+
+#define DEFAULT_BATCH_MAX    32
+#define DEFAULT_STACK_SIZE   3072
+#define DEFAULT_ENTER_FRAMES 4
+#define DEFAULT_IDLE_POLLS   2
+#define WAIT_TICKS           pdMS_TO_TICKS(100)  /**< Interrupt-mode block, bounds stop latency */
+
+/** @brief Module state */
+typedef struct {
+    can_twai_hybrid_mode_t       mode;
+    can_twai_hybrid_thresholds_t th;
+    can_twai_hybrid_handler_t    handler;
+    void                        *ctx;
+    twai_message_t              *batch;
+    size_t                       batch_max;
+    can_twai_hybrid_stats_t      st;
+    int64_t                      poll_since_us;
+    volatile bool                stop;
+    volatile bool                exited;
+    bool                         running;
+} hybrid_t;
+
+static hybrid_t hy;
+static portMUX_TYPE hy_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void apply_defaults(can_twai_hybrid_thresholds_t *th)
+{
+    if (th->poll_interval == 0) {
+        th->poll_interval = 1;
+    }
+    if (th->enter_frames == 0) {
+        th->enter_frames = DEFAULT_ENTER_FRAMES;
+    }
+    if (th->enter_gap_us == 0) {
+        th->enter_gap_us = 2 * pdTICKS_TO_MS(th->poll_interval) * 1000;
+    }
+    if (th->idle_polls == 0) {
+        th->idle_polls = DEFAULT_IDLE_POLLS;
+    }
+}
+
+/** @brief Deliver a batch and account it */
+static void deliver(size_t n, int64_t start_us)
+{
+    if (n > 0) {
+        hy.handler(hy.batch, n, hy.ctx);
+    }
+    int64_t end_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&hy_lock);
+    hy.st.frames += n;
+    hy.st.batches += n > 0;
+    if (n > hy.st.max_batch) {
+        hy.st.max_batch = n;
+    }
+    hy.st.busy_us += end_us - start_us;
+    portEXIT_CRITICAL(&hy_lock);
+}
+
+static void set_polling(bool polling, int64_t now_us)
+{
+    portENTER_CRITICAL(&hy_lock);
+    if (polling) {
+        hy.st.to_poll++;
+        hy.poll_since_us = now_us;
+    } else {
+        hy.st.to_interrupt++;
+        hy.st.poll_mode_us += now_us - hy.poll_since_us;
+    }
+    hy.st.polling = polling;
+    portEXIT_CRITICAL(&hy_lock);
+}
+
+static void receiver_task(void *arg)
+{
+    (void)arg;
+    bool polling = hy.mode == CAN_TWAI_HYBRID_POLL;
+    uint32_t burst = 0;    // closely spaced frames seen in interrupt mode
+    uint32_t idle = 0;     // empty polls in a row
+    int64_t last_rx_us = 0;
+
+    if (polling) {
+        set_polling(true, esp_timer_get_time());
+    }
+
+    while (!hy.stop) {
+        portENTER_CRITICAL(&hy_lock);
+        can_twai_hybrid_thresholds_t th = hy.th;
+        portEXIT_CRITICAL(&hy_lock);
+
+        if (!polling) {
+            // Interrupt mode: the driver ISR wakes this task
+            size_t taken;
+            size_t n = can_twai_receive_batch_counted(hy.batch, hy.batch_max, WAIT_TICKS, &taken);
+            if (taken == 0) {
+                continue;
+            }
+            int64_t now = esp_timer_get_time();
+            deliver(n, now);
+
+            portENTER_CRITICAL(&hy_lock);
+            hy.st.wakeups++;
+            portEXIT_CRITICAL(&hy_lock);
+
+            // Frames already queued at this wake arrived closer than the gap too
+            burst = now - last_rx_us <= (int64_t)th.enter_gap_us ? burst + taken : taken;
+            last_rx_us = now;
+            if (hy.mode == CAN_TWAI_HYBRID_AUTO && burst >= th.enter_frames) {
+                polling = true;
+                idle = 0;
+                set_polling(true, now);
+            }
+            continue;
+        }
+
+        // Polling mode: the queue fills without waking anybody
+        vTaskDelay(th.poll_interval);
+        int64_t now = esp_timer_get_time();
+        size_t total = 0;
+        size_t taken;
+        do {
+            size_t n = can_twai_receive_batch_counted(hy.batch, hy.batch_max, 0, &taken);
+            deliver(n, now);
+            total += taken;
+            now = esp_timer_get_time();
+        } while (taken == hy.batch_max && !hy.stop);
+
+        portENTER_CRITICAL(&hy_lock);
+        hy.st.polls++;
+        hy.st.empty_polls += total == 0;
+        portEXIT_CRITICAL(&hy_lock);
+
+        if (total > 0) {
+            idle = 0;
+            last_rx_us = now;
+        } else if (hy.mode == CAN_TWAI_HYBRID_AUTO && ++idle >= th.idle_polls) {
+            polling = false;
+            burst = 0;
+            set_polling(false, now);
+        }
+    }
+
+    if (polling) {
+        set_polling(false, esp_timer_get_time());
+    }
+    hy.exited = true;
+    vTaskDelete(NULL);
+}
+
+bool can_twai_hybrid_start(const can_twai_hybrid_config_t *cfg)
+{
+    if (hy.running) {
+        ESP_LOGE(TAG, "Hybrid receiver already running");
+        return false;
+    }
+    if (cfg == NULL || cfg->handler == NULL || cfg->mode > CAN_TWAI_HYBRID_POLL) {
+        ESP_LOGE(TAG, "Invalid configuration");
+        return false;
+    }
+
+    memset(&hy, 0, sizeof(hy));
+    hy.mode = cfg->mode;
+    hy.th = cfg->thresholds;
+    apply_defaults(&hy.th);
+    hy.handler = cfg->handler;
+    hy.ctx = cfg->ctx;
+    hy.batch_max = cfg->batch_max ? cfg->batch_max : DEFAULT_BATCH_MAX;
+    hy.batch = calloc(hy.batch_max, sizeof(twai_message_t));
+    if (hy.batch == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        return false;
+    }
+
+    uint32_t stack = cfg->stack_size ? cfg->stack_size : DEFAULT_STACK_SIZE;
+    if (xTaskCreatePinnedToCore(receiver_task, "can_hybrid", stack, NULL, cfg->priority, NULL,
+                                cfg->core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create receiver task");
+        free(hy.batch);
+        hy.batch = NULL;
+        return false;
+    }
+    hy.running = true;
+
+    ESP_LOGI(TAG, "Hybrid receiver started: enter %lu frames < %lu us, exit after %lu empty polls, poll %lu ms",
+             (unsigned long)hy.th.enter_frames, (unsigned long)hy.th.enter_gap_us,
+             (unsigned long)hy.th.idle_polls, (unsigned long)pdTICKS_TO_MS(hy.th.poll_interval));
+    return true;
+}
+
+void can_twai_hybrid_stop(void)
+{
+    if (!hy.running) {
+        return;
+    }
+    hy.stop = true;
+    while (!hy.exited) {
+        vTaskDelay(1);
+    }
+    free(hy.batch);
+    hy.batch = NULL;
+    hy.running = false;
+}
+
+void can_twai_hybrid_set_thresholds(const can_twai_hybrid_thresholds_t *thresholds)
+{
+    if (thresholds == NULL) {
+        return;
+    }
+    can_twai_hybrid_thresholds_t th = *thresholds;
+    apply_defaults(&th);
+    portENTER_CRITICAL(&hy_lock);
+    hy.th = th;
+    portEXIT_CRITICAL(&hy_lock);
+}
+
+void can_twai_hybrid_get_stats(can_twai_hybrid_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&hy_lock);
+    *out = hy.st;
+    if (hy.st.polling) {
+        out->poll_mode_us += now - hy.poll_since_us;
+    }
+    portEXIT_CRITICAL(&hy_lock);
+}
+
+void can_twai_hybrid_reset_stats(void)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&hy_lock);
+    bool polling = hy.st.polling;
+    memset(&hy.st, 0, sizeof(hy.st));
+    hy.st.polling = polling;
+    hy.poll_since_us = now;
+    portEXIT_CRITICAL(&hy_lock);
+}
@@ -0,0 +1,184 @@
+/**
+ * @file can_twai_image.c
+ * @brief Seqlock-protected process image of received CAN messages
+ *
+ * Slots are kept in an array sorted by identifier, so the receive hook and
+ * readers locate a slot by binary search. Each slot carries a sequence
+ * counter that is odd while the slot is being written.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_image.h"
+#include "can_twai_priv.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_image";
+
+/** @brief One process image slot */
+typedef struct {
+    _Atomic uint32_t seq;           /**< Sequence counter, odd while writing */
+    uint32_t         identifier;    /**< Tracked identifier (sort key) */
+    twai_message_t   msg;           /**< Latest message */
+    int64_t          timestamp_us;  /**< Reception time */
+    uint32_t         rx_count;      /**< Messages received for this ID */
+} image_slot_t;
+
+/** @brief Slots sorted by identifier */
+static image_slot_t *slots = NULL;
+static size_t slot_count = 0;
+
+/**
+ * @brief Keeps the (tiny) slot update from being preempted on its core,
+ *        so a higher-priority reader can never spin on a half-written slot
+ */
+static portMUX_TYPE write_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static CAN_TWAI_HOT_ATTR image_slot_t *find_slot(uint32_t identifier)
+{
+    size_t lo = 0;
+    size_t hi = slot_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t key = slots[mid].identifier;
+        if (key == identifier) {
+            return &slots[mid];
+        }
+        if (key < identifier) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static CAN_TWAI_HOT_ATTR bool image_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    (void)ctx;
+    image_slot_t *slot = find_slot(msg->identifier);
+    if (slot == NULL) {
+        return true;
+    }
+
+    portENTER_CRITICAL(&write_lock);
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->msg = *msg;
+    slot->timestamp_us = rx_time_us;
+    slot->rx_count++;
+
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+    portEXIT_CRITICAL(&write_lock);
+
+    return true;
+}
+
+bool can_twai_image_init(const can_twai_image_config_t *cfg)
+{
+    if (cfg == NULL || cfg->ids == NULL || cfg->count == 0) {
+        ESP_LOGE(TAG, "Invalid process image configuration");
+        return false;
+    }
+    if (slots != NULL) {
+        ESP_LOGE(TAG, "Process image already initialized");
+        return false;
+    }
+
+    uint32_t *ids = malloc(cfg->count * sizeof(uint32_t));
+    image_slot_t *new_slots = can_twai_hot_calloc(cfg->count, sizeof(image_slot_t));
+    if (ids == NULL || new_slots == NULL) {
+        ESP_LOGE(TAG, "Out of memory for %u slots", (unsigned)cfg->count);
+        free(ids);
+        free(new_slots);
+        return false;
+    }
+
+    memcpy(ids, cfg->ids, cfg->count * sizeof(uint32_t));
+    qsort(ids, cfg->count, sizeof(uint32_t), cmp_u32);
+    for (size_t i = 0; i < cfg->count; i++) {
+        if (i > 0 && ids[i] == ids[i - 1]) {
+            ESP_LOGE(TAG, "Duplicate ID 0x%lX", (unsigned long)ids[i]);
+            free(ids);
+            free(new_slots);
+            return false;
+        }
+        new_slots[i].identifier = ids[i];
+        atomic_init(&new_slots[i].seq, 0);
+    }
+    free(ids);
+
+    slots = new_slots;
+    slot_count = cfg->count;
+
+    if (!can_twai_register_rx_hook(image_rx_hook, NULL)) {
+        free(slots);
+        slots = NULL;
+        slot_count = 0;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Process image created (%u IDs)", (unsigned)slot_count);
+    return true;
+}
+
+void can_twai_image_deinit(void)
+{
+    if (slots == NULL) {
+        return;
+    }
+    can_twai_unregister_rx_hook(image_rx_hook, NULL);
+    free(slots);
+    slots = NULL;
+    slot_count = 0;
+}
+
+bool can_twai_image_read(uint32_t identifier, can_twai_image_sample_t *out)
+{
+    if (out == NULL) {
+        return false;
+    }
+
+    image_slot_t *slot = find_slot(identifier);
+    if (slot == NULL) {
+        return false;
+    }
+
+    can_twai_image_sample_t copy;
+    uint32_t seq1, seq2;
+    do {
+        seq1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq1 & 1u) {
+            continue;  // writer active on another core
+        }
+        copy.msg          = slot->msg;
+        copy.timestamp_us = slot->timestamp_us;
+        copy.rx_count     = slot->rx_count;
+        atomic_thread_fence(memory_order_acquire);
+        seq2 = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    } while ((seq1 & 1u) || seq1 != seq2);
+
+    if (copy.rx_count == 0) {
+        return false;
+    }
+
+    copy.age_us = esp_timer_get_time() - copy.timestamp_us;
+    *out = copy;
+    return true;
+}
@@ -0,0 +1,332 @@
+/**
+ * @file can_twai_liveness.c
+ * @brief Hierarchical timer wheel for per-ID message timeouts
+ *
+ * Level 0 has 256 slots of one tick each, level 1 has 64 slots of 256 ticks.
+ * Timers due within 256 ticks go straight to level 0; later ones wait in
+ * level 1 and are cascaded into level 0 whenever the level-0 index wraps.
+ * Slots are intrusive doubly linked lists of entry indices, so arming,
+ * re-arming and expiring a timer are all O(1). Received identifiers are
+ * mapped to entries through an open-addressing hash table.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_liveness.h"
+#include "can_twai_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_liveness";
+
+#define L0_BITS   8
+#define L0_SLOTS  (1u << L0_BITS)
+#define L1_SLOTS  64u
+#define NO_INDEX  0xFFFFu
+
+/** @brief One monitored ID and its timer */
+typedef struct {
+    uint32_t identifier;
+    uint32_t timeout_ticks;
+    uint32_t expiry;         /**< Absolute tick of expiration */
+    uint16_t prev;           /**< Previous entry in slot list */
+    uint16_t next;           /**< Next entry in slot list */
+    uint16_t slot;           /**< Slot holding the entry (NO_INDEX = not armed) */
+    bool     expired;
+} liveness_entry_t;
+
+/** @brief Monitor state */
+typedef struct {
+    liveness_entry_t      *entries;
+    size_t                 count;
+    uint16_t              *hash;        /**< identifier -> entry index */
+    uint32_t               hash_mask;
+    uint16_t               head[L0_SLOTS + L1_SLOTS];
+    uint32_t               now;         /**< Current tick */
+    uint32_t              *status;      /**< Timed-out bitmap */
+    uint32_t               missing;
+    can_twai_liveness_cb_t callback;
+    void                  *ctx;
+    esp_timer_handle_t     timer;
+} liveness_t;
+
+static liveness_t lv;
+static portMUX_TYPE lv_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t hash_id(uint32_t identifier)
+{
+    return (identifier * 2654435761u) >> 7;
+}
+
+static CAN_TWAI_HOT_ATTR int lookup(uint32_t identifier)
+{
+    if (lv.hash == NULL) {
+        return -1;
+    }
+    for (uint32_t h = hash_id(identifier) & lv.hash_mask;; h = (h + 1) & lv.hash_mask) {
+        uint16_t idx = lv.hash[h];
+        if (idx == NO_INDEX) {
+            return -1;
+        }
+        if (lv.entries[idx].identifier == identifier) {
+            return idx;
+        }
+    }
+}
+
+static CAN_TWAI_HOT_ATTR void unlink_entry(uint16_t idx)
+{
+    liveness_entry_t *e = &lv.entries[idx];
+    if (e->slot == NO_INDEX) {
+        return;
+    }
+    if (e->prev != NO_INDEX) {
+        lv.entries[e->prev].next = e->next;
+    } else {
+        lv.head[e->slot] = e->next;
+    }
+    if (e->next != NO_INDEX) {
+        lv.entries[e->next].prev = e->prev;
+    }
+    e->slot = NO_INDEX;
+}
+
+static CAN_TWAI_HOT_ATTR void link_entry(uint16_t idx)
+{
+    liveness_entry_t *e = &lv.entries[idx];
+    uint32_t delta = e->expiry - lv.now;
+    uint16_t slot = (delta < L0_SLOTS)
+                  ? (uint16_t)(e->expiry & (L0_SLOTS - 1))
+                  : (uint16_t)(L0_SLOTS + ((e->expiry >> L0_BITS) & (L1_SLOTS - 1)));
+
+    e->slot = slot;
+    e->prev = NO_INDEX;
+    e->next = lv.head[slot];
+    if (e->next != NO_INDEX) {
+        lv.entries[e->next].prev = idx;
+    }
+    lv.head[slot] = idx;
+}
+
+static void cascade(void)
+{
+    uint16_t slot = (uint16_t)(L0_SLOTS + ((lv.now >> L0_BITS) & (L1_SLOTS - 1)));
+    uint16_t idx = lv.head[slot];
+    lv.head[slot] = NO_INDEX;
+    while (idx != NO_INDEX) {
+        uint16_t next = lv.entries[idx].next;
+        link_entry(idx);  // now within 256 ticks -> level 0
+        idx = next;
+    }
+}
+
+static void liveness_tick(void *arg)
+{
+    (void)arg;
+    portENTER_CRITICAL(&lv_lock);
+    uint32_t now = ++lv.now;
+    if ((now & (L0_SLOTS - 1)) == 0) {
+        cascade();
+    }
+    portEXIT_CRITICAL(&lv_lock);
+
+    uint16_t slot = (uint16_t)(now & (L0_SLOTS - 1));
+    for (;;) {
+        portENTER_CRITICAL(&lv_lock);
+        uint16_t idx = lv.head[slot];
+        if (idx == NO_INDEX) {
+            portEXIT_CRITICAL(&lv_lock);
+            break;
+        }
+        liveness_entry_t *e = &lv.entries[idx];
+        unlink_entry(idx);
+        e->expired = true;
+        lv.status[idx / 32] |= 1u << (idx % 32);
+        lv.missing++;
+        uint32_t identifier = e->identifier;
+        portEXIT_CRITICAL(&lv_lock);
+
+        ESP_LOGD(TAG, "ID 0x%lX timed out", (unsigned long)identifier);
+        if (lv.callback != NULL) {
+            lv.callback(identifier, false, lv.ctx);
+        }
+    }
+}
+
+static CAN_TWAI_HOT_ATTR bool liveness_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    (void)rx_time_us;
+    (void)ctx;
+    int idx = lookup(msg->identifier);
+    if (idx < 0) {
+        return true;
+    }
+
+    portENTER_CRITICAL(&lv_lock);
+    liveness_entry_t *e = &lv.entries[idx];
+    unlink_entry((uint16_t)idx);
+    e->expiry = lv.now + e->timeout_ticks;
+    link_entry((uint16_t)idx);
+    bool recovered = e->expired;
+    if (recovered) {
+        e->expired = false;
+        lv.status[idx / 32] &= ~(1u << (idx % 32));
+        lv.missing--;
+    }
+    portEXIT_CRITICAL(&lv_lock);
+
+    if (recovered && lv.callback != NULL) {
+        lv.callback(msg->identifier, true, lv.ctx);
+    }
+    return true;
+}
+
+static void free_state(void)
+{
+    free(lv.entries);
+    free(lv.hash);
+    free(lv.status);
+    memset(&lv, 0, sizeof(lv));
+}
+
+bool can_twai_liveness_init(const can_twai_liveness_config_t *cfg)
+{
+    if (cfg == NULL || cfg->entries == NULL || cfg->count == 0 ||
+        cfg->count > CAN_TWAI_LIVENESS_MAX_ENTRIES || cfg->tick_ms == 0) {
+        ESP_LOGE(TAG, "Invalid liveness configuration");
+        return false;
+    }
+    if (lv.entries != NULL) {
+        ESP_LOGE(TAG, "Liveness monitor already initialized");
+        return false;
+    }
+
+    uint32_t hash_size = 1;
+    while (hash_size < cfg->count * 2) {
+        hash_size <<= 1;
+    }
+
+    lv.entries = can_twai_hot_calloc(cfg->count, sizeof(liveness_entry_t));
+    lv.hash = can_twai_hot_calloc(hash_size, sizeof(uint16_t));
+    lv.status = can_twai_hot_calloc((cfg->count + 31) / 32, sizeof(uint32_t));
+    if (lv.entries == NULL || lv.hash == NULL || lv.status == NULL) {
+        ESP_LOGE(TAG, "Out of memory for %u entries", (unsigned)cfg->count);
+        free_state();
+        return false;
+    }
+    memset(lv.hash, 0xFF, hash_size * sizeof(uint16_t));
+    memset(lv.head, 0xFF, sizeof(lv.head));
+    lv.hash_mask = hash_size - 1;
+    lv.count = cfg->count;
+    lv.callback = cfg->callback;
+    lv.ctx = cfg->ctx;
+
+    for (size_t i = 0; i < cfg->count; i++) {
+        const can_twai_liveness_entry_t *c = &cfg->entries[i];
+        uint32_t ticks = (c->timeout_ms + cfg->tick_ms - 1) / cfg->tick_ms;
+        if (ticks == 0) {
+            ticks = 1;
+        }
+        if (ticks > CAN_TWAI_LIVENESS_MAX_TICKS) {
+            ESP_LOGE(TAG, "ID 0x%lX: timeout %lums exceeds %u ticks", (unsigned long)c->identifier,
+                     (unsigned long)c->timeout_ms, CAN_TWAI_LIVENESS_MAX_TICKS);
+            free_state();
+            return false;
+        }
+        if (lookup(c->identifier) >= 0) {
+            ESP_LOGE(TAG, "Duplicate ID 0x%lX", (unsigned long)c->identifier);
+            free_state();
+            return false;
+        }
+
+        uint32_t h = hash_id(c->identifier) & lv.hash_mask;
+        while (lv.hash[h] != NO_INDEX) {
+            h = (h + 1) & lv.hash_mask;
+        }
+        lv.hash[h] = (uint16_t)i;
+
+        liveness_entry_t *e = &lv.entries[i];
+        e->identifier = c->identifier;
+        e->timeout_ticks = ticks;
+        e->expiry = ticks;
+        link_entry((uint16_t)i);
+    }
+
+    const esp_timer_create_args_t args = {
+        .callback = liveness_tick,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "can_liveness",
+        .skip_unhandled_events = false,
+    };
+    if (esp_timer_create(&args, &lv.timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create tick timer");
+        free_state();
+        return false;
+    }
+    if (!can_twai_register_rx_hook(liveness_rx_hook, NULL)) {
+        esp_timer_delete(lv.timer);
+        free_state();
+        return false;
+    }
+    esp_timer_start_periodic(lv.timer, (uint64_t)cfg->tick_ms * 1000);
+
+    ESP_LOGI(TAG, "Liveness monitor started (%u IDs, tick=%lums)", (unsigned)lv.count,
+             (unsigned long)cfg->tick_ms);
+    return true;
+}
+
+void can_twai_liveness_deinit(void)
+{
+    if (lv.entries == NULL) {
+        return;
+    }
+    can_twai_unregister_rx_hook(liveness_rx_hook, NULL);
+    esp_timer_stop(lv.timer);
+    esp_timer_delete(lv.timer);
+
+    portENTER_CRITICAL(&lv_lock);
+    liveness_entry_t *entries = lv.entries;
+    uint16_t *hash = lv.hash;
+    uint32_t *status = lv.status;
+    memset(&lv, 0, sizeof(lv));
+    portEXIT_CRITICAL(&lv_lock);
+
+    free(entries);
+    free(hash);
+    free(status);
+}
+
+bool can_twai_liveness_is_alive(uint32_t identifier)
+{
+    int idx = lookup(identifier);
+    if (idx < 0) {
+        return false;
+    }
+    return (lv.status[idx / 32] & (1u << (idx % 32))) == 0;
+}
+
+size_t can_twai_liveness_get_status(uint32_t *bits, size_t words)
+{
+    if (bits == NULL || lv.status == NULL) {
+        return 0;
+    }
+    size_t n = (lv.count + 31) / 32;
+    if (n > words) {
+        n = words;
+    }
+    portENTER_CRITICAL(&lv_lock);
+    memcpy(bits, lv.status, n * sizeof(uint32_t));
+    portEXIT_CRITICAL(&lv_lock);
+    return n;
+}
+
+uint32_t can_twai_liveness_missing_count(void)
+{
+    return lv.missing;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file can_twai_loopback.c
+ * @brief Zero-copy delivery of sent frames to in-node subscribers
+ *
+ * Subscriptions are kept sorted by identifier (stable for equal IDs). A
+ * recursive mutex serializes deliveries and table changes: the order in
+ * which senders pass the lock is the order every subscriber sees. The lock
+ * is recursive so that a callback can itself send a looped frame.
+ *
+ * A callback may subscribe or unsubscribe while its delivery loop is
+ * running. Every running loop (nested ones included) registers its index as
+ * a cursor, and insertions and removals move the cursors with the entries,
+ * so no subscriber is skipped or called twice.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_loopback.h"
+#include "can_twai_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_loopback";
+
+#define DEFAULT_MAX_SUBSCRIPTIONS 16
+
+/** @brief Position of a running delivery loop */
+typedef struct delivery {
+    ptrdiff_t        i;      /**< Index of the subscriber being called */
+    struct delivery *outer;  /**< Enclosing delivery of the same task */
+} delivery_t;
+
+/** @brief Loopback state */
+typedef struct {
+    can_twai_loopback_sub_t  *subs;      /**< Sorted by identifier */
+    size_t                    count;
+    size_t                    capacity;
+    SemaphoreHandle_t         lock;      /**< Recursive: delivery order and table */
+    delivery_t               *active;    /**< Innermost running delivery, under lock */
+    can_twai_loopback_stats_t stats;
+    bool                      running;
+} loopback_t;
+
+static loopback_t lb;
+
+/** @brief Index of the first subscription with identifier >= @p identifier */
+static CAN_TWAI_HOT_ATTR size_t lower_bound(uint32_t identifier)
+{
+    size_t lo = 0;
+    size_t hi = lb.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (lb.subs[mid].identifier < identifier) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/** @brief Keep running deliveries on their entry after a change at @p pos (under lock) */
+static void move_cursors(size_t pos, ptrdiff_t delta)
+{
+    for (delivery_t *d = lb.active; d != NULL; d = d->outer) {
+        if ((ptrdiff_t)pos <= d->i) {
+            d->i += delta;
+        }
+    }
+}
+
+static CAN_TWAI_HOT_ATTR bool loopback_tx_local(const twai_message_t *msg)
+{
+    if (lb.count == 0) {
+        return true;
+    }
+
+    bool wire = true;
+    xSemaphoreTakeRecursive(lb.lock, portMAX_DELAY);
+    delivery_t d = {.i = (ptrdiff_t)lower_bound(msg->identifier), .outer = lb.active};
+    if ((size_t)d.i < lb.count && lb.subs[d.i].identifier == msg->identifier) {
+        lb.stats.frames_looped++;
+        lb.active = &d;
+        // Callbacks may (un)subscribe, which moves d.i; re-check the bound
+        for (; (size_t)d.i < lb.count && lb.subs[d.i].identifier == msg->identifier; d.i++) {
+            const can_twai_loopback_sub_t *s = &lb.subs[d.i];
+            if (s->local_only) {
+                wire = false;
+            }
+            lb.stats.deliveries++;
+            s->callback(msg, s->ctx);
+        }
+        lb.active = d.outer;
+        if (!wire) {
+            lb.stats.frames_local++;
+        }
+    }
+    xSemaphoreGiveRecursive(lb.lock);
+    return wire;
+}
+
+bool can_twai_loopback_init(const can_twai_loopback_config_t *cfg)
+{
+    if (lb.running) {
+        ESP_LOGE(TAG, "Loopback already enabled");
+        return false;
+    }
+
+    memset(&lb, 0, sizeof(lb));
+    lb.capacity = (cfg != NULL && cfg->max_subscriptions) ? cfg->max_subscriptions
+                                                          : DEFAULT_MAX_SUBSCRIPTIONS;
+    lb.subs = can_twai_hot_calloc(lb.capacity, sizeof(can_twai_loopback_sub_t));
+    lb.lock = xSemaphoreCreateRecursiveMutex();
+    if (lb.subs == NULL || lb.lock == NULL) {
+        ESP_LOGE(TAG, "Out of memory for %u subscriptions", (unsigned)lb.capacity);
+        free(lb.subs);
+        if (lb.lock != NULL) {
+            vSemaphoreDelete(lb.lock);
+        }
+        memset(&lb, 0, sizeof(lb));
+        return false;
+    }
+
+    lb.running = true;
+    can_twai_set_tx_local(loopback_tx_local);
+    ESP_LOGI(TAG, "Local loopback enabled (%u subscriptions)", (unsigned)lb.capacity);
+    return true;
+}
+
+void can_twai_loopback_deinit(void)
+{
+    if (!lb.running) {
+        return;
+    }
+    // Returns only after sends that already picked up loopback_tx_local are done
+    can_twai_set_tx_local(NULL);
+
+    vSemaphoreDelete(lb.lock);
+    free(lb.subs);
+    memset(&lb, 0, sizeof(lb));
+}
+
+bool can_twai_loopback_subscribe(const can_twai_loopback_sub_t *sub)
+{
+    if (!lb.running || sub == NULL || sub->callback == NULL) {
+        ESP_LOGE(TAG, "Loopback not enabled or invalid subscription");
+        return false;
+    }
+
+    bool ok = false;
+    xSemaphoreTakeRecursive(lb.lock, portMAX_DELAY);
+    if (lb.count < lb.capacity) {
+        // Insert after existing subscribers of the same ID
+        size_t pos = lower_bound(sub->identifier);
+        while (pos < lb.count && lb.subs[pos].identifier == sub->identifier) {
+            pos++;
+        }
+        memmove(&lb.subs[pos + 1], &lb.subs[pos], (lb.count - pos) * sizeof(can_twai_loopback_sub_t));
+        lb.subs[pos] = *sub;
+        lb.count++;
+        move_cursors(pos, 1);
+        ok = true;
+    }
+    xSemaphoreGiveRecursive(lb.lock);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Subscription table full (%u entries)", (unsigned)lb.capacity);
+    }
+    return ok;
+}
+
+void can_twai_loopback_unsubscribe(uint32_t identifier, can_twai_loopback_cb_t callback, void *ctx)
+{
+    if (!lb.running) {
+        return;
+    }
+
+    xSemaphoreTakeRecursive(lb.lock, portMAX_DELAY);
+    for (size_t i = lower_bound(identifier); i < lb.count && lb.subs[i].identifier == identifier; i++) {
+        if (lb.subs[i].callback == callback && lb.subs[i].ctx == ctx) {
+            memmove(&lb.subs[i], &lb.subs[i + 1], (lb.count - i - 1) * sizeof(can_twai_loopback_sub_t));
+            lb.count--;
+            move_cursors(i, -1);
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(lb.lock);
+}
+
+void can_twai_loopback_get_stats(can_twai_loopback_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    if (!lb.running) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTakeRecursive(lb.lock, portMAX_DELAY);
+    *out = lb.stats;
+    xSemaphoreGiveRecursive(lb.lock);
+}
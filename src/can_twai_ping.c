@@ -0,0 +1,500 @@
+/**
+ * @file can_twai_ping.c
+ * @brief Round-trip latency probe between two nodes
+ *
+ * The initiator keeps one slot per sequence number modulo PROBE_SLOTS. A
+ * slot is armed before the probe is queued (the echo may arrive before the
+ * send call returns), cleared by its echo, and expired by the sender task
+ * once the timeout has passed. Because the timeout is shorter than
+ * PROBE_SLOTS intervals, a slot is always resolved before it is reused.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_ping.h"
+#include "can_twai.h"
+#include "can_twai_priv.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_ping";
+
+#define PROBE_DLC           8
+#define PROBE_SLOTS         256
+#define DEFAULT_INTERVAL_MS 10
+#define DEFAULT_TIMEOUT_MS  100
+#define DEFAULT_BUCKET_US   50
+#define TASK_STACK          3072
+#define HIST_BAR_WIDTH      40
+
+/** @brief State of one probe slot */
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_PENDING,   /**< Sent, echo expected */
+    SLOT_EXPIRED,   /**< Counted as lost, a late echo is still recognized */
+} slot_state_t;
+
+typedef struct {
+    int64_t      sent_us;
+    uint16_t     seq;
+    slot_state_t state;
+} probe_slot_t;
+
+/** @brief Initiator state */
+typedef struct {
+    can_twai_ping_config_t cfg;
+    probe_slot_t           slots[PROBE_SLOTS];
+    uint16_t               next_seq;
+    uint32_t               pending;
+    can_twai_ping_stats_t  st;
+    uint64_t               rtt_sum_us;
+    uint64_t               turnaround_sum_us;
+    bool                   background;
+    volatile bool          stop;
+    volatile bool          done;
+    volatile bool          exited;
+    bool                   running;
+} initiator_t;
+
+/** @brief Responder state */
+typedef struct {
+    can_twai_ping_responder_config_t cfg;
+    volatile uint32_t                echoed;
+    volatile uint32_t                failed;
+    bool                             running;
+} responder_t;
+
+static initiator_t pi;
+static responder_t pr;
+static portMUX_TYPE pi_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline bool is_frame(const twai_message_t *msg, uint32_t identifier, bool extd)
+{
+    return msg->identifier == identifier && msg->extd == extd && !msg->rtr &&
+           msg->data_length_code == PROBE_DLC;
+}
+
+// --------------------------------------------------------------------------------------
+// Responder
+// --------------------------------------------------------------------------------------
+static CAN_TWAI_HOT_ATTR void echo_probe(const twai_message_t *probe, int64_t rx_time_us)
+{
+    twai_message_t echo = *probe;
+    echo.identifier = pr.cfg.reply_id;
+    echo.extd = pr.cfg.extd;
+    echo.self = 0;
+
+    int64_t held = esp_timer_get_time() - rx_time_us;
+    put_le16(&echo.data[6], held > UINT16_MAX ? UINT16_MAX : (uint16_t)held);
+    if (can_twai_send_timeout(&echo, 0)) {
+        pr.echoed++;
+    } else {
+        pr.failed++;
+    }
+}
+
+static CAN_TWAI_HOT_ATTR bool responder_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    if (!is_frame(msg, pr.cfg.request_id, pr.cfg.extd)) {
+        return true;
+    }
+    echo_probe(msg, rx_time_us);
+    return false;
+}
+
+static bool id_valid(uint32_t identifier, bool extd)
+{
+    return identifier <= (extd ? TWAI_EXTD_ID_MASK : TWAI_STD_ID_MASK);
+}
+
+bool can_twai_ping_responder_init(const can_twai_ping_responder_config_t *cfg)
+{
+    if (pr.running) {
+        ESP_LOGE(TAG, "Responder already running");
+        return false;
+    }
+    if (cfg == NULL || !id_valid(cfg->request_id, cfg->extd) || !id_valid(cfg->reply_id, cfg->extd) ||
+        cfg->request_id == cfg->reply_id) {
+        ESP_LOGE(TAG, "Invalid probe/echo IDs");
+        return false;
+    }
+
+    memset(&pr, 0, sizeof(pr));
+    pr.cfg = *cfg;
+    if (cfg->rx == CAN_TWAI_PING_RX_HOOK && !can_twai_register_rx_hook(responder_rx_hook, NULL)) {
+        return false;
+    }
+    pr.running = true;
+    ESP_LOGI(TAG, "Echoing probes 0x%lX as 0x%lX", (unsigned long)cfg->request_id,
+             (unsigned long)cfg->reply_id);
+    return true;
+}
+
+void can_twai_ping_responder_deinit(void)
+{
+    if (!pr.running) {
+        return;
+    }
+    if (pr.cfg.rx == CAN_TWAI_PING_RX_HOOK) {
+        can_twai_unregister_rx_hook(responder_rx_hook, NULL);
+    }
+    pr.running = false;
+}
+
+void can_twai_ping_responder_get_counts(uint32_t *echoed, uint32_t *failed)
+{
+    if (echoed != NULL) {
+        *echoed = pr.echoed;
+    }
+    if (failed != NULL) {
+        *failed = pr.failed;
+    }
+}
+
+// --------------------------------------------------------------------------------------
+// Initiator
+// --------------------------------------------------------------------------------------
+static CAN_TWAI_HOT_ATTR void record_echo(const twai_message_t *echo)
+{
+    uint32_t now32 = (uint32_t)esp_timer_get_time();
+    uint16_t seq = get_le16(&echo->data[0]);
+    uint32_t sent32 = get_le32(&echo->data[2]);
+    uint16_t turnaround = get_le16(&echo->data[6]);
+    uint32_t rtt = now32 - sent32;
+    probe_slot_t *slot = &pi.slots[seq % PROBE_SLOTS];
+
+    portENTER_CRITICAL(&pi_lock);
+    if (slot->seq != seq || slot->state == SLOT_FREE || (uint32_t)slot->sent_us != sent32) {
+        pi.st.unexpected++;
+    } else if (slot->state == SLOT_EXPIRED) {
+        pi.st.late++;
+        slot->state = SLOT_FREE;
+    } else if (rtt > pi.cfg.timeout_ms * 1000) {
+        // Overdue, but the sender task has not expired it yet
+        slot->state = SLOT_FREE;
+        pi.pending--;
+        pi.st.lost++;
+        pi.st.late++;
+    } else {
+        slot->state = SLOT_FREE;
+        pi.pending--;
+        pi.st.received++;
+        pi.rtt_sum_us += rtt;
+        pi.turnaround_sum_us += turnaround;
+        if (rtt < pi.st.rtt_min_us) {
+            pi.st.rtt_min_us = rtt;
+        }
+        if (rtt > pi.st.rtt_max_us) {
+            pi.st.rtt_max_us = rtt;
+        }
+        if (turnaround > pi.st.turnaround_max_us) {
+            pi.st.turnaround_max_us = turnaround;
+        }
+        uint32_t bucket = rtt / pi.st.bucket_us;
+        pi.st.hist[bucket < CAN_TWAI_PING_HIST_BUCKETS ? bucket : CAN_TWAI_PING_HIST_BUCKETS - 1]++;
+    }
+    portEXIT_CRITICAL(&pi_lock);
+}
+
+static CAN_TWAI_HOT_ATTR bool initiator_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    if (!is_frame(msg, pi.cfg.reply_id, pi.cfg.extd)) {
+        return true;
+    }
+    record_echo(msg);
+    return false;
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_ping_process(const twai_message_t *msg)
+{
+    if (pr.running && is_frame(msg, pr.cfg.request_id, pr.cfg.extd)) {
+        echo_probe(msg, esp_timer_get_time());
+        return true;
+    }
+    if (pi.running && is_frame(msg, pi.cfg.reply_id, pi.cfg.extd)) {
+        record_echo(msg);
+        return true;
+    }
+    return false;
+}
+
+CAN_TWAI_HOT_ATTR void can_twai_ping_fastpath_handler(const twai_message_t *msg, void *ctx)
+{
+    can_twai_ping_process(msg);
+}
+
+/** @brief Count probes without echo after the timeout as lost */
+static void expire_probes(int64_t now_us, bool all)
+{
+    int64_t limit_us = (int64_t)pi.cfg.timeout_ms * 1000;
+    portENTER_CRITICAL(&pi_lock);
+    for (int i = 0; i < PROBE_SLOTS && pi.pending > 0; i++) {
+        probe_slot_t *slot = &pi.slots[i];
+        if (slot->state == SLOT_PENDING && (all || now_us - slot->sent_us > limit_us)) {
+            slot->state = SLOT_EXPIRED;
+            pi.pending--;
+            pi.st.lost++;
+        }
+    }
+    portEXIT_CRITICAL(&pi_lock);
+}
+
+static void send_probe(void)
+{
+    uint16_t seq = pi.next_seq++;
+    probe_slot_t *slot = &pi.slots[seq % PROBE_SLOTS];
+    int64_t now = esp_timer_get_time();
+
+    twai_message_t probe = {
+        .identifier = pi.cfg.request_id,
+        .extd = pi.cfg.extd,
+        .data_length_code = PROBE_DLC,
+    };
+    put_le16(&probe.data[0], seq);
+    put_le32(&probe.data[2], (uint32_t)now);
+
+    // Arm the slot first: the echo may arrive before the send call returns
+    portENTER_CRITICAL(&pi_lock);
+    slot->seq = seq;
+    slot->sent_us = now;
+    slot->state = SLOT_PENDING;
+    pi.pending++;
+    portEXIT_CRITICAL(&pi_lock);
+
+    // Waiting for a TX queue slot is part of the measured round trip
+    bool queued = can_twai_send_timeout(&probe, pdMS_TO_TICKS(pi.cfg.interval_ms));
+
+    portENTER_CRITICAL(&pi_lock);
+    if (queued) {
+        pi.st.sent++;
+    } else {
+        pi.st.send_failed++;
+        if (slot->seq == seq && slot->state == SLOT_PENDING) {
+            slot->state = SLOT_FREE;
+            pi.pending--;
+        }
+    }
+    portEXIT_CRITICAL(&pi_lock);
+}
+
+static void sender_task(void *arg)
+{
+    TickType_t period = pdMS_TO_TICKS(pi.cfg.interval_ms);
+    TickType_t last = xTaskGetTickCount();
+    uint32_t probes = 0;
+
+    while (!pi.stop && (pi.cfg.count == 0 || probes < pi.cfg.count)) {
+        expire_probes(esp_timer_get_time(), false);
+        send_probe();
+        probes++;
+        vTaskDelayUntil(&last, period > 0 ? period : 1);
+    }
+
+    // Give the last echoes their full timeout
+    int64_t until = esp_timer_get_time() + (int64_t)pi.cfg.timeout_ms * 1000;
+    while (!pi.stop && pi.pending > 0 && esp_timer_get_time() < until) {
+        vTaskDelay(1);
+        expire_probes(esp_timer_get_time(), false);
+    }
+    expire_probes(esp_timer_get_time(), true);
+
+    if (pi.background) {
+        can_twai_gen_stop();
+    }
+    pi.done = true;
+    pi.exited = true;
+    vTaskDelete(NULL);
+}
+
+bool can_twai_ping_start(const can_twai_ping_config_t *cfg)
+{
+    if (pi.running) {
+        ESP_LOGE(TAG, "Ping already running");
+        return false;
+    }
+    if (cfg == NULL || !id_valid(cfg->request_id, cfg->extd) || !id_valid(cfg->reply_id, cfg->extd) ||
+        cfg->request_id == cfg->reply_id) {
+        ESP_LOGE(TAG, "Invalid probe/echo IDs");
+        return false;
+    }
+
+    memset(&pi, 0, sizeof(pi));
+    pi.cfg = *cfg;
+    pi.cfg.interval_ms = cfg->interval_ms ? cfg->interval_ms : DEFAULT_INTERVAL_MS;
+    pi.cfg.timeout_ms = cfg->timeout_ms ? cfg->timeout_ms : DEFAULT_TIMEOUT_MS;
+    if (pi.cfg.timeout_ms >= PROBE_SLOTS * pi.cfg.interval_ms) {
+        ESP_LOGE(TAG, "Timeout %lu ms must be below %d probe intervals",
+                 (unsigned long)pi.cfg.timeout_ms, PROBE_SLOTS);
+        return false;
+    }
+    pi.st.bucket_us = cfg->bucket_us ? cfg->bucket_us : DEFAULT_BUCKET_US;
+    pi.st.rtt_min_us = UINT32_MAX;
+
+    if (cfg->rx == CAN_TWAI_PING_RX_HOOK && !can_twai_register_rx_hook(initiator_rx_hook, NULL)) {
+        return false;
+    }
+    if (cfg->background != NULL) {
+        if (!can_twai_gen_start(cfg->background)) {
+            ESP_LOGE(TAG, "Failed to start background load");
+            can_twai_unregister_rx_hook(initiator_rx_hook, NULL);
+            return false;
+        }
+        pi.background = true;
+    }
+
+    pi.running = true;
+    UBaseType_t prio = cfg->priority ? cfg->priority : configMAX_PRIORITIES - 3;
+    if (xTaskCreate(sender_task, "can_ping", TASK_STACK, NULL, prio, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sender task");
+        if (pi.background) {
+            can_twai_gen_stop();
+        }
+        if (cfg->rx == CAN_TWAI_PING_RX_HOOK) {
+            can_twai_unregister_rx_hook(initiator_rx_hook, NULL);
+        }
+        pi.running = false;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Pinging 0x%lX -> 0x%lX every %lu ms%s", (unsigned long)cfg->request_id,
+             (unsigned long)cfg->reply_id, (unsigned long)pi.cfg.interval_ms,
+             pi.background ? " with background load" : "");
+    return true;
+}
+
+bool can_twai_ping_wait(TickType_t timeout)
+{
+    if (!pi.running || pi.cfg.count == 0) {
+        return false;
+    }
+    TickType_t start = xTaskGetTickCount();
+    while (!pi.done) {
+        if (timeout != portMAX_DELAY && xTaskGetTickCount() - start >= timeout) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+void can_twai_ping_stop(void)
+{
+    if (!pi.running) {
+        return;
+    }
+    pi.stop = true;
+    while (!pi.exited) {
+        vTaskDelay(1);
+    }
+    if (pi.cfg.rx == CAN_TWAI_PING_RX_HOOK) {
+        can_twai_unregister_rx_hook(initiator_rx_hook, NULL);
+    }
+    pi.running = false;
+}
+
+void can_twai_ping_get_stats(can_twai_ping_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&pi_lock);
+    *out = pi.st;
+    if (pi.st.received > 0) {
+        out->rtt_avg_us = (uint32_t)(pi.rtt_sum_us / pi.st.received);
+        out->turnaround_avg_us = (uint32_t)(pi.turnaround_sum_us / pi.st.received);
+    } else {
+        out->rtt_min_us = 0;
+    }
+    portEXIT_CRITICAL(&pi_lock);
+}
+
+uint32_t can_twai_ping_percentile_us(const can_twai_ping_stats_t *stats, uint32_t percent)
+{
+    if (stats == NULL || stats->received == 0 || percent == 0) {
+        return 0;
+    }
+    if (percent > 100) {
+        percent = 100;
+    }
+
+    uint64_t target = ((uint64_t)stats->received * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < CAN_TWAI_PING_HIST_BUCKETS - 1; b++) {
+        seen += stats->hist[b];
+        if (seen >= target) {
+            uint32_t limit = (uint32_t)(b + 1) * stats->bucket_us;
+            return limit < stats->rtt_max_us ? limit : stats->rtt_max_us;
+        }
+    }
+    return stats->rtt_max_us;
+}
+
+void can_twai_ping_log_report(void)
+{
+    can_twai_ping_stats_t st;
+    can_twai_ping_get_stats(&st);
+
+    ESP_LOGI(TAG, "Probes %lu sent, %lu echoed, %lu lost, %lu late, %lu unexpected, %lu not queued",
+             (unsigned long)st.sent, (unsigned long)st.received, (unsigned long)st.lost,
+             (unsigned long)st.late, (unsigned long)st.unexpected, (unsigned long)st.send_failed);
+    if (st.received == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "RTT us min/avg/p50/p90/p99/max: %lu/%lu/%lu/%lu/%lu/%lu, responder avg/max %lu/%lu",
+             (unsigned long)st.rtt_min_us, (unsigned long)st.rtt_avg_us,
+             (unsigned long)can_twai_ping_percentile_us(&st, 50),
+             (unsigned long)can_twai_ping_percentile_us(&st, 90),
+             (unsigned long)can_twai_ping_percentile_us(&st, 99),
+             (unsigned long)st.rtt_max_us,
+             (unsigned long)st.turnaround_avg_us, (unsigned long)st.turnaround_max_us);
+
+    uint32_t peak = 0;
+    for (size_t b = 0; b < CAN_TWAI_PING_HIST_BUCKETS; b++) {
+        peak = st.hist[b] > peak ? st.hist[b] : peak;
+    }
+    char bar[HIST_BAR_WIDTH + 1];
+    for (size_t b = 0; b < CAN_TWAI_PING_HIST_BUCKETS; b++) {
+        if (st.hist[b] == 0) {
+            continue;
+        }
+        size_t len = (size_t)((uint64_t)st.hist[b] * HIST_BAR_WIDTH / peak);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        uint32_t lo = (uint32_t)b * st.bucket_us;
+        if (b == CAN_TWAI_PING_HIST_BUCKETS - 1) {
+            ESP_LOGI(TAG, "%6lu+      us | %7lu %s", (unsigned long)lo, (unsigned long)st.hist[b], bar);
+        } else {
+            ESP_LOGI(TAG, "%6lu-%-6lu us | %7lu %s", (unsigned long)lo,
+                     (unsigned long)(lo + st.bucket_us), (unsigned long)st.hist[b], bar);
+        }
+    }
+}
@@ -0,0 +1,343 @@
+/**
+ * @file can_twai_priv.h
+ * @brief Internal interfaces shared between TWAI adapter modules
+ * 
+ * Not part of the public API. Feature modules (process image, E2E, ...) use
+ * these hooks to attach themselves to the adapter's receive and transmit paths.
+ * 
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#endif
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Placement of receive/transmit hot-path code
+ *
+ * With CONFIG_CAN_TWAI_IRAM_HOT_PATH the send/receive functions and the hook
+ * dispatchers live in IRAM, so they never miss in the flash cache and keep
+ * their timing while flash is being written by the other core.
+ */
+#if CONFIG_CAN_TWAI_IRAM_HOT_PATH
+#define CAN_TWAI_HOT_ATTR IRAM_ATTR
+#else
+#define CAN_TWAI_HOT_ATTR
+#endif
+
+/**
+ * @brief Allocate zeroed hot-path data
+ *
+ * With CONFIG_CAN_TWAI_IRAM_HOT_PATH the memory is taken from internal DRAM
+ * even when malloc() may return PSRAM. Release with free().
+ */
+static inline void *can_twai_hot_calloc(size_t n, size_t size)
+{
+#if CONFIG_CAN_TWAI_IRAM_HOT_PATH
+    return heap_caps_calloc(n, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+    return calloc(n, size);
+#endif
+}
+
+/** @brief Maximum number of simultaneously registered RX hooks */
+#define CAN_TWAI_MAX_RX_HOOKS 8
+
+/** @brief Maximum number of simultaneously registered TX hooks */
+#define CAN_TWAI_MAX_TX_HOOKS 4
+
+/** @brief Maximum number of simultaneously registered TX-done hooks */
+#define CAN_TWAI_MAX_TX_DONE_HOOKS 2
+
+/** @brief Maximum number of simultaneously registered alert hooks */
+#define CAN_TWAI_MAX_ALERT_HOOKS 4
+
+/**
+ * @brief Receive-path hook
+ * 
+ * Called for every valid message received through can_twai_receive_timeout(),
+ * in registration order, from the receiving task.
+ * 
+ * @param[in,out] msg        Received message (hooks may modify it)
+ * @param[in]     rx_time_us Reception time (esp_timer_get_time())
+ * @param[in]     ctx        Context pointer given at registration
+ * 
+ * @return true to pass the message on, false to consume it (the caller of
+ *         can_twai_receive() then sees no message)
+ */
+typedef bool (*can_twai_rx_hook_t)(twai_message_t *msg, int64_t rx_time_us, void *ctx);
+
+/**
+ * @brief Register a receive-path hook
+ * 
+ * @return false if the hook table is full
+ * 
+ * @note May be called while frames are being received. Unregistering returns
+ *       only after every dispatch that could still call the hook has
+ *       finished, so the module may free its state right afterwards. Must
+ *       not be called from a receive-path hook (it would wait for itself).
+ */
+bool can_twai_register_rx_hook(can_twai_rx_hook_t hook, void *ctx);
+
+/**
+ * @brief Remove a previously registered receive-path hook
+ */
+void can_twai_unregister_rx_hook(can_twai_rx_hook_t hook, void *ctx);
+
+/**
+ * @brief Wait until every receive-path dispatch in progress has finished
+ * 
+ * Lets a hook that walks its own lock-free list free an element it has
+ * just unlinked: dispatches that start afterwards cannot see it any more.
+ * 
+ * @note Must not be called from a receive-path hook
+ */
+void can_twai_sync_rx_hooks(void);
+
+/**
+ * @brief Final delivery decision for a received frame
+ * 
+ * Called after all receive-path hooks have passed the frame, so a module
+ * can keep a frame from the application without hiding it from the hooks
+ * registered after its own.
+ * 
+ * @return true to deliver the frame to the caller of can_twai_receive()
+ */
+typedef bool (*can_twai_rx_deliver_t)(const twai_message_t *msg);
+
+/**
+ * @brief Install the delivery filter
+ * 
+ * @param[in] deliver Filter function, or NULL to deliver every frame the hooks pass
+ * 
+ * @note May be called while frames are being received. Returns only after
+ *       every dispatch that could still use the previous function has
+ *       finished, so its resources may be freed right afterwards.
+ */
+void can_twai_set_rx_deliver(can_twai_rx_deliver_t deliver);
+
+/**
+ * @brief Transmit-path hook
+ * 
+ * Called for every message passed to can_twai_send(), in registration order,
+ * on a private copy of the message just before it is handed to the driver.
+ * 
+ * @param[in,out] msg Message about to be sent (hooks may modify it)
+ * @param[in]     seq Sequence number of this send, passed again to the
+ *                    TX-done hooks (wraps after 2^32 sends)
+ * @param[in]     ctx Context pointer given at registration
+ * 
+ * @return true to continue, false to abort the send (can_twai_send() fails)
+ */
+typedef bool (*can_twai_tx_hook_t)(twai_message_t *msg, uint32_t seq, void *ctx);
+
+/**
+ * @brief Register a transmit-path hook
+ * 
+ * @return false if the hook table is full
+ * 
+ * @note May be called while frames are being sent. Unregistering returns only
+ *       after every send that could still call the hook has finished (a send
+ *       may block up to its transmit timeout). Must not be called from a
+ *       transmit-path hook, gate or local delivery function.
+ */
+bool can_twai_register_tx_hook(can_twai_tx_hook_t hook, void *ctx);
+
+/**
+ * @brief Remove a previously registered transmit-path hook
+ */
+void can_twai_unregister_tx_hook(can_twai_tx_hook_t hook, void *ctx);
+
+/**
+ * @brief Transmit-result hook
+ * 
+ * Called at the end of every can_twai_send() that reached the TX hooks,
+ * after the message was handed to the driver or the send was given up.
+ * 
+ * @param[in] msg    Message as passed to the driver (after TX hooks)
+ * @param[in] seq    Sequence number the TX hooks saw for this send
+ * @param[in] queued true if the driver accepted the message into its TX queue
+ * @param[in] ctx    Context pointer given at registration
+ */
+typedef void (*can_twai_tx_done_hook_t)(const twai_message_t *msg, uint32_t seq, bool queued, void *ctx);
+
+/**
+ * @brief Register a transmit-result hook
+ * 
+ * @return false if the hook table is full
+ * 
+ * @note May be called while frames are being sent. Unregistering returns only
+ *       after every send that could still call the hook has finished (a send
+ *       may block up to its transmit timeout). Must not be called from a
+ *       transmit-path hook, gate or local delivery function.
+ */
+bool can_twai_register_tx_done_hook(can_twai_tx_done_hook_t hook, void *ctx);
+
+/**
+ * @brief Remove a previously registered transmit-result hook
+ */
+void can_twai_unregister_tx_done_hook(can_twai_tx_done_hook_t hook, void *ctx);
+
+/**
+ * @brief Alert hook
+ * 
+ * Called from the adapter's alert task whenever twai_read_alerts() returns
+ * alerts that intersect the mask given at registration.
+ * 
+ * @param[in] alerts  All alerts returned by the driver (TWAI_ALERT_* bits)
+ * @param[in] time_us Time the alerts were read (esp_timer_get_time())
+ * @param[in] ctx     Context pointer given at registration
+ */
+typedef void (*can_twai_alert_hook_t)(uint32_t alerts, int64_t time_us, void *ctx);
+
+/**
+ * @brief Register an alert hook and enable the alerts it needs
+ * 
+ * The first registration starts the alert task, which becomes the only
+ * reader of twai_read_alerts(). Alerts requested by hooks are enabled on
+ * top of params.alerts_enabled.
+ * 
+ * @return false if the hook table is full, the driver is not installed or
+ *         the alert task cannot be created
+ * 
+ * @note Call after can_twai_init()
+ */
+bool can_twai_register_alert_hook(uint32_t alerts, can_twai_alert_hook_t hook, void *ctx);
+
+/**
+ * @brief Remove an alert hook; the last removal stops the alert task
+ */
+void can_twai_unregister_alert_hook(can_twai_alert_hook_t hook, void *ctx);
+
+/**
+ * @brief Replacement source for received frames
+ * 
+ * Same contract as twai_receive(): ESP_OK with a frame, ESP_ERR_TIMEOUT
+ * if none arrived within @p timeout.
+ */
+typedef esp_err_t (*can_twai_rx_source_t)(twai_message_t *msg, TickType_t timeout);
+
+/**
+ * @brief Make can_twai_receive_timeout() read frames from @p source
+ * 
+ * Used by modules that take over the driver RX queue themselves (e.g. the
+ * fast path dispatcher) and forward the remaining traffic. Validation and
+ * RX hooks still run on forwarded frames.
+ * 
+ * @param[in] source Frame source, or NULL to read the driver again
+ * 
+ * @note Switch while no receive is in progress (module init/deinit)
+ */
+void can_twai_set_rx_source(can_twai_rx_source_t source);
+
+/**
+ * @brief Send a frame that is known to be valid
+ * 
+ * Same as can_twai_send_timeout() without the message validation. Used for
+ * frames checked once in advance (e.g. message templates).
+ */
+bool can_twai_send_validated(const twai_message_t *msg, TickType_t timeout);
+
+/**
+ * @brief Transmit timeout used by can_twai_send()
+ */
+TickType_t can_twai_get_transmit_timeout(void);
+
+/**
+ * @brief Configured driver TX queue length (0 if the backend has none)
+ */
+int can_twai_get_tx_queue_len(void);
+
+/**
+ * @brief Receive straight from the active backend
+ *
+ * Bypasses the frame source, validation and receive hooks. Used by modules
+ * that drain the controller themselves (fast path, sniffer).
+ */
+esp_err_t can_twai_backend_receive(twai_message_t *msg, TickType_t timeout);
+
+/**
+ * @brief can_twai_receive_batch() that also reports how many frames it took
+ *
+ * @param[out] taken Frames taken from the queue, including those dropped for
+ *                   an invalid DLC or consumed by a hook (may be NULL)
+ *
+ * @return Number of messages stored in @p msgs
+ *
+ * @note A return value of 0 with *taken > 0 means the queue was not empty.
+ */
+size_t can_twai_receive_batch_counted(twai_message_t *msgs, size_t max, TickType_t timeout, size_t *taken);
+
+/**
+ * @brief Status of the active backend, with the driver's error code
+ */
+esp_err_t can_twai_backend_status(twai_status_info_t *status);
+
+/**
+ * @brief Local delivery of transmitted frames
+ * 
+ * Called by can_twai_send() for every frame after the TX hooks, just before
+ * it is handed to the driver, from the sending task.
+ * 
+ * @param[in] msg Frame about to be sent
+ * 
+ * @return true to also transmit the frame on the bus, false to keep it
+ *         local (can_twai_send() still succeeds)
+ */
+typedef bool (*can_twai_tx_local_t)(const twai_message_t *msg);
+
+/**
+ * @brief Install the local delivery function
+ * 
+ * @param[in] local Delivery function, or NULL to send everything to the bus only
+ * 
+ * @note May be called while frames are being sent. Returns only after every
+ *       send that could still use the previous function has finished, so
+ *       its resources may be freed right afterwards.
+ */
+void can_twai_set_tx_local(can_twai_tx_local_t local);
+
+/**
+ * @brief Exclusive access to the transmit path
+ * 
+ * Called by can_twai_send() with @p enter true before the TX hooks and with
+ * @p enter false after the frame was handed to the driver (or rejected).
+ * Used to keep frames of other senders out of a burst group.
+ * 
+ * @param[in] enter   true to acquire, false to release
+ * @param[in] timeout Maximum time to wait when acquiring
+ * 
+ * @return false if the transmit path could not be acquired in time (the
+ *         frame is then not sent); ignored on release
+ */
+typedef bool (*can_twai_tx_gate_t)(bool enter, TickType_t timeout);
+
+/**
+ * @brief Install the transmit gate
+ * 
+ * @param[in] gate Gate function, or NULL to send without serialization
+ * 
+ * @note May be called while frames are being sent. Returns only after every
+ *       send that could still use the previous function has finished, so
+ *       its resources may be freed right afterwards.
+ */
+void can_twai_set_tx_gate(can_twai_tx_gate_t gate);
+
+#ifdef __cplusplus
+}
+#endif
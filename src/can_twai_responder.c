@@ -0,0 +1,224 @@
+/**
+ * @file can_twai_responder.c
+ * @brief Request ID -> response table serviced from the receive path
+ *
+ * The table is sorted by request ID and searched with a binary search. The
+ * response is built on the stack from the template (and, for live entries,
+ * the live payload copied under the lock). It is then queued without
+ * blocking, so a full TX queue never stalls reception.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_responder.h"
+#include "can_twai.h"
+#include "can_twai_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_responder";
+
+/** @brief Runtime state of one request ID */
+typedef struct {
+    can_twai_responder_entry_t cfg;
+    uint8_t                    live_data[TWAI_FRAME_MAX_DLC];
+    uint8_t                    live_dlc;
+    uint32_t                   requests;
+    uint32_t                   responses;
+    uint32_t                   failed;
+    uint32_t                   latency_max_us;
+    uint64_t                   latency_sum_us;
+} responder_entry_t;
+
+/** @brief Entries sorted by request ID */
+static responder_entry_t *entries_tab = NULL;
+static size_t entry_count = 0;
+
+/** @brief Guards live payloads and statistics */
+static portMUX_TYPE resp_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int cmp_entry(const void *a, const void *b)
+{
+    uint32_t x = ((const responder_entry_t *)a)->cfg.request_id;
+    uint32_t y = ((const responder_entry_t *)b)->cfg.request_id;
+    return (x > y) - (x < y);
+}
+
+static CAN_TWAI_HOT_ATTR responder_entry_t *find_entry(uint32_t identifier)
+{
+    size_t lo = 0;
+    size_t hi = entry_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t key = entries_tab[mid].cfg.request_id;
+        if (key == identifier) {
+            return &entries_tab[mid];
+        }
+        if (key < identifier) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static CAN_TWAI_HOT_ATTR bool matches(const responder_entry_t *e, const twai_message_t *msg)
+{
+    switch (e->cfg.match) {
+    case CAN_TWAI_RESPONDER_RTR:
+        return msg->rtr;
+    case CAN_TWAI_RESPONDER_DATA:
+        return !msg->rtr;
+    default:
+        return true;
+    }
+}
+
+static CAN_TWAI_HOT_ATTR bool responder_rx_hook(twai_message_t *msg, int64_t rx_time_us, void *ctx)
+{
+    (void)ctx;
+    responder_entry_t *e = find_entry(msg->identifier);
+    if (e == NULL || !matches(e, msg)) {
+        return true;
+    }
+
+    twai_message_t resp = e->cfg.response;
+    if (e->cfg.live) {
+        portENTER_CRITICAL(&resp_lock);
+        resp.data_length_code = e->live_dlc;
+        memcpy(resp.data, e->live_data, e->live_dlc);
+        portEXIT_CRITICAL(&resp_lock);
+    }
+
+    bool queued = can_twai_send_timeout(&resp, 0);
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - rx_time_us);
+
+    portENTER_CRITICAL(&resp_lock);
+    e->requests++;
+    if (queued) {
+        e->responses++;
+        e->latency_sum_us += dt;
+        if (dt > e->latency_max_us) {
+            e->latency_max_us = dt;
+        }
+    } else {
+        e->failed++;
+    }
+    portEXIT_CRITICAL(&resp_lock);
+
+    return !e->cfg.consume;
+}
+
+bool can_twai_responder_init(const can_twai_responder_config_t *cfg)
+{
+    if (entries_tab != NULL) {
+        ESP_LOGE(TAG, "Responder already initialized");
+        return false;
+    }
+    if (cfg == NULL || cfg->entries == NULL || cfg->count == 0) {
+        ESP_LOGE(TAG, "Invalid responder configuration");
+        return false;
+    }
+
+    responder_entry_t *tab = can_twai_hot_calloc(cfg->count, sizeof(responder_entry_t));
+    if (tab == NULL) {
+        ESP_LOGE(TAG, "Out of memory for %u entries", (unsigned)cfg->count);
+        return false;
+    }
+
+    for (size_t i = 0; i < cfg->count; i++) {
+        const can_twai_responder_entry_t *c = &cfg->entries[i];
+        if (c->response.data_length_code > TWAI_FRAME_MAX_DLC || c->match > CAN_TWAI_RESPONDER_ANY) {
+            ESP_LOGE(TAG, "ID 0x%lX: invalid response template", (unsigned long)c->request_id);
+            free(tab);
+            return false;
+        }
+        tab[i].cfg = *c;
+        tab[i].live_dlc = c->response.data_length_code;
+        memcpy(tab[i].live_data, c->response.data, c->response.data_length_code);
+    }
+
+    qsort(tab, cfg->count, sizeof(responder_entry_t), cmp_entry);
+    for (size_t i = 1; i < cfg->count; i++) {
+        if (tab[i].cfg.request_id == tab[i - 1].cfg.request_id) {
+            ESP_LOGE(TAG, "Duplicate request ID 0x%lX", (unsigned long)tab[i].cfg.request_id);
+            free(tab);
+            return false;
+        }
+    }
+
+    entries_tab = tab;
+    entry_count = cfg->count;
+
+    if (!can_twai_register_rx_hook(responder_rx_hook, NULL)) {
+        free(entries_tab);
+        entries_tab = NULL;
+        entry_count = 0;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Auto-responder active for %u request IDs", (unsigned)entry_count);
+    return true;
+}
+
+void can_twai_responder_deinit(void)
+{
+    if (entries_tab == NULL) {
+        return;
+    }
+    can_twai_unregister_rx_hook(responder_rx_hook, NULL);
+    free(entries_tab);
+    entries_tab = NULL;
+    entry_count = 0;
+}
+
+bool can_twai_responder_set_data(uint32_t request_id, const uint8_t *data, uint8_t len)
+{
+    responder_entry_t *e = entries_tab != NULL ? find_entry(request_id) : NULL;
+    if (e == NULL || !e->cfg.live || len > TWAI_FRAME_MAX_DLC || (len > 0 && data == NULL)) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&resp_lock);
+    memcpy(e->live_data, data, len);
+    e->live_dlc = len;
+    portEXIT_CRITICAL(&resp_lock);
+    return true;
+}
+
+bool can_twai_responder_get_stats(uint32_t request_id, can_twai_responder_stats_t *out)
+{
+    responder_entry_t *e = entries_tab != NULL ? find_entry(request_id) : NULL;
+    if (e == NULL || out == NULL) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&resp_lock);
+    out->requests = e->requests;
+    out->responses = e->responses;
+    out->failed = e->failed;
+    out->latency_max_us = e->latency_max_us;
+    out->latency_avg_us = e->responses ? (uint32_t)(e->latency_sum_us / e->responses) : 0;
+    portEXIT_CRITICAL(&resp_lock);
+    return true;
+}
+
+void can_twai_responder_reset_stats(void)
+{
+    portENTER_CRITICAL(&resp_lock);
+    for (size_t i = 0; i < entry_count; i++) {
+        responder_entry_t *e = &entries_tab[i];
+        e->requests = 0;
+        e->responses = 0;
+        e->failed = 0;
+        e->latency_max_us = 0;
+        e->latency_sum_us = 0;
+    }
+    portEXIT_CRITICAL(&resp_lock);
+}
@@ -0,0 +1,577 @@
+/**
+ * @file can_twai_rxbuf.c
+ * @brief RX buffer with priority-aware overflow policies
+ *
+ * Each lane is a ring of frames. Frames are compared by their arbitration
+ * key: the 11-bit base ID in the top bits, then the IDE bit, then the
+ * 18-bit ID extension, so a lower key wins arbitration and a standard frame
+ * beats an extended one with the same base ID.
+ *
+ * With DROP_LOWEST a lane instead keeps its frames in a slot pool linked in
+ * arrival order, plus a binary max-heap of the slots ordered by (key,
+ * arrival), so the frame to evict is always at the heap root. Push, pop and
+ * eviction each cost O(log capacity) under the lock instead of a scan and
+ * shift of the whole lane.
+ *
+ * Drop counts live in an open-addressing hash table like the one in
+ * can_twai_cantop.c: keys are (identifier + 1) with bit 31 marking extended
+ * IDs, linear probing, at most 7/8 full, rows never deleted.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_rxbuf.h"
+#include "can_twai_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_rxbuf";
+
+#define DEFAULT_CAPACITY   64
+#define DEFAULT_DROP_TABLE 64
+#define KEY_EXTD           0x80000000u
+#define NO_SLOT            UINT32_MAX
+
+/** @brief Bookkeeping of one frame slot in a DROP_LOWEST lane */
+typedef struct {
+    uint32_t next;      /**< Next newer frame, or next free slot */
+    uint32_t prev;      /**< Next older frame */
+    uint32_t heap_pos;  /**< Index in the heap */
+    uint32_t key;       /**< Arbitration key */
+    uint32_t seq;       /**< Arrival number, newer wins ties as the victim */
+} prio_slot_t;
+
+/** @brief Ring of frames, or slot pool with a priority heap (DROP_LOWEST) */
+typedef struct {
+    twai_message_t *buf;
+    size_t          cap;
+    size_t          head;        /**< Ring: oldest index; pool: oldest slot */
+    size_t          count;
+    uint32_t        high_water;
+    prio_slot_t    *slots;       /**< DROP_LOWEST only, else NULL */
+    uint32_t       *heap;        /**< Slots, lowest priority at the root */
+    uint32_t        tail;        /**< Newest slot */
+    uint32_t        free_slot;   /**< Head of the free slot list */
+    uint32_t        seq;
+} lane_t;
+
+/** @brief Drop table slot */
+typedef struct {
+    uint32_t key;    /**< (identifier + 1) | KEY_EXTD, 0 = empty */
+    uint32_t drops;
+} drop_slot_t;
+
+/** @brief Module state */
+typedef struct {
+    can_twai_rxbuf_policy_t policy;
+    lane_t                  main;
+    lane_t                  fast;
+    uint32_t                fast_key;   /**< Arbitration key limit of the fast lane */
+    drop_slot_t            *drops;
+    uint32_t                mask;       /**< Drop table size - 1 */
+    uint32_t                shift;      /**< 32 - log2(drop table size) */
+    uint32_t                used;
+    uint32_t                limit;      /**< Maximum number of used drop slots (7/8 load) */
+    can_twai_rxbuf_stats_t  st;
+    SemaphoreHandle_t       avail;      /**< Given when a frame is queued */
+    bool                    running;
+} rxbuf_t;
+
+static rxbuf_t rb;
+static portMUX_TYPE rb_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t arb_key(uint32_t identifier, bool extd)
+{
+    if (extd) {
+        return ((identifier >> 18) & TWAI_STD_ID_MASK) << 19 | 1u << 18 | (identifier & 0x3FFFF);
+    }
+    return (identifier & TWAI_STD_ID_MASK) << 19;
+}
+
+static inline twai_message_t *lane_at(lane_t *lane, size_t i)
+{
+    size_t pos = lane->head + i;
+    return &lane->buf[pos < lane->cap ? pos : pos - lane->cap];
+}
+
+static inline void lane_append(lane_t *lane, const twai_message_t *msg)
+{
+    *lane_at(lane, lane->count) = *msg;
+    lane->count++;
+    if (lane->count > lane->high_water) {
+        lane->high_water = lane->count;
+    }
+}
+
+/** @brief true if slot @p a loses against slot @p b (lower priority, or equal and newer) */
+static inline bool prio_worse(const lane_t *lane, uint32_t a, uint32_t b)
+{
+    const prio_slot_t *x = &lane->slots[a];
+    const prio_slot_t *y = &lane->slots[b];
+    return x->key != y->key ? x->key > y->key : (int32_t)(x->seq - y->seq) > 0;
+}
+
+static inline void heap_set(lane_t *lane, size_t i, uint32_t slot)
+{
+    lane->heap[i] = slot;
+    lane->slots[slot].heap_pos = (uint32_t)i;
+}
+
+/** @brief Restore the heap order around index @p i of a heap with @p n entries */
+static CAN_TWAI_HOT_ATTR void heap_fix(lane_t *lane, size_t i, size_t n)
+{
+    uint32_t slot = lane->heap[i];
+    while (i > 0 && prio_worse(lane, slot, lane->heap[(i - 1) / 2])) {
+        heap_set(lane, i, lane->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= n) {
+            break;
+        }
+        if (c + 1 < n && prio_worse(lane, lane->heap[c + 1], lane->heap[c])) {
+            c++;
+        }
+        if (!prio_worse(lane, lane->heap[c], slot)) {
+            break;
+        }
+        heap_set(lane, i, lane->heap[c]);
+        i = c;
+    }
+    heap_set(lane, i, slot);
+}
+
+static CAN_TWAI_HOT_ATTR void prio_append(lane_t *lane, const twai_message_t *msg, uint32_t key)
+{
+    uint32_t s = lane->free_slot;
+    prio_slot_t *ps = &lane->slots[s];
+    lane->free_slot = ps->next;
+
+    lane->buf[s] = *msg;
+    ps->next = NO_SLOT;
+    ps->prev = lane->tail;
+    ps->key = key;
+    ps->seq = lane->seq++;
+    if (lane->tail != NO_SLOT) {
+        lane->slots[lane->tail].next = s;
+    } else {
+        lane->head = s;
+    }
+    lane->tail = s;
+
+    lane->heap[lane->count] = s;
+    lane->count++;
+    heap_fix(lane, lane->count - 1, lane->count);
+    if (lane->count > lane->high_water) {
+        lane->high_water = lane->count;
+    }
+}
+
+/** @brief Remove slot @p s from arrival order and heap and free it */
+static CAN_TWAI_HOT_ATTR void prio_remove(lane_t *lane, uint32_t s)
+{
+    prio_slot_t *ps = &lane->slots[s];
+    if (ps->prev != NO_SLOT) {
+        lane->slots[ps->prev].next = ps->next;
+    } else {
+        lane->head = ps->next;
+    }
+    if (ps->next != NO_SLOT) {
+        lane->slots[ps->next].prev = ps->prev;
+    } else {
+        lane->tail = ps->prev;
+    }
+
+    size_t i = ps->heap_pos;
+    size_t last = --lane->count;
+    if (i != last) {
+        heap_set(lane, i, lane->heap[last]);
+        heap_fix(lane, i, lane->count);
+    }
+
+    ps->next = lane->free_slot;
+    lane->free_slot = s;
+}
+
+static inline void lane_take(lane_t *lane, twai_message_t *msg)
+{
+    if (lane->slots != NULL) {
+        uint32_t s = (uint32_t)lane->head;
+        *msg = lane->buf[s];
+        prio_remove(lane, s);
+        return;
+    }
+    *msg = lane->buf[lane->head];
+    lane->head = lane->head + 1 < lane->cap ? lane->head + 1 : 0;
+    lane->count--;
+}
+
+/** @brief Count a lost frame of @p msg's ID (lock held) */
+static CAN_TWAI_HOT_ATTR void count_drop(const twai_message_t *msg)
+{
+    uint32_t key = (msg->identifier + 1) | (msg->extd ? KEY_EXTD : 0);
+    uint32_t i = (key * 0x9E3779B1u) >> rb.shift;
+    while (rb.drops[i].key != key && rb.drops[i].key != 0) {
+        i = (i + 1) & rb.mask;
+    }
+
+    rb.st.dropped++;
+    if (rb.drops[i].key == 0) {
+        if (rb.used >= rb.limit) {
+            rb.st.untracked_ids++;
+            return;
+        }
+        rb.used++;
+        rb.drops[i].key = key;
+    }
+    rb.drops[i].drops++;
+}
+
+/** @brief Store a frame in a lane, applying the policy (lock held) */
+static CAN_TWAI_HOT_ATTR bool lane_store(lane_t *lane, const twai_message_t *msg, uint32_t key)
+{
+    if (lane->count < lane->cap) {
+        if (lane->slots != NULL) {
+            prio_append(lane, msg, key);
+        } else {
+            lane_append(lane, msg);
+        }
+        return true;
+    }
+
+    twai_message_t old;
+    switch (rb.policy) {
+    case CAN_TWAI_RXBUF_DROP_OLDEST:
+        lane_take(lane, &old);
+        count_drop(&old);
+        rb.st.dropped_oldest++;
+        lane_append(lane, msg);
+        return true;
+
+    case CAN_TWAI_RXBUF_DROP_LOWEST: {
+        // Heap root: highest key, among equal keys the newest, like an arriving one would
+        uint32_t victim = lane->heap[0];
+        if (key < lane->slots[victim].key) {
+            count_drop(&lane->buf[victim]);
+            rb.st.evicted++;
+            prio_remove(lane, victim);
+            prio_append(lane, msg, key);
+            return true;
+        }
+        break;
+    }
+
+    case CAN_TWAI_RXBUF_DROP_NEWEST:
+    default:
+        break;
+    }
+
+    count_drop(msg);
+    rb.st.dropped_newest++;
+    return false;
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_rxbuf_push(const twai_message_t *msg)
+{
+    if (msg == NULL) {
+        return false;
+    }
+    uint32_t key = arb_key(msg->identifier, msg->extd);
+
+    portENTER_CRITICAL(&rb_lock);
+    if (!rb.running) {
+        portEXIT_CRITICAL(&rb_lock);
+        return false;
+    }
+    rb.st.pushed++;
+    bool fast = rb.fast.cap > 0 && key <= rb.fast_key;
+    bool stored = lane_store(fast ? &rb.fast : &rb.main, msg, key);
+    if (stored && fast) {
+        rb.st.fast++;
+    }
+    portEXIT_CRITICAL(&rb_lock);
+
+    if (stored) {
+        xSemaphoreGive(rb.avail);
+    }
+    return stored;
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_rxbuf_pop(twai_message_t *msg, TickType_t timeout)
+{
+    if (msg == NULL || !rb.running) {
+        return false;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        portENTER_CRITICAL(&rb_lock);
+        lane_t *lane = rb.fast.count > 0 ? &rb.fast : rb.main.count > 0 ? &rb.main : NULL;
+        if (lane != NULL) {
+            lane_take(lane, msg);
+            rb.st.popped++;
+            bool more = rb.fast.count + rb.main.count > 0;
+            portEXIT_CRITICAL(&rb_lock);
+            if (more) {
+                // The semaphore is binary: pass the wakeup on to the next consumer
+                xSemaphoreGive(rb.avail);
+            }
+            return true;
+        }
+        portEXIT_CRITICAL(&rb_lock);
+
+        TickType_t wait = timeout;
+        if (timeout != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= timeout) {
+                return false;
+            }
+            wait = timeout - elapsed;
+        }
+        if (xSemaphoreTake(rb.avail, wait) != pdTRUE) {
+            return false;
+        }
+    }
+}
+
+static bool lane_alloc(lane_t *lane, size_t cap, bool prio)
+{
+    memset(lane, 0, sizeof(*lane));
+    if (cap == 0) {
+        return true;
+    }
+    lane->buf = can_twai_hot_calloc(cap, sizeof(twai_message_t));
+    lane->cap = cap;
+    if (lane->buf == NULL || !prio) {
+        return lane->buf != NULL;
+    }
+
+    lane->slots = can_twai_hot_calloc(cap, sizeof(prio_slot_t));
+    lane->heap = can_twai_hot_calloc(cap, sizeof(uint32_t));
+    if (lane->slots == NULL || lane->heap == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < cap; i++) {
+        lane->slots[i].next = i + 1 < cap ? (uint32_t)(i + 1) : NO_SLOT;
+    }
+    lane->head = NO_SLOT;
+    lane->tail = NO_SLOT;
+    lane->free_slot = 0;
+    return true;
+}
+
+static void lane_free(lane_t *lane)
+{
+    free(lane->buf);
+    free(lane->slots);
+    free(lane->heap);
+}
+
+bool can_twai_rxbuf_init(const can_twai_rxbuf_config_t *cfg)
+{
+    if (rb.running) {
+        ESP_LOGE(TAG, "RX buffer already initialized");
+        return false;
+    }
+    if (cfg == NULL || cfg->policy > CAN_TWAI_RXBUF_DROP_LOWEST ||
+        cfg->fast_lane_id > (cfg->fast_lane_extd ? TWAI_EXTD_ID_MASK : TWAI_STD_ID_MASK)) {
+        ESP_LOGE(TAG, "Invalid configuration");
+        return false;
+    }
+
+    size_t want = cfg->drop_table_len ? cfg->drop_table_len : DEFAULT_DROP_TABLE;
+    uint32_t bits = 3;
+    while (((size_t)1 << bits) < want && bits < 16) {
+        bits++;
+    }
+    size_t table = (size_t)1 << bits;
+
+    memset(&rb, 0, sizeof(rb));
+    rb.policy = cfg->policy;
+    rb.fast_key = arb_key(cfg->fast_lane_id, cfg->fast_lane_extd);
+    bool prio = cfg->policy == CAN_TWAI_RXBUF_DROP_LOWEST;
+    if (!lane_alloc(&rb.main, cfg->capacity ? cfg->capacity : DEFAULT_CAPACITY, prio) ||
+        !lane_alloc(&rb.fast, cfg->fast_lane_len, prio)) {
+        ESP_LOGE(TAG, "Out of memory");
+        goto fail;
+    }
+    rb.drops = can_twai_hot_calloc(table, sizeof(drop_slot_t));
+    rb.avail = xSemaphoreCreateBinary();
+    if (rb.drops == NULL || rb.avail == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        goto fail;
+    }
+    rb.mask = table - 1;
+    rb.shift = 32 - bits;
+    rb.limit = table - table / 8;
+
+    portENTER_CRITICAL(&rb_lock);
+    rb.running = true;
+    portEXIT_CRITICAL(&rb_lock);
+    if (rb.fast.cap > 0) {
+        ESP_LOGI(TAG, "RX buffer: %u frames + %u fast lane (IDs up to 0x%lX), policy %d",
+                 (unsigned)rb.main.cap, (unsigned)rb.fast.cap, (unsigned long)cfg->fast_lane_id, (int)rb.policy);
+    } else {
+        ESP_LOGI(TAG, "RX buffer: %u frames, policy %d", (unsigned)rb.main.cap, (int)rb.policy);
+    }
+    return true;
+
+fail:
+    lane_free(&rb.main);
+    lane_free(&rb.fast);
+    free(rb.drops);
+    if (rb.avail != NULL) {
+        vSemaphoreDelete(rb.avail);
+    }
+    memset(&rb, 0, sizeof(rb));
+    return false;
+}
+
+void can_twai_rxbuf_deinit(void)
+{
+    if (!rb.running) {
+        return;
+    }
+    portENTER_CRITICAL(&rb_lock);
+    rb.running = false;
+    portEXIT_CRITICAL(&rb_lock);
+
+    if (rb.st.dropped > 0) {
+        ESP_LOGW(TAG, "%lu frames dropped", (unsigned long)rb.st.dropped);
+    }
+    lane_free(&rb.main);
+    lane_free(&rb.fast);
+    free(rb.drops);
+    vSemaphoreDelete(rb.avail);
+    memset(&rb, 0, sizeof(rb));
+}
+
+void can_twai_rxbuf_get_stats(can_twai_rxbuf_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&rb_lock);
+    *out = rb.st;
+    out->depth = rb.main.count + rb.fast.count;
+    out->high_water = rb.main.high_water;
+    out->fast_high_water = rb.fast.high_water;
+    portEXIT_CRITICAL(&rb_lock);
+}
+
+uint32_t can_twai_rxbuf_get_drops(uint32_t identifier, bool extd)
+{
+    uint32_t key = (identifier + 1) | (extd ? KEY_EXTD : 0);
+    uint32_t drops = 0;
+
+    portENTER_CRITICAL(&rb_lock);
+    if (rb.running) {
+        uint32_t i = (key * 0x9E3779B1u) >> rb.shift;
+        while (rb.drops[i].key != key && rb.drops[i].key != 0) {
+            i = (i + 1) & rb.mask;
+        }
+        drops = rb.drops[i].drops;
+    }
+    portEXIT_CRITICAL(&rb_lock);
+    return drops;
+}
+
+static int cmp_by_drops(const void *a, const void *b)
+{
+    const drop_slot_t *x = a, *y = b;
+    return x->drops < y->drops ? 1 : x->drops > y->drops ? -1 : (x->key > y->key) - (x->key < y->key);
+}
+
+size_t can_twai_rxbuf_drop_snapshot(can_twai_rxbuf_drop_entry_t *out, size_t max)
+{
+    if (!rb.running || out == NULL || max == 0) {
+        return 0;
+    }
+
+    // Copy under the lock, sort outside of it
+    size_t table = rb.mask + 1;
+    drop_slot_t *copy = malloc(table * sizeof(*copy));
+    if (copy == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        return 0;
+    }
+    portENTER_CRITICAL(&rb_lock);
+    memcpy(copy, rb.drops, table * sizeof(*copy));
+    portEXIT_CRITICAL(&rb_lock);
+
+    size_t n = 0;
+    for (size_t i = 0; i < table; i++) {
+        if (copy[i].key != 0) {
+            copy[n++] = copy[i];
+        }
+    }
+    qsort(copy, n, sizeof(*copy), cmp_by_drops);
+    if (n > max) {
+        n = max;
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i].identifier = (copy[i].key & ~KEY_EXTD) - 1;
+        out[i].extd = (copy[i].key & KEY_EXTD) != 0;
+        out[i].drops = copy[i].drops;
+    }
+    free(copy);
+    return n;
+}
+
+void can_twai_rxbuf_reset_stats(void)
+{
+    portENTER_CRITICAL(&rb_lock);
+    if (rb.running) {
+        memset(&rb.st, 0, sizeof(rb.st));
+        memset(rb.drops, 0, (rb.mask + 1) * sizeof(drop_slot_t));
+        rb.used = 0;
+        rb.main.high_water = rb.main.count;
+        rb.fast.high_water = rb.fast.count;
+    }
+    portEXIT_CRITICAL(&rb_lock);
+}
+
+void can_twai_rxbuf_log_report(size_t rows)
+{
+    if (!rb.running) {
+        ESP_LOGW(TAG, "RX buffer not running");
+        return;
+    }
+
+    can_twai_rxbuf_stats_t st;
+    can_twai_rxbuf_get_stats(&st);
+    ESP_LOGI(TAG, "Pushed %lu, popped %lu, fast lane %lu, queued %lu (high water %lu/%u, fast %lu/%u)",
+             (unsigned long)st.pushed, (unsigned long)st.popped, (unsigned long)st.fast,
+             (unsigned long)st.depth, (unsigned long)st.high_water, (unsigned)rb.main.cap,
+             (unsigned long)st.fast_high_water, (unsigned)rb.fast.cap);
+    ESP_LOGI(TAG, "Dropped %lu: %lu newest, %lu oldest, %lu evicted, %lu of untracked IDs",
+             (unsigned long)st.dropped, (unsigned long)st.dropped_newest, (unsigned long)st.dropped_oldest,
+             (unsigned long)st.evicted, (unsigned long)st.untracked_ids);
+    if (st.dropped == 0) {
+        return;
+    }
+
+    size_t max = rows ? rows : rb.limit;
+    can_twai_rxbuf_drop_entry_t *tab = malloc(max * sizeof(*tab));
+    if (tab == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        return;
+    }
+    size_t n = can_twai_rxbuf_drop_snapshot(tab, max);
+    ESP_LOGI(TAG, "        ID |   drops");
+    for (size_t i = 0; i < n; i++) {
+        if (tab[i].extd) {
+            ESP_LOGI(TAG, "  %08lX | %7lu", (unsigned long)tab[i].identifier, (unsigned long)tab[i].drops);
+        } else {
+            ESP_LOGI(TAG, "       %03lX | %7lu", (unsigned long)tab[i].identifier, (unsigned long)tab[i].drops);
+        }
+    }
+    free(tab);
+}
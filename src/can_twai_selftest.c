@@ -0,0 +1,335 @@
+/**
+ * @file can_twai_selftest.c
+ * @brief Self-reception loopback test with throughput, CPU load and latency
+ *
+ * Test frames carry a sequence number in data[0..3] and, in the latency
+ * phase, the low 32 bits of the send time (esp_timer, us) in data[4..7].
+ * A receiver task on the caller's core checks the sequence and measures
+ * latency. CPU load is estimated by an idle-priority spinner task: its
+ * iteration rate during the throughput phase is compared with the rate
+ * measured on an otherwise idle core.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_selftest.h"
+#include "can_twai.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_selftest";
+
+#define RX_TASK_STACK      3072
+#define RX_TASK_PRIO       (configMAX_PRIORITIES - 2)
+#define SPIN_TASK_STACK    1536
+#define CALIBRATION_MS     200
+#define DRAIN_TIMEOUT_MS   500
+#define LATENCY_TIMEOUT_MS 100
+
+/** @brief State shared between the test driver and its helper tasks */
+typedef struct {
+    uint32_t          identifier;
+    volatile bool     rx_stop;
+    volatile bool     rx_exited;
+    volatile bool     measure_latency;
+    volatile uint32_t received;
+    volatile uint32_t corrupt;
+    volatile uint32_t expected_seq;
+    volatile int64_t  last_rx_us;
+    uint32_t          lat_min;
+    uint32_t          lat_max;
+    uint64_t          lat_sum;
+    uint32_t          lat_count;
+    SemaphoreHandle_t rx_sem;
+
+    volatile bool     spin_stop;
+    volatile bool     spin_exited;
+    volatile uint32_t spin_count;
+} selftest_ctx_t;
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/** @brief Worst-case length in bits of a standard-ID data frame incl. stuffing and IFS */
+static uint32_t frame_bits(uint8_t dlc)
+{
+    uint32_t stuffed = 34u + 8u * dlc;
+    return 47u + 8u * dlc + (stuffed - 1u) / 4u;
+}
+
+static void rx_task(void *arg)
+{
+    selftest_ctx_t *ctx = (selftest_ctx_t *)arg;
+    twai_message_t msg;
+
+    while (!ctx->rx_stop) {
+        if (!can_twai_receive_timeout(&msg, pdMS_TO_TICKS(10))) {
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        if (msg.identifier != ctx->identifier || msg.data_length_code < 4) {
+            continue;
+        }
+
+        uint32_t seq = get_le32(msg.data);
+        if (seq != ctx->expected_seq) {
+            ctx->corrupt++;
+        }
+        ctx->expected_seq = seq + 1;
+        ctx->received++;
+        ctx->last_rx_us = now;
+
+        if (ctx->measure_latency && msg.data_length_code == 8) {
+            uint32_t lat = (uint32_t)now - get_le32(&msg.data[4]);
+            if (lat < ctx->lat_min) {
+                ctx->lat_min = lat;
+            }
+            if (lat > ctx->lat_max) {
+                ctx->lat_max = lat;
+            }
+            ctx->lat_sum += lat;
+            ctx->lat_count++;
+            xSemaphoreGive(ctx->rx_sem);
+        }
+    }
+    ctx->rx_exited = true;
+    vTaskDelete(NULL);
+}
+
+static void spin_task(void *arg)
+{
+    selftest_ctx_t *ctx = (selftest_ctx_t *)arg;
+    while (!ctx->spin_stop) {
+        ctx->spin_count++;
+    }
+    ctx->spin_exited = true;
+    vTaskDelete(NULL);
+}
+
+static bool start_spinner(selftest_ctx_t *ctx, BaseType_t core)
+{
+    ctx->spin_stop = false;
+    ctx->spin_exited = false;
+    ctx->spin_count = 0;
+    return xTaskCreatePinnedToCore(spin_task, "can_st_spin", SPIN_TASK_STACK, ctx,
+                                   tskIDLE_PRIORITY, NULL, core) == pdPASS;
+}
+
+static uint32_t stop_spinner(selftest_ctx_t *ctx)
+{
+    ctx->spin_stop = true;
+    while (!ctx->spin_exited) {
+        vTaskDelay(1);
+    }
+    return ctx->spin_count;
+}
+
+/** @brief Spinner iterations per ms on the test core with no CAN traffic */
+static uint32_t calibrate_idle(selftest_ctx_t *ctx, BaseType_t core)
+{
+    if (!start_spinner(ctx, core)) {
+        return 0;
+    }
+    int64_t start = esp_timer_get_time();
+    vTaskDelay(pdMS_TO_TICKS(CALIBRATION_MS));
+    uint32_t count = stop_spinner(ctx);
+    int64_t elapsed_ms = (esp_timer_get_time() - start) / 1000;
+    return elapsed_ms > 0 ? (uint32_t)(count / elapsed_ms) : 0;
+}
+
+static void wait_drained(selftest_ctx_t *ctx, uint32_t expected)
+{
+    int64_t deadline = esp_timer_get_time() + DRAIN_TIMEOUT_MS * 1000;
+    while (ctx->received < expected && esp_timer_get_time() < deadline) {
+        vTaskDelay(1);
+    }
+}
+
+static void run_throughput(selftest_ctx_t *ctx, const can_twai_selftest_config_t *cfg,
+                           uint32_t bitrate_kbps, uint32_t idle_rate, BaseType_t core,
+                           can_twai_selftest_result_t *res)
+{
+    twai_message_t msg = {0};
+    msg.identifier = cfg->identifier;
+    msg.self = 1;
+    msg.data_length_code = cfg->dlc;
+
+    bool spinning = idle_rate > 0 && start_spinner(ctx, core);
+    int64_t start = esp_timer_get_time();
+
+    uint32_t sent = 0;
+    for (uint32_t i = 0; i < cfg->throughput_frames; i++) {
+        put_le32(msg.data, i);
+        if (!can_twai_send(&msg)) {
+            break;
+        }
+        sent++;
+    }
+    wait_drained(ctx, sent);
+
+    int64_t end = ctx->received > 0 ? ctx->last_rx_us : esp_timer_get_time();
+    uint32_t spins = spinning ? stop_spinner(ctx) : 0;
+    int64_t elapsed_us = end - start;
+
+    res->frames_sent = sent;
+    res->frames_received = ctx->received;
+    res->frames_lost = sent > ctx->received ? sent - ctx->received : 0;
+    res->send_failed = cfg->throughput_frames - sent;
+    if (elapsed_us > 0) {
+        res->frames_per_sec = (uint32_t)((uint64_t)ctx->received * 1000000ull / (uint64_t)elapsed_us);
+        res->bus_load_pct = (uint32_t)((uint64_t)res->frames_per_sec * frame_bits(cfg->dlc) /
+                                       (bitrate_kbps * 10u));
+    }
+    if (spinning && elapsed_us >= 1000) {
+        uint64_t idle_spins = (uint64_t)idle_rate * (uint64_t)(elapsed_us / 1000);
+        uint32_t idle_pct = idle_spins > 0 ? (uint32_t)((uint64_t)spins * 100u / idle_spins) : 0;
+        res->cpu_load_pct = idle_pct >= 100 ? 0 : 100 - idle_pct;
+    }
+}
+
+static void run_latency(selftest_ctx_t *ctx, const can_twai_selftest_config_t *cfg,
+                        can_twai_selftest_result_t *res)
+{
+    twai_message_t msg = {0};
+    msg.identifier = cfg->identifier;
+    msg.self = 1;
+    msg.data_length_code = 8;
+
+    ctx->lat_min = UINT32_MAX;
+    ctx->lat_max = 0;
+    ctx->lat_sum = 0;
+    ctx->lat_count = 0;
+    ctx->measure_latency = true;
+
+    uint32_t seq = ctx->expected_seq;
+    for (uint32_t i = 0; i < cfg->latency_samples; i++) {
+        // A late echo of a previous probe must not complete this one
+        xSemaphoreTake(ctx->rx_sem, 0);
+
+        put_le32(msg.data, seq++);
+        put_le32(&msg.data[4], (uint32_t)esp_timer_get_time());
+        if (!can_twai_send(&msg)) {
+            res->send_failed++;
+            seq = ctx->expected_seq;
+            continue;
+        }
+        if (xSemaphoreTake(ctx->rx_sem, pdMS_TO_TICKS(LATENCY_TIMEOUT_MS)) != pdTRUE) {
+            res->frames_lost++;
+            seq = ctx->expected_seq;  // resynchronize after a loss
+        }
+    }
+    ctx->measure_latency = false;
+
+    if (ctx->lat_count > 0) {
+        res->latency_min_us = ctx->lat_min;
+        res->latency_max_us = ctx->lat_max;
+        res->latency_avg_us = (uint32_t)(ctx->lat_sum / ctx->lat_count);
+    }
+}
+
+static void run_bitrate(const twai_backend_config_t *base, const can_twai_selftest_config_t *cfg,
+                        const can_twai_selftest_bitrate_t *rate, uint32_t idle_rate,
+                        selftest_ctx_t *ctx, can_twai_selftest_result_t *res)
+{
+    memset(res, 0, sizeof(*res));
+    res->bitrate_kbps = rate->bitrate_kbps;
+
+    twai_backend_config_t hw = *base;
+    hw.params.mode = TWAI_MODE_NO_ACK;
+    hw.tf.timing = rate->timing;
+    if (!can_twai_init(&hw)) {
+        ESP_LOGE(TAG, "%lu kbit/s: failed to initialize controller", (unsigned long)rate->bitrate_kbps);
+        return;
+    }
+
+    BaseType_t core = xPortGetCoreID();
+    ctx->rx_stop = false;
+    ctx->rx_exited = false;
+    ctx->measure_latency = false;
+    ctx->received = 0;
+    ctx->corrupt = 0;
+    ctx->expected_seq = 0;
+    if (xTaskCreatePinnedToCore(rx_task, "can_st_rx", RX_TASK_STACK, ctx, RX_TASK_PRIO, NULL,
+                                core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create receiver task");
+        can_twai_deinit();
+        return;
+    }
+
+    run_throughput(ctx, cfg, rate->bitrate_kbps, idle_rate, core, res);
+    run_latency(ctx, cfg, res);
+    res->frames_corrupt = ctx->corrupt;
+
+    ctx->rx_stop = true;
+    while (!ctx->rx_exited) {
+        vTaskDelay(1);
+    }
+    can_twai_deinit();
+
+    res->passed = res->frames_lost == 0 && res->send_failed == 0 && res->frames_corrupt == 0;
+}
+
+bool can_twai_selftest_run(const twai_backend_config_t *base,
+                           const can_twai_selftest_config_t *cfg,
+                           can_twai_selftest_result_t *results)
+{
+    if (base == NULL || cfg == NULL || results == NULL || cfg->bitrates == NULL ||
+        cfg->bitrate_count == 0 || cfg->dlc < 4 || cfg->dlc > TWAI_FRAME_MAX_DLC) {
+        ESP_LOGE(TAG, "Invalid self-test configuration");
+        return false;
+    }
+
+    selftest_ctx_t ctx = { .identifier = cfg->identifier };
+    ctx.rx_sem = xSemaphoreCreateBinary();
+    if (ctx.rx_sem == NULL) {
+        ESP_LOGE(TAG, "Failed to create semaphore");
+        return false;
+    }
+
+    uint32_t idle_rate = calibrate_idle(&ctx, xPortGetCoreID());
+    if (idle_rate == 0) {
+        ESP_LOGW(TAG, "CPU load calibration failed, load will not be reported");
+    }
+
+    bool all_passed = true;
+    for (size_t i = 0; i < cfg->bitrate_count; i++) {
+        ESP_LOGI(TAG, "Testing %lu kbit/s ...", (unsigned long)cfg->bitrates[i].bitrate_kbps);
+        run_bitrate(base, cfg, &cfg->bitrates[i], idle_rate, &ctx, &results[i]);
+        all_passed &= results[i].passed;
+    }
+
+    vSemaphoreDelete(ctx.rx_sem);
+    return all_passed;
+}
+
+void can_twai_selftest_print_report(const can_twai_selftest_result_t *results, size_t count)
+{
+    ESP_LOGI(TAG, "kbit/s | result |  sent  |  recv  | lost | txerr | bad | frames/s | bus%% | cpu%% | lat min/avg/max us");
+    for (size_t i = 0; i < count; i++) {
+        const can_twai_selftest_result_t *r = &results[i];
+        ESP_LOGI(TAG, "%6lu | %-6s | %6lu | %6lu | %4lu | %5lu | %3lu | %8lu | %4lu | %4lu | %lu/%lu/%lu",
+                 (unsigned long)r->bitrate_kbps, r->passed ? "PASS" : "FAIL",
+                 (unsigned long)r->frames_sent, (unsigned long)r->frames_received,
+                 (unsigned long)r->frames_lost, (unsigned long)r->send_failed,
+                 (unsigned long)r->frames_corrupt,
+                 (unsigned long)r->frames_per_sec, (unsigned long)r->bus_load_pct,
+                 (unsigned long)r->cpu_load_pct, (unsigned long)r->latency_min_us,
+                 (unsigned long)r->latency_avg_us, (unsigned long)r->latency_max_us);
+    }
+}
@@ -0,0 +1,379 @@
+/**
+ * @file can_twai_sniffer.c
+ * @brief Highest-priority drain task and capture ring for listen-only capture
+ *
+ * The drain task is the only producer and can_twai_sniffer_read() the only
+ * consumer of the ring. Records are written and read outside the lock;
+ * only the fill level and the statistics are updated under it.
+ *
+ * After every frame the drain task compares the driver's rx_missed_count
+ * and rx_overrun_count with their last values. A loss that appears there
+ * happened after the frames still waiting in the driver queue
+ * (msgs_to_rx). It is therefore booked against the sequence number of the
+ * first frame after them and reported in that record's lost_before.
+ *
+ * A filter is replaced by publishing the new pointer and bumping an epoch.
+ * The drain task acknowledges the epoch at the top of every loop, before it
+ * reads the pointer; once it has, the old filter is no longer in use and is
+ * freed.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_sniffer.h"
+#include "can_twai.h"
+#include "can_twai_filter.h"
+#include "can_twai_priv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_sniffer";
+
+#define DEFAULT_RX_QUEUE_LEN 512
+#define DEFAULT_RING_FRAMES  1024
+#define DEFAULT_STACK_SIZE   3072
+#define POLL_TICKS           pdMS_TO_TICKS(10)
+#define MAX_PENDING_LOSSES   8
+
+/** @brief Driver loss waiting for the record it precedes */
+typedef struct {
+    uint32_t seq;   /**< Sequence number of the first frame after the loss */
+    uint32_t lost;  /**< Frames lost */
+} pending_loss_t;
+
+/** @brief Capture state */
+typedef struct {
+    can_twai_sniffer_record_t *ring;
+    size_t                     capacity;
+    size_t                     head;           /**< Next slot to write, drain task only */
+    size_t                     tail;           /**< Next slot to read, reader only */
+    size_t                     used;           /**< Records in the ring */
+    SemaphoreHandle_t          data;           /**< Given when a record was added */
+    uint32_t                   seq;            /**< Next sequence number */
+    uint32_t                   carry;          /**< Losses to report in the next stored record */
+    bool                       ring_dropping;  /**< Last frame did not fit into the ring */
+    pending_loss_t             pending[MAX_PENDING_LOSSES];
+    size_t                     pending_count;
+    uint32_t                   last_missed;
+    uint32_t                   last_overrun;
+    can_twai_sniffer_stats_t   stats;
+    can_twai_filter_t *volatile filter;        /**< Capture filter (NULL = all) */
+    volatile uint32_t          filter_epoch;   /**< Bumped on every filter change */
+    volatile uint32_t          filter_seen;    /**< Epoch acknowledged by the drain task */
+    volatile bool              stop;
+    volatile bool              exited;
+    bool                       running;
+} sniffer_t;
+
+static sniffer_t sn;
+static portMUX_TYPE sn_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/** @brief Account a loss detected at @p now_us; call with sn_lock held */
+static void note_loss_locked(int64_t now_us)
+{
+    sn.stats.loss_events++;
+    if (sn.stats.first_loss_us == 0) {
+        sn.stats.first_loss_us = now_us;
+    }
+    sn.stats.last_loss_us = now_us;
+}
+
+/**
+ * @brief Detect frames lost in the controller or the driver queue
+ *
+ * @param next_seq Sequence number the next frame taken from the driver will get
+ */
+static CAN_TWAI_HOT_ATTR void check_driver_loss(uint32_t next_seq, int64_t now_us)
+{
+    twai_status_info_t status;
+    if (can_twai_backend_status(&status) != ESP_OK) {
+        return;
+    }
+
+    uint32_t missed = status.rx_missed_count - sn.last_missed;
+    uint32_t overrun = status.rx_overrun_count - sn.last_overrun;
+    sn.last_missed = status.rx_missed_count;
+    sn.last_overrun = status.rx_overrun_count;
+
+    portENTER_CRITICAL(&sn_lock);
+    if (status.msgs_to_rx > sn.stats.driver_high_water) {
+        sn.stats.driver_high_water = status.msgs_to_rx;
+    }
+    if (missed + overrun > 0) {
+        sn.stats.lost_driver += missed;
+        sn.stats.lost_overrun += overrun;
+        note_loss_locked(now_us);
+    }
+    portEXIT_CRITICAL(&sn_lock);
+
+    if (missed + overrun == 0) {
+        return;
+    }
+
+    // The lost frames came after everything still queued in the driver
+    uint32_t at = next_seq + status.msgs_to_rx;
+    if (sn.pending_count > 0 && sn.pending[sn.pending_count - 1].seq == at) {
+        sn.pending[sn.pending_count - 1].lost += missed + overrun;
+    } else if (sn.pending_count < MAX_PENDING_LOSSES) {
+        sn.pending[sn.pending_count++] = (pending_loss_t){ .seq = at, .lost = missed + overrun };
+    } else {
+        sn.pending[sn.pending_count - 1].lost += missed + overrun;  // position less exact
+    }
+}
+
+/** @brief Store one frame in the ring, or count it as filtered or lost */
+static CAN_TWAI_HOT_ATTR void push_record(const twai_message_t *msg, int64_t now_us,
+                                          const can_twai_filter_t *filter)
+{
+    uint32_t seq = sn.seq++;
+
+    // Driver losses that precede this frame
+    uint32_t lost = sn.carry;
+    while (sn.pending_count > 0 && (int32_t)(sn.pending[0].seq - seq) <= 0) {
+        lost += sn.pending[0].lost;
+        memmove(&sn.pending[0], &sn.pending[1], (sn.pending_count - 1) * sizeof(pending_loss_t));
+        sn.pending_count--;
+    }
+
+    if (filter != NULL) {
+        const can_twai_filter_frame_t fr = {
+            .identifier = msg->identifier, .dlc = msg->data_length_code,
+            .extd = msg->extd, .rtr = msg->rtr, .data = msg->data,
+        };
+        if (!can_twai_filter_match(filter, &fr)) {
+            sn.carry = lost;
+            portENTER_CRITICAL(&sn_lock);
+            sn.stats.filtered++;
+            portEXIT_CRITICAL(&sn_lock);
+            return;
+        }
+    }
+
+    portENTER_CRITICAL(&sn_lock);
+    size_t used = sn.used;
+    if (used >= sn.capacity) {
+        sn.stats.lost_ring++;
+        if (!sn.ring_dropping) {
+            note_loss_locked(now_us);
+        }
+        portEXIT_CRITICAL(&sn_lock);
+        sn.ring_dropping = true;
+        sn.carry = lost + 1;
+        return;
+    }
+    portEXIT_CRITICAL(&sn_lock);
+
+    can_twai_sniffer_record_t *rec = &sn.ring[sn.head];
+    rec->msg = *msg;
+    rec->time_us = now_us;
+    rec->seq = seq;
+    rec->lost_before = lost;
+    sn.carry = 0;
+    sn.ring_dropping = false;
+    sn.head = (sn.head + 1) % sn.capacity;
+
+    portENTER_CRITICAL(&sn_lock);
+    sn.used++;
+    sn.stats.frames++;
+    if (used + 1 > sn.stats.ring_high_water) {
+        sn.stats.ring_high_water = used + 1;
+    }
+    portEXIT_CRITICAL(&sn_lock);
+
+    xSemaphoreGive(sn.data);
+}
+
+static CAN_TWAI_HOT_ATTR void drain_task(void *arg)
+{
+    twai_message_t msg;
+
+    while (!sn.stop) {
+        sn.filter_seen = sn.filter_epoch;
+        esp_err_t err = can_twai_backend_receive(&msg, POLL_TICKS);
+        int64_t now_us = esp_timer_get_time();
+        if (err != ESP_OK) {
+            check_driver_loss(sn.seq, now_us);
+            if (err != ESP_ERR_TIMEOUT) {
+                vTaskDelay(POLL_TICKS);  // driver stopped
+            }
+            continue;
+        }
+        check_driver_loss(sn.seq + 1, now_us);
+        push_record(&msg, now_us, sn.filter);
+    }
+
+    sn.exited = true;
+    vTaskDelete(NULL);
+}
+
+bool can_twai_sniffer_start(const twai_backend_config_t *hw, const can_twai_sniffer_config_t *cfg)
+{
+    static const can_twai_sniffer_config_t defaults = { .core = tskNO_AFFINITY };
+    if (sn.running) {
+        ESP_LOGE(TAG, "Sniffer already running");
+        return false;
+    }
+    if (hw == NULL) {
+        ESP_LOGE(TAG, "Invalid configuration");
+        return false;
+    }
+    if (cfg == NULL) {
+        cfg = &defaults;
+    }
+
+    memset(&sn, 0, sizeof(sn));
+    sn.capacity = cfg->ring_frames ? cfg->ring_frames : DEFAULT_RING_FRAMES;
+    sn.ring = calloc(sn.capacity, sizeof(can_twai_sniffer_record_t));
+    sn.data = xSemaphoreCreateBinary();
+    if (sn.ring == NULL || sn.data == NULL) {
+        ESP_LOGE(TAG, "Out of memory for %u records", (unsigned)sn.capacity);
+        goto fail;
+    }
+
+    twai_backend_config_t c = *hw;
+    int queue_len = cfg->rx_queue_len ? (int)cfg->rx_queue_len : DEFAULT_RX_QUEUE_LEN;
+    c.params.mode = TWAI_MODE_LISTEN_ONLY;
+    if (c.params.rx_queue_len < queue_len) {
+        c.params.rx_queue_len = queue_len;
+    }
+    if (!can_twai_init(&c)) {
+        goto fail;
+    }
+
+    twai_status_info_t status;
+    if (can_twai_backend_status(&status) == ESP_OK) {
+        sn.last_missed = status.rx_missed_count;
+        sn.last_overrun = status.rx_overrun_count;
+    }
+
+    uint32_t stack = cfg->stack_size ? cfg->stack_size : DEFAULT_STACK_SIZE;
+    if (xTaskCreatePinnedToCore(drain_task, "can_sniffer", stack, NULL,
+                                configMAX_PRIORITIES - 1, NULL, cfg->core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create drain task");
+        can_twai_deinit();
+        goto fail;
+    }
+
+    sn.running = true;
+    ESP_LOGI(TAG, "Capturing (driver queue %d, ring %u records)",
+             c.params.rx_queue_len, (unsigned)sn.capacity);
+    return true;
+
+fail:
+    free(sn.ring);
+    if (sn.data != NULL) {
+        vSemaphoreDelete(sn.data);
+    }
+    memset(&sn, 0, sizeof(sn));
+    return false;
+}
+
+void can_twai_sniffer_stop(void)
+{
+    if (!sn.running) {
+        return;
+    }
+
+    sn.stop = true;
+    while (!sn.exited) {
+        vTaskDelay(1);
+    }
+    can_twai_deinit();
+
+    can_twai_sniffer_stats_t st;
+    can_twai_sniffer_get_stats(&st);
+    ESP_LOGI(TAG, "Capture stopped: %lu frames, %lu lost",
+             (unsigned long)st.frames, (unsigned long)can_twai_sniffer_lost(&st));
+
+    free(sn.ring);
+    can_twai_filter_free(sn.filter);
+    vSemaphoreDelete(sn.data);
+    memset(&sn, 0, sizeof(sn));
+}
+
+bool can_twai_sniffer_set_filter(const char *expr, char *err, size_t err_len)
+{
+    if (!sn.running) {
+        return false;
+    }
+
+    can_twai_filter_t *filter = NULL;
+    if (expr != NULL && expr[0] != '\0') {
+        char msg[64];
+        filter = can_twai_filter_compile(expr, msg, sizeof(msg));
+        if (filter == NULL) {
+            ESP_LOGE(TAG, "Filter not changed: %s", msg);
+            if (err != NULL && err_len > 0) {
+                snprintf(err, err_len, "%s", msg);
+            }
+            return false;
+        }
+    }
+
+    can_twai_filter_t *old = sn.filter;
+    sn.filter = filter;
+    uint32_t epoch = ++sn.filter_epoch;
+
+    // The drain task acknowledges at least once per receive timeout
+    while (sn.filter_seen != epoch && !sn.exited) {
+        vTaskDelay(1);
+    }
+    can_twai_filter_free(old);
+
+    ESP_LOGI(TAG, "Capture filter %s%s", filter != NULL ? "set: " : "cleared",
+             filter != NULL ? expr : "");
+    return true;
+}
+
+size_t can_twai_sniffer_read(can_twai_sniffer_record_t *out, size_t max, TickType_t timeout)
+{
+    if (!sn.running || out == NULL || max == 0) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&sn_lock);
+    size_t avail = sn.used;
+    portEXIT_CRITICAL(&sn_lock);
+    if (avail == 0) {
+        if (xSemaphoreTake(sn.data, timeout) != pdTRUE) {
+            return 0;
+        }
+        portENTER_CRITICAL(&sn_lock);
+        avail = sn.used;
+        portEXIT_CRITICAL(&sn_lock);
+    }
+
+    size_t n = avail < max ? avail : max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = sn.ring[sn.tail];
+        sn.tail = (sn.tail + 1) % sn.capacity;
+    }
+
+    portENTER_CRITICAL(&sn_lock);
+    sn.used -= n;
+    portEXIT_CRITICAL(&sn_lock);
+    return n;
+}
+
+void can_twai_sniffer_get_stats(can_twai_sniffer_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&sn_lock);
+    *out = sn.stats;
+    portEXIT_CRITICAL(&sn_lock);
+}
+
+uint32_t can_twai_sniffer_lost(const can_twai_sniffer_stats_t *stats)
+{
+    return stats != NULL ? stats->lost_overrun + stats->lost_driver + stats->lost_ring : 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file can_twai_template.c
+ * @brief Precompiled TX message templates
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_template.h"
+#include "can_twai_priv.h"
+#include <string.h>
+#include "esp_log.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_template";
+
+#define STD_ID_MAX 0x7FFu
+#define EXT_ID_MAX 0x1FFFFFFFu
+
+bool can_twai_template_init(can_twai_template_t *tpl, const can_twai_template_config_t *cfg)
+{
+    if (tpl == NULL || cfg == NULL) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return false;
+    }
+    memset(tpl, 0, sizeof(*tpl));
+
+    if (cfg->identifier > (cfg->extd ? EXT_ID_MAX : STD_ID_MAX)) {
+        ESP_LOGE(TAG, "ID 0x%lX does not fit %s identifier", (unsigned long)cfg->identifier,
+                 cfg->extd ? "a 29-bit" : "an 11-bit");
+        return false;
+    }
+    if (cfg->dlc > TWAI_FRAME_MAX_DLC) {
+        ESP_LOGE(TAG, "ID 0x%lX: invalid DLC %u", (unsigned long)cfg->identifier, cfg->dlc);
+        return false;
+    }
+
+    tpl->msg.identifier = cfg->identifier;
+    tpl->msg.data_length_code = cfg->dlc;
+    tpl->msg.extd = cfg->extd;
+    tpl->msg.rtr = cfg->rtr;
+    tpl->msg.ss = cfg->single_shot;
+    tpl->msg.self = cfg->self_rx;
+    if (cfg->data != NULL && !cfg->rtr) {
+        memcpy(tpl->msg.data, cfg->data, cfg->dlc);
+    }
+    tpl->valid = true;
+    return true;
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_template_send_timeout(can_twai_template_t *tpl, const uint8_t *data,
+                                                      TickType_t timeout)
+{
+    if (!tpl->valid) {
+        ESP_LOGE(TAG, "Template not initialized");
+        return false;
+    }
+    if (data != NULL) {
+        // A constant-size copy for full frames compiles to a single move, no memcpy() call
+        if (tpl->msg.data_length_code == TWAI_FRAME_MAX_DLC) {
+            memcpy(tpl->msg.data, data, TWAI_FRAME_MAX_DLC);
+        } else {
+            memcpy(tpl->msg.data, data, tpl->msg.data_length_code);
+        }
+    }
+    return can_twai_send_validated(&tpl->msg, timeout);
+}
+
+CAN_TWAI_HOT_ATTR bool can_twai_template_send(can_twai_template_t *tpl, const uint8_t *data)
+{
+    return can_twai_template_send_timeout(tpl, data, can_twai_get_transmit_timeout());
+}
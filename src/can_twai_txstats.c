@@ -0,0 +1,454 @@
+/**
+ * @file can_twai_txstats.c
+ * @brief Per-ID TX latency and arbitration-loss histograms
+ *
+ * Sent frames move through an in-flight FIFO:
+ * - the TX hook appends a PENDING record with the enqueue time and the
+ *   send's sequence number,
+ * - the TX-done hook finds the record by that sequence number and marks it
+ *   QUEUED once the driver accepted it (or drops it),
+ * - alerts and TX-done calls reconcile the number of QUEUED records with the
+ *   driver's msgs_to_tx and complete the oldest ones.
+ *
+ * The driver status is read outside the module lock. Records marked QUEUED
+ * after the status read started may or may not be counted in its
+ * msgs_to_tx; they are left out of that reconcile (queued_gen), so a frame
+ * accepted by the driver but not yet marked QUEUED can never complete
+ * another frame. The next reconcile picks them up.
+ *
+ * Approximations:
+ * - the arbitration losses seen by one reconcile are all charged to the
+ *   oldest QUEUED record, although the driver does not say which frame lost,
+ * - all frames completed by one reconcile share its timestamp (the time the
+ *   alerts were read, or of the TX-done call).
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_txstats.h"
+#include "can_twai_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/** @brief Logging tag for this module */
+static const char *TAG = "can_twai_txstats";
+
+#define DEFAULT_IN_FLIGHT 64
+#define LAT_BASE_SHIFT    6      /**< First bucket limit: 64 us */
+
+#define TXSTATS_ALERTS (TWAI_ALERT_TX_SUCCESS | TWAI_ALERT_TX_FAILED | TWAI_ALERT_ARB_LOST | \
+                        TWAI_ALERT_BUS_OFF)
+
+/** @brief Statistics of one instrumented ID */
+typedef struct {
+    uint32_t           identifier;
+    can_twai_txstats_t st;
+    uint64_t           lat_sum_us;
+} id_entry_t;
+
+/** @brief In-flight record state */
+typedef enum {
+    FLIGHT_PENDING = 0,  /**< Handed to can_twai_send(), driver result unknown */
+    FLIGHT_QUEUED,       /**< Accepted into the driver TX queue */
+} flight_state_t;
+
+/** @brief One frame between can_twai_send() and transmit completion */
+typedef struct {
+    int64_t  enq_us;
+    uint32_t seq;       /**< Sequence number of the send (TX hook argument) */
+    int32_t  entry;     /**< Index into the ID table, -1 = not instrumented */
+    uint8_t  arb_lost;
+    uint8_t  state;
+} flight_t;
+
+/** @brief Module state */
+typedef struct {
+    id_entry_t *tab;
+    size_t      tab_count;
+    flight_t   *fifo;       /**< Oldest record at index 0 */
+    size_t      fifo_cap;
+    size_t      fifo_len;
+    size_t      queued;     /**< Records in state FLIGHT_QUEUED */
+    uint32_t    queued_gen; /**< Incremented on every PENDING -> QUEUED transition */
+    uint32_t    last_arb_lost_count;
+    uint32_t    last_tx_failed_count;
+    uint32_t    overflows;
+    bool        desync;     /**< FIFO overflowed, wait for an empty TX queue */
+    bool        running;
+} txstats_t;
+
+static txstats_t ts;
+static portMUX_TYPE ts_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int cmp_entry(const void *a, const void *b)
+{
+    uint32_t x = ((const id_entry_t *)a)->identifier;
+    uint32_t y = ((const id_entry_t *)b)->identifier;
+    return (x > y) - (x < y);
+}
+
+static int32_t find_entry(uint32_t identifier)
+{
+    size_t lo = 0;
+    size_t hi = ts.tab_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t key = ts.tab[mid].identifier;
+        if (key == identifier) {
+            return (int32_t)mid;
+        }
+        if (key < identifier) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+static size_t lat_bucket(uint32_t lat_us)
+{
+    size_t bucket = 0;
+    for (uint32_t v = lat_us >> LAT_BASE_SHIFT; v != 0; v >>= 1) {
+        bucket++;
+    }
+    return bucket < CAN_TWAI_TXSTATS_LAT_BUCKETS ? bucket : CAN_TWAI_TXSTATS_LAT_BUCKETS - 1;
+}
+
+static void fifo_remove(size_t pos)
+{
+    memmove(&ts.fifo[pos], &ts.fifo[pos + 1], (ts.fifo_len - pos - 1) * sizeof(flight_t));
+    ts.fifo_len--;
+}
+
+/** @brief Position of the oldest QUEUED record (the one on the bus), or fifo_len */
+static size_t oldest_queued(void)
+{
+    size_t pos = 0;
+    while (pos < ts.fifo_len && ts.fifo[pos].state != FLIGHT_QUEUED) {
+        pos++;
+    }
+    return pos;
+}
+
+/** @brief Account and remove the oldest QUEUED record */
+static void complete_oldest(int64_t now_us, bool ok)
+{
+    size_t pos = oldest_queued();
+    if (pos == ts.fifo_len) {
+        return;
+    }
+
+    const flight_t *f = &ts.fifo[pos];
+    if (f->entry >= 0) {
+        id_entry_t *e = &ts.tab[f->entry];
+        if (ok) {
+            uint32_t lat = (uint32_t)(now_us - f->enq_us);
+            if (e->st.frames == 0 || lat < e->st.lat_min_us) {
+                e->st.lat_min_us = lat;
+            }
+            if (lat > e->st.lat_max_us) {
+                e->st.lat_max_us = lat;
+            }
+            e->st.frames++;
+            e->lat_sum_us += lat;
+            e->st.lat_hist[lat_bucket(lat)]++;
+            size_t arb = f->arb_lost < CAN_TWAI_TXSTATS_ARB_BUCKETS ? f->arb_lost
+                                                                    : CAN_TWAI_TXSTATS_ARB_BUCKETS - 1;
+            e->st.arb_hist[arb]++;
+        } else {
+            e->st.failed++;
+        }
+    }
+    fifo_remove(pos);
+    ts.queued--;
+}
+
+/** @brief Counter increase since @p *last; 0 for a snapshot older than the last one seen */
+static uint32_t counter_delta(uint32_t now, uint32_t *last)
+{
+    uint32_t delta = now - *last;
+    if ((int32_t)delta <= 0) {
+        return 0;
+    }
+    *last = now;
+    return delta;
+}
+
+/**
+ * @brief Match QUEUED records against a driver status; call with ts_lock held
+ *
+ * @param[in] status Driver status, read without the lock
+ * @param[in] gen    queued_gen before @p status was read
+ */
+static void reconcile_locked(int64_t now_us, bool bus_off, const twai_status_info_t *status, uint32_t gen)
+{
+    // Records marked QUEUED since the status read started may be missing in it
+    size_t late = ts.queued_gen - gen;
+    size_t queued = ts.queued > late ? ts.queued - late : 0;
+
+    // Arbitration losses are charged to the oldest QUEUED frame (approximation)
+    uint32_t arb = counter_delta(status->arb_lost_count, &ts.last_arb_lost_count);
+    size_t head = oldest_queued();
+    if (arb > 0 && head < ts.fifo_len) {
+        flight_t *f = &ts.fifo[head];
+        f->arb_lost = (uint8_t)(f->arb_lost + arb > UINT8_MAX ? UINT8_MAX : f->arb_lost + arb);
+        if (f->entry >= 0) {
+            ts.tab[f->entry].st.arb_lost += arb;
+        }
+    }
+
+    uint32_t failed = counter_delta(status->tx_failed_count, &ts.last_tx_failed_count);
+
+    if (ts.desync) {
+        if (status->msgs_to_tx == 0 && late == 0) {
+            for (size_t pos = ts.fifo_len; pos-- > 0;) {
+                if (ts.fifo[pos].state == FLIGHT_QUEUED) {
+                    fifo_remove(pos);
+                }
+            }
+            ts.queued = 0;
+            ts.desync = false;
+        }
+        return;
+    }
+
+    if (bus_off) {
+        // The driver discards its TX queue on bus-off
+        while (ts.queued > 0) {
+            complete_oldest(now_us, false);
+        }
+        return;
+    }
+
+    size_t completed = queued > status->msgs_to_tx ? queued - status->msgs_to_tx : 0;
+    while (completed-- > 0) {
+        bool ok = failed == 0;
+        if (!ok) {
+            failed--;
+        }
+        complete_oldest(now_us, ok);
+    }
+}
+
+/** @brief Read the driver status outside the lock and reconcile with it */
+static void reconcile(int64_t now_us, bool bus_off, uint32_t gen)
+{
+    twai_status_info_t status;
+    if (can_twai_backend_status(&status) != ESP_OK) {
+        return;
+    }
+    portENTER_CRITICAL(&ts_lock);
+    reconcile_locked(now_us, bus_off, &status, gen);
+    portEXIT_CRITICAL(&ts_lock);
+}
+
+static bool txstats_tx_hook(twai_message_t *msg, uint32_t seq, void *ctx)
+{
+    int64_t now_us = esp_timer_get_time();
+    int32_t entry = find_entry(msg->identifier);
+
+    portENTER_CRITICAL(&ts_lock);
+    if (ts.fifo_len < ts.fifo_cap) {
+        ts.fifo[ts.fifo_len++] = (flight_t){
+            .enq_us = now_us, .seq = seq, .entry = entry, .state = FLIGHT_PENDING,
+        };
+    } else {
+        ts.overflows++;
+        ts.desync = true;
+    }
+    portEXIT_CRITICAL(&ts_lock);
+    return true;
+}
+
+static void txstats_tx_done_hook(const twai_message_t *msg, uint32_t seq, bool queued, void *ctx)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&ts_lock);
+    for (size_t pos = ts.fifo_len; pos-- > 0;) {
+        flight_t *f = &ts.fifo[pos];
+        if (f->state == FLIGHT_PENDING && f->seq == seq) {
+            if (queued) {
+                f->state = FLIGHT_QUEUED;
+                ts.queued++;
+                ts.queued_gen++;
+            } else {
+                fifo_remove(pos);
+            }
+            break;
+        }
+    }
+    uint32_t gen = ts.queued_gen;
+    portEXIT_CRITICAL(&ts_lock);
+
+    // The frame may already be on the wire or done; its alert may have passed
+    reconcile(now_us, false, gen);
+}
+
+static void txstats_alert_hook(uint32_t alerts, int64_t time_us, void *ctx)
+{
+    portENTER_CRITICAL(&ts_lock);
+    uint32_t gen = ts.queued_gen;
+    portEXIT_CRITICAL(&ts_lock);
+
+    reconcile(time_us, (alerts & TWAI_ALERT_BUS_OFF) != 0, gen);
+}
+
+bool can_twai_txstats_init(const can_twai_txstats_config_t *cfg)
+{
+    if (ts.running) {
+        ESP_LOGE(TAG, "TX statistics already running");
+        return false;
+    }
+    if (cfg == NULL || (cfg->count > 0 && cfg->ids == NULL)) {
+        ESP_LOGE(TAG, "Invalid configuration");
+        return false;
+    }
+
+    memset(&ts, 0, sizeof(ts));
+    ts.fifo_cap = cfg->max_in_flight ? cfg->max_in_flight : DEFAULT_IN_FLIGHT;
+    ts.tab = calloc(cfg->count ? cfg->count : 1, sizeof(id_entry_t));
+    ts.fifo = calloc(ts.fifo_cap, sizeof(flight_t));
+    if (ts.tab == NULL || ts.fifo == NULL) {
+        ESP_LOGE(TAG, "Out of memory");
+        goto fail;
+    }
+
+    for (size_t i = 0; i < cfg->count; i++) {
+        ts.tab[i].identifier = cfg->ids[i];
+    }
+    qsort(ts.tab, cfg->count, sizeof(id_entry_t), cmp_entry);
+    for (size_t i = 1; i < cfg->count; i++) {
+        if (ts.tab[i].identifier == ts.tab[i - 1].identifier) {
+            ESP_LOGE(TAG, "Duplicate ID 0x%lX", ts.tab[i].identifier);
+            goto fail;
+        }
+    }
+    ts.tab_count = cfg->count;
+
+    twai_status_info_t status;
+    if (can_twai_backend_status(&status) == ESP_OK) {
+        ts.last_arb_lost_count = status.arb_lost_count;
+        ts.last_tx_failed_count = status.tx_failed_count;
+        ts.desync = status.msgs_to_tx != 0;
+    }
+
+    if (!can_twai_register_tx_hook(txstats_tx_hook, NULL)) {
+        goto fail;
+    }
+    if (!can_twai_register_tx_done_hook(txstats_tx_done_hook, NULL)) {
+        can_twai_unregister_tx_hook(txstats_tx_hook, NULL);
+        goto fail;
+    }
+    if (!can_twai_register_alert_hook(TXSTATS_ALERTS, txstats_alert_hook, NULL)) {
+        can_twai_unregister_tx_done_hook(txstats_tx_done_hook, NULL);
+        can_twai_unregister_tx_hook(txstats_tx_hook, NULL);
+        goto fail;
+    }
+    ts.running = true;
+    return true;
+
+fail:
+    free(ts.tab);
+    free(ts.fifo);
+    memset(&ts, 0, sizeof(ts));
+    return false;
+}
+
+void can_twai_txstats_deinit(void)
+{
+    if (!ts.running) {
+        return;
+    }
+    can_twai_unregister_alert_hook(txstats_alert_hook, NULL);
+    can_twai_unregister_tx_done_hook(txstats_tx_done_hook, NULL);
+    can_twai_unregister_tx_hook(txstats_tx_hook, NULL);
+    if (ts.overflows > 0) {
+        ESP_LOGW(TAG, "In-flight FIFO overflowed %lu times", (unsigned long)ts.overflows);
+    }
+
+    free(ts.tab);
+    free(ts.fifo);
+    memset(&ts, 0, sizeof(ts));
+}
+
+bool can_twai_txstats_get(uint32_t identifier, can_twai_txstats_t *out)
+{
+    int32_t entry = ts.running ? find_entry(identifier) : -1;
+    if (entry < 0 || out == NULL) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&ts_lock);
+    const id_entry_t *e = &ts.tab[entry];
+    *out = e->st;
+    out->lat_avg_us = e->st.frames ? (uint32_t)(e->lat_sum_us / e->st.frames) : 0;
+    portEXIT_CRITICAL(&ts_lock);
+    return true;
+}
+
+void can_twai_txstats_reset(void)
+{
+    portENTER_CRITICAL(&ts_lock);
+    for (size_t i = 0; i < ts.tab_count; i++) {
+        memset(&ts.tab[i].st, 0, sizeof(can_twai_txstats_t));
+        ts.tab[i].lat_sum_us = 0;
+    }
+    portEXIT_CRITICAL(&ts_lock);
+}
+
+uint32_t can_twai_txstats_bucket_limit_us(size_t bucket)
+{
+    if (bucket >= CAN_TWAI_TXSTATS_LAT_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+    return (1u << LAT_BASE_SHIFT) << bucket;
+}
+
+uint32_t can_twai_txstats_percentile_us(const can_twai_txstats_t *stats, uint32_t percent)
+{
+    if (stats == NULL || stats->frames == 0 || percent == 0) {
+        return 0;
+    }
+    if (percent > 100) {
+        percent = 100;
+    }
+
+    uint64_t target = ((uint64_t)stats->frames * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < CAN_TWAI_TXSTATS_LAT_BUCKETS; b++) {
+        seen += stats->lat_hist[b];
+        if (seen >= target) {
+            uint32_t limit = can_twai_txstats_bucket_limit_us(b);
+            return limit < stats->lat_max_us ? limit : stats->lat_max_us;
+        }
+    }
+    return stats->lat_max_us;
+}
+
+void can_twai_txstats_log(void)
+{
+    if (!ts.running) {
+        ESP_LOGW(TAG, "TX statistics not running");
+        return;
+    }
+
+    ESP_LOGI(TAG, "      ID |  frames | failed | arb lost | lat min/avg/p99/max us");
+    for (size_t i = 0; i < ts.tab_count; i++) {
+        can_twai_txstats_t st;
+        if (!can_twai_txstats_get(ts.tab[i].identifier, &st)) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%8lX | %7lu | %6lu | %8lu | %lu/%lu/%lu/%lu",
+                 (unsigned long)ts.tab[i].identifier, (unsigned long)st.frames,
+                 (unsigned long)st.failed, (unsigned long)st.arb_lost,
+                 (unsigned long)st.lat_min_us, (unsigned long)st.lat_avg_us,
+                 (unsigned long)can_twai_txstats_percentile_us(&st, 99),
+                 (unsigned long)st.lat_max_us);
+    }
+}
@@ -0,0 +1,302 @@
+/**
+ * @file can_twai_wcrt.c
+ * @brief Revised CAN schedulability analysis and optimal priority assignment
+ *
+ * All times are handled in nanoseconds (64 bit) internally, so bit times of
+ * fast bitrates are represented exactly; results are rounded up to whole
+ * microseconds.
+ *
+ * For message m with higher-priority set hp(m) and lower-priority set lp(m):
+ * @code
+ * C_m = (g + 8 s + 13 + floor((g + 8 s - 1) / 4)) * tau      g = 34 (std) / 54 (ext)
+ * B_m = max C_k, k in lp(m)
+ * t_m = B_m + sum_{k in hp(m) + m} ceil((t_m + J_k) / T_k) C_k              busy period
+ * Q_m = ceil((t_m + J_m) / T_m)
+ * w_m(q) = B_m + q C_m + sum_{k in hp(m)} ceil((w_m(q) + J_k + tau) / T_k) C_k
+ * R_m = max_{q < Q_m} (J_m + w_m(q) - q T_m + C_m)
+ * @endcode
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include "can_twai_wcrt.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Response times beyond this are treated as unbounded (~18 minutes) */
+#define HORIZON_NS (1ull << 40)
+
+#define UNBOUNDED UINT64_MAX
+
+/** @brief Per-message quantities in nanoseconds */
+typedef struct {
+    uint64_t c;    /**< Worst-case transmission time */
+    uint64_t t;    /**< Period */
+    uint64_t j;    /**< Jitter */
+    uint64_t d;    /**< Deadline */
+    uint64_t key;  /**< Arbitration priority, lower wins */
+} msg_ns_t;
+
+uint32_t can_twai_wcrt_frame_bits(uint8_t dlc, bool extended)
+{
+    uint32_t g = extended ? 54 : 34;
+    uint32_t payload = 8u * (dlc > 8 ? 8 : dlc);
+    return g + payload + 13 + (g + payload - 1) / 4;
+}
+
+uint32_t can_twai_wcrt_bitrate(uint32_t quanta_hz, uint32_t src_hz, uint32_t brp,
+                               uint32_t tseg_1, uint32_t tseg_2)
+{
+    uint32_t quanta_per_bit = 1 + tseg_1 + tseg_2;
+    if (quanta_hz == 0) {
+        if (brp == 0) {
+            return 0;
+        }
+        quanta_hz = src_hz / brp;
+    }
+    return quanta_hz / quanta_per_bit;
+}
+
+/** @brief Arbitration key: base ID first, standard beats extended with equal base ID */
+static uint64_t arbitration_key(const can_twai_wcrt_msg_t *m)
+{
+    if (!m->extended) {
+        return (uint64_t)(m->identifier & 0x7FF) << 19;
+    }
+    uint32_t id = m->identifier & 0x1FFFFFFF;
+    return ((uint64_t)(id >> 18) << 19) | (1u << 18) | (id & 0x3FFFF);
+}
+
+static bool prepare(const can_twai_wcrt_msg_t *msgs, size_t count, uint32_t bitrate,
+                    msg_ns_t *out, uint64_t *tau)
+{
+    if (msgs == NULL || count == 0 || bitrate == 0) {
+        return false;
+    }
+    *tau = 1000000000ull / bitrate;
+    for (size_t i = 0; i < count; i++) {
+        const can_twai_wcrt_msg_t *m = &msgs[i];
+        if (m->dlc > 8 || m->period_us == 0) {
+            return false;
+        }
+        out[i].c = (uint64_t)can_twai_wcrt_frame_bits(m->dlc, m->extended) * 1000000000ull / bitrate;
+        out[i].t = (uint64_t)m->period_us * 1000;
+        out[i].j = (uint64_t)m->jitter_us * 1000;
+        out[i].d = (uint64_t)(m->deadline_us ? m->deadline_us : m->period_us) * 1000;
+        out[i].key = arbitration_key(m);
+    }
+    return true;
+}
+
+static inline uint64_t ceil_div(uint64_t a, uint64_t b)
+{
+    return (a + b - 1) / b;
+}
+
+/**
+ * @brief Worst-case response time of message @p m
+ *
+ * @param hp    Indices of higher-priority messages
+ * @param nhp   Number of higher-priority messages
+ * @param b     Blocking time
+ * @param limit Stop and return UNBOUNDED once the response exceeds this
+ * @param q_out Number of instances examined (may be NULL)
+ */
+static uint64_t response_time(const msg_ns_t *ms, size_t m, const size_t *hp, size_t nhp,
+                              uint64_t b, uint64_t tau, uint64_t limit, uint32_t *q_out)
+{
+    const msg_ns_t *me = &ms[m];
+
+    // Length of the priority level-m busy period
+    uint64_t t = me->c;
+    for (;;) {
+        uint64_t next = b + ceil_div(t + me->j, me->t) * me->c;
+        for (size_t i = 0; i < nhp; i++) {
+            const msg_ns_t *k = &ms[hp[i]];
+            next += ceil_div(t + k->j, k->t) * k->c;
+        }
+        if (next == t) {
+            break;
+        }
+        if (next > HORIZON_NS) {
+            return UNBOUNDED;
+        }
+        t = next;
+    }
+
+    uint64_t q_count = ceil_div(t + me->j, me->t);
+    if (q_out != NULL) {
+        *q_out = (uint32_t)q_count;
+    }
+
+    uint64_t worst = 0;
+    uint64_t w = b;
+    for (uint64_t q = 0; q < q_count; q++) {
+        // w(q) >= w(q-1) + C, so the previous solution is a valid starting point
+        w = w > b + q * me->c ? w : b + q * me->c;
+        for (;;) {
+            uint64_t next = b + q * me->c;
+            for (size_t i = 0; i < nhp; i++) {
+                const msg_ns_t *k = &ms[hp[i]];
+                next += ceil_div(w + k->j + tau, k->t) * k->c;
+            }
+            if (next == w) {
+                break;
+            }
+            if (next > HORIZON_NS) {
+                return UNBOUNDED;
+            }
+            w = next;
+        }
+
+        uint64_t r = me->j + w + me->c - q * me->t;
+        if (r > worst) {
+            worst = r;
+        }
+        if (worst > limit) {
+            return UNBOUNDED;
+        }
+    }
+    return worst;
+}
+
+static uint32_t ns_to_us_ceil(uint64_t ns)
+{
+    if (ns == UNBOUNDED) {
+        return UINT32_MAX;
+    }
+    uint64_t us = ceil_div(ns, 1000);
+    return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+uint32_t can_twai_wcrt_utilization_permille(const can_twai_wcrt_msg_t *msgs, size_t count,
+                                            uint32_t bitrate)
+{
+    if (msgs == NULL || bitrate == 0) {
+        return 0;
+    }
+    uint64_t permille = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (msgs[i].period_us == 0) {
+            continue;
+        }
+        uint64_t bits = can_twai_wcrt_frame_bits(msgs[i].dlc, msgs[i].extended);
+        permille += bits * 1000000000ull / ((uint64_t)msgs[i].period_us * bitrate);
+    }
+    return (uint32_t)permille;
+}
+
+bool can_twai_wcrt_analyze(const can_twai_wcrt_msg_t *msgs, size_t count, uint32_t bitrate,
+                           can_twai_wcrt_result_t *results)
+{
+    if (results == NULL) {
+        return false;
+    }
+    memset(results, 0, count * sizeof(can_twai_wcrt_result_t));
+    msg_ns_t *ms = calloc(count ? count : 1, sizeof(msg_ns_t));
+    size_t *hp = calloc(count ? count : 1, sizeof(size_t));
+    uint64_t tau = 0;
+    bool all_ok = ms != NULL && hp != NULL && prepare(msgs, count, bitrate, ms, &tau);
+
+    for (size_t i = 0; all_ok && i < count; i++) {
+        for (size_t k = i + 1; k < count; k++) {
+            if (ms[i].key == ms[k].key) {
+                all_ok = false;  // duplicate identifier
+            }
+        }
+    }
+
+    if (all_ok) {
+        for (size_t m = 0; m < count; m++) {
+            size_t nhp = 0;
+            uint64_t b = 0;
+            for (size_t k = 0; k < count; k++) {
+                if (ms[k].key < ms[m].key) {
+                    hp[nhp++] = k;
+                } else if (ms[k].key > ms[m].key && ms[k].c > b) {
+                    b = ms[k].c;
+                }
+            }
+
+            can_twai_wcrt_result_t *r = &results[m];
+            uint64_t wcrt = response_time(ms, m, hp, nhp, b, tau, HORIZON_NS, &r->instances);
+            r->transmit_us = ns_to_us_ceil(ms[m].c);
+            r->blocking_us = ns_to_us_ceil(b);
+            r->wcrt_us = ns_to_us_ceil(wcrt);
+            r->schedulable = wcrt != UNBOUNDED && wcrt <= ms[m].d;
+            if (!r->schedulable) {
+                all_ok = false;
+            }
+        }
+    }
+
+    free(ms);
+    free(hp);
+    return all_ok;
+}
+
+bool can_twai_wcrt_assign_priorities(const can_twai_wcrt_msg_t *msgs, size_t count,
+                                     uint32_t bitrate, size_t *order)
+{
+    if (order == NULL) {
+        return false;
+    }
+    msg_ns_t *ms = calloc(count ? count : 1, sizeof(msg_ns_t));
+    size_t *hp = calloc(count ? count : 1, sizeof(size_t));
+    bool *assigned = calloc(count ? count : 1, sizeof(bool));
+    uint64_t tau = 0;
+    bool ok = ms != NULL && hp != NULL && assigned != NULL &&
+              prepare(msgs, count, bitrate, ms, &tau);
+
+    // Try candidates from the lowest current priority up, so the suggested
+    // order stays as close to the existing identifiers as possible
+    size_t *by_key = ok ? calloc(count, sizeof(size_t)) : NULL;
+    ok = ok && by_key != NULL;
+    for (size_t i = 0; ok && i < count; i++) {
+        size_t pos = i;
+        while (pos > 0 && ms[by_key[pos - 1]].key < ms[i].key) {
+            by_key[pos] = by_key[pos - 1];
+            pos--;
+        }
+        by_key[pos] = i;
+    }
+
+    // Lowest priority level first; lower levels only contribute blocking
+    uint64_t b = 0;
+    for (size_t level = count; ok && level-- > 0;) {
+        size_t chosen = count;
+        for (size_t c = 0; c < count && chosen == count; c++) {
+            size_t cand = by_key[c];
+            if (assigned[cand]) {
+                continue;
+            }
+            size_t nhp = 0;
+            for (size_t k = 0; k < count; k++) {
+                if (!assigned[k] && k != cand) {
+                    hp[nhp++] = k;
+                }
+            }
+            uint64_t r = response_time(ms, cand, hp, nhp, b, tau, ms[cand].d, NULL);
+            if (r != UNBOUNDED && r <= ms[cand].d) {
+                chosen = cand;
+            }
+        }
+
+        if (chosen == count) {
+            ok = false;
+            break;
+        }
+        assigned[chosen] = true;
+        order[level] = chosen;
+        if (ms[chosen].c > b) {
+            b = ms[chosen].c;
+        }
+    }
+
+    free(ms);
+    free(hp);
+    free(assigned);
+    free(by_key);
+    return ok;
+}
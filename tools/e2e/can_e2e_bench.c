@@ -0,0 +1,151 @@
+/**
+ * @file can_e2e_bench.c
+ * @brief Host tool: compare the bitwise, table and slicing-by-4 CRC engines
+ *
+ * Checks every engine against the catalogue check value ("123456789") and
+ * against each other on pseudo-random buffers, then prints nanoseconds per
+ * buffer for the lengths the E2E profiles use (up to 10 bytes: Data ID and
+ * a classic CAN payload) and one longer buffer for reference.
+ *
+ * Usage:
+ * @code
+ * can_e2e_bench
+ * @endcode
+ *
+ * Build: make e2e-bench (or cc -O2 -Iinclude tools/e2e/can_e2e_bench.c src/can_twai_crc.c)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "can_twai_e2e.h"
+
+#define BUFFERS  4096
+#define MAX_LEN  64
+#define ROUNDS   500
+
+typedef uint8_t (*crc8_fn_t)(const uint8_t *data, size_t len);
+typedef uint16_t (*crc16_fn_t)(const uint8_t *data, size_t len);
+
+static const struct {
+    const char *name;
+    crc8_fn_t   crc8;
+    crc16_fn_t  crc16;
+} engines[] = {
+    { "bitwise", can_twai_crc8_sae_j1850_bitwise, can_twai_crc16_ccitt_bitwise },
+    { "table",   can_twai_crc8_sae_j1850_table,   can_twai_crc16_ccitt_table },
+    { "slice4",  can_twai_crc8_sae_j1850_slice4,  can_twai_crc16_ccitt_slice4 },
+};
+#define ENGINES (sizeof(engines) / sizeof(engines[0]))
+
+static const size_t lengths[] = { 4, 8, 10, MAX_LEN };
+
+static uint8_t buffers[BUFFERS][MAX_LEN];
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** @brief Check values and cross-engine agreement; false on any mismatch */
+static bool verify(void)
+{
+    static const uint8_t check[] = "123456789";
+    bool ok = true;
+
+    for (size_t e = 0; e < ENGINES; e++) {
+        uint8_t c8 = engines[e].crc8(check, 9);
+        uint16_t c16 = engines[e].crc16(check, 9);
+        if (c8 != 0x4B || c16 != 0x29B1) {
+            printf("%s: check value mismatch (crc8 0x%02X, crc16 0x%04X)\n", engines[e].name, c8, c16);
+            ok = false;
+        }
+    }
+
+    for (size_t i = 0; i < BUFFERS; i++) {
+        size_t len = rng() % (MAX_LEN + 1);
+        for (size_t e = 1; e < ENGINES; e++) {
+            if (engines[e].crc8(buffers[i], len) != engines[0].crc8(buffers[i], len) ||
+                engines[e].crc16(buffers[i], len) != engines[0].crc16(buffers[i], len)) {
+                printf("%s: mismatch against bitwise on buffer %zu, length %zu\n", engines[e].name, i, len);
+                return false;
+            }
+        }
+    }
+    return ok;
+}
+
+static double bench8(crc8_fn_t fn, size_t len)
+{
+    volatile uint8_t sink = 0;
+    double t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < BUFFERS; i++) {
+            sink ^= fn(buffers[i], len);
+        }
+    }
+    (void)sink;
+    return (now_ns() - t0) / ((double)ROUNDS * BUFFERS);
+}
+
+static double bench16(crc16_fn_t fn, size_t len)
+{
+    volatile uint16_t sink = 0;
+    double t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < BUFFERS; i++) {
+            sink ^= fn(buffers[i], len);
+        }
+    }
+    (void)sink;
+    return (now_ns() - t0) / ((double)ROUNDS * BUFFERS);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < BUFFERS; i++) {
+        for (size_t k = 0; k < MAX_LEN; k++) {
+            buffers[i][k] = (uint8_t)rng();
+        }
+    }
+
+    if (!verify()) {
+        return 1;
+    }
+    printf("all engines match the check values and each other\n\n");
+
+    printf("%-8s %-7s", "crc", "engine");
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        printf("  %6zu B", lengths[l]);
+    }
+    printf("   (ns/buffer)\n");
+
+    for (int width = 8; width <= 16; width += 8) {
+        for (size_t e = 0; e < ENGINES; e++) {
+            printf("%-8s %-7s", width == 8 ? "CRC8" : "CRC16", engines[e].name);
+            for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+                double ns = width == 8 ? bench8(engines[e].crc8, lengths[l])
+                                       : bench16(engines[e].crc16, lengths[l]);
+                printf("  %8.2f", ns);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
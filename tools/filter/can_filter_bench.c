@@ -0,0 +1,160 @@
+/**
+ * @file can_filter_bench.c
+ * @brief Host tool: compile filter expressions and measure evaluation cost
+ *
+ * Evaluates each expression on a fixed pseudo-random frame set and prints
+ * the program length, matches and nanoseconds per frame. The built-in
+ * expressions are also checked against hand-written C equivalents, which
+ * gives both a correctness check and the interpreter overhead.
+ *
+ * Usage:
+ * @code
+ * can_filter_bench                                   # built-in expressions
+ * can_filter_bench "id in 0x100..0x1FF && data[2] & 0x80" "dlc == 8"
+ * @endcode
+ *
+ * Build: make filter-bench (or cc -O2 -Iinclude tools/filter/can_filter_bench.c src/can_twai_filter.c)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "can_twai_filter.h"
+
+#define FRAMES  4096
+#define ROUNDS  1000
+
+/** @brief Frame storage for the benchmark */
+typedef struct {
+    can_twai_filter_frame_t view;
+    uint8_t                 data[8];
+} bench_frame_t;
+
+typedef bool (*reference_t)(const can_twai_filter_frame_t *f);
+
+static bool ref_range_bit(const can_twai_filter_frame_t *f)
+{
+    return f->identifier >= 0x100 && f->identifier <= 0x1FF && f->dlc > 2 && (f->data[2] & 0x80);
+}
+
+static bool ref_signal(const can_twai_filter_frame_t *f)
+{
+    uint32_t v = (f->dlc > 0 ? f->data[0] : 0) | (uint32_t)(f->dlc > 1 ? f->data[1] : 0) << 8;
+    return !f->extd && f->dlc >= 4 && v > 1000;
+}
+
+static bool ref_set(const can_twai_filter_frame_t *f)
+{
+    return f->identifier == 0x100 || f->identifier == 0x181 || f->identifier == 0x201 ||
+           f->identifier == 0x281 || (f->identifier & 0x780) == 0x700;
+}
+
+static const struct {
+    const char *expr;
+    reference_t ref;
+} builtin[] = {
+    { "id in 0x100..0x1FF && data[2] & 0x80", ref_range_bit },
+    { "!ext && dlc >= 4 && (data[1] << 8 | data[0]) > 1000", ref_signal },
+    { "id == 0x100 || id == 0x181 || id == 0x201 || id == 0x281 || (id & 0x780) == 0x700", ref_set },
+};
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static void make_frames(bench_frame_t *frames, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        bench_frame_t *b = &frames[i];
+        memset(b, 0, sizeof(*b));
+        b->view.extd = (rng() % 8) == 0;
+        b->view.identifier = b->view.extd ? rng() & 0x1FFFFFFF : rng() & 0x7FF;
+        b->view.dlc = (uint8_t)(rng() % 9);
+        for (int k = 0; k < b->view.dlc; k++) {
+            b->data[k] = (uint8_t)rng();
+        }
+        b->view.data = b->data;
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** @brief Benchmark one expression; returns false on compile error or mismatch */
+static bool bench(const char *expr, reference_t ref, const bench_frame_t *frames)
+{
+    char err[96];
+    can_twai_filter_t *f = can_twai_filter_compile(expr, err, sizeof(err));
+    if (f == NULL) {
+        printf("%s\n  compile error: %s\n", expr, err);
+        return false;
+    }
+
+    volatile uint32_t matches = 0;
+    double t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < FRAMES; i++) {
+            matches += can_twai_filter_match(f, &frames[i].view);
+        }
+    }
+    double filter_ns = (now_ns() - t0) / ((double)ROUNDS * FRAMES);
+
+    printf("%s\n  %zu insns, %u/%d frames match, %.2f ns/frame", expr, can_twai_filter_length(f),
+           (unsigned)(matches / ROUNDS), FRAMES, filter_ns);
+
+    bool ok = true;
+    if (ref != NULL) {
+        volatile uint32_t ref_matches = 0;
+        t0 = now_ns();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (size_t i = 0; i < FRAMES; i++) {
+                ref_matches += ref(&frames[i].view);
+            }
+        }
+        double ref_ns = (now_ns() - t0) / ((double)ROUNDS * FRAMES);
+        printf(", hand-written C %.2f ns/frame", ref_ns);
+
+        for (size_t i = 0; i < FRAMES; i++) {
+            if (can_twai_filter_match(f, &frames[i].view) != ref(&frames[i].view)) {
+                printf("\n  MISMATCH on frame %zu (id 0x%x)", i, (unsigned)frames[i].view.identifier);
+                ok = false;
+                break;
+            }
+        }
+    }
+    printf("\n");
+    can_twai_filter_free(f);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    static bench_frame_t frames[FRAMES];
+    make_frames(frames, FRAMES);
+
+    bool ok = true;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            ok &= bench(argv[i], NULL, frames);
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(builtin) / sizeof(builtin[0]); i++) {
+            ok &= bench(builtin[i].expr, builtin[i].ref, frames);
+        }
+    }
+    return ok ? 0 : 1;
+}
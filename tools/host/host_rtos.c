@@ -0,0 +1,481 @@
+/**
+ * @file host_rtos.c
+ * @brief Host shim: FreeRTOS and esp_timer calls on POSIX threads
+ *
+ * Lets the host tools link the component sources unchanged. Tasks are
+ * detached threads, priorities and cores are ignored, and all critical
+ * sections share one recursive mutex, so the shim checks logic and
+ * ordering, not timing on the chip.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// --------------------------------------------------------------------------------------
+// Time
+// --------------------------------------------------------------------------------------
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+static void sleep_us(int64_t us)
+{
+    if (us <= 0) {
+        return;
+    }
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+/** @brief Absolute CLOCK_MONOTONIC deadline @p ticks from now */
+static struct timespec deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/** @brief Wait on @p cond until @p done() or the deadline; false on timeout */
+static bool cond_wait_until(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t ticks,
+                            bool (*done)(void *), void *arg)
+{
+    struct timespec end = deadline(ticks);
+    while (!done(arg)) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, mutex);
+        } else if (pthread_cond_timedwait(cond, mutex, &end) == ETIMEDOUT) {
+            return done(arg);
+        }
+    }
+    return true;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    default: return "ESP_ERR_UNKNOWN";
+    }
+}
+
+// --------------------------------------------------------------------------------------
+// Critical sections
+// --------------------------------------------------------------------------------------
+static pthread_mutex_t critical;
+static pthread_once_t critical_once = PTHREAD_ONCE_INIT;
+
+static void critical_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_once(&critical_once, critical_init);
+    pthread_mutex_lock(&critical);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_unlock(&critical);
+}
+
+// --------------------------------------------------------------------------------------
+// Tasks
+// --------------------------------------------------------------------------------------
+struct host_task {
+    TaskFunction_t  fn;
+    void           *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    uint32_t        notes;
+};
+
+static __thread struct host_task *current;
+
+static struct host_task *task_new(TaskFunction_t fn, void *arg)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (t != NULL) {
+        t->fn = fn;
+        t->arg = arg;
+        pthread_mutex_init(&t->lock, NULL);
+        cond_init(&t->cond);
+    }
+    return t;
+}
+
+static void *task_main(void *p)
+{
+    current = p;
+    current->fn(current->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *out, BaseType_t core)
+{
+    (void)name, (void)stack, (void)priority, (void)core;
+    struct host_task *t = task_new(fn, arg);
+    pthread_t th;
+    if (t == NULL || pthread_create(&th, NULL, task_main, t) != 0) {
+        free(t);
+        return pdFAIL;
+    }
+    pthread_detach(th);
+    if (out != NULL) {
+        *out = t;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t priority, TaskHandle_t *out)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, out, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Only self-deletion is used; the handle stays valid for late notifications
+    if (task == NULL) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    sleep_us((int64_t)ticks * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *previous, TickType_t increment)
+{
+    *previous += increment;
+    sleep_us((int64_t)*previous * 1000 - esp_timer_get_time());
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (current == NULL) {
+        current = task_new(NULL, NULL);   // main thread or foreign thread
+    }
+    return current;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notes++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+static bool has_notes(void *arg)
+{
+    return ((struct host_task *)arg)->notes > 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout)
+{
+    struct host_task *t = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&t->lock);
+    uint32_t n = 0;
+    if (cond_wait_until(&t->cond, &t->lock, timeout, has_notes, t)) {
+        n = t->notes;
+        t->notes = clear ? 0 : n - 1;
+    }
+    pthread_mutex_unlock(&t->lock);
+    return n;
+}
+
+// --------------------------------------------------------------------------------------
+// Queues
+// --------------------------------------------------------------------------------------
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+    uint8_t        *buf;
+    size_t          len;
+    size_t          item;
+    size_t          head;
+    size_t          count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (q == NULL || (q->buf = malloc((size_t)length * item_size)) == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->len = length;
+    q->item = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init(&q->changed);
+    return q;
+}
+
+static bool has_space(void *arg)
+{
+    struct host_queue *q = arg;
+    return q->count < q->len;
+}
+
+static bool has_items(void *arg)
+{
+    return ((struct host_queue *)arg)->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t timeout)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = cond_wait_until(&q->changed, &q->lock, timeout, has_space, q);
+    if (ok) {
+        memcpy(q->buf + (q->head + q->count) % q->len * q->item, item, q->item);
+        q->count++;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t timeout)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = cond_wait_until(&q->changed, &q->lock, timeout, has_items, q);
+    if (ok) {
+        memcpy(item, q->buf + q->head * q->item, q->item);
+        q->head = (q->head + 1) % q->len;
+        q->count--;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    size_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return (UBaseType_t)n;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (q != NULL) {
+        free(q->buf);
+        free(q);
+    }
+}
+
+// --------------------------------------------------------------------------------------
+// Semaphores
+// --------------------------------------------------------------------------------------
+struct host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            given;
+    bool            recursive;
+};
+
+static struct host_sem *sem_new(bool recursive)
+{
+    struct host_sem *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->recursive = recursive;
+    if (recursive) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&s->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    } else {
+        pthread_mutex_init(&s->lock, NULL);
+        cond_init(&s->cond);
+    }
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_new(false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return sem_new(true);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->given = true;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return pdTRUE;
+}
+
+static bool is_given(void *arg)
+{
+    return ((struct host_sem *)arg)->given;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t timeout)
+{
+    pthread_mutex_lock(&s->lock);
+    bool ok = cond_wait_until(&s->cond, &s->lock, timeout, is_given, s);
+    if (ok) {
+        s->given = false;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t timeout)
+{
+    if (timeout == portMAX_DELAY) {
+        return pthread_mutex_lock(&s->lock) == 0 ? pdTRUE : pdFALSE;
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_REALTIME, &end);   // pthread_mutex_timedlock() uses CLOCK_REALTIME
+    end.tv_sec += timeout / 1000;
+    end.tv_nsec += (long)(timeout % 1000) * 1000000;
+    if (end.tv_nsec >= 1000000000) {
+        end.tv_sec++;
+        end.tv_nsec -= 1000000000;
+    }
+    return pthread_mutex_timedlock(&s->lock, &end) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s)
+{
+    return pthread_mutex_unlock(&s->lock) == 0 ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    if (s != NULL) {
+        pthread_mutex_destroy(&s->lock);
+        if (!s->recursive) {
+            pthread_cond_destroy(&s->cond);
+        }
+        free(s);
+    }
+}
+
+// --------------------------------------------------------------------------------------
+// Periodic timers
+// --------------------------------------------------------------------------------------
+struct esp_timer {
+    esp_timer_cb_t   cb;
+    void            *arg;
+    uint64_t         period_us;
+    volatile bool    run;
+    pthread_t        thread;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    t->cb = args->callback;
+    t->arg = args->arg;
+    *out = t;
+    return ESP_OK;
+}
+
+static void *timer_main(void *p)
+{
+    struct esp_timer *t = p;
+    int64_t next = esp_timer_get_time();
+    while (t->run) {
+        next += (int64_t)t->period_us;
+        sleep_us(next - esp_timer_get_time());
+        if (t->run) {
+            t->cb(t->arg);
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us)
+{
+    t->period_us = period_us;
+    t->run = true;
+    return pthread_create(&t->thread, NULL, timer_main, t) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    if (!t->run) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    t->run = false;
+    pthread_join(t->thread, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t)
+{
+    free(t);
+    return ESP_OK;
+}
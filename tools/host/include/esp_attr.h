@@ -0,0 +1,12 @@
+/**
+ * @file esp_attr.h
+ * @brief Host shim: placement attributes have no meaning on the host
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
@@ -0,0 +1,56 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host shim: FreeRTOS types for building component sources with cc
+ *
+ * Not a FreeRTOS port: tasks are detached POSIX threads, the tick is 1 ms
+ * of CLOCK_MONOTONIC, and every critical section takes one global
+ * recursive mutex. Enough to run the component's logic on the host, not to
+ * reproduce scheduling on the chip.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdTRUE               1
+#define pdFALSE              0
+#define pdPASS               1
+#define pdFAIL               0
+#define portMAX_DELAY        0xFFFFFFFFu
+#define configMAX_PRIORITIES 25
+#define portTICK_PERIOD_MS   1
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(ms))
+#define pdTICKS_TO_MS(t)     ((uint32_t)(t))
+#define tskNO_AFFINITY       0x7FFFFFFF
+
+typedef struct {
+    uint32_t unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)     vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)      vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)  vPortExitCritical(mux)
+
+#ifdef __cplusplus
+}
+#endif
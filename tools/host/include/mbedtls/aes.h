@@ -0,0 +1,34 @@
+/**
+ * @file aes.h
+ * @brief Host shim: the AES-128 ECB subset of mbedTLS used by can_twai_auth.c
+ *
+ * Plain byte-oriented software AES (tools/host/host_aes.c), encryption only.
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MBEDTLS_AES_ENCRYPT 1
+#define MBEDTLS_AES_DECRYPT 0
+
+typedef struct {
+    uint8_t rk[176];  /**< AES-128 round keys */
+} mbedtls_aes_context;
+
+void mbedtls_aes_init(mbedtls_aes_context *ctx);
+void mbedtls_aes_free(mbedtls_aes_context *ctx);
+int mbedtls_aes_setkey_enc(mbedtls_aes_context *ctx, const unsigned char *key, unsigned int keybits);
+int mbedtls_aes_crypt_ecb(mbedtls_aes_context *ctx, int mode, const unsigned char input[16],
+                          unsigned char output[16]);
+
+#ifdef __cplusplus
+}
+#endif
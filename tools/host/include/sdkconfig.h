@@ -0,0 +1,12 @@
+/**
+ * @file sdkconfig.h
+ * @brief Host build configuration for the tools (ESP-IDF linux target)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#pragma once
+
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_FREERTOS_HZ      1000
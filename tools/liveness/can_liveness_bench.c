@@ -0,0 +1,219 @@
+/**
+ * @file can_liveness_bench.c
+ * @brief Host tool: per-frame cost of the liveness monitor versus monitored IDs
+ *
+ * Links the component sources unchanged (src/can_twai.c and
+ * src/can_twai_liveness.c on the tools/host shim) and feeds frames through
+ * can_twai_receive_timeout() from an in-memory backend. Every frame carries
+ * a monitored ID, so each one takes the hash lookup and re-arms its timer
+ * in the wheel. The receive path without the monitor is measured first as a
+ * baseline; the difference is the monitor's own cost per frame, which
+ * should stay flat as the number of IDs grows.
+ *
+ * The shim's critical sections are a pthread mutex rather than the chip's
+ * spinlock, so absolute numbers are host numbers; the scaling is the point.
+ *
+ * Usage:
+ * @code
+ * can_liveness_bench          # 8, 64 and 512 IDs
+ * can_liveness_bench 200 1000 # custom ID counts (max 1024)
+ * @endcode
+ *
+ * Build: make liveness-bench
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "can_twai.h"
+#include "can_twai_backend.h"
+#include "can_twai_liveness.h"
+
+#define FRAMES  4096
+#define ROUNDS  2000
+
+/** @brief Frames handed out by the in-memory backend, in order */
+static twai_message_t frames[FRAMES];
+static size_t next_frame = 0;
+
+static esp_err_t mem_ok(void)
+{
+    return ESP_OK;
+}
+
+static esp_err_t mem_init(const twai_backend_config_t *cfg)
+{
+    (void)cfg;
+    return ESP_OK;
+}
+
+static esp_err_t mem_transmit(const twai_message_t *msg, TickType_t timeout)
+{
+    (void)msg;
+    (void)timeout;
+    return ESP_OK;
+}
+
+static esp_err_t mem_receive(twai_message_t *msg, TickType_t timeout)
+{
+    (void)timeout;
+    *msg = frames[next_frame];
+    next_frame = (next_frame + 1) & (FRAMES - 1);
+    return ESP_OK;
+}
+
+static esp_err_t mem_get_status(twai_status_info_t *status)
+{
+    memset(status, 0, sizeof(*status));
+    status->state = TWAI_STATE_RUNNING;
+    return ESP_OK;
+}
+
+static esp_err_t mem_read_alerts(uint32_t *alerts, TickType_t timeout)
+{
+    (void)timeout;
+    *alerts = 0;
+    return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t mem_reconfigure_alerts(uint32_t alerts_enabled, uint32_t *current_alerts)
+{
+    (void)alerts_enabled;
+    (void)current_alerts;
+    return ESP_OK;
+}
+
+static const can_twai_backend_t mem_backend = {
+    .name = "memory",
+    .init = mem_init,
+    .deinit = mem_ok,
+    .start = mem_ok,
+    .stop = mem_ok,
+    .transmit = mem_transmit,
+    .receive = mem_receive,
+    .get_status = mem_get_status,
+    .recover = mem_ok,
+    .read_alerts = mem_read_alerts,
+    .reconfigure_alerts = mem_reconfigure_alerts,
+};
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** @brief Average ns per can_twai_receive_timeout() over the frame set */
+static double receive_ns(void)
+{
+    twai_message_t msg;
+    volatile uint32_t sink = 0;
+    next_frame = 0;
+    double t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < FRAMES; i++) {
+            can_twai_receive_timeout(&msg, 0);
+            sink += msg.identifier;
+        }
+    }
+    (void)sink;
+    return (now_ns() - t0) / ((double)ROUNDS * FRAMES);
+}
+
+/** @brief Monitor @p count distinct IDs, fill the frame set with them and time it */
+static bool bench(size_t count, double baseline)
+{
+    can_twai_liveness_entry_t *entries = calloc(count, sizeof(*entries));
+    if (entries == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint32_t id;
+        bool dup;
+        do {
+            id = rng() & 0x7FF;
+            dup = false;
+            for (size_t k = 0; k < i; k++) {
+                dup |= entries[k].identifier == id;
+            }
+        } while (dup);
+        entries[i].identifier = id;
+        entries[i].timeout_ms = 60000;  // never expires while measuring
+    }
+    for (size_t i = 0; i < FRAMES; i++) {
+        memset(&frames[i], 0, sizeof(frames[i]));
+        frames[i].identifier = entries[rng() % count].identifier;
+        frames[i].data_length_code = 8;
+    }
+
+    const can_twai_liveness_config_t cfg = {
+        .entries = entries, .count = count, .tick_ms = 100, .callback = NULL, .ctx = NULL,
+    };
+    bool ok = can_twai_liveness_init(&cfg);
+    free(entries);
+    if (!ok) {
+        return false;
+    }
+    double ns = receive_ns();
+    bool all_alive = can_twai_liveness_missing_count() == 0;
+    can_twai_liveness_deinit();
+
+    printf("%6zu IDs  %8.2f ns/frame  monitor %6.2f ns/frame%s\n", count, ns, ns - baseline,
+           all_alive ? "" : "  (timeouts during run)");
+    return all_alive;
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t defaults[] = { 8, 64, 512 };
+
+    twai_backend_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    if (!can_twai_set_backend(&mem_backend) || !can_twai_init(&cfg)) {
+        return 1;
+    }
+
+    // Baseline: same frame layout, no hooks registered
+    for (size_t i = 0; i < FRAMES; i++) {
+        memset(&frames[i], 0, sizeof(frames[i]));
+        frames[i].identifier = rng() & 0x7FF;
+        frames[i].data_length_code = 8;
+    }
+    double baseline = receive_ns();
+    printf("receive path without monitor: %.2f ns/frame\n", baseline);
+
+    bool ok = true;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            size_t n = strtoul(argv[i], NULL, 0);
+            if (n == 0 || n > CAN_TWAI_LIVENESS_MAX_ENTRIES) {
+                printf("invalid ID count: %s\n", argv[i]);
+                ok = false;
+                continue;
+            }
+            ok &= bench(n, baseline);
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) {
+            ok &= bench(defaults[i], baseline);
+        }
+    }
+
+    can_twai_deinit();
+    return ok ? 0 : 1;
+}
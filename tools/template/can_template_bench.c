@@ -0,0 +1,205 @@
+/**
+ * @file can_template_bench.c
+ * @brief Host tool: per-send cost with and without message templates
+ *
+ * Links the component sources unchanged (src/can_twai.c and
+ * src/can_twai_template.c on the tools/host shim) and compares three ways
+ * of sending a frame:
+ * - rebuild: clear a twai_message_t, set flags, identifier and DLC, copy the
+ *   payload and call can_twai_send_timeout() (DLC validation included),
+ * - template: can_twai_template_send_timeout() with a payload to copy,
+ * - in place: update one signal byte through can_twai_template_payload()
+ *   and send with a NULL payload.
+ *
+ * All three end in an in-memory backend whose transmit copies the frame into
+ * a queue slot, as xQueueSend() in twai_transmit() does. The driver and bus
+ * time itself is not modeled; the tool shows only the adapter-side cost
+ * that templates remove.
+ *
+ * Usage:
+ * @code
+ * can_template_bench [dlc]    # default 8
+ * @endcode
+ *
+ * Build: make template-bench
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "can_twai.h"
+#include "can_twai_backend.h"
+#include "can_twai_template.h"
+
+#define SENDS      10000000u
+#define ROUNDS     5          /**< Best of, to reduce noise */
+#define QUEUE_LEN  16
+#define MAX_DLC    8
+
+/** @brief Transmit queue of the in-memory backend */
+static twai_message_t queue[QUEUE_LEN];
+static uint32_t queued;
+
+static esp_err_t mem_ok(void)
+{
+    return ESP_OK;
+}
+
+static esp_err_t mem_init(const twai_backend_config_t *cfg)
+{
+    (void)cfg;
+    return ESP_OK;
+}
+
+static esp_err_t mem_transmit(const twai_message_t *msg, TickType_t timeout)
+{
+    (void)timeout;
+    queue[queued++ % QUEUE_LEN] = *msg;
+    return ESP_OK;
+}
+
+static esp_err_t mem_receive(twai_message_t *msg, TickType_t timeout)
+{
+    (void)msg;
+    (void)timeout;
+    return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t mem_get_status(twai_status_info_t *status)
+{
+    memset(status, 0, sizeof(*status));
+    status->state = TWAI_STATE_RUNNING;
+    return ESP_OK;
+}
+
+static esp_err_t mem_read_alerts(uint32_t *alerts, TickType_t timeout)
+{
+    (void)timeout;
+    *alerts = 0;
+    return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t mem_reconfigure_alerts(uint32_t alerts_enabled, uint32_t *current_alerts)
+{
+    (void)alerts_enabled;
+    (void)current_alerts;
+    return ESP_OK;
+}
+
+static const can_twai_backend_t mem_backend = {
+    .name = "memory",
+    .init = mem_init,
+    .deinit = mem_ok,
+    .start = mem_ok,
+    .stop = mem_ok,
+    .transmit = mem_transmit,
+    .receive = mem_receive,
+    .get_status = mem_get_status,
+    .recover = mem_ok,
+    .read_alerts = mem_read_alerts,
+    .reconfigure_alerts = mem_reconfigure_alerts,
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** @brief Precomputed payloads, so producing the data costs the same everywhere */
+#define PAYLOADS 256
+static uint8_t payloads[PAYLOADS][MAX_DLC];
+
+static double bench_rebuild(uint8_t dlc)
+{
+    twai_message_t msg;
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < SENDS; i++) {
+        const uint8_t *payload = payloads[i % PAYLOADS];
+        memset(&msg, 0, sizeof(msg));
+        msg.identifier = 0x123;
+        msg.extd = 0;
+        msg.rtr = 0;
+        msg.ss = 0;
+        msg.data_length_code = dlc;
+        memcpy(msg.data, payload, dlc);
+        can_twai_send_timeout(&msg, 0);
+    }
+    return (now_ns() - t0) / SENDS;
+}
+
+static double bench_template(can_twai_template_t *tpl)
+{
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < SENDS; i++) {
+        can_twai_template_send_timeout(tpl, payloads[i % PAYLOADS], 0);
+    }
+    return (now_ns() - t0) / SENDS;
+}
+
+static double bench_in_place(can_twai_template_t *tpl)
+{
+    uint8_t *payload = can_twai_template_payload(tpl);
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < SENDS; i++) {
+        payload[0] = (uint8_t)i;  // e.g. a counter signal
+        can_twai_template_send_timeout(tpl, NULL, 0);
+    }
+    return (now_ns() - t0) / SENDS;
+}
+
+int main(int argc, char **argv)
+{
+    int dlc = argc > 1 ? atoi(argv[1]) : MAX_DLC;
+    if (dlc < 0 || dlc > MAX_DLC) {
+        fprintf(stderr, "usage: %s [dlc 0..8]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < PAYLOADS; i++) {
+        for (int k = 0; k < MAX_DLC; k++) {
+            payloads[i][k] = (uint8_t)(i * 31 + k);
+        }
+    }
+
+    twai_backend_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    can_twai_template_t tpl;
+    const can_twai_template_config_t tpl_cfg = { .identifier = 0x123, .dlc = (uint8_t)dlc };
+    if (!can_twai_set_backend(&mem_backend) || !can_twai_init(&cfg) ||
+        !can_twai_template_init(&tpl, &tpl_cfg)) {
+        return 1;
+    }
+
+    double rebuild = 1e9, templ = 1e9, in_place = 1e9;
+    for (int r = 0; r < ROUNDS; r++) {
+        double t = bench_rebuild((uint8_t)dlc);
+        rebuild = t < rebuild ? t : rebuild;
+        t = bench_template(&tpl);
+        templ = t < templ ? t : templ;
+        t = bench_in_place(&tpl);
+        in_place = t < in_place ? t : in_place;
+    }
+    can_twai_deinit();
+
+    bool ok = queued == 3u * ROUNDS * SENDS;
+    printf("DLC %d, best of %d x %u sends (adapter send path + copy into backend queue slot)\n", dlc,
+           ROUNDS, SENDS);
+    printf("  rebuild + can_twai_send_timeout  %6.2f ns/send\n", rebuild);
+    printf("  can_twai_template_send_timeout   %6.2f ns/send  (%.0f %% of rebuild)\n", templ,
+           100.0 * templ / rebuild);
+    printf("  template payload in place        %6.2f ns/send  (%.0f %% of rebuild)\n", in_place,
+           100.0 * in_place / rebuild);
+    if (!ok) {
+        printf("  only %lu of %lu frames reached the backend\n", (unsigned long)queued,
+               (unsigned long)(3u * ROUNDS * SENDS));
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+/**
+ * @file can_wcrt.c
+ * @brief Host tool: worst-case response time analysis of a CAN message matrix
+ *
+ * Reads a CSV message set, prints per-message worst-case response times and,
+ * on request or when the set misses deadlines, a priority order (identifier
+ * reassignment) that makes it schedulable.
+ *
+ * Input format, one message per line ('#' starts a comment):
+ * @code
+ * # id,   period_us, dlc, jitter_us, deadline_us, ext
+ * 0x100,  10000,     8,   500,       0,           0
+ * @endcode
+ * deadline_us = 0 means deadline = period; ext is optional (1 = 29-bit ID).
+ *
+ * Usage:
+ * @code
+ * can_wcrt -b 500000 matrix.csv
+ * can_wcrt -t 20000000:15:4 -s matrix.csv   # bitrate from quanta_resolution_hz:tseg_1:tseg_2
+ * @endcode
+ *
+ * Build: make wcrt (or cc -O2 -Iinclude tools/wcrt/can_wcrt.c src/can_twai_wcrt.c)
+ *
+ * @author Ivo Marvan
+ * @date 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include "can_twai_wcrt.h"
+
+#define MAX_MESSAGES 2048
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s (-b BITRATE | -t QUANTA_HZ:TSEG1:TSEG2) [-s] FILE.csv\n"
+            "  -b  bitrate in bit/s\n"
+            "  -t  bitrate from twai_timing_config_t fields\n"
+            "  -s  always suggest a priority order\n",
+            prog);
+}
+
+static size_t load(const char *path, can_twai_wcrt_msg_t *msgs, size_t max)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return 0;
+    }
+
+    char line[256];
+    size_t count = 0;
+    unsigned lineno = 0;
+    while (fgets(line, sizeof(line), f) != NULL && count < max) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash != NULL) {
+            *hash = '\0';
+        }
+        long id = 0;
+        unsigned long period, dlc, jitter = 0, deadline = 0, ext = 0;
+        int n = sscanf(line, " %li , %lu , %lu , %lu , %lu , %lu", &id, &period, &dlc,
+                       &jitter, &deadline, &ext);
+        if (n <= 0) {
+            continue;  // empty or comment line
+        }
+        if (n < 3) {
+            fprintf(stderr, "%s:%u: expected id,period_us,dlc[,jitter_us,deadline_us,ext]\n",
+                    path, lineno);
+            fclose(f);
+            return 0;
+        }
+        msgs[count++] = (can_twai_wcrt_msg_t){
+            .identifier = (uint32_t)id, .extended = ext != 0, .dlc = (uint8_t)dlc,
+            .period_us = (uint32_t)period, .jitter_us = (uint32_t)jitter,
+            .deadline_us = (uint32_t)deadline,
+        };
+    }
+    fclose(f);
+    return count;
+}
+
+static void print_table(const can_twai_wcrt_msg_t *msgs, const can_twai_wcrt_result_t *res,
+                        size_t count)
+{
+    printf("%10s %9s %4s %8s %8s %10s %10s  %s\n", "ID", "period", "dlc", "C", "B", "R",
+           "deadline", "status");
+    for (size_t i = 0; i < count; i++) {
+        const can_twai_wcrt_msg_t *m = &msgs[i];
+        uint32_t d = m->deadline_us ? m->deadline_us : m->period_us;
+        char r[16];
+        if (res[i].wcrt_us == UINT32_MAX) {
+            snprintf(r, sizeof(r), "unbounded");
+        } else {
+            snprintf(r, sizeof(r), "%u", (unsigned)res[i].wcrt_us);
+        }
+        printf("%#10x %9u %4u %8u %8u %10s %10u  %s\n", (unsigned)m->identifier,
+               (unsigned)m->period_us, (unsigned)m->dlc, (unsigned)res[i].transmit_us,
+               (unsigned)res[i].blocking_us, r, (unsigned)d,
+               res[i].schedulable ? "ok" : "MISS");
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/** @brief Print the order and a reassignment of the existing IDs that realizes it */
+static void suggest(can_twai_wcrt_msg_t *msgs, size_t count, uint32_t bitrate)
+{
+    size_t *order = calloc(count, sizeof(size_t));
+    uint32_t *ids = calloc(count, sizeof(uint32_t));
+    can_twai_wcrt_result_t *res = calloc(count, sizeof(can_twai_wcrt_result_t));
+    if (order == NULL || ids == NULL || res == NULL) {
+        fprintf(stderr, "out of memory\n");
+        goto out;
+    }
+
+    if (!can_twai_wcrt_assign_priorities(msgs, count, bitrate, order)) {
+        printf("\nNo priority order makes this set schedulable at %u bit/s.\n", (unsigned)bitrate);
+        goto out;
+    }
+
+    printf("\nSuggested priority order (highest first):\n");
+    for (size_t p = 0; p < count; p++) {
+        const can_twai_wcrt_msg_t *m = &msgs[order[p]];
+        printf("  %3zu: %#x%s\n", p + 1, (unsigned)m->identifier, m->extended ? " (ext)" : "");
+    }
+
+    // Reuse the current identifiers (highest priority gets the smallest one);
+    // only possible without mixing formats, as that would change frame lengths
+    bool mixed = false;
+    for (size_t i = 0; i < count; i++) {
+        ids[i] = msgs[i].identifier;
+        mixed |= msgs[i].extended != msgs[0].extended;
+    }
+    if (mixed) {
+        printf("\nMixed standard/extended IDs: choose new identifiers in this order.\n");
+        goto out;
+    }
+    qsort(ids, count, sizeof(uint32_t), cmp_u32);
+
+    can_twai_wcrt_msg_t *reassigned = calloc(count, sizeof(can_twai_wcrt_msg_t));
+    if (reassigned == NULL) {
+        fprintf(stderr, "out of memory\n");
+        goto out;
+    }
+    printf("\nID reassignment:\n");
+    for (size_t p = 0; p < count; p++) {
+        reassigned[p] = msgs[order[p]];
+        reassigned[p].identifier = ids[p];
+        if (ids[p] != msgs[order[p]].identifier) {
+            printf("  %#x -> %#x\n", (unsigned)msgs[order[p]].identifier, (unsigned)ids[p]);
+        }
+    }
+
+    printf("\nWith reassigned IDs:\n");
+    can_twai_wcrt_analyze(reassigned, count, bitrate, res);
+    print_table(reassigned, res, count);
+    free(reassigned);
+
+out:
+    free(order);
+    free(ids);
+    free(res);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t bitrate = 0;
+    bool always_suggest = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:sh")) != -1) {
+        switch (opt) {
+        case 'b':
+            bitrate = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't': {
+            unsigned long quanta, tseg1, tseg2;
+            if (sscanf(optarg, "%lu:%lu:%lu", &quanta, &tseg1, &tseg2) != 3) {
+                usage(argv[0]);
+                return 2;
+            }
+            bitrate = can_twai_wcrt_bitrate((uint32_t)quanta, 0, 0, (uint32_t)tseg1, (uint32_t)tseg2);
+            break;
+        }
+        case 's':
+            always_suggest = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (bitrate == 0 || optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    static can_twai_wcrt_msg_t msgs[MAX_MESSAGES];
+    static can_twai_wcrt_result_t res[MAX_MESSAGES];
+    size_t count = load(argv[optind], msgs, MAX_MESSAGES);
+    if (count == 0) {
+        fprintf(stderr, "no messages loaded\n");
+        return 2;
+    }
+
+    uint32_t util = can_twai_wcrt_utilization_permille(msgs, count, bitrate);
+    printf("%zu messages, %u bit/s, worst-case bus utilization %u.%u %%\n\n", count,
+           (unsigned)bitrate, (unsigned)(util / 10), (unsigned)(util % 10));
+
+    bool ok = can_twai_wcrt_analyze(msgs, count, bitrate, res);
+    print_table(msgs, res, count);
+    printf("\n%s\n", ok ? "All deadlines met." : "Deadlines missed (or invalid input).");
+
+    if (!ok || always_suggest) {
+        suggest(msgs, count, bitrate);
+    }
+    return ok ? 0 : 1;
+}